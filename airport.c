@@ -0,0 +1,220 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "runway.h"
+#include "airport.h"
+
+static int find_end(const airport *a, const char *name)
+{
+  int i;
+
+  for (i = 0; i < a->num_ends; i++)
+  {
+    if (strcmp(a->names[i], name) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int airport_load(airport *a, const char *filename)
+{
+  FILE *fp;
+  char line[256];
+  char *tokens[5];
+  char *comment;
+  char *save;
+  int num_tokens;
+  int line_number = 0;
+  int e;
+  int f;
+
+  if ((fp = fopen(filename, "r")) == NULL)
+  {
+    printf("Cannot open airport layout %s for reading.\n", filename);
+    return -1;
+  }
+
+  memset(a, 0, sizeof(*a));
+  while (fgets(line, sizeof(line), fp))
+  {
+    line_number++;
+    if ((comment = strchr(line, '#')) != NULL)
+    {
+      *comment = '\0';
+    }
+
+    num_tokens = 0;
+    for (tokens[0] = strtok_r(line, " \t\r\n", &save);
+         tokens[num_tokens] != NULL && num_tokens < 4;
+         tokens[num_tokens] = strtok_r(NULL, " \t\r\n", &save))
+    {
+      num_tokens++;
+    }
+    tokens[num_tokens] = NULL;
+    if (num_tokens == 0)
+    {
+      continue;
+    }
+
+    if (strcmp(tokens[0], "end") == 0 && num_tokens >= 3 &&
+        (strcmp(tokens[2], "north") == 0 || strcmp(tokens[2], "south") == 0))
+    {
+      if (a->num_ends == AIRPORT_MAX_ENDS ||
+          find_end(a, tokens[1]) != -1 ||
+          strlen(tokens[1]) >= AIRPORT_NAME_SIZE)
+      {
+        fprintf(stderr, "%s:%d: runway end skipped\n", filename,
+                line_number);
+        continue;
+      }
+      e = a->num_ends++;
+      strcpy(a->names[e], tokens[1]);
+      a->direction[e] = strcmp(tokens[2], "north") == 0 ? NORTH : SOUTH;
+      a->capacity[e] = tokens[3] != NULL ? atoi(tokens[3]) : 1;
+      if (a->capacity[e] < 1)
+      {
+        a->capacity[e] = 1;
+      }
+      a->ends_for[a->direction[e]] |= 1u << e;
+    }
+    else if (strcmp(tokens[0], "conflict") == 0 && num_tokens >= 3 &&
+             (e = find_end(a, tokens[1])) != -1 &&
+             (f = find_end(a, tokens[2])) != -1 && e != f)
+    {
+      a->conflicts[e] |= 1u << f;
+      a->conflicts[f] |= 1u << e;
+    }
+    else
+    {
+      fprintf(stderr, "%s:%d: unrecognized line skipped\n", filename,
+              line_number);
+    }
+  }
+  fclose(fp);
+
+  if (a->num_ends == 0)
+  {
+    printf("Airport layout %s has no runway ends.\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+int airport_slots(const airport *a)
+{
+  int slots = 0;
+  int e;
+
+  for (e = 0; e < a->num_ends; e++)
+  {
+    slots += a->capacity[e];
+  }
+  return slots;
+}
+
+static int count_bits(unsigned int bits)
+{
+  int count = 0;
+
+  for (; bits != 0; bits &= bits - 1)
+  {
+    count++;
+  }
+  return count;
+}
+
+int airport_pick(const airport *a, int direction, int limit)
+{
+  unsigned int free_ends;
+  unsigned int candidates;
+  int best = -1;
+  int best_cost = AIRPORT_MAX_ENDS + 1;
+  int cost;
+  int e;
+
+  free_ends = ~(a->full | a->blocked);
+  candidates = a->ends_for[direction] & free_ends;
+  if (candidates == 0 || limit <= 0)
+  {
+    return -1;
+  }
+
+  /* The end that shuts out fewest other free ends of the same flow; ends
+   * of the other flow only matter after a direction switch, when the
+   * runways are empty anyway.
+   */
+  for (e = 0; candidates != 0; e++, candidates >>= 1)
+  {
+    if ((candidates & 1) == 0 || a->in_use[e] >= limit)
+    {
+      continue;
+    }
+    cost = count_bits(a->conflicts[e] & free_ends & a->ends_for[direction]);
+    if (cost < best_cost)
+    {
+      best = e;
+      best_cost = cost;
+    }
+  }
+  return best;
+}
+
+void airport_take(airport *a, int end)
+{
+  unsigned int others;
+  int f;
+
+  if (a->in_use[end]++ == 0)
+  {
+    for (others = a->conflicts[end], f = 0; others != 0; f++, others >>= 1)
+    {
+      if (others & 1)
+      {
+        a->blocking[f]++;
+        a->blocked |= 1u << f;
+      }
+    }
+  }
+  if (a->in_use[end] == a->capacity[end])
+  {
+    a->full |= 1u << end;
+  }
+  a->uses[end]++;
+}
+
+void airport_release(airport *a, int end)
+{
+  unsigned int others;
+  int f;
+
+  a->full &= ~(1u << end);
+  if (--a->in_use[end] == 0)
+  {
+    for (others = a->conflicts[end], f = 0; others != 0; f++, others >>= 1)
+    {
+      if ((others & 1) && --a->blocking[f] == 0)
+      {
+        a->blocked &= ~(1u << f);
+      }
+    }
+  }
+}
@@ -0,0 +1,74 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Airport layouts with several runways whose use can conflict.
+ *
+ * A layout lists runway ends (a runway used in one direction) and the
+ * pairs of ends that cannot be used at the same time: the two ends of one
+ * runway, runways that cross, runways whose paths intersect.  An airport
+ * works in one flow, so each end belongs to the NORTH or the SOUTH flow of
+ * the simulator.  Layout file lines:
+ *
+ *   end <name> north|south [<capacity>]   runway end, 1 aircraft by default
+ *   conflict <name> <name>                 ends that exclude each other
+ *
+ * Everything after a '#' is a comment.  Conflicts are kept as one bitmask
+ * per end, and the ends blocked by conflicts with ends in use as one more
+ * bitmask, so whether an aircraft can get a runway is a constant-time
+ * check.  Not thread safe; the simulator calls it with runway_mutex held.
+ */
+
+#ifndef AIRPORT_H
+#define AIRPORT_H
+
+#define AIRPORT_MAX_ENDS 32      /* One bit per end in an unsigned int */
+#define AIRPORT_NAME_SIZE 8
+
+typedef struct
+{
+  int num_ends;
+  char names[AIRPORT_MAX_ENDS][AIRPORT_NAME_SIZE];
+  int direction[AIRPORT_MAX_ENDS];       /* NORTH or SOUTH */
+  int capacity[AIRPORT_MAX_ENDS];
+  unsigned int conflicts[AIRPORT_MAX_ENDS];   /* ends that exclude each end */
+  unsigned int ends_for[2];              /* ends of each flow direction */
+
+  /* State while running */
+  int in_use[AIRPORT_MAX_ENDS];          /* aircraft on each end */
+  int blocking[AIRPORT_MAX_ENDS];        /* ends in use that exclude it */
+  unsigned int full;                     /* ends at capacity */
+  unsigned int blocked;                  /* ends excluded by ends in use */
+  int uses[AIRPORT_MAX_ENDS];            /* aircraft each end has taken */
+} airport;
+
+/* Reads a layout file.  Returns 0 on success, or -1 after printing why if
+ * the file cannot be read or has no usable runway end.
+ */
+int airport_load(airport *a, const char *filename);
+
+/* Total number of aircraft the layout can hold at once. */
+int airport_slots(const airport *a);
+
+/* Picks a free end for the flow direction that excludes as few of the
+ * other free ends as possible, with at most limit aircraft per end.
+ * Returns the end, or -1 if every end of that flow is full or blocked.
+ */
+int airport_pick(const airport *a, int direction, int limit);
+
+void airport_take(airport *a, int end);
+void airport_release(airport *a, int end);
+
+#endif
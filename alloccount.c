@@ -0,0 +1,82 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+#include <stddef.h>
+
+#include "alloccount.h"
+
+/* glibc's own entry points, which the replacements forward to */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static __thread unsigned long heap_calls = 0;
+
+unsigned long thread_heap_calls(void)
+{
+  return heap_calls;
+}
+
+void *malloc(size_t size)
+{
+  heap_calls++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+  heap_calls++;
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  heap_calls++;
+  return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+  if (ptr != NULL)
+  {
+    heap_calls++;
+  }
+  __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+  heap_calls++;
+  return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+  heap_calls++;
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+  heap_calls++;
+  if ((*ptr = __libc_memalign(alignment, size)) == NULL)
+  {
+    return 12;                   /* ENOMEM */
+  }
+  return 0;
+}
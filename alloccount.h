@@ -0,0 +1,32 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Heap call counting for checking builds.
+ *
+ * alloccount.c replaces malloc(), calloc(), realloc(), free() and the
+ * aligned allocators with versions that count calls per thread before
+ * handing them to the C library.  It is linked only into
+ * runway-alloccheck, which is runway built with COUNT_ALLOCATIONS and
+ * asserts that the aircraft threads make no heap calls.
+ */
+
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+/* Heap calls made by the calling thread so far. */
+unsigned long thread_heap_calls(void);
+
+#endif
@@ -0,0 +1,179 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+
+#include "arena.h"
+#include "placement.h"
+
+#define ARENA_ALIGN 16           /* Alignment of every allocation */
+
+#define ROUND_UP(size) (((size) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct arena_block
+{
+  arena_block *next;
+  size_t size;                   /* usable bytes after the header */
+};
+
+/* Blocks come from calloc(), or are mapped on the arena's node; both
+ * align them.  The data starts after the header rounded up to ARENA_ALIGN.
+ */
+#define BLOCK_HEADER ROUND_UP(sizeof(arena_block))
+#define BLOCK_DATA(b) ((char *)(b) + BLOCK_HEADER)
+
+void arena_init(arena *a)
+{
+  pthread_mutex_init(&a->lock, NULL);
+  a->blocks = NULL;
+  a->block_used = 0;
+  a->allocated = 0;
+  a->node = -1;
+}
+
+void arena_bind(arena *a, int node)
+{
+  a->node = node;
+}
+
+static arena_block *new_block(arena *a, size_t size)
+{
+  arena_block *b;
+
+  if (a->node < 0)
+  {
+    b = calloc(1, BLOCK_HEADER + size);
+  }
+  else
+  {
+    b = node_alloc(BLOCK_HEADER + size, a->node);
+  }
+  if (b != NULL)
+  {
+    b->size = size;
+  }
+  return b;
+}
+
+static void free_block(arena *a, arena_block *b)
+{
+  if (a->node < 0)
+  {
+    free(b);
+  }
+  else
+  {
+    node_free(b, BLOCK_HEADER + b->size);
+  }
+}
+
+void arena_release(arena *a)
+{
+  arena_block *b;
+
+  while ((b = a->blocks) != NULL)
+  {
+    a->blocks = b->next;
+    free_block(a, b);
+  }
+  a->block_used = 0;
+  a->allocated = 0;
+  pthread_mutex_destroy(&a->lock);
+}
+
+/* Takes size bytes from the newest block, starting a new block when it is
+ * full.  Called with the arena locked.
+ */
+static char *take(arena *a, size_t size)
+{
+  arena_block *b;
+  char *p;
+
+  if (size > ARENA_BLOCK_SIZE / 4)
+  {
+    /* A big request gets a block of its own behind the current one, so
+     * the rest of the current block stays in use.
+     */
+    if ((b = new_block(a, size)) == NULL)
+    {
+      return NULL;
+    }
+    a->allocated += size;
+    if (a->blocks == NULL)
+    {
+      a->blocks = b;
+      b->next = NULL;
+      a->block_used = size;
+    }
+    else
+    {
+      b->next = a->blocks->next;
+      a->blocks->next = b;
+    }
+    return BLOCK_DATA(b);
+  }
+
+  if (a->blocks == NULL || a->block_used + size > a->blocks->size)
+  {
+    if ((b = new_block(a, ARENA_BLOCK_SIZE)) == NULL)
+    {
+      return NULL;
+    }
+    b->next = a->blocks;
+    a->blocks = b;
+    a->block_used = 0;
+    a->allocated += ARENA_BLOCK_SIZE;
+  }
+  p = BLOCK_DATA(a->blocks) + a->block_used;
+  a->block_used += size;
+  return p;
+}
+
+void arena_cache_init(arena_cache *c, arena *a)
+{
+  c->owner = a;
+  c->next = NULL;
+  c->end = NULL;
+}
+
+void *arena_alloc(arena_cache *c, size_t size)
+{
+  char *p;
+
+  size = ROUND_UP(size > 0 ? size : 1);
+  if (c->next != NULL && size <= (size_t)(c->end - c->next))
+  {
+    p = c->next;
+    c->next += size;
+    return p;
+  }
+
+  pthread_mutex_lock(&c->owner->lock);
+  if (size > ARENA_CHUNK_SIZE / 2)
+  {
+    /* Too big to be worth a chunk; keep the current one */
+    p = take(c->owner, size);
+  }
+  else if ((p = take(c->owner, ARENA_CHUNK_SIZE)) != NULL)
+  {
+    c->next = p + size;
+    c->end = p + ARENA_CHUNK_SIZE;
+  }
+  pthread_mutex_unlock(&c->owner->lock);
+  return p;
+}
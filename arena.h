@@ -0,0 +1,73 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Arena allocator for the state of one simulation run.
+ *
+ * An arena hands out memory from large blocks and gives it all back in
+ * one step when the run is over; nothing is freed on its own.  Threads
+ * allocate through their own arena_cache, a chunk of a block that they
+ * bump through without locking.  Only carving a new chunk out of the
+ * arena takes the arena's mutex, and requests too big for a chunk get a
+ * block of their own.  Memory is zeroed and aligned for any type.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define ARENA_BLOCK_SIZE 65536   /* Bytes in an ordinary arena block */
+#define ARENA_CHUNK_SIZE 4096    /* Bytes a cache takes from the arena at once */
+
+typedef struct arena_block arena_block;
+
+typedef struct
+{
+  pthread_mutex_t lock;
+  arena_block *blocks;           /* newest first */
+  size_t block_used;             /* bytes handed out of the newest block */
+  size_t allocated;              /* bytes in all blocks */
+  int node;                      /* NUMA node blocks are bound to, or -1 */
+} arena;
+
+typedef struct
+{
+  arena *owner;
+  char *next;                    /* next free byte of the chunk */
+  char *end;
+} arena_cache;
+
+void arena_init(arena *a);
+
+/* Places the blocks allocated from now on on a NUMA node, or anywhere
+ * for -1.  Call it before the first allocation.
+ */
+void arena_bind(arena *a, int node);
+
+/* Gives every block back to the system.  The arena can be used again
+ * after arena_init().
+ */
+void arena_release(arena *a);
+
+void arena_cache_init(arena_cache *c, arena *a);
+
+/* Returns size zeroed bytes from the cache's chunk, taking a new chunk
+ * from the arena when it runs out.  Returns NULL if memory runs out.
+ */
+void *arena_alloc(arena_cache *c, size_t size);
+
+#endif
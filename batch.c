@@ -0,0 +1,415 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "batch.h"
+
+#define ITEM_OK 0                /* the trace ran to the end */
+#define ITEM_FAILED -1           /* it could not be read or run */
+#define ITEM_STOPPED 1           /* batch_stop() ended it part way */
+#define ITEM_SKIPPED 2           /* batch_stop() came before it started */
+#define ITEM_STALLED 3           /* the stall watchdog abandoned it */
+
+typedef struct
+{
+  char *name;               /* file name within the directory */
+  char *path;
+  int status;               /* ITEM_* */
+  runway_sim *sim;          /* the simulation while it runs */
+  runway_metrics metrics;
+} batch_item;
+
+typedef struct
+{
+  const runway_config *config;
+  int nodes;                /* NUMA nodes to spread the traces over, or 0 */
+  batch_item *items;
+  int num_items;
+  int next;                 /* next trace to hand out */
+  int stopping;             /* set by batch_stop() */
+  struct timespec stop_at;  /* when batch_stop() was first called */
+  pthread_mutex_t mutex;
+} batch_queue;
+
+/* The batch in progress, for batch_stop() */
+static batch_queue *running;
+static pthread_mutex_t running_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int by_name(const void *a, const void *b)
+{
+  const batch_item *x = a;
+  const batch_item *y = b;
+
+  return strcmp(x->name, y->name);
+}
+
+static int is_trace(const char *name)
+{
+  size_t length = strlen(name);
+  size_t suffix = strlen(BATCH_SUFFIX);
+
+  return name[0] != '.' && length > suffix &&
+         strcmp(name + length - suffix, BATCH_SUFFIX) == 0;
+}
+
+/* Lists the traces in dir, sorted by name.  Returns their number or -1. */
+static int list_traces(const char *dir, batch_item **items)
+{
+  DIR *d;
+  struct dirent *entry;
+  batch_item *list = NULL;
+  int count = 0;
+  int size = 0;
+
+  if ((d = opendir(dir)) == NULL)
+  {
+    fprintf(stderr, "runway: cannot read directory %s\n", dir);
+    return -1;
+  }
+
+  while ((entry = readdir(d)) != NULL)
+  {
+    if (!is_trace(entry->d_name))
+    {
+      continue;
+    }
+    if (count == size)
+    {
+      size = size > 0 ? size * 2 : 64;
+      list = realloc(list, sizeof(batch_item) * size);
+    }
+    memset(&list[count], 0, sizeof(batch_item));
+    list[count].name = strdup(entry->d_name);
+    if (asprintf(&list[count].path, "%s/%s", dir, entry->d_name) < 0)
+    {
+      list[count].path = NULL;
+    }
+    list[count].status = ITEM_SKIPPED;
+    count++;
+  }
+  closedir(d);
+
+  qsort(list, count, sizeof(batch_item), by_name);
+  *items = list;
+  return count;
+}
+
+/* Runs one trace as its own simulation, with no log.  The simulation is
+ * published in the item while it runs so that batch_stop() can reach it.
+ * A trace that deadlocks is abandoned after the stall limit and keeps
+ * the metrics of the aircraft that got through.
+ */
+static void run_item(batch_queue *q, batch_item *item)
+{
+  runway_config config = *q->config;
+  runway_sim *sim;
+  int result;
+
+  if (q->nodes > 0)
+  {
+    config.numa_node = (int)(item - q->items) % q->nodes;
+  }
+  if (config.stall_limit <= 0)
+  {
+    config.stall_limit = BATCH_STALL;
+  }
+  item->status = ITEM_FAILED;
+  if (item->path == NULL || (sim = runway_create(&config)) == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock(&q->mutex);
+  item->sim = sim;
+  pthread_mutex_unlock(&q->mutex);
+
+  if (runway_load_file(sim, item->path) == 0)
+  {
+    result = runway_run(sim);
+    runway_get_metrics(sim, &item->metrics);
+    if (result == 0)
+    {
+      item->status = item->metrics.stopped ? ITEM_STOPPED : ITEM_OK;
+    }
+    else if (item->metrics.gave_up > 0 && !item->metrics.stopped)
+    {
+      item->status = ITEM_STALLED;
+    }
+  }
+
+  pthread_mutex_lock(&q->mutex);
+  item->sim = NULL;
+  pthread_mutex_unlock(&q->mutex);
+  runway_destroy(sim);
+}
+
+/* Code for one worker of the pool: takes traces until none are left. */
+static void * batch_worker(void *arg)
+{
+  batch_queue *q = (batch_queue *)arg;
+  int i;
+
+  while (1)
+  {
+    pthread_mutex_lock(&q->mutex);
+    i = q->next < q->num_items && !q->stopping ? q->next++ : -1;
+    pthread_mutex_unlock(&q->mutex);
+    if (i < 0)
+    {
+      break;
+    }
+    run_item(q, &q->items[i]);
+  }
+
+  return NULL;
+}
+
+static const char *status_name(int status)
+{
+  switch (status)
+  {
+    case ITEM_OK:
+      return "ok";
+    case ITEM_STOPPED:
+      return "stopped";
+    case ITEM_SKIPPED:
+      return "skipped";
+    case ITEM_STALLED:
+      return "stalled";
+  }
+  return "error";
+}
+
+/* Items that ran, even part way, have metrics to report. */
+static int has_metrics(const batch_item *item)
+{
+  return item->status == ITEM_OK || item->status == ITEM_STOPPED ||
+         item->status == ITEM_STALLED;
+}
+
+static double per_hour(long count, double makespan)
+{
+  return makespan > 0 ? count * 3600 / makespan : 0;
+}
+
+/* Writes a string as a CSV field or a JSON string. */
+static void write_name(FILE *fp, const char *name, int format)
+{
+  int quote = format == BATCH_JSON || strpbrk(name, ",\"\n") != NULL;
+
+  if (quote)
+  {
+    fputc('"', fp);
+  }
+  for (; *name != '\0'; name++)
+  {
+    if (*name == '"')
+    {
+      fputc(format == BATCH_JSON ? '\\' : '"', fp);
+    }
+    else if (*name == '\\' && format == BATCH_JSON)
+    {
+      fputc('\\', fp);
+    }
+    fputc(*name, fp);
+  }
+  if (quote)
+  {
+    fputc('"', fp);
+  }
+}
+
+static void write_csv(FILE *fp, const batch_item *items, int count)
+{
+  const runway_metrics *m;
+  int i;
+
+  fprintf(fp, "scenario,status,aircraft,landed,departed,diverted,makespan,"
+          "arrivals_per_hour,departures_per_hour,average_wait,wait_p50,"
+          "wait_p90,wait_p99,max_wait,fuel_emergencies,direction_switches,"
+          "controller_breaks,controller_shifts\n");
+  for (i = 0; i < count; i++)
+  {
+    m = &items[i].metrics;
+    write_name(fp, items[i].name, BATCH_CSV);
+    if (!has_metrics(&items[i]))
+    {
+      fprintf(fp, ",%s,,,,,,,,,,,,,,,,\n", status_name(items[i].status));
+      continue;
+    }
+    fprintf(fp, ",%s,%ld,%ld,%ld,%ld,%.3f,%.1f,%.1f,%.3f,%.3f,%.3f,%.3f,"
+            "%.3f,%d,%d,%d,%d\n", status_name(items[i].status),
+            m->aircraft, m->landed, m->departed, m->diverted, m->makespan,
+            per_hour(m->landed, m->makespan),
+            per_hour(m->departed, m->makespan), m->average_wait,
+            m->wait_p50, m->wait_p90, m->wait_p99, m->max_wait,
+            m->fuel_emergencies, m->direction_switches,
+            m->controller_breaks, m->controller_shifts);
+  }
+}
+
+static void write_json(FILE *fp, const batch_item *items, int count)
+{
+  const runway_metrics *m;
+  int i;
+
+  fprintf(fp, "[\n");
+  for (i = 0; i < count; i++)
+  {
+    m = &items[i].metrics;
+    fprintf(fp, "  {\"scenario\": ");
+    write_name(fp, items[i].name, BATCH_JSON);
+    if (!has_metrics(&items[i]))
+    {
+      fprintf(fp, ", \"status\": \"%s\"}", status_name(items[i].status));
+    }
+    else
+    {
+      fprintf(fp, ", \"status\": \"%s\", \"aircraft\": %ld, "
+              "\"landed\": %ld, \"departed\": %ld, \"diverted\": %ld, "
+              "\"makespan\": %.3f, \"arrivals_per_hour\": %.1f, "
+              "\"departures_per_hour\": %.1f, \"average_wait\": %.3f, "
+              "\"wait_p50\": %.3f, \"wait_p90\": %.3f, \"wait_p99\": %.3f, "
+              "\"max_wait\": %.3f, \"fuel_emergencies\": %d, "
+              "\"direction_switches\": %d, \"controller_breaks\": %d, "
+              "\"controller_shifts\": %d}", status_name(items[i].status),
+              m->aircraft, m->landed, m->departed, m->diverted,
+              m->makespan, per_hour(m->landed, m->makespan),
+              per_hour(m->departed, m->makespan), m->average_wait,
+              m->wait_p50, m->wait_p90, m->wait_p99, m->max_wait,
+              m->fuel_emergencies, m->direction_switches,
+              m->controller_breaks, m->controller_shifts);
+    }
+    fprintf(fp, "%s\n", i + 1 < count ? "," : "");
+  }
+  fprintf(fp, "]\n");
+}
+
+static double wall_since(const struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void batch_stop(int policy)
+{
+  int i;
+
+  pthread_mutex_lock(&running_mutex);
+  if (running != NULL)
+  {
+    pthread_mutex_lock(&running->mutex);
+    if (!running->stopping)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &running->stop_at);
+    }
+    running->stopping = 1;
+    for (i = 0; i < running->num_items; i++)
+    {
+      if (running->items[i].sim != NULL)
+      {
+        runway_stop(running->items[i].sim, policy);
+      }
+    }
+    pthread_mutex_unlock(&running->mutex);
+  }
+  pthread_mutex_unlock(&running_mutex);
+}
+
+int batch_run(const runway_config *config, const char *dir, int jobs,
+              int format, int spread, FILE *fp)
+{
+  batch_queue q;
+  pthread_t *workers;
+  int started;
+  int failed = 0;
+  int i;
+
+  if ((q.num_items = list_traces(dir, &q.items)) < 0)
+  {
+    return -1;
+  }
+  q.config = config;
+  q.nodes = spread ? runway_numa_nodes() : 0;
+  q.next = 0;
+  q.stopping = 0;
+  pthread_mutex_init(&q.mutex, NULL);
+  pthread_mutex_lock(&running_mutex);
+  running = &q;
+  pthread_mutex_unlock(&running_mutex);
+
+  if (jobs > q.num_items)
+  {
+    jobs = q.num_items;
+  }
+  workers = malloc(sizeof(pthread_t) * (jobs + 1));
+  for (started = 0; started < jobs; started++)
+  {
+    if (pthread_create(&workers[started], NULL, batch_worker, &q))
+    {
+      break;
+    }
+  }
+  if (started == 0)
+  {
+    /* No worker could be started: run the traces on this thread */
+    batch_worker(&q);
+  }
+  for (i = 0; i < started; i++)
+  {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+
+  pthread_mutex_lock(&running_mutex);
+  running = NULL;
+  pthread_mutex_unlock(&running_mutex);
+  pthread_mutex_destroy(&q.mutex);
+  if (q.stopping)
+  {
+    fprintf(stderr, "runway: batch stopped, %d of %d traces not started, "
+            "shutdown took %.3f s\n", q.num_items - q.next, q.num_items,
+            wall_since(&q.stop_at));
+  }
+
+  if (format == BATCH_JSON)
+  {
+    write_json(fp, q.items, q.num_items);
+  }
+  else
+  {
+    write_csv(fp, q.items, q.num_items);
+  }
+
+  for (i = 0; i < q.num_items; i++)
+  {
+    failed |= q.items[i].status != ITEM_OK;
+    free(q.items[i].name);
+    free(q.items[i].path);
+  }
+  free(q.items);
+  return failed;
+}
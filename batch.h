@@ -0,0 +1,53 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Batch mode (runway --batch DIR): every trace in a directory is run as
+ * an independent simulation in one process.  A pool of worker threads
+ * takes the traces in turn, and one summary row per trace is written as
+ * CSV or JSON once all of them have run.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "librunway.h"
+
+#define BATCH_SPEED 100          /* Default clock speed of batch runs */
+#define BATCH_SUFFIX ".txt"      /* Files in the directory that are traces */
+#define BATCH_STALL 600          /* Simulated seconds of stall that end a trace */
+
+#define BATCH_CSV 0
+#define BATCH_JSON 1
+
+/* Runs every trace in dir with the given configuration, jobs at a time,
+ * and writes the rows to fp in the given format.  With spread, the traces
+ * are bound in turn to the NUMA nodes of the machine, each with its
+ * threads and memory on one node.  A trace that stalls for BATCH_STALL
+ * simulated seconds, unless the configuration sets its own stall_limit,
+ * is abandoned.  Returns 0 if every trace ran, 1 if some failed (they get
+ * an error row), stalled or were stopped, or -1 if the directory cannot
+ * be read.
+ */
+int batch_run(const runway_config *config, const char *dir, int jobs,
+              int format, int spread, FILE *fp);
+
+/* Stops the batch in progress, from another thread: traces not yet
+ * started are skipped and the running ones get runway_stop() with the
+ * given policy.  Their rows say "stopped" or "skipped".
+ */
+void batch_stop(int policy);
+
+#endif
@@ -0,0 +1,230 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "runway.h"
+#include "estimate.h"
+
+#define ESTIMATE_ITERATIONS 200  /* most fixed-point iterations */
+#define ESTIMATE_TOLERANCE 1e-6  /* seconds of wait change that converge */
+#define ESTIMATE_DAMPING 0.5     /* share of the new waits taken per step */
+
+void estimate_defaults(estimate_input *in)
+{
+  memset(in, 0, sizeof(*in));
+  in->capacity = MAX_RUNWAY_CAPACITY;
+  in->direction_limit = DIRECTION_LIMIT;
+  in->fairness_limit = FAIRNESS_LIMIT;
+  in->controller_limit = CONTROLLER_LIMIT;
+  in->switch_time = DIRECTION_SWITCH_TIME;
+  in->break_time = BREAK_TIME;
+}
+
+int estimate_from_scenario(estimate_input *in, const scenario *s)
+{
+  double span;
+  double t;
+  int counts[3] = { 0, 0, 0 };
+  int i;
+
+  if (s->num_aircraft < 2)
+  {
+    return -1;
+  }
+  in->runway_mean = 0;
+  in->runway_square = 0;
+  for (i = 0; i < s->num_aircraft; i++)
+  {
+    t = s->aircraft[i].runway_time;
+    counts[s->aircraft[i].aircraft_type]++;
+    in->runway_mean += t;
+    in->runway_square += t * t;
+  }
+  in->runway_mean /= s->num_aircraft;
+  in->runway_square /= s->num_aircraft;
+
+  /* n arrivals span n - 1 gaps */
+  span = s->aircraft[s->num_aircraft - 1].arrival - s->aircraft[0].arrival;
+  span = span > 0 ? span * s->num_aircraft / (s->num_aircraft - 1) : 1;
+  for (i = 0; i < 3; i++)
+  {
+    in->rate[i] = counts[i] / span;
+  }
+  return 0;
+}
+
+/* Probability that an arrival waits in M/M/c with offered load a < c,
+ * and in p0 the probability of an empty system.
+ */
+static double erlang_c(int c, double a, double *p0)
+{
+  double term = 1;
+  double sum = 0;
+  double tail;
+  int k;
+
+  for (k = 0; k < c; k++)
+  {
+    sum += term;
+    term *= a / (k + 1);
+  }
+  tail = term * c / (c - a);
+  *p0 = 1 / (sum + tail);
+  return tail / (sum + tail);
+}
+
+/* Aircraft served per visit to a direction: the natural run of the class
+ * in the arrival stream (1 / share of the other class), or with a queue,
+ * as many as are waiting up to the limit.
+ */
+static double visit_length(double rate, double other_rate, double queue,
+                           int limit)
+{
+  double natural = (rate + other_rate) / other_rate;
+  double batch = 1 + queue < limit ? 1 + queue : limit;
+
+  return natural > batch ? natural : batch;
+}
+
+int estimate_run(const estimate_input *in, estimate_result *result)
+{
+  double rc = in->rate[COMMERCIAL];
+  double rg = in->rate[CARGO];
+  double re = in->rate[EMERGENCY];
+  double regular = rc + rg;
+  double total = regular + re;
+  double m = in->runway_mean;
+  double residual = m > 0 ? in->runway_square / (2 * m) : 0;
+  double c = in->capacity;
+  double drain = residual * (c - 1) / c;
+  double per_break = in->controller_limit > 0 ?
+                     1.0 / in->controller_limit : 0;
+  int limit = in->direction_limit < in->fairness_limit ?
+              in->direction_limit : in->fairness_limit;
+  double wait_c = 0;
+  double wait_g = 0;
+  double wait_e = 0;
+  double switches = 0;      /* switches per regular aircraft */
+  double service;
+  double variance;
+  double overhead;
+  double cs2;
+  double a;
+  double p0 = 1;
+  double rho;
+  double rho_e;
+  double queued;
+  double vacation;
+  double new_c;
+  double new_g;
+  double new_e;
+  double share;
+  int i;
+
+  memset(result, 0, sizeof(*result));
+  result->utilization = total * m / c;
+  if (total <= 0)
+  {
+    return 0;
+  }
+
+  for (i = 0; i < ESTIMATE_ITERATIONS; i++)
+  {
+    /* Switches from the visit lengths, which depend on the queues */
+    switches = 0;
+    if (rc > 0 && rg > 0)
+    {
+      switches = 2 / (visit_length(rc, rg, rc * wait_c, limit) +
+                      visit_length(rg, rc, rg * wait_g, limit));
+    }
+
+    /* Overheads spread over every aircraft as lost capacity of all the
+     * runway slots
+     */
+    overhead = (regular * switches * (in->switch_time + drain) +
+                total * per_break * (in->break_time + drain)) / total;
+    service = m + c * overhead;
+    share = regular / total;
+    variance = in->runway_square - m * m +
+               c * c * (share * switches * (1 - share * switches) *
+                        pow(in->switch_time + drain, 2) +
+                        per_break * (1 - per_break) *
+                        pow(in->break_time + drain, 2));
+    a = total * service;
+    result->load = a / c;
+    if (a >= c)
+    {
+      return -1;
+    }
+    cs2 = variance / (service * service);
+    queued = erlang_c(in->capacity, a, &p0) * service / (c - a) *
+             (1 + cs2) / 2;
+
+    /* Non-preemptive priority for emergencies */
+    rho = a / c;
+    rho_e = re * service / c;
+    vacation = (regular * switches * in->switch_time * in->switch_time +
+                total * per_break * in->break_time * in->break_time) / 2;
+    new_e = queued * (1 - rho) / (1 - rho_e) + vacation;
+    new_c = queued / (1 - rho_e) + vacation;
+    new_g = new_c;
+
+    /* A regular arrival at a quiet runway set the other way waits for a
+     * switch, and one behind the other class for it to clear as well.
+     * Under load that delay is part of the queueing already.
+     */
+    if (regular > 0)
+    {
+      new_c += rg / regular * in->switch_time * p0 +
+               rg * m * (residual + in->switch_time) * (1 - rho);
+      new_g += rc / regular * in->switch_time * p0 +
+               rc * m * (residual + in->switch_time) * (1 - rho);
+    }
+
+    new_c = ESTIMATE_DAMPING * new_c + (1 - ESTIMATE_DAMPING) * wait_c;
+    new_g = ESTIMATE_DAMPING * new_g + (1 - ESTIMATE_DAMPING) * wait_g;
+    new_e = ESTIMATE_DAMPING * new_e + (1 - ESTIMATE_DAMPING) * wait_e;
+    if (fabs(new_c - wait_c) < ESTIMATE_TOLERANCE &&
+        fabs(new_g - wait_g) < ESTIMATE_TOLERANCE &&
+        fabs(new_e - wait_e) < ESTIMATE_TOLERANCE)
+    {
+      i++;
+      wait_c = new_c;
+      wait_g = new_g;
+      wait_e = new_e;
+      break;
+    }
+    wait_c = new_c;
+    wait_g = new_g;
+    wait_e = new_e;
+  }
+
+  result->iterations = i;
+  result->wait[COMMERCIAL] = wait_c;
+  result->wait[CARGO] = wait_g;
+  result->wait[EMERGENCY] = wait_e;
+  result->average_wait = (rc * wait_c + rg * wait_g + re * wait_e) / total;
+  /* Switches and breaks delay aircraft but leave the share of time
+   * someone is on the runway as it is without them
+   */
+  erlang_c(in->capacity, total * m, &p0);
+  result->occupied = 1 - p0;
+  result->switches_per_hour = regular * switches * 3600;
+  result->breaks_per_hour = total * per_break * 3600;
+  return 0;
+}
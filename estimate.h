@@ -0,0 +1,91 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Analytical estimate of runway waits and utilization.
+ *
+ * Answers "what waits does this traffic give" in microseconds instead of
+ * a simulation.  The runway is taken as an M/G/c queue, c the runway
+ * capacity, with the rules folded in as overheads and extra delays:
+ *
+ *   - direction switches are switchover times between the commercial
+ *     (north) and cargo (south) classes.  A visit to one direction lasts
+ *     for the natural run of that class in the arrival stream, or, once
+ *     the queue is long, up to the direction limit; the number of
+ *     switches follows from the queue lengths, which follow from the
+ *     waits, so the estimate is iterated to a fixed point.
+ *   - controller breaks are server vacations, one every controller limit
+ *     aircraft.
+ *   - both need the runway empty, which idles the other servers for the
+ *     residual runway time of the last aircraft.
+ *   - emergencies are a non-preemptive priority class that goes in
+ *     whatever direction the runway is set.
+ *
+ * The overheads lengthen the effective service time, whose mean and
+ * variance go into the Allen-Cunneen approximation of the M/G/c wait,
+ * which is then split between the priority classes.  Arrivals that find a
+ * switch or break in progress wait for the rest of it, and a regular
+ * arrival at a quiet runway set the other way waits for a switch.  Fuel
+ * emergencies, departures, wake separation and holding are not modeled.
+ * The approximations are rough near saturation; runway-estimate -V
+ * checks them against simulation.
+ */
+
+#ifndef ESTIMATE_H
+#define ESTIMATE_H
+
+#include "scenario.h"
+
+typedef struct
+{
+  double rate[3];           /* arrivals per second by COMMERCIAL, CARGO
+                               and EMERGENCY */
+  double runway_mean;       /* mean runway time, seconds */
+  double runway_square;     /* mean of the squared runway time */
+  int capacity;             /* aircraft on the runway at once */
+  int direction_limit;
+  int fairness_limit;
+  int controller_limit;
+  double switch_time;
+  double break_time;
+} estimate_input;
+
+typedef struct
+{
+  double wait[3];           /* mean admission wait by type */
+  double average_wait;      /* over all aircraft */
+  double utilization;       /* busy share of each runway slot */
+  double occupied;          /* share of time with aircraft on the runway */
+  double load;              /* utilization with the overheads counted */
+  double switches_per_hour;
+  double breaks_per_hour;
+  int iterations;           /* fixed-point iterations taken */
+} estimate_result;
+
+/* Sets the rules to those of runway.h and the traffic to none. */
+void estimate_defaults(estimate_input *in);
+
+/* Takes the arrival rates and the runway time moments from a scenario,
+ * rates over the span from the first to the last arrival.  Returns 0, or
+ * -1 if the scenario has fewer than two aircraft.
+ */
+int estimate_from_scenario(estimate_input *in, const scenario *s);
+
+/* Estimates waits and utilization.  Returns 0, or -1 if the traffic
+ * saturates the runway; result then has the utilization and load only.
+ */
+int estimate_run(const estimate_input *in, estimate_result *result);
+
+#endif
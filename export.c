@@ -0,0 +1,243 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Export of per-aircraft outcomes (runway_export_csv() and
+ * runway_export_columns() in librunway.h).  Both writers go through a
+ * large stdio buffer, and the columnar one gathers each column of a chunk
+ * into one array that is written with a single fwrite(), so the export
+ * costs little next to the run itself.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "librunway.h"
+
+#define EXPORT_BUFFER_SIZE (1 << 20)     /* stdio buffer of an export file */
+#define EXPORT_CHUNK_ROWS 65536          /* rows per column chunk */
+
+#define COLUMN_INT32 1
+#define COLUMN_FLOAT64 2
+
+typedef struct
+{
+  const char *name;
+  int type;                 /* COLUMN_* */
+  size_t offset;            /* of the field in runway_outcome */
+} export_column;
+
+static const export_column columns[] =
+{
+  { "id", COLUMN_INT32, offsetof(runway_outcome, aircraft_id) },
+  { "type", COLUMN_INT32, offsetof(runway_outcome, aircraft_type) },
+  { "departure", COLUMN_INT32, offsetof(runway_outcome, departure) },
+  { "arrival", COLUMN_FLOAT64, offsetof(runway_outcome, arrival) },
+  { "fuel", COLUMN_INT32, offsetof(runway_outcome, fuel_reserve) },
+  { "admitted", COLUMN_FLOAT64, offsetof(runway_outcome, admitted_at) },
+  { "direction", COLUMN_INT32, offsetof(runway_outcome, direction) },
+  { "cleared", COLUMN_FLOAT64, offsetof(runway_outcome, cleared_at) },
+  { "wait", COLUMN_FLOAT64, offsetof(runway_outcome, wait) },
+  { "fuel_emergency", COLUMN_INT32,
+    offsetof(runway_outcome, fuel_emergency) },
+  { "diverted", COLUMN_INT32, offsetof(runway_outcome, diverted) },
+  { "blocked_runway", COLUMN_FLOAT64,
+    offsetof(runway_outcome, blocked[RUNWAY_BLOCK_RUNWAY]) },
+  { "blocked_controller", COLUMN_FLOAT64,
+    offsetof(runway_outcome, blocked[RUNWAY_BLOCK_CONTROLLER]) },
+  { "blocked_direction", COLUMN_FLOAT64,
+    offsetof(runway_outcome, blocked[RUNWAY_BLOCK_DIRECTION]) },
+  { "blocked_type", COLUMN_FLOAT64,
+    offsetof(runway_outcome, blocked[RUNWAY_BLOCK_TYPE]) },
+  { "blocked_priority", COLUMN_FLOAT64,
+    offsetof(runway_outcome, blocked[RUNWAY_BLOCK_PRIORITY]) },
+  { "blocked_fairness", COLUMN_FLOAT64,
+    offsetof(runway_outcome, blocked[RUNWAY_BLOCK_FAIRNESS]) },
+  { "blocked_separation", COLUMN_FLOAT64,
+    offsetof(runway_outcome, blocked[RUNWAY_BLOCK_SEPARATION]) }
+};
+
+#define NUM_COLUMNS ((int)(sizeof(columns) / sizeof(columns[0])))
+
+/* Fetches the outcomes of a finished run.  Returns their number, or -1. */
+static long get_outcomes(runway_sim *sim, runway_outcome **outcomes)
+{
+  long count = runway_get_outcomes(sim, NULL, 0);
+
+  if ((*outcomes = malloc(sizeof(runway_outcome) * (count + 1))) == NULL)
+  {
+    return -1;
+  }
+  return runway_get_outcomes(sim, *outcomes, count);
+}
+
+/* Opens an export file with a large buffer, or returns NULL. */
+static FILE *open_export(const char *filename, char **buffer)
+{
+  FILE *fp;
+
+  if ((fp = fopen(filename, "wb")) == NULL)
+  {
+    return NULL;
+  }
+  if ((*buffer = malloc(EXPORT_BUFFER_SIZE)) != NULL)
+  {
+    setvbuf(fp, *buffer, _IOFBF, EXPORT_BUFFER_SIZE);
+  }
+  return fp;
+}
+
+/* Closes an export file and returns 0, or -1 if anything failed. */
+static int close_export(FILE *fp, char *buffer, runway_outcome *outcomes)
+{
+  int result = ferror(fp) ? -1 : 0;
+
+  if (fclose(fp) != 0)
+  {
+    result = -1;
+  }
+  free(buffer);
+  free(outcomes);
+  return result;
+}
+
+int runway_export_csv(runway_sim *sim, const char *filename)
+{
+  runway_outcome *outcomes;
+  const runway_outcome *o;
+  char *buffer = NULL;
+  FILE *fp;
+  long count;
+  long i;
+  int c;
+
+  if ((count = get_outcomes(sim, &outcomes)) < 0)
+  {
+    return -1;
+  }
+  if ((fp = open_export(filename, &buffer)) == NULL)
+  {
+    free(outcomes);
+    return -1;
+  }
+
+  for (c = 0; c < NUM_COLUMNS; c++)
+  {
+    fprintf(fp, "%s%c", columns[c].name, c + 1 < NUM_COLUMNS ? ',' : '\n');
+  }
+  for (i = 0; i < count; i++)
+  {
+    o = &outcomes[i];
+    fprintf(fp, "%d,%d,%d,%.3f,%d,%.3f,%d,%.3f,%.3f,%d,%d,"
+            "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+            o->aircraft_id, o->aircraft_type, o->departure, o->arrival,
+            o->fuel_reserve, o->admitted_at, o->direction, o->cleared_at,
+            o->wait, o->fuel_emergency, o->diverted,
+            o->blocked[RUNWAY_BLOCK_RUNWAY],
+            o->blocked[RUNWAY_BLOCK_CONTROLLER],
+            o->blocked[RUNWAY_BLOCK_DIRECTION],
+            o->blocked[RUNWAY_BLOCK_TYPE],
+            o->blocked[RUNWAY_BLOCK_PRIORITY],
+            o->blocked[RUNWAY_BLOCK_FAIRNESS],
+            o->blocked[RUNWAY_BLOCK_SEPARATION]);
+  }
+
+  return close_export(fp, buffer, outcomes);
+}
+
+/* Writes one column of the rows first .. first + rows - 1, gathered into
+ * chunk.
+ */
+static void write_column(FILE *fp, const export_column *column,
+                         const runway_outcome *outcomes, long first,
+                         long rows, void *chunk)
+{
+  int32_t *ints = chunk;
+  double *doubles = chunk;
+  const char *field;
+  long i;
+
+  for (i = 0; i < rows; i++)
+  {
+    field = (const char *)&outcomes[first + i] + column->offset;
+    if (column->type == COLUMN_INT32)
+    {
+      ints[i] = *(const int *)field;
+    }
+    else
+    {
+      doubles[i] = *(const double *)field;
+    }
+  }
+  fwrite(chunk, column->type == COLUMN_INT32 ? sizeof(int32_t) :
+                sizeof(double), rows, fp);
+}
+
+int runway_export_columns(runway_sim *sim, const char *filename)
+{
+  runway_outcome *outcomes;
+  char *buffer = NULL;
+  double *chunk;
+  FILE *fp;
+  uint32_t header[2];
+  uint64_t num_rows;
+  unsigned char descriptor[2];
+  long count;
+  long first;
+  long rows;
+  int c;
+
+  if ((count = get_outcomes(sim, &outcomes)) < 0)
+  {
+    return -1;
+  }
+  if ((chunk = malloc(sizeof(double) * EXPORT_CHUNK_ROWS)) == NULL ||
+      (fp = open_export(filename, &buffer)) == NULL)
+  {
+    free(chunk);
+    free(outcomes);
+    return -1;
+  }
+
+  header[0] = NUM_COLUMNS;
+  header[1] = EXPORT_CHUNK_ROWS;
+  num_rows = (uint64_t)count;
+  fwrite("RWYCOL01", 1, 8, fp);
+  fwrite(header, sizeof(header), 1, fp);
+  fwrite(&num_rows, sizeof(num_rows), 1, fp);
+  for (c = 0; c < NUM_COLUMNS; c++)
+  {
+    descriptor[0] = (unsigned char)columns[c].type;
+    descriptor[1] = (unsigned char)strlen(columns[c].name);
+    fwrite(descriptor, 1, 2, fp);
+    fwrite(columns[c].name, 1, descriptor[1], fp);
+  }
+
+  for (first = 0; first < count; first += rows)
+  {
+    rows = count - first < EXPORT_CHUNK_ROWS ? count - first :
+                                               EXPORT_CHUNK_ROWS;
+    for (c = 0; c < NUM_COLUMNS; c++)
+    {
+      write_column(fp, &columns[c], outcomes, first, rows, chunk);
+    }
+  }
+
+  free(chunk);
+  return close_export(fp, buffer, outcomes);
+}
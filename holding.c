@@ -0,0 +1,79 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+#include <assert.h>
+
+#include "holding.h"
+
+void holding_init(holding_stack *h, int num_levels)
+{
+  int i;
+
+  assert(num_levels >= 0 && num_levels <= HOLDING_MAX_LEVELS);
+
+  h->num_levels = num_levels;
+  for (i = 0; i < num_levels; i++)
+  {
+    h->free_levels[i] = i;
+  }
+  h->first_free = 0;
+  h->num_free = num_levels;
+  h->peak_occupancy = 0;
+  h->diversions_full = 0;
+  h->diversions_fuel = 0;
+  h->fuel_burned = 0;
+}
+
+int holding_enter(holding_stack *h)
+{
+  int level;
+
+  if (h->num_free == 0)
+  {
+    return HOLDING_NONE;
+  }
+
+  level = h->free_levels[h->first_free];
+  h->first_free = (h->first_free + 1) % h->num_levels;
+  h->num_free--;
+
+  if (h->num_levels - h->num_free > h->peak_occupancy)
+  {
+    h->peak_occupancy = h->num_levels - h->num_free;
+  }
+  return level;
+}
+
+void holding_leave(holding_stack *h, int level)
+{
+  assert(level >= 0 && level < h->num_levels);
+  assert(h->num_free < h->num_levels);
+
+  h->free_levels[(h->first_free + h->num_free) % h->num_levels] = level;
+  h->num_free++;
+}
+
+double holding_burn_rate(const holding_stack *h, int level)
+{
+  if (h->num_levels < 2)
+  {
+    return HOLDING_BURN_LOW;
+  }
+
+  /* Linear from HOLDING_BURN_LOW at level 0 down to nominal at the top */
+  return HOLDING_BURN_LOW - (HOLDING_BURN_LOW - 1.0) * level /
+                            (h->num_levels - 1);
+}
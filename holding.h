@@ -0,0 +1,62 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Holding stack: a finite number of holding levels above the airfield.
+ *
+ * Aircraft that cannot land straight away are given a free level and burn
+ * fuel at that level's rate until they are cleared to land or divert.
+ * Lower levels are flown at lower altitude and burn more.  Free levels are
+ * kept in a ring queue, so entering and leaving the stack are O(1) queue
+ * operations.  The stack does no locking of its own; the simulator calls
+ * it with runway_mutex held.
+ */
+
+#ifndef HOLDING_H
+#define HOLDING_H
+
+#define HOLDING_MAX_LEVELS 64    /* Most levels a stack can have */
+#define HOLDING_NONE -1          /* Aircraft is not in the stack */
+#define HOLDING_BURN_LOW 1.5     /* Fuel burn of the lowest level, nominal is 1 */
+
+typedef struct
+{
+  int num_levels;                /* 0 when there is no holding stack */
+  int free_levels[HOLDING_MAX_LEVELS];   /* ring queue of free levels */
+  int first_free;
+  int num_free;
+  int peak_occupancy;            /* most levels in use at once */
+  int diversions_full;           /* aircraft that found the stack full */
+  int diversions_fuel;           /* aircraft that ran out of holding fuel */
+  double fuel_burned;            /* fuel burned in the stack, in seconds */
+} holding_stack;
+
+/* Sets up a stack with the given number of levels, 0 for none. */
+void holding_init(holding_stack *h, int num_levels);
+
+/* Takes the free level that has been free longest.  Returns the level, or
+ * HOLDING_NONE if every level is taken.
+ */
+int holding_enter(holding_stack *h);
+
+/* Gives a level back to the stack. */
+void holding_leave(holding_stack *h, int level);
+
+/* Fuel burned per second of holding at a level, relative to the nominal
+ * burn that fuel reserves are measured in.
+ */
+double holding_burn_rate(const holding_stack *h, int level);
+
+#endif
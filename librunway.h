@@ -0,0 +1,329 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* librunway: the runway simulator as a library.
+ *
+ * A simulation is an opaque runway_sim handle.  Create it from a
+ * runway_config, load a scenario from a file or a buffer (or set
+ * soak_hours for generated arrivals), run it, read the metrics and
+ * destroy it:
+ *
+ *   runway_config config;
+ *   runway_sim *sim;
+ *   runway_metrics m;
+ *
+ *   runway_config_defaults(&config);
+ *   config.speed = 100;
+ *   sim = runway_create(&config);
+ *   if (sim != NULL && runway_load_file(sim, "trace.txt") == 0 &&
+ *       runway_run(sim) == 0)
+ *   {
+ *     runway_get_metrics(sim, &m);
+ *   }
+ *   runway_destroy(sim);
+ *
+ * The library keeps no state outside the handle, so any number of
+ * simulations can be created and run at the same time from different
+ * threads.  One handle must not be used from two threads at once.
+ * runway_run() runs the simulation with its own threads and returns when
+ * it is over; it takes as long as the scenario at config.speed.
+ */
+
+#ifndef LIBRUNWAY_H
+#define LIBRUNWAY_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define RUNWAY_EVENT_MESSAGE 0   /* a line of the simulation log */
+#define RUNWAY_EVENT_ADMITTED 1  /* an aircraft took the runway */
+#define RUNWAY_EVENT_CLEARED 2   /* an aircraft cleared the runway */
+#define RUNWAY_EVENT_DIVERTED 3  /* an aircraft diverted to its alternate */
+
+/* Rules that can keep a waiting aircraft off the runway.  Each aircraft's
+ * waiting time is split over them in runway_outcome.blocked.
+ */
+#define RUNWAY_BLOCK_RUNWAY 0    /* runway full, closed or in use */
+#define RUNWAY_BLOCK_CONTROLLER 1        /* controller break or shift change */
+#define RUNWAY_BLOCK_DIRECTION 2 /* runway set the other way, or switching */
+#define RUNWAY_BLOCK_TYPE 3      /* commercial and cargo do not mix */
+#define RUNWAY_BLOCK_PRIORITY 4  /* emergencies or due departures go first */
+#define RUNWAY_BLOCK_FAIRNESS 5  /* the other type's turn */
+#define RUNWAY_BLOCK_SEPARATION 6        /* wake or departure separation */
+#define RUNWAY_BLOCK_REASONS 7
+
+#define RUNWAY_STOP_DRAIN 0      /* let the aircraft already waiting land */
+#define RUNWAY_STOP_ABORT 1      /* waiting aircraft give up at once */
+
+typedef struct runway_sim runway_sim;
+
+typedef struct
+{
+  int kind;                 /* RUNWAY_EVENT_* */
+  double time;              /* simulated seconds since the start */
+  int aircraft_id;          /* the aircraft, or -1 for a message */
+  int aircraft_type;        /* COMMERCIAL, CARGO or EMERGENCY, or -1 */
+  int direction;            /* runway direction for admissions, or -1 */
+  const char *message;      /* log line for RUNWAY_EVENT_MESSAGE, or NULL */
+} runway_event;
+
+typedef struct
+{
+  long aircraft;            /* aircraft handled */
+  long landed;              /* arrivals that landed */
+  long departed;
+  long diverted;
+  double makespan;          /* time the last aircraft cleared */
+  double average_wait;      /* admission wait of the arrivals that landed */
+  double max_wait;
+  int max_wait_aircraft;    /* aircraft with the longest wait */
+  int max_overtaken;        /* most later arrivals of its own class that
+                               landed before one aircraft; 0 for soak runs */
+  int max_overtaken_aircraft;
+  double wait_p50;          /* wait percentiles of the arrivals that */
+  double wait_p90;          /* landed; 0 for soak runs */
+  double wait_p99;
+  double average_departure_delay;
+  double max_departure_delay;
+  double runway_occupied;   /* share of the makespan with the runway in use */
+  int fuel_emergencies;
+  int direction_switches;
+  int controller_breaks;
+  int controller_shifts;
+  int reopenings;           /* switches, breaks and shift changes that
+                               ended with aircraft waiting */
+  int ramps;                /* ... after which any were admitted */
+  double average_ramp;      /* wall-clock seconds from the end of the
+                               pause to the last admission it allowed */
+  double max_ramp;
+  int gave_up;              /* aircraft that gave up waiting when the run
+                               was abandoned or aborted */
+  int stopped;              /* non-zero if runway_stop() ended the run */
+  double shutdown_latency;  /* wall-clock seconds from runway_stop() until
+                               every thread of the run had finished */
+} runway_metrics;
+
+/* What happened to one aircraft of a finished run. */
+typedef struct
+{
+  int aircraft_id;
+  int aircraft_type;        /* COMMERCIAL, CARGO or EMERGENCY */
+  int departure;            /* non-zero for a departure */
+  double arrival;           /* simulated time it arrived */
+  int fuel_reserve;         /* seconds */
+  double admitted_at;       /* simulated time it took the runway, or -1 */
+  int direction;            /* runway direction it used */
+  double cleared_at;        /* simulated time it cleared, or -1 */
+  double wait;              /* admitted_at - arrival, or -1 if diverted */
+  int fuel_emergency;       /* non-zero if it declared a fuel emergency */
+  int diverted;             /* non-zero if it diverted instead */
+  double blocked[RUNWAY_BLOCK_REASONS];   /* wait by RUNWAY_BLOCK_* */
+} runway_outcome;
+
+/* Called for every event.  Events come from the simulation's own
+ * threads, several at a time, and some while the runway is locked: the
+ * callback must be thread-safe and must not call back into the library.
+ * The event and its message are only valid during the call.
+ */
+typedef void (*runway_event_fn)(const runway_event *event, void *user);
+
+/* Called once when a run is over, from the thread that called
+ * runway_run().
+ */
+typedef void (*runway_metrics_fn)(const runway_metrics *metrics,
+                                  void *user);
+
+typedef struct
+{
+  unsigned int seed;        /* seed for fuel reserves drawn at load time */
+  double speed;             /* simulated seconds per wall-clock second */
+  int holding_levels;       /* holding stack levels, 0 for none */
+  int arrivals_only;        /* leave the scenario's departures out */
+  int wake_reorder;         /* let lighter aircraft go first */
+  int fifo_tickets;         /* admit each class in arrival order */
+  int group_admission;      /* the controller admits the next group after
+                               a switch, break or shift change */
+  int reactor;              /* run in one thread with epoll instead of a
+                               thread per aircraft; no taxi stages */
+  int taxi_slots;           /* taxi and gate stages, 0 slots for none */
+  double taxi_time;
+  int gates;
+  double gate_time;
+  const char *layout;       /* airport layout file, or NULL for one runway */
+  const char *live_name;    /* shared-memory object to publish the runway
+                               state in for runway-top, e.g. "/runway",
+                               or NULL */
+  double soak_hours;        /* generate arrivals for this long instead of
+                               loading a scenario, 0 for a normal run */
+  /* Rule parameters, runway.h's constants by default */
+  int direction_limit;      /* aircraft one way before the other may go */
+  int fairness_limit;       /* aircraft of one type before the other */
+  int controller_limit;     /* aircraft between controller breaks */
+  int switch_threshold;     /* aircraft waiting the other way that make
+                               direction_limit force a switch, 1 default */
+  double switch_time;       /* seconds a direction switch takes */
+  double break_time;        /* seconds a controller break takes */
+  double stall_limit;       /* give up after this many seconds with
+                               aircraft waiting at an empty runway and
+                               none admitted, 0 (default) to wait forever */
+  double drain_limit;       /* wall-clock seconds a RUNWAY_STOP_DRAIN may
+                               take before it becomes an abort, 0 (default)
+                               for no limit */
+  /* Placement: CPU lists like "0-3,8" or NULL for anywhere, and a NUMA
+   * node for the threads and the run's memory, or -1 (default) for none.
+   * The controller and the thread in runway_run() run on
+   * controller_cpus; aircraft, pool and stage threads on aircraft_cpus.
+   * With a node, either list is narrowed to the node's CPUs and defaults
+   * to all of them.
+   */
+  const char *controller_cpus;
+  const char *aircraft_cpus;
+  int numa_node;
+  runway_event_fn on_event; /* may be NULL */
+  runway_metrics_fn on_metrics;   /* may be NULL */
+  void *user;               /* handed to the callbacks */
+} runway_config;
+
+/* Fills in the defaults: seed 0, real time, no holding stack, departures
+ * and wake reordering on, no taxi and gate stages, one runway, the rule
+ * parameters of runway.h and no placement.
+ */
+void runway_config_defaults(runway_config *config);
+
+/* Number of NUMA nodes of the machine, 1 where there is no NUMA. */
+int runway_numa_nodes(void);
+
+/* Creates a simulation.  The layout file, if any, is read here.  Returns
+ * NULL if the configuration is invalid, a CPU list is malformed or names
+ * no CPU this process may use, or the layout cannot be read.
+ */
+runway_sim *runway_create(const runway_config *config);
+
+/* Loads a scenario in the format of test-cases/README.md, from a file or
+ * from length bytes of text.  Returns 0 on success or -1 with errno set:
+ * the error from opening the file, or EINVAL if the scenario holds no
+ * aircraft or one is already loaded.  A simulation loads one scenario.
+ */
+int runway_load_file(runway_sim *sim, const char *filename);
+int runway_load_buffer(runway_sim *sim, const char *text, size_t length);
+
+/* Runs the loaded scenario, or the soak run, to the end.  Returns 0 on
+ * success or -1 if nothing is loaded, the simulation has already run,
+ * its threads cannot be started or the stall watchdog abandoned it.
+ */
+int runway_run(runway_sim *sim);
+
+/* Ends a runway_run() in progress, from any other thread; called before
+ * the run it ends the run as soon as it starts.  No more aircraft arrive.
+ * With RUNWAY_STOP_DRAIN the aircraft already waiting still land; with
+ * RUNWAY_STOP_ABORT they give up at once and breaks, switches and runway
+ * time in progress are cut short.  The controller then exits between two
+ * of its polls and runway_run() returns 0 with the metrics of the
+ * aircraft that arrived.  May be called more than once; an abort
+ * overrides a drain.  Not async-signal-safe: call it from a thread that
+ * waits for signals, not from a handler.  Returns -1 for an unknown
+ * policy.
+ */
+int runway_stop(runway_sim *sim, int policy);
+
+/* Metrics of a finished run. */
+void runway_get_metrics(runway_sim *sim, runway_metrics *metrics);
+
+/* Copies the outcomes of up to max aircraft of a finished run, in id
+ * order, and returns the number of aircraft in the run.  Soak runs keep
+ * no per-aircraft records and have none.
+ */
+long runway_get_outcomes(runway_sim *sim, runway_outcome *outcomes,
+                         long max);
+
+/* Writes the outcomes of a finished run to a file, as CSV with a header
+ * line or in the columnar layout below.  Return 0 on success or -1 if the
+ * file cannot be written.
+ *
+ * Columnar layout, in native byte order:
+ *
+ *   char     magic[8]            "RWYCOL01"
+ *   uint32   num_columns
+ *   uint32   chunk_rows          rows per chunk
+ *   uint64   num_rows
+ *   num_columns times:
+ *     uint8  type                1 = int32, 2 = float64
+ *     uint8  name_length
+ *     char   name[name_length]
+ *   then for each chunk of up to chunk_rows rows, the chunk's values of
+ *   the first column, then of the second column and so on.
+ *
+ * The columns are the fields of runway_outcome, with one column per
+ * blocking reason, named as in the CSV header.
+ */
+int runway_export_csv(runway_sim *sim, const char *filename);
+int runway_export_columns(runway_sim *sim, const char *filename);
+
+/* Asynchronous log writer.  Runs with a lot of logging are limited by
+ * output: printing from every aircraft thread makes them take turns at
+ * write(2).  A writer batches records into large buffers that a thread of
+ * its own writes to a file through io_uring, or with writev(2) where
+ * io_uring is unavailable, so the threads producing the records never
+ * wait for the disk.  When every buffer is waiting to be written, records
+ * are dropped and counted rather than waited for.
+ */
+#define RUNWAY_WRITER_AUTO 0     /* io_uring if the kernel has it, else a thread */
+#define RUNWAY_WRITER_URING 1    /* io_uring only */
+#define RUNWAY_WRITER_THREAD 2   /* writer thread with writev(2) */
+
+typedef struct runway_writer runway_writer;
+
+typedef struct
+{
+  int backend;              /* RUNWAY_WRITER_URING or _THREAD, as used */
+  long long records;        /* records taken */
+  long long bytes;
+  long long dropped;        /* records dropped with every buffer full */
+  long long writes;         /* writes submitted or writev() calls */
+  int errors;               /* failed writes */
+} runway_writer_stats;
+
+/* Creates or truncates filename and starts writing to it.  Returns NULL
+ * if the file cannot be opened, or with RUNWAY_WRITER_URING if io_uring
+ * cannot be set up.
+ */
+runway_writer *runway_writer_open(const char *filename, int backend);
+
+/* Appends length bytes.  Thread-safe; never blocks on the file. */
+void runway_writer_write(runway_writer *w, const char *record,
+                         size_t length);
+
+/* An event callback for runway_config.on_event, with the writer as
+ * config.user: writes each RUNWAY_EVENT_MESSAGE as a line, the way the
+ * runway program prints its log.
+ */
+void runway_writer_event(const runway_event *event, void *user);
+
+/* Writes out what is buffered, closes the file and frees the writer.
+ * stats, if not NULL, gets its counters.  Returns 0, or -1 if a write
+ * failed.
+ */
+int runway_writer_close(runway_writer *w, runway_writer_stats *stats);
+
+/* Prints the summary, or one line per aircraft with its admission and
+ * clearance times, in the format of the runway program.
+ */
+void runway_print_summary(runway_sim *sim, FILE *fp);
+void runway_print_results(runway_sim *sim, FILE *fp);
+
+void runway_destroy(runway_sim *sim);
+
+#endif
@@ -0,0 +1,144 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Shared-memory live view (see live.h). */
+
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sched.h>
+
+#include "live.h"
+
+#define LIVE_READ_TRIES 1000     /* snapshots tried before live_read fails */
+
+live_state *live_create(const char *name)
+{
+  live_state *state;
+  int fd;
+
+  shm_unlink(name);
+  if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0)
+  {
+    return NULL;
+  }
+  if (ftruncate(fd, sizeof(live_state)) != 0)
+  {
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+  state = mmap(NULL, sizeof(live_state), PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+  close(fd);
+  if (state == MAP_FAILED)
+  {
+    shm_unlink(name);
+    return NULL;
+  }
+
+  /* The object starts zeroed; the magic number goes in last */
+  state->pid = getpid();
+  __atomic_store_n(&state->magic, LIVE_MAGIC, __ATOMIC_RELEASE);
+  return state;
+}
+
+void live_destroy(live_state *state, const char *name)
+{
+  munmap(state, sizeof(live_state));
+  shm_unlink(name);
+}
+
+/* There is one writer at a time, the thread holding runway_mutex, so the
+ * count can be bumped with plain loads and stores.  The fences keep the
+ * field stores between the two bumps.
+ */
+void live_begin(live_state *state)
+{
+  unsigned int seq = __atomic_load_n(&state->seq, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&state->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void live_end(live_state *state)
+{
+  unsigned int seq = __atomic_load_n(&state->seq, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&state->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+const live_state *live_attach(const char *name)
+{
+  live_state *state;
+  struct stat st;
+  int fd;
+
+  if ((fd = shm_open(name, O_RDONLY, 0)) < 0)
+  {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size != (off_t)sizeof(live_state))
+  {
+    close(fd);
+    return NULL;
+  }
+  state = mmap(NULL, sizeof(live_state), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (state == MAP_FAILED)
+  {
+    return NULL;
+  }
+  if (__atomic_load_n(&state->magic, __ATOMIC_ACQUIRE) != LIVE_MAGIC)
+  {
+    munmap(state, sizeof(live_state));
+    return NULL;
+  }
+  return state;
+}
+
+void live_detach(const live_state *state)
+{
+  munmap((void *)state, sizeof(live_state));
+}
+
+int live_read(const live_state *state, live_state *copy)
+{
+  unsigned int before;
+  unsigned int after;
+  int tries;
+
+  for (tries = 0; tries < LIVE_READ_TRIES; tries++)
+  {
+    before = __atomic_load_n(&state->seq, __ATOMIC_ACQUIRE);
+    if (before % 2 == 0)
+    {
+      memcpy(copy, state, sizeof(live_state));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      after = __atomic_load_n(&state->seq, __ATOMIC_RELAXED);
+      if (after == before)
+      {
+        return 0;
+      }
+    }
+    sched_yield();
+  }
+  return -1;
+}
@@ -0,0 +1,103 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Live view of a running simulation in shared memory, for runway-top.
+ *
+ * With config.live_name set, the simulation maps a POSIX shared-memory
+ * object of that name and copies the runway state into it after every
+ * change, with runway_mutex held.  The copy is guarded by a sequence
+ * lock: the writer makes the count odd, stores the fields and makes it
+ * even again, so it never waits for a reader.  A reader copies the whole
+ * state and keeps the copy only if the count was even and unchanged
+ * across it.  The segment is removed when the simulation is destroyed.
+ */
+
+#ifndef LIVE_H
+#define LIVE_H
+
+#define LIVE_MAGIC 0x72776c76    /* "rwlv", and the layout version */
+#define LIVE_WAITS 512           /* recent arrival waits for percentiles */
+
+#define LIVE_WORKING 0           /* What the controller is doing */
+#define LIVE_BREAK 1
+#define LIVE_SWITCH 2
+#define LIVE_SHIFT 3
+
+typedef struct
+{
+  unsigned int magic;
+  unsigned int seq;         /* odd while the simulation is writing */
+  int pid;                  /* process running the simulation */
+  int finished;             /* set when the run is over */
+  long epoch_sec;           /* CLOCK_MONOTONIC start of the run */
+  long epoch_nsec;
+  double speed;             /* simulated seconds per wall-clock second */
+  double updated_at;        /* simulated time of the last change */
+
+  /* Waiting aircraft by class and by preferred direction */
+  int waiting[3];
+  int waiting_north;
+  int waiting_south;
+  int waiting_departures;
+  int fuel_emergency_waiting;
+
+  /* The runway */
+  int on_runway[3];         /* arrivals on the runway by class */
+  int departures_on_runway;
+  int capacity;
+  int direction;            /* NORTH or SOUTH */
+  int consecutive_direction;
+  int aircraft_since_break;
+  int controller;           /* LIVE_* */
+  double controller_until;  /* simulated time a break, switch or shift
+                               handover ends */
+
+  /* Totals so far */
+  long landed;
+  long departed;
+  long diverted;
+  int direction_switches;
+  int controller_breaks;
+
+  /* Waits of the last LIVE_WAITS arrivals that landed, as a ring */
+  long waits_seen;
+  float waits[LIVE_WAITS];
+} live_state;
+
+/* Creates and maps the shared-memory object, replacing one of the same
+ * name.  Returns NULL on failure.
+ */
+live_state *live_create(const char *name);
+
+/* Unmaps the state and removes the object. */
+void live_destroy(live_state *state, const char *name);
+
+/* Write side: every change goes between live_begin() and live_end(). */
+void live_begin(live_state *state);
+void live_end(live_state *state);
+
+/* Maps an existing object read-only.  Returns NULL if there is none or it
+ * is not a live view of this layout.
+ */
+const live_state *live_attach(const char *name);
+void live_detach(const live_state *state);
+
+/* Copies a consistent snapshot of the state.  Returns 0, or -1 if the
+ * writer kept changing it for too long.
+ */
+int live_read(const live_state *state, live_state *copy);
+
+#endif
@@ -0,0 +1,1606 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include "runway.h"
+#include "scenario.h"
+#include "model.h"
+
+#define ACTION_NONE 0            /* Controller is idle */
+#define ACTION_BREAK 1           /* Controller is on a break */
+#define ACTION_SWITCH 2          /* Runway direction is being switched */
+#define ACTION_SHIFT 3           /* A new controller is taking over */
+
+#define NEVER 1e300              /* Time of an event that does not happen */
+
+typedef struct
+{
+  const scenario_aircraft *aircraft;
+  model_result *results;
+  model_metrics *metrics;
+  int *order;
+  int admitted;
+  double now;
+
+  int *waiting;                  /* waiting aircraft, in arrival order */
+  int num_waiting;
+  int num_held;                  /* the last of them, not in line yet */
+  char *declared;                /* fuel emergency declared while waiting */
+  int occupants[MAX_RUNWAY_CAPACITY];
+
+  int action;                    /* ACTION_* */
+  double action_end;
+  int reopening;                 /* the action has just finished */
+  const scenario_event **held_events; /* outside changes that came in
+                                    while the controller was busy */
+  int num_held_events;
+  int shift_pending;
+  int shift_handover;
+  int direction_pending;
+  int forced_direction;
+
+  /* Mirrors of the shared state in runway.c */
+  int waiting_commercial;
+  int waiting_cargo;
+  int waiting_emergency;
+  int waiting_north;
+  int waiting_south;
+  int fuel_emergency_waiting;
+  int last_regular_type;
+  int regular_type_count;
+  int aircraft_on_runway;
+  int commercial_on_runway;
+  int cargo_on_runway;
+  int emergency_on_runway;
+  int aircraft_since_break;
+  int current_direction;
+  int consecutive_direction;
+  int runway_capacity;
+
+  model_ties *ties;              /* how ties are broken, NULL for the
+                                    default way */
+} model_state;
+
+/* The state that carries over a point where the runway is empty, nobody
+ * is waiting and the controller has nothing to do.
+ */
+typedef struct
+{
+  int current_direction;
+  int consecutive_direction;
+  int aircraft_since_break;
+  int last_regular_type;
+  int regular_type_count;
+} model_boundary;
+
+/* A stretch of the scenario replayed on its own by model_run_parallel() */
+typedef struct
+{
+  int first;                     /* its events are first .. last - 1 */
+  int last;
+  int capacity;                  /* runway capacity when it starts */
+  int order_at;                  /* admissions before it */
+  model_boundary start;          /* assumed state when it starts */
+  model_boundary end;            /* state its last replay ended in */
+  double quiet_at;               /* when its last replay went quiet */
+  int status;                    /* what its last replay returned */
+  int dirty;                     /* must be replayed from start */
+  int guessed;                   /* start is still the guess of split() */
+  int shifts;                    /* shift change events in it */
+  model_metrics metrics;
+} model_segment;
+
+typedef struct
+{
+  const scenario *s;
+  model_result *results;
+  int *order;
+  model_segment *segments;
+  int *todo;                     /* segments to replay this round */
+  int num_todo;
+  int next;                      /* next of them to hand out */
+  pthread_mutex_t mutex;
+} replay_queue;
+
+struct model_chain
+{
+  model_state m;
+  model_metrics metrics;
+  model_traffic traffic;
+  scenario_aircraft *aircraft;   /* the aircraft generated so far */
+  model_result *results;
+  int *waiting;
+  char *declared;
+  int count;                     /* aircraft generated and kept */
+  int room;                      /* aircraft the arrays have room for */
+  double last_clock;             /* when the last arrival was due */
+  double clock;                  /* when the next arrival is due */
+  double next_arrival;           /* clock rounded up, NEVER past horizon */
+  int burst_left;                /* aircraft of a burst still to come */
+  unsigned int seed;
+  long work;
+  double peak;                   /* highest importance of the last run */
+};
+
+static int desired_direction(model_state *m, int type)
+{
+  if (type == COMMERCIAL)
+  {
+    return NORTH;
+  }
+  if (type == CARGO)
+  {
+    return SOUTH;
+  }
+  return m->current_direction;
+}
+
+/* Same checks, in the same order, as can_enter_common() in runway.c. */
+static int can_enter(model_state *m, int type, int direction,
+                     int fuel_emergency)
+{
+  int other_type_waiting;
+  int opposite_waiting;
+
+  if (m->aircraft_on_runway >= m->runway_capacity)
+  {
+    return 0;
+  }
+  if (m->shift_pending)
+  {
+    return 0;
+  }
+  if (m->direction_pending)
+  {
+    return 0;
+  }
+  if (m->aircraft_since_break >= CONTROLLER_LIMIT)
+  {
+    return 0;
+  }
+  if ((type == COMMERCIAL || type == CARGO) &&
+      direction != m->current_direction)
+  {
+    return 0;
+  }
+  if (type == COMMERCIAL && m->cargo_on_runway > 0)
+  {
+    return 0;
+  }
+  if (type == CARGO && m->commercial_on_runway > 0)
+  {
+    return 0;
+  }
+  if (m->fuel_emergency_waiting > 0 && !fuel_emergency)
+  {
+    return 0;
+  }
+  if (type != EMERGENCY && m->waiting_emergency > 0)
+  {
+    return 0;
+  }
+  if (type == COMMERCIAL || type == CARGO)
+  {
+    other_type_waiting = type == COMMERCIAL ? m->waiting_cargo
+                                            : m->waiting_commercial;
+    if (m->regular_type_count >= FAIRNESS_LIMIT &&
+        m->last_regular_type == type &&
+        other_type_waiting > 0)
+    {
+      return 0;
+    }
+  }
+
+  opposite_waiting = m->current_direction == NORTH ? m->waiting_south
+                                                   : m->waiting_north;
+  if (direction == m->current_direction &&
+      m->consecutive_direction >= DIRECTION_LIMIT &&
+      opposite_waiting > 0)
+  {
+    return 0;
+  }
+
+  return 1;
+}
+
+/* Adds by to the waiting counters of an aircraft: 1 when it gets in line
+ * to enter.
+ */
+static void count_waiting(model_state *m, int id, int by)
+{
+  int type = m->aircraft[id].aircraft_type;
+
+  if (type == COMMERCIAL)
+  {
+    m->waiting_commercial += by;
+    m->waiting_north += by;
+  }
+  else if (type == CARGO)
+  {
+    m->waiting_cargo += by;
+    m->waiting_south += by;
+  }
+  else
+  {
+    m->waiting_emergency += by;
+  }
+}
+
+/* An arriving aircraft gets in line in settle(), or once the controller
+ * has reopened if it is busy: until then it is blocked on runway_mutex.
+ */
+static void arrive(model_state *m, int id)
+{
+  m->waiting[m->num_waiting++] = id;
+  m->num_held++;
+}
+
+/* Moves the aircraft at position pos of the waiting list onto the runway,
+ * updating the counters the way *_enter() does.
+ */
+static void admit(model_state *m, int pos)
+{
+  int id = m->waiting[pos];
+  int type = m->aircraft[id].aircraft_type;
+  model_result *r = &m->results[id];
+  double wait;
+
+  memmove(&m->waiting[pos], &m->waiting[pos + 1],
+          sizeof(int) * (m->num_waiting - pos - 1));
+  m->num_waiting--;
+
+  if (type == COMMERCIAL)
+  {
+    m->waiting_commercial--;
+    m->waiting_north--;
+    m->commercial_on_runway++;
+  }
+  else if (type == CARGO)
+  {
+    m->waiting_cargo--;
+    m->waiting_south--;
+    m->cargo_on_runway++;
+  }
+  else
+  {
+    m->waiting_emergency--;
+    m->emergency_on_runway++;
+  }
+  if (m->declared[id])
+  {
+    m->fuel_emergency_waiting--;
+  }
+
+  m->occupants[m->aircraft_on_runway++] = id;
+  m->aircraft_since_break++;
+  m->consecutive_direction++;
+
+  if (type == COMMERCIAL || type == CARGO)
+  {
+    if (m->last_regular_type == type)
+    {
+      m->regular_type_count++;
+    }
+    else
+    {
+      m->last_regular_type = type;
+      m->regular_type_count = 1;
+    }
+  }
+
+  r->admitted_at = m->now;
+  r->cleared_at = m->now + m->aircraft[id].runway_time;
+  r->direction = m->current_direction;
+  r->fuel_emergency = m->declared[id];
+  if (m->order)
+  {
+    m->order[m->admitted] = id;
+  }
+  m->admitted++;
+
+  wait = m->now - m->aircraft[id].arrival;
+  m->metrics->total_wait += wait;
+  if (wait > m->metrics->max_wait)
+  {
+    m->metrics->max_wait = wait;
+  }
+  if (r->cleared_at > m->metrics->makespan)
+  {
+    m->metrics->makespan = r->cleared_at;
+  }
+}
+
+static void leave(model_state *m, int slot)
+{
+  int id = m->occupants[slot];
+  int type = m->aircraft[id].aircraft_type;
+
+  m->occupants[slot] = m->occupants[--m->aircraft_on_runway];
+  if (type == COMMERCIAL)
+  {
+    m->commercial_on_runway--;
+  }
+  else if (type == CARGO)
+  {
+    m->cargo_on_runway--;
+  }
+  else
+  {
+    m->emergency_on_runway--;
+  }
+}
+
+/* Position in the waiting list of the earliest arrival in line that may
+ * enter, -1 if there is none.  While reopening only emergencies are
+ * asked.
+ */
+static int first_to_enter(model_state *m)
+{
+  int pos;
+  int id;
+  int type;
+
+  for (pos = 0; pos < m->num_waiting - m->num_held; pos++)
+  {
+    id = m->waiting[pos];
+    type = m->aircraft[id].aircraft_type;
+    if (m->reopening && type != EMERGENCY)
+    {
+      continue;
+    }
+    if (can_enter(m, type, desired_direction(m, type), m->declared[id]))
+    {
+      return pos;
+    }
+  }
+  return -1;
+}
+
+/* Same decisions as one iteration of controller_thread(). */
+static void controller_step(model_state *m)
+{
+  int opposite_waiting;
+  int same_waiting;
+
+  if (m->aircraft_on_runway != 0)
+  {
+    return;
+  }
+
+  if (m->shift_pending)
+  {
+    m->action = ACTION_SHIFT;
+    m->action_end = m->now + m->shift_handover;
+    return;
+  }
+
+  if (m->direction_pending)
+  {
+    if (m->forced_direction != m->current_direction)
+    {
+      m->action = ACTION_SWITCH;
+      m->action_end = m->now + DIRECTION_SWITCH_TIME;
+    }
+    else
+    {
+      m->direction_pending = 0;
+    }
+    return;
+  }
+
+  if (m->aircraft_since_break >= CONTROLLER_LIMIT)
+  {
+    m->action = ACTION_BREAK;
+    m->action_end = m->now + BREAK_TIME;
+    return;
+  }
+
+  opposite_waiting = m->current_direction == NORTH ? m->waiting_south
+                                                   : m->waiting_north;
+  same_waiting = m->current_direction == NORTH ? m->waiting_north
+                                               : m->waiting_south;
+  if (opposite_waiting > 0 &&
+      (m->consecutive_direction >= DIRECTION_LIMIT || same_waiting == 0))
+  {
+    m->action = ACTION_SWITCH;
+    m->action_end = m->now + DIRECTION_SWITCH_TIME;
+  }
+}
+
+static void finish_action(model_state *m)
+{
+  if (m->action == ACTION_BREAK)
+  {
+    m->aircraft_since_break = 0;
+    m->metrics->controller_breaks++;
+  }
+  else if (m->action == ACTION_SHIFT)
+  {
+    m->aircraft_since_break = 0;
+    m->shift_pending = 0;
+    m->metrics->controller_shifts++;
+  }
+  else
+  {
+    m->current_direction = m->current_direction == NORTH ? SOUTH : NORTH;
+    m->consecutive_direction = 0;
+    m->metrics->direction_switches++;
+    if (m->forced_direction == m->current_direction)
+    {
+      m->direction_pending = 0;
+    }
+  }
+  m->action = ACTION_NONE;
+  m->reopening = 1;
+}
+
+/* Earliest time after which something changes: an occupant clears, the
+ * controller finishes or a waiting aircraft runs out of reserve.  when is
+ * the time of the next outside event, NEVER if there is none.
+ */
+static double next_change(model_state *m, double when)
+{
+  double deadline;
+  int i;
+
+  for (i = 0; i < m->aircraft_on_runway; i++)
+  {
+    if (m->results[m->occupants[i]].cleared_at < when)
+    {
+      when = m->results[m->occupants[i]].cleared_at;
+    }
+  }
+  if (m->action != ACTION_NONE)
+  {
+    /* Nobody can act before the controller is done */
+    return m->action_end < when ? m->action_end : when;
+  }
+  for (i = 0; i < m->num_waiting; i++)
+  {
+    const scenario_aircraft *a = &m->aircraft[m->waiting[i]];
+
+    deadline = a->arrival + a->fuel_reserve;
+    if (!m->declared[m->waiting[i]] && deadline < when)
+    {
+      when = deadline;
+    }
+  }
+  return when;
+}
+
+/* Lets the occupants that are done clear and the controller finish. */
+static void expire(model_state *m)
+{
+  int i;
+
+  for (i = m->aircraft_on_runway - 1; i >= 0; i--)
+  {
+    if (m->results[m->occupants[i]].cleared_at <= m->now)
+    {
+      leave(m, i);
+    }
+  }
+  if (m->action != ACTION_NONE && m->action_end <= m->now)
+  {
+    finish_action(m);
+  }
+}
+
+/* Declares the fuel emergencies of aircraft in line that are due, only
+ * those of emergencies while reopening.
+ */
+static void declare_due(model_state *m)
+{
+  int i;
+
+  for (i = 0; i < m->num_waiting - m->num_held; i++)
+  {
+    int id = m->waiting[i];
+
+    if (m->reopening && m->aircraft[id].aircraft_type != EMERGENCY)
+    {
+      continue;
+    }
+    if (!m->declared[id] &&
+        m->now - m->aircraft[id].arrival >= m->aircraft[id].fuel_reserve)
+    {
+      m->declared[id] = 1;
+      m->fuel_emergency_waiting++;
+      m->metrics->fuel_emergencies++;
+    }
+  }
+}
+
+/* Breaks a tie that can go ways ways at now: returns the way to take, 0
+ * for the way model_run() takes, and records the tie in m->ties.
+ */
+static int tie(model_state *m, int ways)
+{
+  model_ties *t = m->ties;
+  int k;
+  int way = 0;
+
+  if (t == NULL || ways < 2 || t->num_ties == MODEL_MAX_TIES)
+  {
+    return 0;
+  }
+  k = t->num_ties++;
+  if (k < t->num_fixed && t->choice[k] < ways)
+  {
+    way = t->choice[k];
+  }
+  t->at[k] = m->now;
+  t->ways[k] = ways;
+  t->choice[k] = way;
+  return way;
+}
+
+/* Whether the aircraft at position pos of the line looks at the rules
+ * when woken, as my_turn() in runway.c: it has a fuel emergency or is the
+ * first of its class in line.
+ */
+static int my_turn(model_state *m, int pos)
+{
+  int type = m->aircraft[m->waiting[pos]].aircraft_type;
+  int i;
+
+  if (m->declared[m->waiting[pos]])
+  {
+    return 1;
+  }
+  for (i = 0; i < pos; i++)
+  {
+    if (m->aircraft[m->waiting[i]].aircraft_type == type)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* With way -1, counts the aircraft from position first of the line on
+ * that would win a free slot if they got runway_mutex first: those whose
+ * turn it is and whom the rules let in.  Otherwise returns the position
+ * of the racer way, counting from 0.
+ */
+static int racer(model_state *m, int first, int way)
+{
+  int count = 0;
+  int type;
+  int pos;
+
+  for (pos = first; pos < m->num_waiting - m->num_held; pos++)
+  {
+    type = m->aircraft[m->waiting[pos]].aircraft_type;
+    if (my_turn(m, pos) &&
+        can_enter(m, type, desired_direction(m, type),
+                  m->declared[m->waiting[pos]]) &&
+        count++ == way)
+    {
+      return pos;
+    }
+  }
+  return count;
+}
+
+/* Admits waiting aircraft until nobody else may enter.  Every admission
+ * changes the counters, so the scan restarts.  The aircraft woken to
+ * look at the rules race for a free slot, and which of those the rules
+ * let in wins is a tie, the earliest arrival by default.  When the
+ * controller reopens it admits the group itself, earliest arrival first.
+ */
+static void admit_waiting(model_state *m)
+{
+  int pos;
+  int way;
+
+  while (m->aircraft_on_runway < m->runway_capacity &&
+         (pos = first_to_enter(m)) >= 0)
+  {
+    if (m->ties != NULL && !m->reopening &&
+        (way = tie(m, racer(m, pos, -1))) > 0)
+    {
+      pos = racer(m, pos, way);
+    }
+    admit(m, pos);
+  }
+}
+
+/* Whether controller_step() would start a break, switch or handover now. */
+static int controller_due(model_state *m)
+{
+  int pending = m->direction_pending;
+  int due;
+
+  controller_step(m);
+  due = m->action != ACTION_NONE;
+  m->action = ACTION_NONE;
+  m->direction_pending = pending;
+  return due;
+}
+
+/* Whether a fuel emergency of an aircraft in line falls due just now. */
+static int fuel_due_now(model_state *m)
+{
+  const scenario_aircraft *a;
+  int i;
+
+  for (i = 0; i < m->num_waiting - m->num_held; i++)
+  {
+    a = &m->aircraft[m->waiting[i]];
+    if (!m->declared[m->waiting[i]] && a->arrival + a->fuel_reserve == m->now)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Declares the fuel emergencies that are due and admits whoever may
+ * enter.  An aircraft whose reserve runs out just now only declares when
+ * its thread looks, which may be after another aircraft took the slot.
+ */
+static void admit_due(model_state *m)
+{
+  if (fuel_due_now(m) && first_to_enter(m) >= 0 && tie(m, 2))
+  {
+    admit_waiting(m);
+  }
+  declare_due(m);
+  admit_waiting(m);
+}
+
+/* Lets one of the aircraft blocked on runway_mutex get in line; which of
+ * them gets the mutex first is a tie.  With alone, it looks at the rules
+ * before the aircraft already in line do, and enters if it is the first
+ * of its class in line and the rules let it.
+ */
+static void line_up(model_state *m, int alone)
+{
+  int first = m->num_waiting - m->num_held;
+  int pos = first + tie(m, m->num_held);
+  int id = m->waiting[pos];
+  int type = m->aircraft[id].aircraft_type;
+  int i;
+
+  memmove(&m->waiting[first + 1], &m->waiting[first],
+          sizeof(int) * (pos - first));
+  m->waiting[first] = id;
+  m->num_held--;
+  count_waiting(m, id, 1);
+  if (!alone || m->aircraft_on_runway >= m->runway_capacity)
+  {
+    return;
+  }
+  for (i = 0; i < first; i++)
+  {
+    if (m->aircraft[m->waiting[i]].aircraft_type == type)
+    {
+      return;
+    }
+  }
+  if (can_enter(m, type, desired_direction(m, type), m->declared[id]))
+  {
+    admit(m, first);
+  }
+}
+
+/* Carries out a scenario event other than an arrival, as apply_event()
+ * in runway.c.
+ */
+static void apply_event(model_state *m, const scenario_event *ev)
+{
+  if (ev->kind == EVENT_CAPACITY)
+  {
+    m->runway_capacity = ev->arg;
+  }
+  else if (ev->kind == EVENT_SHIFT)
+  {
+    m->shift_pending = 1;
+    m->shift_handover = ev->aux;
+  }
+  else if (ev->kind == EVENT_DIRECTION)
+  {
+    m->direction_pending = ev->arg != m->current_direction;
+    m->forced_direction = ev->arg;
+  }
+}
+
+/* Once the outside events at now are in: declares the fuel emergencies
+ * that are due, admits whoever may enter, lets the aircraft that arrived
+ * get in line one by one, each looking at the rules as it does, and lets
+ * the controller decide.  When the controller has just reopened it goes
+ * as reopen() does: the emergencies first, before it looks at the fuel of
+ * anybody else, and the aircraft that arrived while it was busy only get
+ * in line after that.  The outside changes that came in meanwhile were
+ * blocked on runway_mutex as well, and are made once the group is in.
+ *
+ * The rest happens at one instant, and the threads may take it in other
+ * orders; each is a tie.  The controller may find the runway empty
+ * before anybody else looks, the new arrivals may look at the rules
+ * before the aircraft already in line are woken, and some of those that
+ * arrived while the controller was busy may get in line before the
+ * changes are made.
+ */
+static void settle(model_state *m)
+{
+  int i;
+
+  if (m->action != ACTION_NONE)
+  {
+    return;
+  }
+
+  if (m->reopening)
+  {
+    declare_due(m);
+    admit_waiting(m);
+    m->reopening = 0;
+  }
+  else if ((m->num_held > 0 || first_to_enter(m) >= 0) &&
+           controller_due(m) && tie(m, 2))
+  {
+    controller_step(m);
+    return;
+  }
+
+  if (m->num_held > 0 && (first_to_enter(m) >= 0 || fuel_due_now(m)) &&
+      tie(m, 2))
+  {
+    while (m->num_held > 0)
+    {
+      line_up(m, 1);
+    }
+  }
+  admit_due(m);
+  if (m->num_held_events > 0)
+  {
+    for (i = tie(m, m->num_held + 1); i > 0; i--)
+    {
+      line_up(m, 0);
+      admit_due(m);
+    }
+    for (i = 0; i < m->num_held_events; i++)
+    {
+      apply_event(m, m->held_events[i]);
+    }
+    m->num_held_events = 0;
+  }
+  while (m->num_held > 0)
+  {
+    line_up(m, 0);
+    admit_due(m);
+  }
+  controller_step(m);
+}
+
+/* Initial state of a whole run */
+static const model_boundary start_of_run = { NORTH, 0, 0, -1, 0 };
+
+/* Replays events first .. last - 1 of the scenario from the boundary state
+ * start with the runway at the given capacity, until nothing is left to
+ * do.  Admissions are written to order[0 ..].  end gets the state and
+ * quiet_at the time of the last thing that happened, -1 if nothing did.
+ * Ties are broken as ties says, the default way if it is NULL.  Returns
+ * 0, or -1 if aircraft are still waiting at the end.
+ */
+static int replay(const scenario *s, int first, int last,
+                  const model_boundary *start, int capacity,
+                  model_result *results, int *order, model_metrics *metrics,
+                  model_boundary *end, double *quiet_at,
+                  model_ties *ties)
+{
+  const scenario_event *ev;
+  model_state m;
+  int count = s->num_aircraft;
+  int next = first;
+  int arrivals = 0;
+  int status;
+
+  memset(&m, 0, sizeof(m));
+  memset(metrics, 0, sizeof(*metrics));
+  m.aircraft = s->aircraft;
+  m.results = results;
+  m.metrics = metrics;
+  m.order = order;
+  m.waiting = malloc(sizeof(int) * (count + 1));
+  m.declared = calloc(count + 1, 1);
+  m.held_events = malloc(sizeof(scenario_event *) * (last - first + 1));
+  m.current_direction = start->current_direction;
+  m.consecutive_direction = start->consecutive_direction;
+  m.aircraft_since_break = start->aircraft_since_break;
+  m.last_regular_type = start->last_regular_type;
+  m.regular_type_count = start->regular_type_count;
+  m.runway_capacity = capacity;
+  m.ties = ties;
+  *quiet_at = -1;
+
+  while (1)
+  {
+    m.now = next_change(&m, next < last ? s->events[next].time : NEVER);
+    if (m.now >= NEVER)
+    {
+      break;
+    }
+    *quiet_at = m.now;
+
+    expire(&m);
+    for (; next < last && s->events[next].time <= m.now; next++)
+    {
+      ev = &s->events[next];
+      if (ev->kind == EVENT_ARRIVAL)
+      {
+        arrive(&m, ev->aux);
+        arrivals++;
+      }
+      else if (m.action != ACTION_NONE || m.reopening)
+      {
+        m.held_events[m.num_held_events++] = ev;
+      }
+      else
+      {
+        apply_event(&m, ev);
+      }
+    }
+    settle(&m);
+    if (next == s->num_events && m.num_waiting == 0 &&
+        m.aircraft_on_runway == 0 && m.action != ACTION_NONE &&
+        tie(&m, 2) == 0)
+    {
+      /* The run ends as the last aircraft clears, and the controller
+       * rarely gets to look before it does
+       */
+      break;
+    }
+  }
+
+  end->current_direction = m.current_direction;
+  end->consecutive_direction = m.consecutive_direction;
+  end->aircraft_since_break = m.aircraft_since_break;
+  end->last_regular_type = m.last_regular_type;
+  end->regular_type_count = m.regular_type_count;
+
+  status = (m.num_waiting > 0 || m.admitted < arrivals) ? -1 : 0;
+  free(m.waiting);
+  free(m.declared);
+  free(m.held_events);
+  return status;
+}
+
+int model_run(const scenario *s, model_result *results, int *order,
+              model_metrics *metrics)
+{
+  model_boundary end;
+  double quiet_at;
+
+  if (replay(s, 0, s->num_events, &start_of_run, MAX_RUNWAY_CAPACITY,
+             results, order, metrics, &end, &quiet_at, NULL) != 0)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+int model_run_ties(const scenario *s, model_ties *ties,
+                   model_result *results, int *order,
+                   model_metrics *metrics)
+{
+  model_boundary end;
+  double quiet_at;
+
+  ties->num_ties = 0;
+  if (replay(s, 0, s->num_events, &start_of_run, MAX_RUNWAY_CAPACITY,
+             results, order, metrics, &end, &quiet_at, ties) != 0)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/* Counters that only matter up to a limit are compared at the limit, so
+ * that boundary states which behave the same compare equal.
+ */
+static void normalize(model_boundary *b)
+{
+  if (b->consecutive_direction > DIRECTION_LIMIT)
+  {
+    b->consecutive_direction = DIRECTION_LIMIT;
+  }
+  if (b->regular_type_count > FAIRNESS_LIMIT)
+  {
+    b->regular_type_count = FAIRNESS_LIMIT;
+  }
+}
+
+static int same_boundary(const model_boundary *a, const model_boundary *b)
+{
+  return a->current_direction == b->current_direction &&
+         a->consecutive_direction == b->consecutive_direction &&
+         a->aircraft_since_break == b->aircraft_since_break &&
+         a->last_regular_type == b->last_regular_type &&
+         a->regular_type_count == b->regular_type_count;
+}
+
+/* Picks up to wanted - 1 cut points near even shares of the events and
+ * guesses the boundary state at each from the events before it: the
+ * direction and aircraft type of the last arrivals and the arrivals since
+ * the last shift change.  A cut goes where the runway is most likely to be
+ * idle, the arrival with the most slack left after a Lindley estimate of
+ * the backlog, with every aircraft served one at a time and its share of
+ * direction switches and breaks.  Returns the number of segments.
+ */
+static int split(const scenario *s, int wanted, model_segment *segments)
+{
+  const scenario_event *ev;
+  model_boundary guess = start_of_run;
+  double *slack;
+  double backlog = 0;
+  int previous = 0;
+  int capacity = MAX_RUNWAY_CAPACITY;
+  int arrivals = 0;
+  int since_shift = 0;
+  int window = s->num_events / (wanted * 2) + 1;
+  int num_segments = 1;
+  int ideal;
+  int best;
+  int direction;
+  int j;
+  int k;
+
+  /* slack[j]: estimated idle time before event j, negative if busy */
+  slack = malloc(sizeof(double) * (s->num_events + 1));
+  for (j = 0; j < s->num_events; j++)
+  {
+    ev = &s->events[j];
+    backlog -= ev->time - previous;
+    slack[j] = -backlog;
+    if (backlog < 0)
+    {
+      backlog = 0;
+    }
+    if (ev->kind == EVENT_ARRIVAL)
+    {
+      backlog += s->aircraft[ev->aux].runway_time +
+                 (double)DIRECTION_SWITCH_TIME / DIRECTION_LIMIT +
+                 (double)BREAK_TIME / CONTROLLER_LIMIT;
+    }
+    else if (ev->kind == EVENT_SHIFT)
+    {
+      backlog += ev->aux;
+    }
+    previous = ev->time;
+  }
+
+  segments[0].first = 0;
+  for (k = 1; k < wanted; k++)
+  {
+    ideal = (int)((long)k * s->num_events / wanted);
+    best = -1;
+    for (j = ideal - window; j <= ideal + window; j++)
+    {
+      if (j <= segments[num_segments - 1].first || j >= s->num_events ||
+          s->events[j].time <= s->events[j - 1].time)
+      {
+        continue;
+      }
+      if (best < 0 || slack[j] > slack[best])
+      {
+        best = j;
+      }
+    }
+    if (best > 0)
+    {
+      segments[num_segments++].first = best;
+    }
+  }
+  free(slack);
+
+  k = 0;
+  for (j = 0; j <= s->num_events; j++)
+  {
+    if (k < num_segments && segments[k].first == j)
+    {
+      segments[k].capacity = capacity;
+      segments[k].order_at = arrivals;
+      segments[k].start = guess;
+      segments[k].start.aircraft_since_break = since_shift % CONTROLLER_LIMIT;
+      normalize(&segments[k].start);
+      segments[k].last = k + 1 < num_segments ? segments[k + 1].first
+                                              : s->num_events;
+      segments[k].dirty = 1;
+      segments[k].guessed = 1;
+      segments[k].shifts = 0;
+      k++;
+    }
+    if (j == s->num_events)
+    {
+      break;
+    }
+
+    ev = &s->events[j];
+    if (ev->kind == EVENT_ARRIVAL)
+    {
+      arrivals++;
+      since_shift++;
+      if (ev->arg == EMERGENCY)
+      {
+        guess.consecutive_direction++;
+        continue;
+      }
+      direction = ev->arg == COMMERCIAL ? NORTH : SOUTH;
+      if (direction == guess.current_direction)
+      {
+        guess.consecutive_direction++;
+      }
+      else
+      {
+        guess.current_direction = direction;
+        guess.consecutive_direction = 1;
+      }
+      if (ev->arg == guess.last_regular_type)
+      {
+        guess.regular_type_count++;
+      }
+      else
+      {
+        guess.last_regular_type = ev->arg;
+        guess.regular_type_count = 1;
+      }
+    }
+    else if (ev->kind == EVENT_CAPACITY)
+    {
+      capacity = ev->arg;
+    }
+    else if (ev->kind == EVENT_SHIFT)
+    {
+      since_shift = 0;
+      segments[k - 1].shifts++;
+    }
+    else if (ev->kind == EVENT_DIRECTION)
+    {
+      guess.current_direction = ev->arg;
+      guess.consecutive_direction = 0;
+    }
+  }
+
+  return num_segments;
+}
+
+/* The since-break guess of split() is off by the aircraft that were held
+ * over the last shift change, which is the same for every cut up to the
+ * next one.  Once segment i turns out to start from actual, the error is
+ * taken out of the guesses after it too.
+ */
+static void correct_guesses(model_segment *segments, int i, int num_segments,
+                            const model_boundary *actual)
+{
+  int error = actual->aircraft_since_break -
+              segments[i].start.aircraft_since_break;
+  int j;
+
+  if (error == 0)
+  {
+    return;
+  }
+  for (j = i + 1; j < num_segments && segments[j - 1].shifts == 0 &&
+                  segments[j].guessed; j++)
+  {
+    segments[j].start.aircraft_since_break =
+      (segments[j].start.aircraft_since_break + error + CONTROLLER_LIMIT) %
+      CONTROLLER_LIMIT;
+    segments[j].dirty = 1;
+  }
+}
+
+/* Code for one worker of the pool: replays segments until none are left. */
+static void * replay_worker(void *arg)
+{
+  replay_queue *q = (replay_queue *)arg;
+  model_segment *seg;
+  int i;
+
+  while (1)
+  {
+    pthread_mutex_lock(&q->mutex);
+    i = q->next < q->num_todo ? q->todo[q->next++] : -1;
+    pthread_mutex_unlock(&q->mutex);
+    if (i < 0)
+    {
+      break;
+    }
+    seg = &q->segments[i];
+    seg->status = replay(q->s, seg->first, seg->last, &seg->start,
+                         seg->capacity, q->results,
+                         q->order != NULL ? q->order + seg->order_at : NULL,
+                         &seg->metrics, &seg->end, &seg->quiet_at, NULL);
+    normalize(&seg->end);
+    seg->dirty = 0;
+  }
+
+  return NULL;
+}
+
+/* Replays the dirty segments on jobs threads. */
+static void replay_round(replay_queue *q, int num_segments, int jobs)
+{
+  pthread_t *workers;
+  int started;
+  int i;
+
+  q->num_todo = 0;
+  q->next = 0;
+  for (i = 0; i < num_segments; i++)
+  {
+    if (q->segments[i].dirty)
+    {
+      q->todo[q->num_todo++] = i;
+    }
+  }
+
+  if (jobs > q->num_todo)
+  {
+    jobs = q->num_todo;
+  }
+  workers = malloc(sizeof(pthread_t) * (jobs + 1));
+  for (started = 0; started < jobs; started++)
+  {
+    if (pthread_create(&workers[started], NULL, replay_worker, q))
+    {
+      break;
+    }
+  }
+  if (started == 0)
+  {
+    replay_worker(q);
+  }
+  for (i = 0; i < started; i++)
+  {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+}
+
+int model_run_parallel(const scenario *s, model_result *results, int *order,
+                       model_metrics *metrics, int jobs, int segments,
+                       model_split_stats *stats)
+{
+  replay_queue q;
+  model_segment *prev;
+  int num_segments;
+  int status;
+  int i;
+
+  memset(stats, 0, sizeof(*stats));
+  memset(metrics, 0, sizeof(*metrics));
+  if (segments < 1 || s->num_events == 0)
+  {
+    segments = 1;
+  }
+
+  q.s = s;
+  q.results = results;
+  q.order = order;
+  q.segments = malloc(sizeof(model_segment) * segments);
+  q.todo = malloc(sizeof(int) * segments);
+  pthread_mutex_init(&q.mutex, NULL);
+  num_segments = s->num_events > 0 ? split(s, segments, q.segments) : 0;
+  stats->segments = num_segments;
+
+  /* Replay every segment from its guessed state, then settle the
+   * boundaries from the left: a cut where the runway was still busy is
+   * dropped by merging the two segments, and a segment that started from
+   * a state other than the one its predecessor ended in is replayed from
+   * that state.  Segment k is exact after at most k + 1 rounds.
+   */
+  while (1)
+  {
+    replay_round(&q, num_segments, jobs);
+    if (q.num_todo == 0)
+    {
+      break;
+    }
+    stats->rounds++;
+    stats->replays += q.num_todo;
+    for (i = 0; i < q.num_todo; i++)
+    {
+      stats->events += q.segments[q.todo[i]].last - q.segments[q.todo[i]].first;
+    }
+
+    for (i = 1; i < num_segments; i++)
+    {
+      prev = &q.segments[i - 1];
+      if (prev->dirty)
+      {
+        continue;
+      }
+      if (prev->status != 0 ||
+          prev->quiet_at >= s->events[q.segments[i].first].time)
+      {
+        prev->last = q.segments[i].last;
+        prev->shifts += q.segments[i].shifts;
+        prev->dirty = 1;
+        memmove(&q.segments[i], &q.segments[i + 1],
+                sizeof(model_segment) * (num_segments - i - 1));
+        num_segments--;
+        stats->merged++;
+        continue;
+      }
+      if (!same_boundary(&prev->end, &q.segments[i].start))
+      {
+        if (q.segments[i].guessed)
+        {
+          correct_guesses(q.segments, i, num_segments, &prev->end);
+        }
+        q.segments[i].start = prev->end;
+        q.segments[i].guessed = 0;
+        q.segments[i].dirty = 1;
+      }
+    }
+  }
+
+  status = 0;
+  for (i = 0; i < num_segments; i++)
+  {
+    model_metrics *m = &q.segments[i].metrics;
+
+    status = q.segments[i].status;
+    metrics->total_wait += m->total_wait;
+    if (m->max_wait > metrics->max_wait)
+    {
+      metrics->max_wait = m->max_wait;
+    }
+    if (m->makespan > metrics->makespan)
+    {
+      metrics->makespan = m->makespan;
+    }
+    metrics->fuel_emergencies += m->fuel_emergencies;
+    metrics->direction_switches += m->direction_switches;
+    metrics->controller_breaks += m->controller_breaks;
+    metrics->controller_shifts += m->controller_shifts;
+  }
+
+  pthread_mutex_destroy(&q.mutex);
+  free(q.segments);
+  free(q.todo);
+  return status;
+}
+
+/* Uniform in (0, 1) */
+static double chain_uniform(model_chain *c)
+{
+  return (rand_r(&c->seed) + 1.0) / ((double)RAND_MAX + 2.0);
+}
+
+/* Draws the time of the arrival after one due at after. */
+static void chain_schedule(model_chain *c, double after)
+{
+  if (c->burst_left > 0)
+  {
+    c->clock = after + c->traffic.burst_gap;
+    c->burst_left--;
+  }
+  else
+  {
+    c->clock = after - log(chain_uniform(c)) * 3600 / c->traffic.rate;
+  }
+  c->next_arrival = c->clock < c->traffic.horizon ? ceil(c->clock) : NEVER;
+}
+
+/* Points the model state at the arrays of c. */
+static void chain_attach(model_chain *c)
+{
+  c->m.aircraft = c->aircraft;
+  c->m.results = c->results;
+  c->m.waiting = c->waiting;
+  c->m.declared = c->declared;
+  c->m.metrics = &c->metrics;
+  c->m.order = NULL;
+}
+
+static int chain_reserve(model_chain *c, int room)
+{
+  scenario_aircraft *aircraft;
+  model_result *results;
+  int *waiting;
+  char *declared;
+
+  aircraft = realloc(c->aircraft, sizeof(scenario_aircraft) * room);
+  if (aircraft != NULL)
+  {
+    c->aircraft = aircraft;
+  }
+  results = realloc(c->results, sizeof(model_result) * room);
+  if (results != NULL)
+  {
+    c->results = results;
+  }
+  waiting = realloc(c->waiting, sizeof(int) * room);
+  if (waiting != NULL)
+  {
+    c->waiting = waiting;
+  }
+  declared = realloc(c->declared, room);
+  if (declared != NULL)
+  {
+    c->declared = declared;
+  }
+  chain_attach(c);
+  if (aircraft == NULL || results == NULL || waiting == NULL ||
+      declared == NULL)
+  {
+    return -1;
+  }
+  c->room = room;
+  return 0;
+}
+
+/* Generates the aircraft due now and puts it in the waiting list. */
+static int chain_arrive(model_chain *c)
+{
+  const model_traffic *t = &c->traffic;
+  scenario_aircraft *a;
+  double u;
+
+  if (c->count == c->room && chain_reserve(c, c->room * 2) != 0)
+  {
+    return -1;
+  }
+  a = &c->aircraft[c->count];
+  memset(a, 0, sizeof(*a));
+  memset(&c->results[c->count], 0, sizeof(model_result));
+  c->declared[c->count] = 0;
+  a->arrival = (int)c->next_arrival;
+  u = chain_uniform(c);
+  a->aircraft_type = u < t->emergency_share ? EMERGENCY
+                   : u < t->emergency_share +
+                         (1 - t->emergency_share) * t->commercial_share ?
+                     COMMERCIAL : CARGO;
+  a->runway_time = t->runway_min +
+                   rand_r(&c->seed) % (t->runway_max - t->runway_min + 1);
+  a->fuel_reserve = t->fuel_min +
+                    rand_r(&c->seed) % (t->fuel_max - t->fuel_min + 1);
+  a->wake = WAKE_MEDIUM;
+  arrive(&c->m, c->count++);
+
+  if (c->burst_left == 0 && t->burst_size > 1 &&
+      chain_uniform(c) < t->burst_chance)
+  {
+    c->burst_left = t->burst_size - 1;
+  }
+  c->last_clock = c->clock;
+  chain_schedule(c, c->clock);
+  return 0;
+}
+
+model_chain *model_chain_start(const model_traffic *traffic,
+                               unsigned int seed)
+{
+  model_chain *c = calloc(1, sizeof(model_chain));
+
+  if (c == NULL)
+  {
+    return NULL;
+  }
+  c->traffic = *traffic;
+  c->seed = seed;
+  if (chain_reserve(c, 64) != 0)
+  {
+    model_chain_free(c);
+    return NULL;
+  }
+  c->m.current_direction = start_of_run.current_direction;
+  c->m.last_regular_type = start_of_run.last_regular_type;
+  c->m.runway_capacity = MAX_RUNWAY_CAPACITY;
+  chain_schedule(c, 0);
+  return c;
+}
+
+model_chain *model_chain_clone(const model_chain *c, unsigned int seed)
+{
+  model_chain *copy = malloc(sizeof(model_chain));
+  int first = c->count;
+  int i;
+
+  if (copy == NULL)
+  {
+    return NULL;
+  }
+
+  /* Only the aircraft from the first one still waiting or on the runway
+   * on are copied, renumbered from 0.
+   */
+  for (i = 0; i < c->m.num_waiting; i++)
+  {
+    if (c->m.waiting[i] < first)
+    {
+      first = c->m.waiting[i];
+    }
+  }
+  for (i = 0; i < c->m.aircraft_on_runway; i++)
+  {
+    if (c->m.occupants[i] < first)
+    {
+      first = c->m.occupants[i];
+    }
+  }
+
+  *copy = *c;
+  copy->aircraft = NULL;
+  copy->results = NULL;
+  copy->waiting = NULL;
+  copy->declared = NULL;
+  copy->count = c->count - first;
+  if (chain_reserve(copy, copy->count > 16 ? copy->count : 16) != 0)
+  {
+    model_chain_free(copy);
+    return NULL;
+  }
+  memcpy(copy->aircraft, c->aircraft + first,
+         sizeof(scenario_aircraft) * copy->count);
+  memcpy(copy->results, c->results + first,
+         sizeof(model_result) * copy->count);
+  memcpy(copy->declared, c->declared + first, copy->count);
+  for (i = 0; i < c->m.num_waiting; i++)
+  {
+    copy->waiting[i] = c->m.waiting[i] - first;
+  }
+  for (i = 0; i < c->m.aircraft_on_runway; i++)
+  {
+    copy->m.occupants[i] = c->m.occupants[i] - first;
+  }
+  copy->seed = seed;
+  copy->work = 0;
+
+  /* Poisson arrivals have no memory, so the time to the next one can be
+   * drawn again; a burst under way keeps its spacing.  Arrivals are due
+   * at the whole second after their time, so all that is known at now is
+   * that none came before the second before now.
+   */
+  if (c->burst_left == 0 && c->m.now < c->traffic.horizon)
+  {
+    chain_schedule(copy, ceil(c->m.now) - 1 > c->last_clock ?
+                         ceil(c->m.now) - 1 : c->last_clock);
+  }
+  return copy;
+}
+
+int model_chain_run(model_chain *c, double level, double ahead, int until)
+{
+  model_state *m = &c->m;
+  const scenario_aircraft *a;
+  double when;
+  double base;
+  double at;
+  int i;
+
+  c->peak = -NEVER;
+  while (1)
+  {
+    /* Overruns grow with time and the queue changes only at events, so
+     * the first crossing before the next event can be found directly.
+     */
+    when = next_change(m, c->next_arrival);
+    base = NEVER;
+    for (i = 0; i < m->num_waiting; i++)
+    {
+      a = &c->aircraft[m->waiting[i]];
+      at = a->arrival + a->fuel_reserve - i * ahead;
+      if (at < base)
+      {
+        base = at;
+      }
+    }
+    if (base + level < NEVER && base + level <= when)
+    {
+      if (base + level > m->now)
+      {
+        m->now = base + level;
+      }
+      c->peak = level;
+      return 1;
+    }
+    if (when >= NEVER)
+    {
+      return 0;
+    }
+    if (base < NEVER && when - base > c->peak)
+    {
+      c->peak = when - base;
+    }
+
+    m->now = when;
+    c->work++;
+    expire(m);
+    while (c->next_arrival <= m->now)
+    {
+      if (chain_arrive(c) != 0)
+      {
+        return 0;
+      }
+    }
+    settle(m);
+    if (until == MODEL_CHAIN_IDLE && m->aircraft_on_runway == 0 &&
+        m->num_waiting == 0 && m->action == ACTION_NONE &&
+        !m->shift_pending && !m->direction_pending)
+    {
+      return 0;
+    }
+  }
+}
+
+double model_chain_overrun(const model_chain *c)
+{
+  const scenario_aircraft *a;
+  double overrun = -NEVER;
+  double over;
+  int i;
+
+  /* Aircraft that landed, then those still waiting */
+  for (i = 0; i < c->count; i++)
+  {
+    a = &c->aircraft[i];
+    if (c->results[i].cleared_at > 0)
+    {
+      over = c->results[i].admitted_at - a->arrival - a->fuel_reserve;
+      if (over > overrun)
+      {
+        overrun = over;
+      }
+    }
+  }
+  for (i = 0; i < c->m.num_waiting; i++)
+  {
+    a = &c->aircraft[c->m.waiting[i]];
+    over = c->m.now - a->arrival - a->fuel_reserve;
+    if (over > overrun)
+    {
+      overrun = over;
+    }
+  }
+  return overrun;
+}
+
+double model_chain_peak(const model_chain *c)
+{
+  return c->peak;
+}
+
+double model_chain_now(const model_chain *c)
+{
+  return c->m.now;
+}
+
+long model_chain_work(const model_chain *c)
+{
+  return c->work;
+}
+
+void model_chain_free(model_chain *c)
+{
+  if (c == NULL)
+  {
+    return;
+  }
+  free(c->aircraft);
+  free(c->results);
+  free(c->waiting);
+  free(c->declared);
+  free(c);
+}
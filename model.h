@@ -0,0 +1,190 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Single-threaded reference model of the runway rules.
+ *
+ * The model replays a scenario as a discrete-event simulation with the
+ * admission semantics of can_enter_common() and the break/switch decisions
+ * of controller_thread(), but without threads, polling or timeouts:
+ * waiting aircraft are re-evaluated in arrival order at every event, fuel
+ * emergencies are declared exactly when the reserve runs out, and the
+ * controller acts as soon as its conditions hold.  Aircraft that arrive
+ * while the controller is busy only join the queue once it has reopened
+ * the runway to those already waiting, as the threads blocked on
+ * runway_mutex do, and capacity, shift and direction changes wait for it
+ * the same way.  It is the oracle the threaded simulator is checked
+ * against.  Departures and wake-turbulence separation are not modeled;
+ * the model treats every aircraft as a medium-category arrival.
+ */
+
+#ifndef MODEL_H
+#define MODEL_H
+
+#include "scenario.h"
+
+typedef struct
+{
+  double admitted_at;       /* time the aircraft entered the runway */
+  double cleared_at;        /* time the aircraft cleared the runway */
+  int direction;            /* NORTH or SOUTH */
+  int fuel_emergency;       /* non-zero if a fuel emergency was declared */
+} model_result;
+
+typedef struct
+{
+  double makespan;          /* time the last aircraft cleared */
+  double total_wait;        /* sum of admission waits */
+  double max_wait;          /* longest admission wait */
+  int fuel_emergencies;
+  int direction_switches;
+  int controller_breaks;
+  int controller_shifts;
+} model_metrics;
+
+/* Runs the model over a compiled scenario whose fuel reserves are all
+ * set.  results[i] gets the outcome of aircraft i and order (if not NULL)
+ * the aircraft ids in admission order.  Returns 0 on success, or -1 if
+ * the rules deadlock with aircraft still waiting.
+ */
+int model_run(const scenario *s, model_result *results, int *order,
+              model_metrics *metrics);
+
+/* Where several things happen at one instant the rules leave their order
+ * open, and the simulator's threads take them in whatever order they are
+ * scheduled: aircraft that arrive together get in line in any order, the
+ * controller may find the runway empty before the aircraft that arrive or
+ * are woken then look at the rules, new arrivals may look before the
+ * aircraft already in line, the aircraft woken when a slot frees race for
+ * it, a fuel emergency falling due as a slot frees may be declared after
+ * the slot is taken, a runway change that came in while the controller
+ * was busy may be made before or after the aircraft held with it get in
+ * line, and the controller may or may not start a break or switch as the
+ * last aircraft clears.  model_run() always breaks these ties the same
+ * way.
+ */
+#define MODEL_MAX_TIES 256
+
+typedef struct
+{
+  int num_fixed;            /* ties to break as choice[] says */
+  int num_ties;             /* ties the run came to, up to MODEL_MAX_TIES */
+  double at[MODEL_MAX_TIES];        /* model time of each */
+  int ways[MODEL_MAX_TIES];         /* ways it could go */
+  int choice[MODEL_MAX_TIES];       /* way it went, 0 as in model_run() */
+} model_ties;
+
+/* Same as model_run(), with the first ties->num_fixed ties broken as
+ * ties->choice[] says and the rest as model_run() breaks them.  The ties
+ * the run came to are recorded in ties, so that a caller can look for
+ * the outcome of any order the rules allow by running it again.
+ */
+int model_run_ties(const scenario *s, model_ties *ties,
+                   model_result *results, int *order,
+                   model_metrics *metrics);
+
+typedef struct
+{
+  int segments;             /* segments the scenario was first split into */
+  int merged;               /* cuts dropped because the runway was busy */
+  int replays;              /* segment replays, the first ones included */
+  long events;              /* events those replays went through */
+  int rounds;               /* parallel rounds until every boundary held */
+} model_split_stats;
+
+/* Same as model_run(), with the scenario split into up to segments pieces
+ * at gaps in the arrivals that are replayed on jobs threads.
+ *
+ * Where the runway is empty, nobody is waiting and the controller has
+ * nothing pending, the rest of the run depends only on the runway
+ * direction, the consecutive-direction, fairness and since-break counters.
+ * Each piece is replayed from a guess of that state; a piece whose guess
+ * differs from the state its predecessor really ended in is replayed
+ * again, and two pieces are joined when the runway turns out not to be
+ * idle at the cut.  The results are exactly those of model_run().
+ */
+int model_run_parallel(const scenario *s, model_result *results, int *order,
+                       model_metrics *metrics, int jobs, int segments,
+                       model_split_stats *stats);
+
+/* Traffic generated as a model_chain runs: Poisson arrivals, of which
+ * some bring a burst of aircraft close behind, with runway times and fuel
+ * reserves drawn uniformly.
+ */
+typedef struct
+{
+  double rate;              /* arrivals per hour, bursts not counted */
+  double commercial_share;  /* share of commercial among regular aircraft */
+  double emergency_share;
+  double burst_chance;      /* chance an arrival starts a burst */
+  int burst_size;           /* aircraft in a burst, the first included */
+  int burst_gap;            /* seconds between the aircraft of a burst */
+  int runway_min;
+  int runway_max;
+  int fuel_min;
+  int fuel_max;
+  double horizon;           /* no arrivals from this time on */
+} model_traffic;
+
+/* A run of the model over generated traffic that can be stopped when an
+ * aircraft has waited a given time past its fuel reserve and cloned, so
+ * that rare-event estimators can restart promising runs.
+ */
+typedef struct model_chain model_chain;
+
+/* Starts a run at time 0 with its own random stream.  Returns NULL if out
+ * of memory.
+ */
+model_chain *model_chain_start(const model_traffic *traffic,
+                               unsigned int seed);
+
+/* Copies c with a new random stream.  The copy's arrivals after the point
+ * c stopped at are drawn anew, and it only keeps the aircraft from the
+ * first one still waiting or on the runway on, so that clones of long
+ * runs stay small.  Returns NULL if out of memory.
+ */
+model_chain *model_chain_clone(const model_chain *c, unsigned int seed);
+
+#define MODEL_CHAIN_END 0        /* run until the traffic is over */
+#define MODEL_CHAIN_IDLE 1       /* or until the runway next goes idle */
+
+/* Runs c until the importance of a waiting aircraft reaches level, and
+ * returns 1, or until the traffic is over and everybody has landed (with
+ * until MODEL_CHAIN_IDLE, until the runway is empty, nobody waits and the
+ * controller has nothing to do), and returns 0.  The importance of an
+ * aircraft is how long it has waited past its fuel reserve plus ahead
+ * seconds for every aircraft waiting ahead of it; with ahead 0 it is the
+ * overrun itself.  A run that returned 1 can be run on to a higher level
+ * and one that returned 0 on to the next idle point.
+ */
+int model_chain_run(model_chain *c, double level, double ahead, int until);
+
+/* Highest importance the last model_chain_run() on c got to. */
+double model_chain_peak(const model_chain *c);
+
+/* The longest any aircraft c holds has waited past its fuel reserve,
+ * negative if none ran out.
+ */
+double model_chain_overrun(const model_chain *c);
+
+/* Model time c has got to */
+double model_chain_now(const model_chain *c);
+
+/* Events c went through since it was started or cloned. */
+long model_chain_work(const model_chain *c);
+
+void model_chain_free(model_chain *c);
+
+#endif
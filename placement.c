@@ -0,0 +1,150 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "placement.h"
+
+#define NODE_PATH "/sys/devices/system/node/node%d/cpulist"
+#define MAX_NODES 64             /* Nodes looked for and bound to */
+#define MPOL_BIND_MODE 2         /* MPOL_BIND of <linux/mempolicy.h> */
+
+int cpu_list_parse(const char *list, cpu_set_t *set)
+{
+  const char *p = list;
+  char *end;
+  long first;
+  long last;
+
+  CPU_ZERO(set);
+  while (*p != '\0' && *p != '\n')
+  {
+    if (!isdigit((unsigned char)*p))
+    {
+      return -1;
+    }
+    first = strtol(p, &end, 10);
+    last = first;
+    p = end;
+    if (*p == '-')
+    {
+      if (!isdigit((unsigned char)p[1]))
+      {
+        return -1;
+      }
+      last = strtol(p + 1, &end, 10);
+      p = end;
+    }
+    if (last < first || last >= CPU_SETSIZE)
+    {
+      return -1;
+    }
+    for (; first <= last; first++)
+    {
+      CPU_SET((int)first, set);
+    }
+    if (*p == ',')
+    {
+      p++;
+    }
+    else if (*p != '\0' && *p != '\n')
+    {
+      return -1;
+    }
+  }
+  return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+int numa_node_cpus(int node, cpu_set_t *set)
+{
+  char path[64];
+  char list[1024];
+  FILE *fp;
+  int result = -1;
+
+  if (node < 0 || node >= MAX_NODES)
+  {
+    return -1;
+  }
+  snprintf(path, sizeof(path), NODE_PATH, node);
+  if ((fp = fopen(path, "r")) == NULL)
+  {
+    /* No sysfs node directory: a machine without NUMA is node 0 */
+    if (node == 0)
+    {
+      return sched_getaffinity(0, sizeof(cpu_set_t), set);
+    }
+    return -1;
+  }
+  if (fgets(list, sizeof(list), fp) != NULL)
+  {
+    result = cpu_list_parse(list, set);
+  }
+  fclose(fp);
+  return result;
+}
+
+int numa_node_count(void)
+{
+  cpu_set_t set;
+  int count = 0;
+  int node;
+
+  for (node = 0; node < MAX_NODES; node++)
+  {
+    if (numa_node_cpus(node, &set) == 0)
+    {
+      count++;
+    }
+  }
+  return count > 0 ? count : 1;
+}
+
+void *node_alloc(size_t size, int node)
+{
+  unsigned long mask;
+  void *p;
+
+  p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+           -1, 0);
+  if (p == MAP_FAILED)
+  {
+    return NULL;
+  }
+  if (node >= 0 && node < MAX_NODES)
+  {
+    mask = 1UL << node;
+    syscall(SYS_mbind, p, size, MPOL_BIND_MODE, &mask,
+            (unsigned long)MAX_NODES, 0UL);
+  }
+  return p;
+}
+
+void node_free(void *p, size_t size)
+{
+  if (p != NULL)
+  {
+    munmap(p, size);
+  }
+}
@@ -0,0 +1,53 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Thread and memory placement for a simulation run.
+ *
+ * CPU sets are written as lists like "0-3,8,10-11", the format of the
+ * kernel's cpulist files.  The CPUs of a NUMA node are read from sysfs,
+ * and memory is bound to a node with the mbind system call, so nothing
+ * beyond the C library is needed; on a machine without NUMA there is one
+ * node, node 0.
+ */
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+/* cpu_set_t needs _GNU_SOURCE, defined before any header is included */
+#include <sched.h>
+#include <stddef.h>
+
+/* Parses a CPU list into set.  Returns 0, or -1 if the list is malformed
+ * or names a CPU beyond CPU_SETSIZE.
+ */
+int cpu_list_parse(const char *list, cpu_set_t *set);
+
+/* Number of NUMA nodes with CPUs, at least 1. */
+int numa_node_count(void);
+
+/* Fills set with the CPUs of a node.  Returns 0, or -1 if there is no
+ * such node.
+ */
+int numa_node_cpus(int node, cpu_set_t *set);
+
+/* Maps size zeroed bytes whose pages are placed on the given node when
+ * they are first touched.  Returns NULL if memory runs out.  Binding is
+ * best effort: where the kernel refuses it the memory is still returned.
+ */
+void *node_alloc(size_t size, int node);
+void node_free(void *p, size_t size);
+
+#endif
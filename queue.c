@@ -0,0 +1,124 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+#include "queue.h"
+
+int bounded_queue_init(bounded_queue *q, unsigned long size,
+                       arena_cache *cache)
+{
+  unsigned long i;
+
+  if (size < 2 || (size & (size - 1)) != 0)
+  {
+    return -1;
+  }
+  if ((q->cells = arena_alloc(cache, sizeof(bounded_queue_cell) * size)) ==
+      NULL)
+  {
+    return -1;
+  }
+
+  for (i = 0; i < size; i++)
+  {
+    q->cells[i].sequence = i;
+    q->cells[i].item = NULL;
+  }
+  q->mask = size - 1;
+  q->enqueue_pos = 0;
+  q->dequeue_pos = 0;
+  return 0;
+}
+
+int bounded_queue_push(bounded_queue *q, void *item)
+{
+  bounded_queue_cell *cell;
+  unsigned long pos;
+  long diff;
+
+  pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+  while (1)
+  {
+    cell = &q->cells[pos & q->mask];
+    diff = (long)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - pos);
+    if (diff == 0)
+    {
+      /* The cell is free for this position; try to claim it */
+      if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      /* The consumer of the previous lap has not emptied it: full */
+      return 0;
+    }
+    else
+    {
+      pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  cell->item = item;
+  __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+int bounded_queue_pop(bounded_queue *q, void **item)
+{
+  bounded_queue_cell *cell;
+  unsigned long pos;
+  long diff;
+
+  pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+  while (1)
+  {
+    cell = &q->cells[pos & q->mask];
+    diff = (long)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) -
+                  (pos + 1));
+    if (diff == 0)
+    {
+      if (__atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      /* Nothing has been pushed at this position yet: empty */
+      return 0;
+    }
+    else
+    {
+      pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  *item = cell->item;
+  /* Free the cell for the producer one lap ahead */
+  __atomic_store_n(&cell->sequence, pos + q->mask + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+unsigned long bounded_queue_length(bounded_queue *q)
+{
+  unsigned long enqueued = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+  unsigned long dequeued = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+
+  return enqueued > dequeued ? enqueued - dequeued : 0;
+}
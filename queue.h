@@ -0,0 +1,65 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Bounded lock-free queue of pointers for handing aircraft from one
+ * pipeline stage to the next.
+ *
+ * Any number of threads may push and pop at the same time.  Each cell
+ * carries a sequence number that tells producers and consumers whether it
+ * is free for them; claiming a cell is one compare-and-swap on the shared
+ * position.  Push and pop never block: they return 0 when the queue is
+ * full or empty and leave waiting to the caller.
+ */
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include "arena.h"
+
+typedef struct
+{
+  unsigned long sequence;
+  void *item;
+} bounded_queue_cell;
+
+typedef struct
+{
+  bounded_queue_cell *cells;
+  unsigned long mask;            /* size - 1; the size is a power of two */
+  unsigned long enqueue_pos;
+  unsigned long dequeue_pos;
+} bounded_queue;
+
+/* Sets up an empty queue with its cells taken from the run's arena, so
+ * they go when the arena is released.  size must be a power of two.
+ * Returns 0 on success or -1 if size is not a power of two or memory runs
+ * out.
+ */
+int bounded_queue_init(bounded_queue *q, unsigned long size,
+                       arena_cache *cache);
+
+/* Returns 1 if item was added, or 0 if the queue is full. */
+int bounded_queue_push(bounded_queue *q, void *item);
+
+/* Returns 1 and stores the oldest item in *item, or 0 if the queue is
+ * empty.
+ */
+int bounded_queue_pop(bounded_queue *q, void **item);
+
+/* Number of items in the queue.  Only a snapshot while others use it. */
+unsigned long bounded_queue_length(bounded_queue *q);
+
+#endif
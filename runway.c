@@ -25,106 +25,690 @@
 #include <errno.h>
 #include <assert.h>
 #include <time.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+#include "librunway.h"
+#include "runway.h"
+#include "scenario.h"
+#include "holding.h"
+#include "queue.h"
+#include "airport.h"
+#include "arena.h"
+#include "placement.h"
+#include "live.h"
+#ifdef COUNT_ALLOCATIONS
+#include "alloccount.h"
+#endif
+
+/* Recovery after runway closures.  For each closure we keep the backlog
+ * when it closed and when it reopened, the first admission after
+ * reopening and the moment the backlog built up during the closure was
+ * gone again.
+ */
+#define MAX_CLOSURES 64          /* Closures tracked for the summary */
 
-/*** Constants that define parameters of the simulation ***/
-
-#define MAX_RUNWAY_CAPACITY 2    /* Number of aircraft that can use runway simultaneously */
-#define CONTROLLER_LIMIT 8       /* Number of aircraft the controller can manage before break */
-#define MAX_AIRCRAFT 1000        /* Maximum number of aircraft in the simulation */
-#define FUEL_MIN 20              /* Minimum fuel reserve in seconds */
-#define FUEL_MAX 60              /* Maximum fuel reserve in seconds */
-#define EMERGENCY_TIMEOUT 30     /* Max wait time for emergency aircraft in seconds */
-#define DIRECTION_SWITCH_TIME 5  /* Time required to switch runway direction */
-#define DIRECTION_LIMIT 3        /* Max consecutive aircraft in same direction */
-
-#define COMMERCIAL 0
-#define CARGO 1
-#define EMERGENCY 2
-
-#define NORTH 0
-#define SOUTH 1
-#define EAST  2
-#define WEST  4
-
-/* TODO */
-/* Add your synchronization variables here */
+typedef struct
+{
+  double closed_at;
+  double reopened_at;            /* -1 while still closed */
+  int backlog_before;            /* aircraft waiting when it closed */
+  int backlog_at_reopen;         /* aircraft waiting when it reopened */
+  double recovered_at;           /* first admission after reopening, or -1 */
+  double cleared_at;             /* backlog back to backlog_before, or -1 */
+} closure_record;
+
+/* While an aircraft waits, its waiting time is charged to the first rule
+ * that keeps it off the runway (RUNWAY_BLOCK_* in librunway.h).
+ */
+#define BLOCK_NONE -1            /* Aircraft may take the runway */
 
-/* Global mutex and condition variable used for all synchronization */
-static pthread_mutex_t runway_mutex;
-static pthread_cond_t  cond_aircraft;
+/* Holding stack for aircraft that cannot land straight away.  Without -H
+ * it has no levels and waiting aircraft simply wait, as before.
+ */
+#define DIVERT_FULL 1            /* Holding stack was full */
+#define DIVERT_FUEL 2            /* Holding fuel ran out */
+#define DIVERT_ABANDONED 3       /* Run abandoned while it was waiting */
+
+/* Arrival order within each class.  An aircraft takes the next ticket of
+ * its class when it arrives, and only the one holding the oldest ticket
+ * still waiting looks at the rules; the others sleep until they are at
+ * the front.  Aircraft with a fuel emergency look at the rules anyway, and
+ * so do lighter ones while the head lets them go first for wake
+ * separation.  Every waiting arrival sleeps on a condition variable of
+ * its own, so only the aircraft whose turn it is are woken.
+ */
+#define TICKET_RING 1024         /* Tickets a queue can have outstanding */
 
-/* Waiting counters */
-static int waiting_commercial = 0;
-static int waiting_cargo = 0;
-static int waiting_emergency = 0;
+typedef struct
+{
+  unsigned long next;            /* ticket for the next arrival */
+  unsigned long head;            /* oldest ticket still waiting */
+  int block;                     /* RUNWAY_BLOCK_* the head last waited for */
+  int yield;                     /* wake categories below this may go too */
+  unsigned char gone[TICKET_RING];  /* tickets past head that have left */
+} ticket_queue;
 
-/* Waiting by preferred direction (commercial -> NORTH, cargo -> SOUTH) */
-static int waiting_north = 0;
-static int waiting_south = 0;
+#define LIVE_CHANGE -1            /* live_publish() without an aircraft event */
 
-/* Number of aircraft that have declared fuel emergencies */
-static int fuel_emergency_waiting = 0;
+#define PAUSE_ON_ABORT 1         /* pause_for() ends when the run is aborted */
+#define PAUSE_ON_EXIT 2          /* ... or when the controller should exit */
 
-/* Track last non-emergency regular type (COMMERCIAL or CARGO)
- * for fairness after 4 consecutive of the same type.
- */
-static int last_regular_type = -1;
-static int regular_type_count = 0;
+static const char *type_names[] = { "Commercial", "Cargo", "Emergency" };
+static const char *arrival_names[] = { "Commercial", "Cargo", "EMERGENCY" };
 
-/* basic information about simulation.  they are printed/checked at the end
- * and in assert statements during execution.
- *
- * you are responsible for maintaining the integrity of these variables in the
- * code that you develop.
+/* Wake-turbulence separation in seconds between the admission of a
+ * leader (row) and the next aircraft (column).  Lighter aircraft behind
+ * heavier ones need the most; nothing is needed behind a lighter leader.
  */
-
-static int aircraft_on_runway = 0;       /* Total number of aircraft currently on runway */
-static int commercial_on_runway = 0;     /* Total number of commercial aircraft on runway */
-static int cargo_on_runway = 0;          /* Total number of cargo aircraft on runway */
-static int emergency_on_runway = 0;      /* Total number of emergency aircraft on runway */
-static int aircraft_since_break = 0;     /* Aircraft processed since last controller break */
-static int current_direction = NORTH;    /* Current runway direction (NORTH or SOUTH) */
-static int consecutive_direction = 0;    /* Consecutive aircraft in current direction */
+static const double wake_separation[WAKE_CATEGORIES][WAKE_CATEGORIES] =
+{
+  /* follower:  L  M  H  J */
+  /* L */     { 0, 0, 0, 0 },
+  /* M */     { 3, 0, 0, 0 },
+  /* H */     { 4, 3, 0, 0 },
+  /* J */     { 6, 5, 4, 0 }
+};
 
 typedef struct
 {
+  runway_sim *sim;          /* simulation the aircraft belongs to */
   int arrival_time;         /* time between arrival of this aircraft and previous */
   int runway_time;          /* time the aircraft needs to spend on the runway */
   int aircraft_id;
   int aircraft_type;        /* COMMERCIAL, CARGO, or EMERGENCY */
   int fuel_reserve;         /* Randomly assigned fuel reserve (FUEL_MIN to FUEL_MAX) */
-  time_t arrival_timestamp; /* timestamp when aircraft thread was created */
+  double arrival_timestamp; /* simulated time when aircraft thread was created */
+  double admitted_at;       /* simulated time the aircraft entered the runway */
+  double cleared_at;        /* simulated time the aircraft cleared the runway */
+  int direction;            /* runway direction used (NORTH or SOUTH) */
+  int fuel_emergency;       /* non-zero if a fuel emergency was declared */
+  int holding_level;        /* level in the holding stack, or HOLDING_NONE */
+  double fuel_left;         /* holding fuel left before a fuel emergency */
+  double fuel_checked_at;   /* simulated time fuel_left was last updated */
+  double fuel_burned;       /* fuel burned in the holding stack */
+  int diverted;             /* DIVERT_* reason, or 0 if the aircraft landed */
+  int departure;            /* non-zero for a departure */
+  int wake;                 /* WAKE_* category */
+  int wake_deferred;        /* non-zero once it let another aircraft go first */
+  int runway_end;           /* end of the airport layout in use, or -1 */
+  double exit_blocked;      /* time spent on the runway waiting for the taxiway */
+  double parked_at;         /* simulated time the aircraft reached its gate */
+  int block_reason;         /* RUNWAY_BLOCK_* it is waiting for, or BLOCK_NONE */
+  double block_since;       /* simulated time it was last checked */
+  double blocked[RUNWAY_BLOCK_REASONS];   /* waiting time by reason */
+  unsigned long ticket;     /* place in the arrival order of its class */
+  long admission;           /* place in the admission order, or -1 */
+  int fuel_declared;        /* declared a fuel emergency while waiting */
+  int granted;              /* admitted by the controller with a group */
+  pthread_cond_t turn;      /* it sleeps on this while waiting to land */
 } aircraft_info;
 
+/* Taxi and gate stages after runway clearance (-P).  A stage has a number
+ * of servers (taxiway slots or gates) that each hold an aircraft for
+ * service_time, fed by a bounded lock-free queue.  A server that cannot
+ * hand its aircraft to the next stage keeps it, so full gates back up the
+ * taxiway and a full taxiway keeps aircraft on the runway.
+ */
+typedef struct pipeline_stage pipeline_stage;
+
+typedef struct
+{
+  pipeline_stage *stage;
+  pthread_t tid;
+  double busy;              /* time spent serving aircraft */
+  double blocked;           /* time spent waiting for the next stage */
+} stage_server;
+
+struct pipeline_stage
+{
+  runway_sim *sim;
+  const char *name;
+  const char *unit;         /* what a server is called in the summary */
+  int num_servers;
+  double service_time;
+  bounded_queue input;
+  pipeline_stage *next;     /* NULL for the last stage */
+  stage_server *servers;
+  unsigned long longest_queue;
+  int closing;              /* set once nothing more will be queued */
+  double busy;              /* server totals, collected when it stops */
+  double blocked;
+};
+
+/* A slot of the soak mode's aircraft pool (see soak_run()). */
+typedef struct
+{
+  aircraft_info ai;
+  pthread_t tid;
+  sem_t start;              /* posted when the slot has an aircraft to fly */
+  int next_free;            /* next slot in the free list, or -1 */
+} soak_slot;
+
+typedef struct
+{
+  long handled;             /* aircraft that cleared or diverted */
+  long landed;
+  double total_wait;
+  double max_wait;
+  long pool_stalls;         /* arrivals that found every slot in use */
+  int peak_in_flight;
+  long first_rss;           /* resident set in kB after the first hour */
+  long peak_rss;
+} soak_stats;
+
+/* Everything one simulation run works on.  There is no state outside it,
+ * so any number of simulations can run side by side in one process.
+ */
+struct runway_sim
+{
+  runway_config config;
+
+  /* Mutex used for all synchronization, and the condition variable the
+   * departures wait on; arrivals wait on their own (see ticket_queue)
+   */
+  pthread_mutex_t runway_mutex;
+  pthread_cond_t  cond_aircraft;
+
+  /* Waiting counters */
+  int waiting_commercial;
+  int waiting_cargo;
+  int waiting_emergency;
+
+  /* Waiting by preferred direction (commercial -> NORTH, cargo -> SOUTH) */
+  int waiting_north;
+  int waiting_south;
+
+  /* Number of aircraft that have declared fuel emergencies */
+  int fuel_emergency_waiting;
+
+  /* Departures waiting at the runway hold point, and those that have
+   * waited DEPARTURE_MAX_WAIT and now hold up new arrivals.
+   */
+  int waiting_departures;
+  int departures_due;
+
+  /* Track last non-emergency regular type (COMMERCIAL or CARGO)
+   * for fairness after config.fairness_limit consecutive of the same
+   * type.
+   */
+  int last_regular_type;
+  int regular_type_count;
+
+  /* basic information about simulation.  they are printed/checked at the
+   * end and in assert statements during execution.
+   *
+   * you are responsible for maintaining the integrity of these variables
+   * in the code that you develop.
+   */
+  int aircraft_on_runway;       /* Total number of aircraft currently on runway */
+  int commercial_on_runway;     /* Total number of commercial aircraft on runway */
+  int cargo_on_runway;          /* Total number of cargo aircraft on runway */
+  int emergency_on_runway;      /* Total number of emergency aircraft on runway */
+  int departures_on_runway;     /* Departures rolling on the runway */
+  int aircraft_since_break;     /* Aircraft processed since last controller break */
+  int current_direction;        /* Current runway direction (NORTH or SOUTH) */
+  int consecutive_direction;    /* Consecutive aircraft in current direction */
+  int runway_capacity;          /* Current capacity, changed by scenario events */
+  int runway_slots;             /* Most aircraft on the runways at once */
+
+  /* Airport layout with several runways.  Aircraft are assigned a runway
+   * end of the current flow direction that no runway in use excludes, and
+   * the capacity set by scenario events applies to each end.
+   */
+  airport layout;
+  int use_layout;
+
+  /* Controller shift change requested by a scenario event.  New aircraft
+   * are held until the runway is empty and the incoming controller has
+   * taken over.
+   */
+  int shift_pending;
+  int shift_handover;           /* Handover time of the pending shift */
+
+  /* Runway direction change ordered by a scenario event.  New aircraft
+   * are held so the runway drains, then the controller switches.
+   */
+  int direction_pending;
+  int forced_direction;
+
+  closure_record closures[MAX_CLOSURES];
+  int num_closures;
+
+  holding_stack holding;
+
+  /* Run statistics printed in the summary at the end of the simulation */
+  int direction_switches;       /* Number of completed direction switches */
+  int controller_breaks;        /* Number of controller breaks taken */
+  int controller_shifts;        /* Number of controller shift changes */
+  int fuel_emergencies;         /* Number of fuel emergencies declared */
+
+  /* Wake state of the admission stream: the last aircraft admitted, and
+   * waiting commercial and cargo aircraft by category.  Nothing is needed
+   * behind a lighter leader, so when a lighter aircraft could go as well
+   * it goes first and the heavier one follows it without separation.
+   */
+  int leader_wake;
+  double leader_admitted_at;
+  int waiting_wake[2][WAKE_CATEGORIES];
+  double wake_time;             /* Separation required in total */
+  int wake_deferrals;           /* Aircraft that let others go first */
+  int wake_deferring;           /* Someone is waiting for a lighter one */
+
+  /* Arrival order of each class (see ticket_queue) and the aircraft
+   * holding each ticket, for the controller's group admission.
+   */
+  ticket_queue queues[3];
+  aircraft_info *ticket_holders[3][TICKET_RING];
+  long admissions;              /* Arrivals admitted so far */
+
+  /* Reopening ramp: wall-clock time from the end of a switch, break or
+   * handover with aircraft waiting to the last admission the reopening
+   * allowed.  The ramp ends when the runway is full or nobody is left
+   * waiting, and before anything else can let more in: a clearance, an
+   * arrival, a fuel declaration or a separation hold.
+   */
+  int ramping;                  /* Set while the runway is filling up */
+  struct timespec reopened_at;  /* Wall-clock end of the pause */
+  double ramp;                  /* Last admission of the ramp, or -1 */
+  unsigned long ramp_tickets;   /* Arrivals so far when it reopened */
+  int ramp_declarations;        /* Fuel emergencies when it reopened */
+  int reopenings;               /* Pauses after which aircraft waited */
+  int ramps;                    /* ... and at least one was admitted */
+  double ramp_total;
+  double ramp_max;
+
+  /* Runway occupancy, for separation and throughput */
+  double arrival_cleared_at;    /* Last time an arrival cleared the runway */
+  double busy_since;            /* Time the runway was last taken */
+  double busy_time;             /* Total time with aircraft on the runway */
+
+  /* Simulation clock.  All times in the simulation are in simulated
+   * seconds measured from clock_epoch.  config.speed scales simulated time
+   * relative to wall-clock time so that long traces can be replayed
+   * quickly.
+   */
+  struct timespec clock_epoch;  /* Wall-clock start of the simulation */
+
+  pipeline_stage taxi_stage;
+  pipeline_stage gate_stage;
+  double pipeline_span;         /* Time the last stage finished */
+
+  /* The loaded scenario and the aircraft records built from it */
+  scenario sc;
+  int loaded;
+  aircraft_info *ai;
+  pthread_t *aircraft_tid;
+  int num_aircraft;
+  int finished;                 /* set once the run is over */
+  int abandoned;                /* set when the stall watchdog gives up */
+  double progress_at;           /* last time the runway was not stalled */
+  int gave_up;                  /* aircraft that gave up waiting */
+
+  /* Cooperative shutdown.  stopping and controller_exit are set under
+   * stop_mutex and read without it; pauses wait on stop_cond so that they
+   * can be cut short.
+   */
+  pthread_mutex_t stop_mutex;
+  pthread_cond_t stop_cond;
+  int stopping;                 /* 0, or the RUNWAY_STOP_* policy + 1 */
+  int controller_exit;          /* set when the controller should exit */
+  struct timespec stop_at;      /* wall-clock time of the first stop */
+  double shutdown_latency;      /* wall-clock seconds the stop took */
+  int scheduled;                /* aircraft in the scenario */
+  int reactor_fd;               /* eventfd of a reactor run, or -1 */
+  double soak_span;             /* simulated seconds the soak run lasted */
+
+  /* Live view for runway-top (config.live_name), or NULL */
+  live_state *live;
+  int controller_state;         /* LIVE_* */
+  double controller_until;      /* End of the break, switch or handover */
+
+  /* Soak mode: the aircraft pool and what it has flown */
+  pthread_mutex_t soak_mutex;
+  pthread_cond_t soak_cond;
+  soak_slot *soak_pool;
+  int soak_free;                /* Head of the free slot list */
+  int soak_in_flight;           /* Slots flying an aircraft */
+  int soak_stopping;            /* Set when the workers should exit */
+  soak_stats soak;
+
+  /* Memory for the run: aircraft records, thread ids, pipeline stages and
+   * the soak pool.  Only the thread that loads and starts the run
+   * allocates, through run_cache; the aircraft threads allocate nothing
+   * at all.
+   */
+  arena run_arena;
+  arena_cache run_cache;
+
+  /* Placement: thread attributes carrying the CPU sets of the config, and
+   * where the thread in runway_run() was allowed to run before.
+   */
+  pthread_attr_t controller_attr;
+  pthread_attr_t aircraft_attr;
+  cpu_set_t controller_cpus;
+  int pin_controller;
+  cpu_set_t dispatcher_cpus;
+};
+
+/* Returns the current simulated time in seconds since clock_epoch. */
+static double sim_now(runway_sim *sim)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((double)(now.tv_sec - sim->clock_epoch.tv_sec) +
+          (double)(now.tv_nsec - sim->clock_epoch.tv_nsec) / 1e9) *
+         sim->config.speed;
+}
+
+/* Sleeps for the given number of simulated seconds. */
+static void sim_sleep(runway_sim *sim, double seconds)
+{
+  struct timespec ts;
+  double wall = seconds / sim->config.speed;
+
+  ts.tv_sec = (time_t)wall;
+  ts.tv_nsec = (long)((wall - (double)ts.tv_sec) * 1e9);
+  while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+  {
+  }
+}
+
+/* Fills ts with the absolute CLOCK_REALTIME deadline that lies the given
+ * number of simulated seconds from now, for use with
+ * pthread_cond_timedwait().
+ */
+static void sim_deadline(runway_sim *sim, struct timespec *ts, double seconds)
+{
+  double wall = seconds / sim->config.speed;
+
+  clock_gettime(CLOCK_REALTIME, ts);
+  ts->tv_sec += (time_t)wall;
+  ts->tv_nsec += (long)((wall - (double)(time_t)wall) * 1e9);
+  if (ts->tv_nsec >= 1000000000L)
+  {
+    ts->tv_sec += 1;
+    ts->tv_nsec -= 1000000000L;
+  }
+}
+
+/* Returns the RUNWAY_STOP_* policy of a requested stop, or -1. */
+static int stop_policy(runway_sim *sim)
+{
+  return __atomic_load_n(&sim->stopping, __ATOMIC_ACQUIRE) - 1;
+}
+
+/* Non-zero when waiting aircraft should give up instead of waiting on:
+ * the stall watchdog abandoned the run or it is being aborted.  Called
+ * with runway_mutex locked.
+ */
+static int giving_up(runway_sim *sim)
+{
+  return sim->abandoned || stop_policy(sim) == RUNWAY_STOP_ABORT;
+}
+
+static int pause_over(runway_sim *sim, int until)
+{
+  return ((until & PAUSE_ON_EXIT) &&
+          __atomic_load_n(&sim->controller_exit, __ATOMIC_ACQUIRE)) ||
+         ((until & PAUSE_ON_ABORT) && stop_policy(sim) == RUNWAY_STOP_ABORT);
+}
+
+/* Waits the given number of simulated seconds, or less if one of the
+ * PAUSE_ON_* events in until happens.  Unlike sim_sleep() it can be cut
+ * short, so the controller may pause in it with runway_mutex held.
+ */
+static void pause_for(runway_sim *sim, double seconds, int until)
+{
+  struct timespec ts;
+
+  sim_deadline(sim, &ts, seconds);
+  pthread_mutex_lock(&sim->stop_mutex);
+  while (!pause_over(sim, until) &&
+         pthread_cond_timedwait(&sim->stop_cond, &sim->stop_mutex,
+                                &ts) != ETIMEDOUT)
+  {
+  }
+  pthread_mutex_unlock(&sim->stop_mutex);
+}
+
+/* Pauses for simulated work: time on the runway or at a stage. */
+static void sim_pause(runway_sim *sim, double seconds)
+{
+  pause_for(sim, seconds, PAUSE_ON_ABORT);
+}
+
+/* Pauses the controller for a break, a switch or a handover. */
+static void controller_pause(runway_sim *sim, double seconds)
+{
+  pause_for(sim, seconds, PAUSE_ON_ABORT | PAUSE_ON_EXIT);
+}
+
+/* Waits until the given simulated time or a stop request, whichever comes
+ * first.  Returns non-zero if a stop was requested.
+ */
+static int wait_for_stop(runway_sim *sim, double when)
+{
+  struct timespec ts;
+  double now = sim_now(sim);
+  int stopped;
+
+  sim_deadline(sim, &ts, when > now ? when - now : 0);
+  pthread_mutex_lock(&sim->stop_mutex);
+  while (stop_policy(sim) < 0 &&
+         pthread_cond_timedwait(&sim->stop_cond, &sim->stop_mutex,
+                                &ts) != ETIMEDOUT)
+  {
+  }
+  stopped = stop_policy(sim) >= 0;
+  pthread_mutex_unlock(&sim->stop_mutex);
+  return stopped;
+}
+
+static double wall_since(const struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Hands a line of the simulation log to the event callback.  Every line
+ * the simulation reports goes through here, from whichever thread reports
+ * it; the CLI prints them to stdout.
+ */
+static void say(runway_sim *sim, const char *format, ...)
+{
+  char line[256];
+  size_t length;
+  va_list args;
+  runway_event event;
+
+  if (sim->config.on_event == NULL)
+  {
+    return;
+  }
+
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  length = strlen(line);
+  if (length > 0 && line[length - 1] == '\n')
+  {
+    line[length - 1] = '\0';
+  }
+
+  event.kind = RUNWAY_EVENT_MESSAGE;
+  event.time = sim_now(sim);
+  event.aircraft_id = -1;
+  event.aircraft_type = -1;
+  event.direction = -1;
+  event.message = line;
+  sim->config.on_event(&event, sim->config.user);
+}
+
+/* Reports an aircraft event (RUNWAY_EVENT_ADMITTED, _CLEARED or
+ * _DIVERTED) to the event callback.
+ */
+static void announce(runway_sim *sim, int kind, const aircraft_info *ai)
+{
+  runway_event event;
+
+  if (sim->config.on_event == NULL)
+  {
+    return;
+  }
+
+  event.kind = kind;
+  event.aircraft_id = ai->aircraft_id;
+  event.aircraft_type = ai->aircraft_type;
+  event.direction = kind == RUNWAY_EVENT_DIVERTED ? -1 : ai->direction;
+  event.time = kind == RUNWAY_EVENT_ADMITTED ? ai->admitted_at
+             : kind == RUNWAY_EVENT_CLEARED ? ai->cleared_at : sim_now(sim);
+  event.message = NULL;
+  sim->config.on_event(&event, sim->config.user);
+}
+
+/* Copies the runway state to the live view for runway-top, if there is
+ * one.  Called with runway_mutex locked after every change.  kind is the
+ * RUNWAY_EVENT_* that goes with the change or LIVE_CHANGE; the aircraft
+ * is only looked at for admissions and diversions.
+ */
+static void live_publish(runway_sim *sim, int kind, const aircraft_info *ai)
+{
+  live_state *s = sim->live;
+
+  if (s == NULL)
+  {
+    return;
+  }
+
+  live_begin(s);
+  s->updated_at = sim_now(sim);
+  s->waiting[COMMERCIAL] = sim->waiting_commercial;
+  s->waiting[CARGO] = sim->waiting_cargo;
+  s->waiting[EMERGENCY] = sim->waiting_emergency;
+  s->waiting_north = sim->waiting_north;
+  s->waiting_south = sim->waiting_south;
+  s->waiting_departures = sim->waiting_departures;
+  s->fuel_emergency_waiting = sim->fuel_emergency_waiting;
+  s->on_runway[COMMERCIAL] = sim->commercial_on_runway;
+  s->on_runway[CARGO] = sim->cargo_on_runway;
+  s->on_runway[EMERGENCY] = sim->emergency_on_runway;
+  s->departures_on_runway = sim->departures_on_runway;
+  s->capacity = sim->runway_capacity;
+  s->direction = sim->current_direction;
+  s->consecutive_direction = sim->consecutive_direction;
+  s->aircraft_since_break = sim->aircraft_since_break;
+  s->controller = sim->controller_state;
+  s->controller_until = sim->controller_until;
+  s->direction_switches = sim->direction_switches;
+  s->controller_breaks = sim->controller_breaks;
+  if (kind == RUNWAY_EVENT_ADMITTED && ai->departure)
+  {
+    s->departed++;
+  }
+  else if (kind == RUNWAY_EVENT_ADMITTED)
+  {
+    s->waits[s->waits_seen % LIVE_WAITS] =
+      (float)(ai->admitted_at - ai->arrival_timestamp);
+    s->waits_seen++;
+    s->landed++;
+  }
+  else if (kind == RUNWAY_EVENT_DIVERTED && ai->diverted != DIVERT_ABANDONED)
+  {
+    s->diverted++;
+  }
+  live_end(s);
+}
+
+/* Shows in the live view what the controller does for the next seconds:
+ * a break, a switch or a handover, or LIVE_WORKING once it is back.
+ * Called with runway_mutex locked.
+ */
+static void live_controller(runway_sim *sim, int state, double seconds)
+{
+  if (sim->live == NULL)
+  {
+    return;
+  }
+  sim->controller_state = state;
+  sim->controller_until = sim_now(sim) + seconds;
+  live_publish(sim, LIVE_CHANGE, NULL);
+}
+
+/* Called as the run starts, with clock_epoch set, and once it is over. */
+static void live_run(runway_sim *sim, int finished)
+{
+  live_state *s = sim->live;
+
+  if (s == NULL)
+  {
+    return;
+  }
+  live_begin(s);
+  s->epoch_sec = (long)sim->clock_epoch.tv_sec;
+  s->epoch_nsec = sim->clock_epoch.tv_nsec;
+  s->speed = sim->config.speed;
+  s->finished = finished;
+  live_end(s);
+  live_publish(sim, LIVE_CHANGE, NULL);
+}
+
 /*
- * Function: can_enter_common
+ * Function: entry_block
  * Parameters:
  *   ai               - pointer to aircraft information structure
  *   desired_direction - NORTH or SOUTH for this aircraft
  *   fuel_emergency   - non-zero if this aircraft has reached fuel emergency
  * Returns:
- *   1 if aircraft is allowed to enter the runway now, 0 otherwise.
+ *   BLOCK_NONE if aircraft is allowed to enter the runway now, otherwise
+ *   the RUNWAY_BLOCK_* reason it has to wait.
  * Description:
  *   Checks all global constraints (capacity, break limit, priorities,
  *   direction rules, type separation, and fairness).
  *   Must be called with runway_mutex locked.
  */
 static int
-can_enter_common(aircraft_info *ai, int desired_direction, int fuel_emergency)
+entry_block(aircraft_info *ai, int desired_direction, int fuel_emergency)
 {
+  runway_sim *sim = ai->sim;
   int opposite_waiting;
   int other_type_waiting;
 
-  /* Capacity: at most 2 aircraft on runway */
-  if (aircraft_on_runway >= MAX_RUNWAY_CAPACITY)
+  /* Capacity: at most runway_capacity aircraft on runway */
+  if (!sim->use_layout && sim->aircraft_on_runway >= sim->runway_capacity)
   {
-    return 0;
+    return RUNWAY_BLOCK_RUNWAY;
+  }
+
+  /* A departure has the runway to itself */
+  if (sim->departures_on_runway > 0)
+  {
+    return RUNWAY_BLOCK_RUNWAY;
+  }
+
+  /* Shift change: hold new aircraft until the new controller takes over */
+  if (sim->shift_pending)
+  {
+    return RUNWAY_BLOCK_CONTROLLER;
+  }
+
+  /* Ordered direction change: hold new aircraft until the runway drains */
+  if (sim->direction_pending)
+  {
+    return RUNWAY_BLOCK_DIRECTION;
   }
 
   /* Controller break: after 8 aircraft, block new ones until break */
-  if (aircraft_since_break >= CONTROLLER_LIMIT)
+  if (sim->aircraft_since_break >= sim->config.controller_limit)
   {
-    return 0;
+    return RUNWAY_BLOCK_CONTROLLER;
   }
 
   /* Direction preference for commercial and cargo:
@@ -133,54 +717,61 @@ can_enter_common(aircraft_info *ai, int desired_direction, int fuel_emergency)
    */
   if (ai->aircraft_type == COMMERCIAL || ai->aircraft_type == CARGO)
   {
-    if (desired_direction != current_direction)
+    if (desired_direction != sim->current_direction)
     {
-      return 0;
+      return RUNWAY_BLOCK_DIRECTION;
     }
   }
 
   /* Commercial and cargo cannot be on runway together */
-  if (ai->aircraft_type == COMMERCIAL && cargo_on_runway > 0)
+  if (ai->aircraft_type == COMMERCIAL && sim->cargo_on_runway > 0)
   {
-    return 0;
+    return RUNWAY_BLOCK_TYPE;
   }
-  if (ai->aircraft_type == CARGO && commercial_on_runway > 0)
+  if (ai->aircraft_type == CARGO && sim->commercial_on_runway > 0)
   {
-    return 0;
+    return RUNWAY_BLOCK_TYPE;
   }
 
   /* Fuel emergency has highest priority */
-  if (fuel_emergency_waiting > 0 && !fuel_emergency)
+  if (sim->fuel_emergency_waiting > 0 && !fuel_emergency)
   {
-    return 0;
+    return RUNWAY_BLOCK_PRIORITY;
   }
 
   /* Emergency aircraft have priority over regular (commercial/cargo) */
-  if (ai->aircraft_type != EMERGENCY && waiting_emergency > 0)
+  if (ai->aircraft_type != EMERGENCY && sim->waiting_emergency > 0)
   {
-    return 0;
+    return RUNWAY_BLOCK_PRIORITY;
+  }
+
+  /* A departure that has waited too long goes before regular arrivals */
+  if (ai->aircraft_type != EMERGENCY && !fuel_emergency &&
+      sim->departures_due > 0)
+  {
+    return RUNWAY_BLOCK_PRIORITY;
   }
 
-  /* Fairness: after 4 regular aircraft of same type, prefer other type
-   * if any are waiting.
+  /* Fairness: after fairness_limit regular aircraft of same type, prefer
+   * other type if any are waiting.
    */
   if (ai->aircraft_type == COMMERCIAL || ai->aircraft_type == CARGO)
   {
     other_type_waiting = 0;
     if (ai->aircraft_type == COMMERCIAL)
     {
-      other_type_waiting = waiting_cargo;
+      other_type_waiting = sim->waiting_cargo;
     }
     else
     {
-      other_type_waiting = waiting_commercial;
+      other_type_waiting = sim->waiting_commercial;
     }
 
-    if (regular_type_count >= 4 &&
-        last_regular_type == ai->aircraft_type &&
+    if (sim->regular_type_count >= sim->config.fairness_limit &&
+        sim->last_regular_type == ai->aircraft_type &&
         other_type_waiting > 0)
     {
-      return 0;
+      return RUNWAY_BLOCK_FAIRNESS;
     }
   }
 
@@ -190,746 +781,3983 @@ can_enter_common(aircraft_info *ai, int desired_direction, int fuel_emergency)
    * empty.
    */
   opposite_waiting = 0;
-  if (current_direction == NORTH)
+  if (sim->current_direction == NORTH)
   {
-    opposite_waiting = waiting_south;
+    opposite_waiting = sim->waiting_south;
   }
-  else if (current_direction == SOUTH)
+  else if (sim->current_direction == SOUTH)
   {
-    opposite_waiting = waiting_north;
+    opposite_waiting = sim->waiting_north;
   }
 
-  if (desired_direction == current_direction &&
-      consecutive_direction >= DIRECTION_LIMIT &&
-      opposite_waiting > 0)
+  if (desired_direction == sim->current_direction &&
+      sim->consecutive_direction >= sim->config.direction_limit &&
+      opposite_waiting >= sim->config.switch_threshold)
   {
-    return 0;
+    return RUNWAY_BLOCK_DIRECTION;
   }
 
-  return 1;
+  /* Several runways: some end of the current flow must be free and not
+   * excluded by a runway in use.
+   */
+  if (sim->use_layout &&
+      airport_pick(&sim->layout, sim->current_direction,
+                   sim->runway_capacity) < 0)
+  {
+    return RUNWAY_BLOCK_RUNWAY;
+  }
+
+  return BLOCK_NONE;
 }
 
-/* Called at beginning of simulation.
- * TODO: Create/initialize all synchronization
- * variables and other global variables that you add.
+/* Returns 1 if the aircraft is allowed to enter the runway now, 0
+ * otherwise.  Must be called with runway_mutex locked.
  */
-static int initialize(aircraft_info *ai, char *filename)
-{
-  aircraft_on_runway    = 0;
-  commercial_on_runway  = 0;
-  cargo_on_runway       = 0;
-  emergency_on_runway   = 0;
-  aircraft_since_break  = 0;
-  current_direction     = NORTH;
-  consecutive_direction = 0;
-
-  waiting_commercial    = 0;
-  waiting_cargo         = 0;
-  waiting_emergency     = 0;
-  waiting_north         = 0;
-  waiting_south         = 0;
-  fuel_emergency_waiting = 0;
-  last_regular_type     = -1;
-  regular_type_count    = 0;
+static int
+can_enter_common(aircraft_info *ai, int desired_direction, int fuel_emergency)
+{
+  return entry_block(ai, desired_direction, fuel_emergency) == BLOCK_NONE;
+}
 
-  /* Initialize synchronization variables */
-  pthread_mutex_init(&runway_mutex, NULL);
-  pthread_cond_init(&cond_aircraft, NULL);
+/* Ends the reopening ramp, if one is under way, and counts it if it
+ * admitted anyone.  Must be called with runway_mutex locked.
+ */
+static void end_ramp(runway_sim *sim)
+{
+  if (sim->ramping && sim->ramp >= 0)
+  {
+    sim->ramps++;
+    sim->ramp_total += sim->ramp;
+    if (sim->ramp > sim->ramp_max)
+    {
+      sim->ramp_max = sim->ramp;
+    }
+  }
+  sim->ramping = 0;
+}
 
-  /* seed random number generator for fuel reserves */
-  srand(time(NULL));
+/* Charges the time since the aircraft's last check to the reason it was
+ * blocked then, and starts timing the new reason.  A separation hold ends
+ * the reopening ramp.  Must be called with runway_mutex locked.
+ */
+static void note_block(aircraft_info *ai, double now, int block)
+{
+  if (ai->block_reason != BLOCK_NONE)
+  {
+    ai->blocked[ai->block_reason] += now - ai->block_since;
+  }
+  if (block == RUNWAY_BLOCK_SEPARATION)
+  {
+    end_ramp(ai->sim);
+  }
+  ai->block_reason = block;
+  ai->block_since = now;
+}
 
-  /* Read in the data file and initialize the aircraft array */
-  FILE *fp;
+/* Fills in an aircraft record from its scenario entry. */
+static void setup_aircraft(runway_sim *sim, aircraft_info *ai,
+                           const scenario_aircraft *sa, int arrival_time)
+{
+  ai->sim = sim;
+  ai->aircraft_type = sa->aircraft_type;
+  ai->arrival_time = arrival_time;
+  ai->runway_time = sa->runway_time;
+  ai->fuel_reserve = sa->fuel_reserve;
+  ai->holding_level = HOLDING_NONE;
+  ai->fuel_burned = 0;
+  ai->diverted = 0;
+  ai->departure = sa->departure;
+  ai->wake = sa->wake;
+  ai->wake_deferred = 0;
+  ai->runway_end = -1;
+  ai->exit_blocked = 0;
+  ai->parked_at = -1;
+  ai->block_reason = BLOCK_NONE;
+  memset(ai->blocked, 0, sizeof(ai->blocked));
+  ai->ticket = 0;
+  ai->admission = -1;
+  ai->fuel_declared = 0;
+  ai->granted = 0;
+}
+
+/* Puts the runway in its starting state.
+ * TODO: Create/initialize all synchronization
+ * variables and other global variables that you add.
+ */
+static void reset_runway(runway_sim *sim)
+{
+  int i;
 
-  if ((fp = fopen(filename, "r")) == NULL)
+  sim->aircraft_on_runway    = 0;
+  sim->commercial_on_runway  = 0;
+  sim->cargo_on_runway       = 0;
+  sim->emergency_on_runway   = 0;
+  sim->aircraft_since_break  = 0;
+  sim->current_direction     = NORTH;
+  sim->consecutive_direction = 0;
+  sim->runway_capacity       = MAX_RUNWAY_CAPACITY;
+  sim->shift_pending         = 0;
+  sim->shift_handover        = 0;
+  sim->direction_pending     = 0;
+  sim->num_closures          = 0;
+  holding_init(&sim->holding, sim->config.holding_levels);
+
+  sim->waiting_commercial    = 0;
+  sim->waiting_cargo         = 0;
+  sim->waiting_emergency     = 0;
+  sim->waiting_north         = 0;
+  sim->waiting_south         = 0;
+  sim->fuel_emergency_waiting = 0;
+  sim->waiting_departures    = 0;
+  sim->departures_due        = 0;
+  sim->departures_on_runway  = 0;
+  sim->arrival_cleared_at    = 0;
+  sim->leader_wake           = WAKE_LIGHT;
+  sim->leader_admitted_at    = 0;
+  sim->wake_time             = 0;
+  sim->wake_deferrals        = 0;
+  sim->wake_deferring        = 0;
+  memset(sim->waiting_wake, 0, sizeof(sim->waiting_wake));
+  for (i = 0; i < 3; i++)
   {
-    printf("Cannot open input file %s for reading.\n", filename);
-    exit(1);
+    sim->queues[i].next      = 0;
+    sim->queues[i].head      = 0;
+    sim->queues[i].block     = RUNWAY_BLOCK_RUNWAY;
+    sim->queues[i].yield     = WAKE_LIGHT;
   }
+  sim->admissions            = 0;
+  sim->ramping               = 0;
+  sim->reopenings            = 0;
+  sim->ramps                 = 0;
+  sim->ramp_total            = 0;
+  sim->ramp_max              = 0;
+  sim->busy_time             = 0;
+  sim->last_regular_type     = -1;
+  sim->regular_type_count    = 0;
+  sim->direction_switches    = 0;
+  sim->controller_breaks     = 0;
+  sim->controller_shifts     = 0;
+  sim->fuel_emergencies      = 0;
+}
 
-  int i = 0;
-  char line[256];
-  while (fgets(line, sizeof(line), fp) && i < MAX_AIRCRAFT)
+/* Called once the scenario is loaded.  Draws the fuel reserves and builds
+ * the aircraft records in the run's arena.  Returns 0 on success or -1.
+ */
+static int initialize(runway_sim *sim)
+{
+  scenario *sc = &sim->sc;
+  unsigned int state = sim->config.seed;
+  int i;
+  int n;
+
+  /* Assign random fuel reserve between FUEL_MIN and FUEL_MAX unless
+   * the scenario sets one.  Departures draw one too, so that leaving them
+   * out does not change the reserves of the arrivals.
+   */
+  for (i = 0; i < sc->num_aircraft; i++)
   {
-    /* Skip comment lines and empty lines */
-    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+    if (sc->aircraft[i].fuel_reserve == FUEL_RANDOM)
     {
-      continue;
+      sc->aircraft[i].fuel_reserve = FUEL_MIN +
+                                     (rand_r(&state) %
+                                      (FUEL_MAX - FUEL_MIN + 1));
     }
+  }
 
-    /* Parse the line */
-    if (sscanf(line, "%d%d%d",
-               &(ai[i].aircraft_type),
-               &(ai[i].arrival_time),
-               &(ai[i].runway_time)) == 3)
+  if (sim->config.arrivals_only)
+  {
+    /* Compiling again rebuilds the events for the remaining aircraft */
+    for (i = 0, n = 0; i < sc->num_aircraft; i++)
     {
-      /* Assign random fuel reserve between FUEL_MIN and FUEL_MAX */
-      ai[i].fuel_reserve = FUEL_MIN +
-                           (rand() % (FUEL_MAX - FUEL_MIN + 1));
-      i = i + 1;
+      if (!sc->aircraft[i].departure)
+      {
+        sc->aircraft[n++] = sc->aircraft[i];
+      }
     }
+    sc->num_aircraft = n;
+    scenario_compile(sc);
   }
 
-  fclose(fp);
-  return i;
+  if (sc->num_aircraft > MAX_AIRCRAFT || sc->num_aircraft <= 0)
+  {
+    say(sim, "Error:  Bad number of aircraft threads. "
+        "Maybe there was a problem with your input file?\n");
+    return -1;
+  }
+
+  sim->num_aircraft = sc->num_aircraft;
+  sim->ai = arena_alloc(&sim->run_cache,
+                        sizeof(aircraft_info) * sim->num_aircraft);
+  sim->aircraft_tid = arena_alloc(&sim->run_cache,
+                                  sizeof(pthread_t) * sim->num_aircraft);
+  if (sim->ai == NULL || sim->aircraft_tid == NULL)
+  {
+    say(sim, "runway: out of memory for %d aircraft\n", sim->num_aircraft);
+    return -1;
+  }
+
+  for (i = 0; i < sim->num_aircraft; i++)
+  {
+    pthread_cond_init(&sim->ai[i].turn, NULL);
+    setup_aircraft(sim, &sim->ai[i], &sc->aircraft[i],
+                   sc->aircraft[i].arrival -
+                   (i > 0 ? sc->aircraft[i - 1].arrival : 0));
+  }
+
+  return 0;
 }
 
 /* Code executed by controller to simulate taking a break
  * You do not need to add anything here.
  */
 __attribute__((unused)) static void
-take_break()
+take_break(runway_sim *sim)
 {
-  printf("The air traffic controller is taking a break now.\n");
-  sleep(5);
-  assert(aircraft_on_runway == 0);
-  aircraft_since_break = 0;
+  say(sim, "The air traffic controller is taking a break now.\n");
+  live_controller(sim, LIVE_BREAK, sim->config.break_time);
+  controller_pause(sim, sim->config.break_time);
+  assert(sim->aircraft_on_runway == 0);
+  sim->aircraft_since_break = 0;
+  sim->controller_breaks++;
+  live_controller(sim, LIVE_WORKING, 0);
 }
 
-/* Code executed to switch runway direction
- * You do not need to add anything here.
+/* Code executed by the controller to hand over to the next shift.
+ * Like a break, the runway must be empty; the incoming controller starts
+ * with a fresh aircraft count.
  */
-__attribute__((unused)) static void
-switch_direction()
+static void
+change_shift(runway_sim *sim)
 {
-  printf("Switching runway direction from %s to %s\n",
-         current_direction == NORTH ? "NORTH" : "SOUTH",
-         current_direction == NORTH ? "SOUTH" : "NORTH");
-
-  assert(aircraft_on_runway == 0);  /* Runway must be empty to switch */
-
-  sleep(DIRECTION_SWITCH_TIME);
-
-  current_direction = (current_direction == NORTH) ? SOUTH : NORTH;
-  consecutive_direction = 0;
+  say(sim, "Controller shift change: a new air traffic controller "
+      "takes over\n");
+  assert(sim->aircraft_on_runway == 0);
+  live_controller(sim, LIVE_SHIFT, sim->shift_handover);
+  controller_pause(sim, sim->shift_handover);
+  sim->aircraft_since_break = 0;
+  sim->shift_pending = 0;
+  sim->controller_shifts++;
+  live_controller(sim, LIVE_WORKING, 0);
+}
 
-  printf("Runway direction switched to %s\n",
-         current_direction == NORTH ? "NORTH" : "SOUTH");
+static int waiting_total(runway_sim *sim)
+{
+  return sim->waiting_commercial + sim->waiting_cargo + sim->waiting_emergency;
 }
 
-/* Code for the air traffic controller thread.
- * Synchronizes controller breaks and direction switches.
+/* Wakes every waiting aircraft, wherever it sleeps.  Called with
+ * runway_mutex locked when the run is abandoned or stopped.
  */
-void * controller_thread(void *arg)
+static void wake_everyone(runway_sim *sim)
 {
-  /* Suppress the warning for now */
-  (void)arg;
-
-  printf("The air traffic controller arrived and is beginning operations\n");
+  ticket_queue *q;
+  unsigned long t;
+  int i;
 
-  /* Loop while waiting for aircraft to arrive. */
-   while (1)
+  pthread_cond_broadcast(&sim->cond_aircraft);
+  for (i = 0; i < 3; i++)
   {
-    pthread_mutex_lock(&runway_mutex);
-
-    if (aircraft_since_break >= CONTROLLER_LIMIT &&
-        aircraft_on_runway == 0)
+    q = &sim->queues[i];
+    for (t = q->head; t != q->next; t++)
     {
-  
-      take_break();
-      pthread_cond_broadcast(&cond_aircraft);
+      if (!q->gone[t % TICKET_RING])
+      {
+        pthread_cond_signal(&sim->ticket_holders[i][t % TICKET_RING]->turn);
+      }
     }
-
-    else if (aircraft_on_runway == 0)
-    {
-      int opposite_waiting = 0;
-      int same_waiting = 0;
-
-      if (current_direction == NORTH)
-      {
-        opposite_waiting = waiting_south;   // planes wanting SOUTH
-        same_waiting = waiting_north;       // planes wanting NORTH
-      }
-      else if (current_direction == SOUTH)
-      {
-        opposite_waiting = waiting_north;   // planes wanting NORTH
-        same_waiting = waiting_south;       // planes wanting SOUTH
-      }
-
-    
-      if (opposite_waiting > 0 &&
-         (consecutive_direction >= DIRECTION_LIMIT ||
-          same_waiting == 0))
-      {
-        switch_direction();
-        pthread_cond_broadcast(&cond_aircraft);
-      }
-    }
-
-    pthread_mutex_unlock(&runway_mutex);
-
-    pthread_testcancel();
-    usleep(100000); // 100ms sleep
   }
-  pthread_exit(NULL);
 }
 
-/* Code executed by a commercial aircraft to enter the runway.
- * Implements all synchronization rules for commercial flights.
+/* Gives an arriving aircraft the next ticket of its class.  Called with
+ * runway_mutex locked.
  */
-void commercial_enter(aircraft_info *arg)
+static void take_ticket(aircraft_info *ai)
 {
-  int desired_direction = NORTH;
-  int fuel_emergency = 0;
-  time_t now;
-  int waited;
-  struct timespec ts;
+  ticket_queue *q = &ai->sim->queues[ai->aircraft_type];
 
-  pthread_mutex_lock(&runway_mutex);
+  assert(q->next - q->head < TICKET_RING);
+  ai->ticket = q->next++;
+  q->gone[ai->ticket % TICKET_RING] = 0;
+  ai->sim->ticket_holders[ai->aircraft_type][ai->ticket % TICKET_RING] = ai;
+}
 
-  waiting_commercial++;
-  waiting_north++;
+/* Called with runway_mutex locked when an aircraft lands or diverts.  If
+ * it was at the front, the next aircraft still waiting moves up and is
+ * woken to look at the rules.
+ */
+static void return_ticket(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
+  ticket_queue *q = &sim->queues[ai->aircraft_type];
+  unsigned long head = q->head;
 
-  while (1)
+  q->gone[ai->ticket % TICKET_RING] = 1;
+  while (q->head != q->next && q->gone[q->head % TICKET_RING])
   {
-    now = time(NULL);
-    waited = (int)(now - arg->arrival_timestamp);
-
-    /* Check for fuel emergency escalation */
-    if (!fuel_emergency && waited >= arg->fuel_reserve)
-    {
-      fuel_emergency = 1;
-      fuel_emergency_waiting++;
-      printf("Commercial aircraft %d has declared a FUEL EMERGENCY\n",
-             arg->aircraft_id);
-    }
-
-    /* Emergency aircraft must be admitted within EMERGENCY_TIMEOUT
-     * seconds, but they are handled separately in emergency_enter().
-     * Here we only respect priority over commercial/cargo.
-     */
-
-    if (can_enter_common(arg, desired_direction, fuel_emergency))
+    q->head++;
+  }
+  if (q->head != head)
+  {
+    q->block = RUNWAY_BLOCK_RUNWAY;
+    q->yield = WAKE_LIGHT;
+    if (q->head != q->next)
     {
-      /* Aircraft can enter runway now */
-      waiting_commercial--;
-      waiting_north--;
-
-      if (fuel_emergency)
-      {
-        fuel_emergency_waiting--;
-      }
-
-      aircraft_on_runway++;
-      commercial_on_runway++;
-      aircraft_since_break++;
-      consecutive_direction++;
-
-      /* Track fairness for commercial/cargo */
-      if (last_regular_type == COMMERCIAL)
-      {
-        regular_type_count++;
-      }
-      else
-      {
-        last_regular_type = COMMERCIAL;
-        regular_type_count = 1;
-      }
-
-      pthread_mutex_unlock(&runway_mutex);
-      return;
+      pthread_cond_signal(
+        &sim->ticket_holders[ai->aircraft_type][q->head % TICKET_RING]->turn);
     }
-
-    /* Wait with timeout to re-check fuel and priorities regularly */
-    clock_gettime(CLOCK_REALTIME, &ts);
-    ts.tv_sec += 1;
-    ts.tv_nsec = 0;
-    pthread_cond_timedwait(&cond_aircraft, &runway_mutex, &ts);
   }
 }
 
-/* Code executed by a cargo aircraft to enter the runway.
- * Implements all synchronization rules for cargo flights.
+/* Returns non-zero if the aircraft should look at the rules itself: it is
+ * at the front of its class, it has a fuel emergency, the head lets its
+ * wake category go first, or tickets are off (config.fifo_tickets).
  */
-void cargo_enter(aircraft_info *ai)
+static int my_turn(aircraft_info *ai, int fuel_emergency)
 {
-  int desired_direction = SOUTH;
-  int fuel_emergency = 0;
-  time_t now;
-  int waited;
-  struct timespec ts;
+  runway_sim *sim = ai->sim;
+  ticket_queue *q = &sim->queues[ai->aircraft_type];
 
-  pthread_mutex_lock(&runway_mutex);
+  return !sim->config.fifo_tickets || fuel_emergency ||
+         ai->ticket == q->head || ai->wake < q->yield;
+}
 
-  waiting_cargo++;
-  waiting_south++;
+/* Wakes the waiting aircraft of a class whose turn it is to look at the
+ * rules.  Called with runway_mutex locked.
+ */
+static void wake_class(runway_sim *sim, int type)
+{
+  ticket_queue *q = &sim->queues[type];
+  aircraft_info *ai;
+  unsigned long t;
 
-  while (1)
+  for (t = q->head; t != q->next; t++)
   {
-    now = time(NULL);
-    waited = (int)(now - ai->arrival_timestamp);
-
-    /* Check for fuel emergency escalation */
-    if (!fuel_emergency && waited >= ai->fuel_reserve)
-    {
-      fuel_emergency = 1;
-      fuel_emergency_waiting++;
-      printf("Cargo aircraft %d has declared a FUEL EMERGENCY\n",
-             ai->aircraft_id);
-    }
-
-    if (can_enter_common(ai, desired_direction, fuel_emergency))
+    ai = sim->ticket_holders[type][t % TICKET_RING];
+    if (!q->gone[t % TICKET_RING] && my_turn(ai, ai->fuel_declared))
     {
-      waiting_cargo--;
-      waiting_south--;
-
-      if (fuel_emergency)
-      {
-        fuel_emergency_waiting--;
-      }
-
-      aircraft_on_runway++;
-      cargo_on_runway++;
-      aircraft_since_break++;
-      consecutive_direction++;
-
-      /* Track fairness for commercial/cargo */
-      if (last_regular_type == CARGO)
-      {
-        regular_type_count++;
-      }
-      else
-      {
-        last_regular_type = CARGO;
-        regular_type_count = 1;
-      }
-
-      pthread_mutex_unlock(&runway_mutex);
-      return;
+      pthread_cond_signal(&ai->turn);
     }
-
-    clock_gettime(CLOCK_REALTIME, &ts);
-    ts.tv_sec += 1;
-    ts.tv_nsec = 0;
-    pthread_cond_timedwait(&cond_aircraft, &runway_mutex, &ts);
   }
 }
 
-/* Code executed by an emergency aircraft to enter the runway.
- * Emergency aircraft have high priority and flexible direction.
+/* Wakes the waiting departures and the arrivals whose turn it is, to
+ * re-check the rules after the runway has changed.  Called with
+ * runway_mutex locked.
  */
-void emergency_enter(aircraft_info *ai)
+static void wake_turns(runway_sim *sim)
 {
-  int fuel_emergency = 0;
-  time_t now;
-  int waited;
-  struct timespec ts;
-  int desired_direction;
-
-  pthread_mutex_lock(&runway_mutex);
+  pthread_cond_broadcast(&sim->cond_aircraft);
+  wake_class(sim, COMMERCIAL);
+  wake_class(sim, CARGO);
+  wake_class(sim, EMERGENCY);
+}
 
-  waiting_emergency++;
+/* Returns the simulated seconds until a waiting aircraft's fuel reaches
+ * the next line: the fuel emergency, or once it has declared one, the
+ * diversion from the holding stack.  Returns -1 if there is none left.
+ * Called with runway_mutex locked, with the fuel brought up to date.
+ */
+static double fuel_wait(aircraft_info *ai, double now, int fuel_emergency)
+{
+  runway_sim *sim = ai->sim;
+  double left;
 
-  while (1)
+  if (sim->holding.num_levels == 0 || ai->aircraft_type == EMERGENCY)
   {
-    now = time(NULL);
-    waited = (int)(now - ai->arrival_timestamp);
-
-    /* Fuel emergency escalation (highest priority overall) */
-    if (!fuel_emergency && waited >= ai->fuel_reserve)
-    {
-      fuel_emergency = 1;
-      fuel_emergency_waiting++;
-      printf("EMERGENCY aircraft %d has declared a FUEL EMERGENCY\n",
-             ai->aircraft_id);
-    }
-
-    /* Emergency aircraft must be admitted within EMERGENCY_TIMEOUT
-     * seconds whenever possible. They already have priority over
-     * commercial/cargo in can_enter_common().
-     */
-
-    /* Emergency aircraft can use either direction; always use the
-     * current direction to avoid forcing a direction switch.
-     */
-    desired_direction = current_direction;
-
-    if (can_enter_common(ai, desired_direction, fuel_emergency))
-    {
-      waiting_emergency--;
-
-      if (fuel_emergency)
-      {
-        fuel_emergency_waiting--;
-      }
-
-      aircraft_on_runway++;
-      emergency_on_runway++;
-      aircraft_since_break++;
-      consecutive_direction++;
-
-      /* Emergency does not affect commercial/cargo fairness counters */
-      pthread_mutex_unlock(&runway_mutex);
-      return;
-    }
+    return fuel_emergency ? -1 :
+           ai->arrival_timestamp + ai->fuel_reserve - now;
+  }
 
-    clock_gettime(CLOCK_REALTIME, &ts);
-    ts.tv_sec += 1;
-    ts.tv_nsec = 0;
-    pthread_cond_timedwait(&cond_aircraft, &runway_mutex, &ts);
+  left = ai->fuel_left + (fuel_emergency ? EMERGENCY_FUEL : 0);
+  if (ai->holding_level == HOLDING_NONE)
+  {
+    return left;
   }
+  return left / holding_burn_rate(&sim->holding, ai->holding_level);
 }
 
-/* Code executed by an aircraft to simulate the time spent on the runway
- * You do not need to add anything here.
+/* Sleeps on the aircraft's own condition variable for at most the given
+ * simulated seconds.  Called with runway_mutex locked.
  */
-static void use_runway(int t)
+static void wait_on(aircraft_info *ai, double seconds)
 {
-  sleep(t);
+  runway_sim *sim = ai->sim;
+  struct timespec ts;
+
+  sim_deadline(sim, &ts, seconds);
+  pthread_cond_timedwait(&ai->turn, &sim->runway_mutex, &ts);
 }
 
-/* Code executed by a commercial aircraft when leaving the runway.
- * Updates shared counters and wakes waiting aircraft.
+/* Sleeps behind the head of the class until the aircraft may be at the
+ * front, until it has to declare a fuel emergency, and at most a second.
+ * Called with runway_mutex locked.
  */
-static void commercial_leave()
+static void wait_turn(aircraft_info *ai, double now)
 {
-  pthread_mutex_lock(&runway_mutex);
-
-  aircraft_on_runway--;
-  commercial_on_runway--;
+  double left = fuel_wait(ai, now, 0);
 
-  assert(aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0);
-
-  /* Wake any waiting aircraft to re-check conditions */
-  pthread_cond_broadcast(&cond_aircraft);
-
-  pthread_mutex_unlock(&runway_mutex);
+  wait_on(ai, left > 0 && left < 1 ? left : 1);
 }
 
-/* Code executed by a cargo aircraft when leaving the runway.
- * Updates shared counters and wakes waiting aircraft.
+/* Returns non-zero if no other aircraft fits on the runway as it is.
+ * Called with runway_mutex locked.
  */
-static void cargo_leave()
+static int runway_full(runway_sim *sim)
 {
-  pthread_mutex_lock(&runway_mutex);
-
-  aircraft_on_runway--;
-  cargo_on_runway--;
-
-  assert(aircraft_on_runway >= 0);
-  assert(cargo_on_runway >= 0);
-
-  pthread_cond_broadcast(&cond_aircraft);
+  if (sim->departures_on_runway > 0)
+  {
+    return 1;
+  }
+  if (sim->use_layout)
+  {
+    return airport_pick(&sim->layout, sim->current_direction,
+                        sim->runway_capacity) < 0;
+  }
+  return sim->aircraft_on_runway >= sim->runway_capacity;
+}
 
-  pthread_mutex_unlock(&runway_mutex);
+/* Returns the number of arrivals that have joined the waiting aircraft. */
+static unsigned long tickets_taken(runway_sim *sim)
+{
+  return sim->queues[COMMERCIAL].next + sim->queues[CARGO].next +
+         sim->queues[EMERGENCY].next;
 }
 
-/* Code executed by an emergency aircraft when leaving the runway.
- * Updates shared counters and wakes waiting aircraft.
+/* Called with runway_mutex locked when a switch, break or handover is over
+ * and the runway takes aircraft again.
  */
-static void emergency_leave()
+static void note_reopen(runway_sim *sim)
 {
-  pthread_mutex_lock(&runway_mutex);
+  end_ramp(sim);
+  sim->ramping = waiting_total(sim) > 0;
+  if (sim->ramping)
+  {
+    sim->reopenings++;
+    sim->ramp = -1;
+    sim->ramp_tickets = tickets_taken(sim);
+    sim->ramp_declarations = sim->fuel_emergencies;
+    clock_gettime(CLOCK_MONOTONIC, &sim->reopened_at);
+  }
+}
 
-  aircraft_on_runway--;
-  emergency_on_runway--;
+/* Called with runway_mutex locked after every admission to track runway
+ * occupancy, the reopening ramp and how the runway recovers from the most
+ * recent closure.
+ */
+static void note_admission(runway_sim *sim, double now)
+{
+  closure_record *c;
 
-  assert(aircraft_on_runway >= 0);
-  assert(emergency_on_runway >= 0);
+  sim->progress_at = now;
+  if (sim->aircraft_on_runway == 1)
+  {
+    sim->busy_since = now;
+  }
 
-  pthread_cond_broadcast(&cond_aircraft);
+  if (sim->ramping && (tickets_taken(sim) != sim->ramp_tickets ||
+                       sim->fuel_emergencies != sim->ramp_declarations))
+  {
+    end_ramp(sim);
+  }
+  else if (sim->ramping)
+  {
+    sim->ramp = wall_since(&sim->reopened_at);
+    if (runway_full(sim) || waiting_total(sim) == 0)
+    {
+      end_ramp(sim);
+    }
+  }
 
-  pthread_mutex_unlock(&runway_mutex);
+  if (sim->num_closures == 0)
+  {
+    return;
+  }
+  c = &sim->closures[sim->num_closures - 1];
+  if (c->reopened_at < 0)
+  {
+    return;
+  }
+  if (c->recovered_at < 0)
+  {
+    c->recovered_at = now;
+  }
+  if (c->cleared_at < 0 && waiting_total(sim) <= c->backlog_before)
+  {
+    c->cleared_at = now;
+  }
 }
 
-/* Main code for commercial aircraft threads.
- * You do not need to change anything here, but you can add
- * debug statements to help you during development/debugging.
+/* Called with runway_mutex locked on admission to give the aircraft a
+ * runway end when there is an airport layout.
  */
-void * commercial_aircraft(void *ai_ptr)
+static void take_end(aircraft_info *ai)
 {
-  aircraft_info *ai = (aircraft_info *)ai_ptr;
-
-  /* Record arrival time for fuel tracking */
-  ai->arrival_timestamp = time(NULL);
-
-  /* Request runway access */
-  commercial_enter(ai);
-
-  printf("Commercial aircraft %d (fuel: %ds) is now on the runway "
-         "(direction: %s)\n",
-         ai->aircraft_id, ai->fuel_reserve,
-         current_direction == NORTH ? "NORTH" : "SOUTH");
-
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-         aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 &&
-         commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 &&
-         cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 &&
-         emergency_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway == 0); /* Commercial and cargo cannot mix */
+  runway_sim *sim = ai->sim;
 
-  /* Use runway --- do not make changes to the 3 lines below */
-  printf("Commercial aircraft %d begins runway operations for %d seconds\n",
-         ai->aircraft_id, ai->runway_time);
-  use_runway(ai->runway_time);
-  printf("Commercial aircraft %d completes runway operations and "
-         "prepares to depart\n",
-         ai->aircraft_id);
+  if (!sim->use_layout)
+  {
+    return;
+  }
 
-  /* Leave runway */
-  commercial_leave();
+  ai->runway_end = airport_pick(&sim->layout, sim->current_direction,
+                                sim->runway_capacity);
+  assert(ai->runway_end >= 0);
+  airport_take(&sim->layout, ai->runway_end);
+  say(sim, "Aircraft %d is assigned runway %s\n", ai->aircraft_id,
+      sim->layout.names[ai->runway_end]);
+}
 
-  printf("Commercial aircraft %d has cleared the runway\n",
-         ai->aircraft_id);
+/* Called with runway_mutex locked when the aircraft clears its end. */
+static void release_end(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
 
-  if (!(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-        aircraft_on_runway >= 0))
+  if (ai->runway_end >= 0)
   {
-    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n",
-           aircraft_on_runway, MAX_RUNWAY_CAPACITY);
-    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, "
-           "direction=%s\n",
-           commercial_on_runway, cargo_on_runway, emergency_on_runway,
-           current_direction == NORTH ? "NORTH" : "SOUTH");
+    airport_release(&sim->layout, ai->runway_end);
   }
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-         aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 &&
-         commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 &&
-         cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 &&
-         emergency_on_runway <= MAX_RUNWAY_CAPACITY);
+}
 
-  pthread_exit(NULL);
+/* Called with runway_mutex locked after every clearance. */
+static void note_clearance(runway_sim *sim, double now)
+{
+  end_ramp(sim);
+  if (sim->aircraft_on_runway == 0)
+  {
+    sim->busy_time += now - sim->busy_since;
+  }
+  live_publish(sim, RUNWAY_EVENT_CLEARED, NULL);
 }
 
-/* Main code for cargo aircraft threads.
- * You do not need to change anything here, but you can add
- * debug statements to help you during development/debugging.
+/* Runway capacity change from a scenario event.  Aircraft already on the
+ * runway keep going and drain; a lower capacity only stops new admissions,
+ * so waiting aircraft are woken only when the capacity goes up.  Called
+ * with runway_mutex locked.
  */
-void * cargo_aircraft(void *ai_ptr)
+static void
+set_capacity(runway_sim *sim, int capacity)
 {
-  aircraft_info *ai = (aircraft_info *)ai_ptr;
-
-  /* Record arrival time for fuel tracking */
-  ai->arrival_timestamp = time(NULL);
+  double now = sim_now(sim);
+  closure_record *c;
 
-  /* Request runway access */
-  cargo_enter(ai);
-
-  printf("Cargo aircraft %d (fuel: %ds) is now on the runway "
-         "(direction: %s)\n",
-         ai->aircraft_id, ai->fuel_reserve,
-         current_direction == NORTH ? "NORTH" : "SOUTH");
-
-  if (!(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-        aircraft_on_runway >= 0))
-  {
-    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n",
-           aircraft_on_runway, MAX_RUNWAY_CAPACITY);
-    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, "
-           "direction=%s\n",
-           commercial_on_runway, cargo_on_runway, emergency_on_runway,
-           current_direction == NORTH ? "NORTH" : "SOUTH");
-  }
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-         aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 &&
-         commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 &&
-         cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 &&
-         emergency_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(commercial_on_runway == 0);
-
-  printf("Cargo aircraft %d begins runway operations for %d seconds\n",
-         ai->aircraft_id, ai->runway_time);
-  use_runway(ai->runway_time);
-  printf("Cargo aircraft %d completes runway operations and "
-         "prepares to depart\n",
-         ai->aircraft_id);
-
-  /* Leave runway */
-  cargo_leave();
+  if (capacity == 0)
+  {
+    say(sim, "Runway CLOSED\n");
+  }
+  else
+  {
+    say(sim, "Runway capacity set to %d\n", capacity);
+  }
+  if (sim->aircraft_on_runway > capacity)
+  {
+    say(sim, "%d aircraft on the runway will clear before new ones enter\n",
+        sim->aircraft_on_runway);
+  }
 
-  printf("Cargo aircraft %d has cleared the runway\n",
-         ai->aircraft_id);
+  if (capacity == 0 && sim->runway_capacity > 0 &&
+      sim->num_closures < MAX_CLOSURES)
+  {
+    c = &sim->closures[sim->num_closures++];
+    c->closed_at = now;
+    c->reopened_at = -1;
+    c->backlog_before = waiting_total(sim);
+    c->backlog_at_reopen = 0;
+    c->recovered_at = -1;
+    c->cleared_at = -1;
+  }
+  else if (capacity > 0 && sim->runway_capacity == 0 && sim->num_closures > 0 &&
+           sim->closures[sim->num_closures - 1].reopened_at < 0)
+  {
+    c = &sim->closures[sim->num_closures - 1];
+    c->reopened_at = now;
+    c->backlog_at_reopen = waiting_total(sim);
+    if (c->backlog_at_reopen <= c->backlog_before)
+    {
+      c->cleared_at = now;
+    }
+  }
 
-  if (!(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-        aircraft_on_runway >= 0))
+  if (capacity > sim->runway_capacity)
   {
-    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n",
-           aircraft_on_runway, MAX_RUNWAY_CAPACITY);
-    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, "
-           "direction=%s\n",
-           commercial_on_runway, cargo_on_runway, emergency_on_runway,
-           current_direction == NORTH ? "NORTH" : "SOUTH");
+    wake_turns(sim);
   }
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-         aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 &&
-         commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 &&
-         cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 &&
-         emergency_on_runway <= MAX_RUNWAY_CAPACITY);
+  sim->runway_capacity = capacity;
+  live_publish(sim, LIVE_CHANGE, NULL);
+}
 
-  pthread_exit(NULL);
+/* Direction change ordered by a scenario event.  The controller switches
+ * once the aircraft on the runway have cleared.  Called with runway_mutex
+ * locked.
+ */
+static void
+request_direction(runway_sim *sim, int direction)
+{
+  if (direction == sim->current_direction)
+  {
+    sim->direction_pending = 0;
+  }
+  else
+  {
+    say(sim, "Runway direction change to %s ordered\n",
+        direction == NORTH ? "NORTH" : "SOUTH");
+    sim->direction_pending = 1;
+    sim->forced_direction = direction;
+  }
 }
 
-/* Main code for emergency aircraft threads.
- * You do not need to change anything here, but you can add
- * debug statements to help you during development/debugging.
+/* Shift change request from a scenario event.  The controller carries it
+ * out as soon as the runway is empty.  Called with runway_mutex locked.
  */
-void * emergency_aircraft(void *ai_ptr)
+static void
+request_shift(runway_sim *sim, int handover)
 {
-  aircraft_info *ai = (aircraft_info *)ai_ptr;
+  sim->shift_pending = 1;
+  sim->shift_handover = handover;
+}
 
-  /* Record arrival time for fuel and emergency timeout tracking */
-  ai->arrival_timestamp = time(NULL);
+/* Carries out a scenario event other than an arrival.  Called with
+ * runway_mutex locked.
+ */
+static void apply_event(runway_sim *sim, const scenario_event *ev)
+{
+  if (ev->kind == EVENT_CAPACITY)
+  {
+    set_capacity(sim, ev->arg);
+  }
+  else if (ev->kind == EVENT_SHIFT)
+  {
+    request_shift(sim, ev->aux);
+  }
+  else if (ev->kind == EVENT_DIRECTION)
+  {
+    request_direction(sim, ev->arg);
+  }
+}
 
-  /* Request runway access */
-  emergency_enter(ai);
-
-  printf("EMERGENCY aircraft %d (fuel: %ds) is now on the runway "
-         "(direction: %s)\n",
-         ai->aircraft_id, ai->fuel_reserve,
-         current_direction == NORTH ? "NORTH" : "SOUTH");
-
-  if (!(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-        aircraft_on_runway >= 0))
-  {
-    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n",
-           aircraft_on_runway, MAX_RUNWAY_CAPACITY);
-    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, "
-           "direction=%s\n",
-           commercial_on_runway, cargo_on_runway, emergency_on_runway,
-           current_direction == NORTH ? "NORTH" : "SOUTH");
-  }
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-         aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 &&
-         commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 &&
-         cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 &&
-         emergency_on_runway <= MAX_RUNWAY_CAPACITY);
-
-  printf("EMERGENCY aircraft %d begins runway operations for %d seconds\n",
-         ai->aircraft_id, ai->runway_time);
-  use_runway(ai->runway_time);
-  printf("EMERGENCY aircraft %d completes runway operations and "
-         "prepares to depart\n",
-         ai->aircraft_id);
+/* Code executed to switch runway direction
+ * You do not need to add anything here.
+ */
+__attribute__((unused)) static void
+switch_direction(runway_sim *sim)
+{
+  say(sim, "Switching runway direction from %s to %s\n",
+      sim->current_direction == NORTH ? "NORTH" : "SOUTH",
+      sim->current_direction == NORTH ? "SOUTH" : "NORTH");
 
-  /* Leave runway */
-  emergency_leave();
+  assert(sim->aircraft_on_runway == 0);  /* Runway must be empty to switch */
 
-  printf("EMERGENCY aircraft %d has cleared the runway\n",
-         ai->aircraft_id);
+  live_controller(sim, LIVE_SWITCH, sim->config.switch_time);
+  controller_pause(sim, sim->config.switch_time);
 
-  if (!(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-        aircraft_on_runway >= 0))
-  {
-    printf("ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n",
-           aircraft_on_runway, MAX_RUNWAY_CAPACITY);
-    printf("Runway state: commercial=%d, cargo=%d, emergency=%d, "
-           "direction=%s\n",
-           commercial_on_runway, cargo_on_runway, emergency_on_runway,
-           current_direction == NORTH ? "NORTH" : "SOUTH");
-  }
-  assert(aircraft_on_runway <= MAX_RUNWAY_CAPACITY &&
-         aircraft_on_runway >= 0);
-  assert(commercial_on_runway >= 0 &&
-         commercial_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(cargo_on_runway >= 0 &&
-         cargo_on_runway <= MAX_RUNWAY_CAPACITY);
-  assert(emergency_on_runway >= 0 &&
-         emergency_on_runway <= MAX_RUNWAY_CAPACITY);
+  sim->current_direction = (sim->current_direction == NORTH) ? SOUTH : NORTH;
+  sim->consecutive_direction = 0;
+  sim->direction_switches++;
+  live_controller(sim, LIVE_WORKING, 0);
 
-  pthread_exit(NULL);
+  say(sim, "Runway direction switched to %s\n",
+      sim->current_direction == NORTH ? "NORTH" : "SOUTH");
 }
 
-/* Main function sets up simulation and prints report
- * at the end.
- * GUID: 355F4066-DA3E-4F74-9656-EF8097FBC985
+/* Called with runway_mutex locked by the controller.  Abandons the run
+ * once aircraft have waited config.stall_limit seconds at an empty runway
+ * without anyone being admitted, which is how a set of rule parameters
+ * that deadlocks shows up.  The waiting aircraft then give up.
  */
-int main(int nargs, char **args)
+static void check_stall(runway_sim *sim)
 {
-  int i;
-  int result;
-  int num_aircraft;
-  void *status;
-  pthread_t controller_tid;
-  pthread_t aircraft_tid[MAX_AIRCRAFT];
-  aircraft_info ai[MAX_AIRCRAFT];
+  double now = sim_now(sim);
 
-  if (nargs != 2)
+  if (sim->config.stall_limit <= 0 || sim->abandoned)
+  {
+    return;
+  }
+  if ((waiting_total(sim) == 0 && sim->waiting_departures == 0) ||
+      sim->aircraft_on_runway > 0)
+  {
+    sim->progress_at = now;
+    return;
+  }
+  if (now - sim->progress_at >= sim->config.stall_limit)
   {
-    printf("Usage: runway <name of inputfile>\n");
-    return EINVAL;
+    sim->abandoned = 1;
+    say(sim, "runway: no aircraft admitted for %.0f s with %d waiting, "
+        "giving up\n", now - sim->progress_at,
+        waiting_total(sim) + sim->waiting_departures);
+    wake_everyone(sim);
   }
+}
 
-  num_aircraft = initialize(ai, args[1]);
-  if (num_aircraft > MAX_AIRCRAFT || num_aircraft <= 0)
+/* Called by the controller without runway_mutex.  Turns a drain that has
+ * taken longer than config.drain_limit into an abort.
+ */
+static void check_drain(runway_sim *sim)
+{
+  if (sim->config.drain_limit > 0 &&
+      stop_policy(sim) == RUNWAY_STOP_DRAIN &&
+      wall_since(&sim->stop_at) >= sim->config.drain_limit)
   {
-    printf("Error:  Bad number of aircraft threads. "
-           "Maybe there was a problem with your input file?\n");
-    return 1;
+    say(sim, "runway: drain still going after %.1f s, aborting the "
+        "aircraft still waiting\n", sim->config.drain_limit);
+    runway_stop(sim, RUNWAY_STOP_ABORT);
   }
+}
 
-  printf("Starting runway simulation with %d aircraft ...\n",
-         num_aircraft);
+static void reopen(runway_sim *sim);
 
-  result = pthread_create(&controller_tid, NULL,
-                          controller_thread, NULL);
+/* Code for the air traffic controller thread.
+ * Synchronizes controller breaks and direction switches.
+ */
+static void * controller_thread(void *arg)
+{
+  runway_sim *sim = (runway_sim *)arg;
 
-  if (result)
-  {
-    printf("runway:  pthread_create failed for controller: %s\n",
-           strerror(result));
-    exit(1);
-  }
+  say(sim, "The air traffic controller arrived and is beginning operations\n");
 
-  for (i = 0; i < num_aircraft; i++)
+  /* Loop while waiting for aircraft to arrive, until told to exit.  The
+   * exit request is only looked at here, with runway_mutex not held.
+   */
+  while (!__atomic_load_n(&sim->controller_exit, __ATOMIC_ACQUIRE))
   {
-    ai[i].aircraft_id = i;
-    sleep(ai[i].arrival_time);
+    check_drain(sim);
+    pthread_mutex_lock(&sim->runway_mutex);
 
-    if (ai[i].aircraft_type == COMMERCIAL)
+    if (sim->shift_pending && sim->aircraft_on_runway == 0)
     {
-      result = pthread_create(&aircraft_tid[i], NULL,
-                              commercial_aircraft,
-                              (void *)&ai[i]);
+      change_shift(sim);
+      reopen(sim);
     }
-    else if (ai[i].aircraft_type == CARGO)
+
+    else if (sim->direction_pending && sim->aircraft_on_runway == 0)
     {
-      result = pthread_create(&aircraft_tid[i], NULL,
-                              cargo_aircraft,
-                              (void *)&ai[i]);
+      if (sim->forced_direction != sim->current_direction)
+      {
+        switch_direction(sim);
+      }
+      sim->direction_pending = 0;
+      reopen(sim);
     }
-    else
+
+    else if (sim->aircraft_since_break >= sim->config.controller_limit &&
+        sim->aircraft_on_runway == 0)
     {
-      result = pthread_create(&aircraft_tid[i], NULL,
-                              emergency_aircraft,
-                              (void *)&ai[i]);
+  
+      take_break(sim);
+      reopen(sim);
     }
 
-    if (result)
+    else if (sim->aircraft_on_runway == 0)
     {
-      printf("runway: pthread_create failed for aircraft %d: %s\n",
-             i, strerror(result));
-      exit(1);
-    }
+      int opposite_waiting = 0;
+      int same_waiting = 0;
+
+      if (sim->current_direction == NORTH)
+      {
+        opposite_waiting = sim->waiting_south;   // planes wanting SOUTH
+        same_waiting = sim->waiting_north;       // planes wanting NORTH
+      }
+      else if (sim->current_direction == SOUTH)
+      {
+        opposite_waiting = sim->waiting_north;   // planes wanting NORTH
+        same_waiting = sim->waiting_south;       // planes wanting SOUTH
+      }
+
+    
+      if ((opposite_waiting >= sim->config.switch_threshold &&
+           sim->consecutive_direction >= sim->config.direction_limit) ||
+          (opposite_waiting > 0 && same_waiting == 0))
+      {
+        switch_direction(sim);
+        reopen(sim);
+      }
+    }
+
+    check_stall(sim);
+    pthread_mutex_unlock(&sim->runway_mutex);
+
+    pause_for(sim, CONTROLLER_POLL_TIME, PAUSE_ON_EXIT);
+  }
+  return NULL;
+}
+
+/* Tells the controller to exit and waits for it. */
+static void stop_controller(runway_sim *sim, pthread_t tid)
+{
+  pthread_mutex_lock(&sim->stop_mutex);
+  __atomic_store_n(&sim->controller_exit, 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&sim->stop_cond);
+  pthread_mutex_unlock(&sim->stop_mutex);
+  pthread_join(tid, NULL);
+}
+
+/* Brings the fuel of a waiting aircraft up to date and returns how much
+ * holding fuel it has left before it must declare a fuel emergency.  In
+ * the holding stack fuel burns at the rate of the aircraft's level;
+ * without a stack the reserve simply counts down from arrival.
+ */
+static double holding_fuel(aircraft_info *ai, double now)
+{
+  runway_sim *sim = ai->sim;
+  double burned;
+
+  if (sim->holding.num_levels == 0)
+  {
+    return ai->fuel_reserve - (int)(now - ai->arrival_timestamp);
+  }
+
+  if (ai->holding_level == HOLDING_NONE)
+  {
+    burned = now - ai->fuel_checked_at;
+  }
+  else
+  {
+    burned = (now - ai->fuel_checked_at) *
+             holding_burn_rate(&sim->holding, ai->holding_level);
+    ai->fuel_burned += burned;
+    sim->holding.fuel_burned += burned;
+  }
+  ai->fuel_left -= burned;
+  ai->fuel_checked_at = now;
+  return ai->fuel_left;
+}
+
+/* Brings the fuel of a waiting arrival up to date and declares a fuel
+ * emergency once it has run out, whether the aircraft looks itself or
+ * the controller looks for it.  Returns the fuel left as holding_fuel()
+ * does; an emergency aircraft counts its reserve down from arrival.
+ * Called with runway_mutex locked.
+ */
+static double check_fuel(aircraft_info *ai, double now)
+{
+  runway_sim *sim = ai->sim;
+  double fuel;
+
+  if (ai->aircraft_type == EMERGENCY)
+  {
+    fuel = ai->fuel_reserve - (int)(now - ai->arrival_timestamp);
+  }
+  else
+  {
+    fuel = holding_fuel(ai, now);
+  }
+  if (!ai->fuel_declared && fuel <= 0)
+  {
+    ai->fuel_declared = 1;
+    sim->fuel_emergency_waiting++;
+    sim->fuel_emergencies++;
+    say(sim, "%s aircraft %d has declared a FUEL EMERGENCY\n",
+        arrival_names[ai->aircraft_type], ai->aircraft_id);
+  }
+  return fuel;
+}
+
+/* Called with runway_mutex locked when a waiting aircraft cannot land.
+ * Puts it in the holding stack if it is not there yet.  Returns the
+ * DIVERT_* reason if it has to divert instead, otherwise 0.
+ */
+static int hold(aircraft_info *ai, double fuel)
+{
+  runway_sim *sim = ai->sim;
+
+  if (ai->holding_level == HOLDING_NONE)
+  {
+    ai->holding_level = holding_enter(&sim->holding);
+    if (ai->holding_level == HOLDING_NONE)
+    {
+      return DIVERT_FULL;
+    }
+    say(sim, "%s aircraft %d enters the holding stack at level %d\n",
+        type_names[ai->aircraft_type], ai->aircraft_id,
+        ai->holding_level);
+  }
+
+  if (fuel <= -EMERGENCY_FUEL)
+  {
+    return DIVERT_FUEL;
+  }
+  return 0;
+}
+
+/* Called with runway_mutex locked when an aircraft lands or diverts. */
+static void leave_holding(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
+
+  if (ai->holding_level != HOLDING_NONE)
+  {
+    holding_leave(&sim->holding, ai->holding_level);
+    ai->holding_level = HOLDING_NONE;
+  }
+}
+
+/* Called with runway_mutex locked after the aircraft has been taken off
+ * the waiting counters.  Aircraft still waiting may be able to go now.
+ */
+static void divert(aircraft_info *ai, int reason)
+{
+  runway_sim *sim = ai->sim;
+
+  leave_holding(ai);
+  ai->diverted = reason;
+  ai->admitted_at = -1;
+  ai->cleared_at = -1;
+  live_publish(sim, RUNWAY_EVENT_DIVERTED, ai);
+  if (reason == DIVERT_ABANDONED)
+  {
+    sim->gave_up++;
+    wake_turns(sim);
+    return;
+  }
+  if (reason == DIVERT_FULL)
+  {
+    sim->holding.diversions_full++;
+  }
+  else
+  {
+    sim->holding.diversions_fuel++;
+  }
+
+  announce(sim, RUNWAY_EVENT_DIVERTED, ai);
+  say(sim, "%s aircraft %d DIVERTS to its alternate (%s)\n",
+      type_names[ai->aircraft_type], ai->aircraft_id,
+      reason == DIVERT_FULL ? "holding stack full" : "out of fuel");
+  wake_turns(sim);
+}
+
+/* Wake-turbulence check on the admission path; called with runway_mutex
+ * locked.  The aircraft must be far enough behind the last one admitted.
+ * A commercial or cargo aircraft also lets a lighter waiting one of its
+ * own type go first when that one is clear of the leader's wake too,
+ * unless it has a fuel emergency or has already waited WAKE_MAX_DEFER
+ * seconds.
+ */
+static int wake_ready(aircraft_info *ai, double now, int fuel_emergency)
+{
+  runway_sim *sim = ai->sim;
+  ticket_queue *q = &sim->queues[ai->aircraft_type];
+  int category;
+
+  if (now < sim->leader_admitted_at +
+            wake_separation[sim->leader_wake][ai->wake])
+  {
+    return 0;
+  }
+
+  if (ai->ticket == q->head)
+  {
+    q->yield = WAKE_LIGHT;
+  }
+  if (sim->config.wake_reorder && !fuel_emergency &&
+      ai->aircraft_type != EMERGENCY &&
+      now - ai->arrival_timestamp < WAKE_MAX_DEFER)
+  {
+    for (category = 0; category < ai->wake; category++)
+    {
+      if (sim->waiting_wake[ai->aircraft_type][category] > 0 &&
+          now >= sim->leader_admitted_at +
+                 wake_separation[sim->leader_wake][category])
+      {
+        if (!ai->wake_deferred)
+        {
+          ai->wake_deferred = 1;
+          sim->wake_deferrals++;
+        }
+        sim->wake_deferring = 1;
+
+        /* The lighter ones may be behind it in the queue */
+        if (ai->ticket == q->head)
+        {
+          q->yield = ai->wake;
+          wake_class(sim, ai->aircraft_type);
+        }
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/* Called with runway_mutex locked when an arrival is admitted.  Aircraft
+ * that let this one go first may be able to follow it straight away.
+ */
+static void note_wake(aircraft_info *ai, double now)
+{
+  runway_sim *sim = ai->sim;
+
+  sim->wake_time += wake_separation[sim->leader_wake][ai->wake];
+  sim->leader_wake = ai->wake;
+  sim->leader_admitted_at = now;
+  if (sim->wake_deferring)
+  {
+    sim->wake_deferring = 0;
+    wake_turns(sim);
+  }
+}
+
+/* How long a waiting aircraft may sleep before it re-checks: until its
+ * wake separation is over, and at most a second.
+ */
+static double wake_wait(aircraft_info *ai, double now)
+{
+  runway_sim *sim = ai->sim;
+  double left = sim->leader_admitted_at +
+                wake_separation[sim->leader_wake][ai->wake] - now;
+
+  return left > 0 && left < 1 ? left : 1;
+}
+
+/* Returns the RUNWAY_BLOCK_* reason that keeps the aircraft waiting, or
+ * BLOCK_NONE if it may take the runway.  Called with runway_mutex locked.
+ * Only an aircraft whose turn it is looks at the rules; the ones behind
+ * the head of their class wait for whatever the head waits for.
+ */
+static int turn_block(aircraft_info *ai, int desired_direction, double now,
+                      int fuel_emergency)
+{
+  ticket_queue *q = &ai->sim->queues[ai->aircraft_type];
+  int block;
+
+  if (!my_turn(ai, fuel_emergency))
+  {
+    return q->block;
+  }
+
+  block = entry_block(ai, desired_direction, fuel_emergency);
+  if (block == BLOCK_NONE && !wake_ready(ai, now, fuel_emergency))
+  {
+    block = RUNWAY_BLOCK_SEPARATION;
+  }
+  if (ai->ticket == q->head)
+  {
+    q->block = block;
+  }
+  return block;
+}
+
+/* Takes a waiting arrival off the waiting counters when it lands or
+ * diverts.  Called with runway_mutex locked.
+ */
+static void leave_waiting(aircraft_info *ai, int fuel_emergency)
+{
+  runway_sim *sim = ai->sim;
+
+  if (ai->aircraft_type == COMMERCIAL)
+  {
+    sim->waiting_commercial--;
+    sim->waiting_north--;
+  }
+  else if (ai->aircraft_type == CARGO)
+  {
+    sim->waiting_cargo--;
+    sim->waiting_south--;
+  }
+  else
+  {
+    sim->waiting_emergency--;
+  }
+  if (ai->aircraft_type != EMERGENCY)
+  {
+    sim->waiting_wake[ai->aircraft_type][ai->wake]--;
+  }
+  if (fuel_emergency)
+  {
+    sim->fuel_emergency_waiting--;
+  }
+}
+
+/* Puts a waiting arrival on the runway: the bookkeeping of an admission,
+ * whether the aircraft admits itself or the controller admits it with a
+ * group.  Called with runway_mutex locked.
+ */
+static void admit_arrival(aircraft_info *ai, double now, int fuel_emergency)
+{
+  runway_sim *sim = ai->sim;
+
+  leave_waiting(ai, fuel_emergency);
+
+  ai->admitted_at = now;
+  ai->admission = sim->admissions++;
+  ai->direction = sim->current_direction;
+  ai->fuel_emergency = fuel_emergency;
+  sim->aircraft_on_runway++;
+  if (ai->aircraft_type == COMMERCIAL)
+  {
+    sim->commercial_on_runway++;
+  }
+  else if (ai->aircraft_type == CARGO)
+  {
+    sim->cargo_on_runway++;
+  }
+  else
+  {
+    sim->emergency_on_runway++;
+  }
+  sim->aircraft_since_break++;
+  sim->consecutive_direction++;
+
+  /* Track fairness for commercial/cargo; emergencies do not count */
+  if (ai->aircraft_type != EMERGENCY)
+  {
+    if (sim->last_regular_type == ai->aircraft_type)
+    {
+      sim->regular_type_count++;
+    }
+    else
+    {
+      sim->last_regular_type = ai->aircraft_type;
+      sim->regular_type_count = 1;
+    }
+  }
+
+  leave_holding(ai);
+  take_end(ai);
+  note_wake(ai, now);
+  return_ticket(ai);
+  note_admission(sim, now);
+  live_publish(sim, RUNWAY_EVENT_ADMITTED, ai);
+}
+
+/* Returns the waiting arrival the controller admits next, or NULL if none
+ * can go.  The candidates are the aircraft that would look at the rules
+ * themselves (my_turn()), after declaring a fuel emergency as they would,
+ * and they are asked in the order the rules favour them anyway:
+ * emergencies, then fuel emergencies, then the rest; within a class in
+ * ticket order.
+ */
+static aircraft_info *next_in_group(runway_sim *sim, double now)
+{
+  static const int order[3][2] = {
+    { EMERGENCY, -1 }, { COMMERCIAL, CARGO }, { COMMERCIAL, CARGO }
+  };
+  ticket_queue *q;
+  aircraft_info *ai;
+  unsigned long t;
+  int desired_direction;
+  int pass;
+  int k;
+
+  for (pass = 0; pass < 3; pass++)
+  {
+    for (k = 0; k < 2 && order[pass][k] >= 0; k++)
+    {
+      q = &sim->queues[order[pass][k]];
+      for (t = q->head; t != q->next; t++)
+      {
+        ai = sim->ticket_holders[order[pass][k]][t % TICKET_RING];
+        if (q->gone[t % TICKET_RING] || ai->granted)
+        {
+          continue;
+        }
+        check_fuel(ai, now);
+        if ((pass == 1 && !ai->fuel_declared) ||
+            !my_turn(ai, ai->fuel_declared))
+        {
+          continue;
+        }
+        desired_direction = ai->aircraft_type == COMMERCIAL ? NORTH :
+                            ai->aircraft_type == CARGO ? SOUTH :
+                            sim->current_direction;
+        if (turn_block(ai, desired_direction, now, ai->fuel_declared) ==
+            BLOCK_NONE)
+        {
+          return ai;
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
+/* Called by the controller with runway_mutex locked once a switch, break
+ * or handover is over.  Rather than wake the waiting aircraft to race for
+ * the mutex and fill the runway one at a time, the controller admits the
+ * next group itself, slot by slot by the same rules, and signals each of
+ * those aircraft on its own condition variable; they find themselves
+ * admitted.  If a slot stays free, the aircraft whose turn it is are
+ * woken as after any other change, as a departure or an aircraft waiting
+ * out wake separation may still take it.
+ */
+static void reopen(runway_sim *sim)
+{
+  double now = sim_now(sim);
+  aircraft_info *ai;
+
+  note_reopen(sim);
+  while (sim->config.group_admission &&
+         (ai = next_in_group(sim, now)) != NULL)
+  {
+    note_block(ai, now, BLOCK_NONE);
+    admit_arrival(ai, now, ai->fuel_declared);
+    ai->granted = 1;
+    pthread_cond_signal(&ai->turn);
+  }
+  if (!sim->config.group_admission || !runway_full(sim))
+  {
+    wake_turns(sim);
+  }
+}
+
+/* Code executed by a commercial aircraft to enter the runway.
+ * Implements all synchronization rules for commercial flights.
+ */
+int commercial_enter(aircraft_info *arg)
+{
+  runway_sim *sim = arg->sim;
+  int desired_direction = NORTH;
+  int fuel_emergency = 0;
+  double now;
+  double fuel;
+  int reason;
+  int block;
+
+  pthread_mutex_lock(&sim->runway_mutex);
+
+  arg->fuel_left = arg->fuel_reserve;
+  arg->fuel_checked_at = arg->arrival_timestamp;
+
+  sim->waiting_commercial++;
+  take_ticket(arg);
+  sim->waiting_wake[arg->aircraft_type][arg->wake]++;
+  sim->waiting_north++;
+  live_publish(sim, LIVE_CHANGE, NULL);
+
+  while (1)
+  {
+    /* The controller admitted it with a group after a pause */
+    if (arg->granted)
+    {
+      arg->granted = 0;
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 1;
+    }
+
+    now = sim_now(sim);
+
+    /* Check for fuel emergency escalation */
+    fuel = check_fuel(arg, now);
+    fuel_emergency = arg->fuel_declared;
+
+    /* Emergency aircraft must be admitted within EMERGENCY_TIMEOUT
+     * seconds, but they are handled separately in emergency_enter().
+     * Here we only respect priority over commercial/cargo.
+     */
+
+    block = turn_block(arg, desired_direction, now, fuel_emergency);
+    note_block(arg, now, block);
+
+    if (block == BLOCK_NONE)
+    {
+      /* Aircraft can enter runway now */
+      admit_arrival(arg, now, fuel_emergency);
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 1;
+    }
+
+    /* Hold, or divert if the stack is full or the fuel has run out; give
+     * up if the run has been abandoned or aborted.
+     */
+    reason = giving_up(sim) ? DIVERT_ABANDONED :
+             sim->holding.num_levels > 0 ? hold(arg, fuel) : 0;
+    if (reason != 0)
+    {
+      leave_waiting(arg, fuel_emergency);
+      return_ticket(arg);
+      divert(arg, reason);
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 0;
+    }
+
+    /* Wait with timeout to re-check fuel and priorities regularly */
+    if (my_turn(arg, fuel_emergency))
+    {
+      wait_on(arg, wake_wait(arg, now));
+    }
+    else
+    {
+      wait_turn(arg, now);
+    }
+  }
+}
+
+/* Code executed by a cargo aircraft to enter the runway.
+ * Implements all synchronization rules for cargo flights.
+ */
+int cargo_enter(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
+  int desired_direction = SOUTH;
+  int fuel_emergency = 0;
+  double now;
+  double fuel;
+  int reason;
+  int block;
+
+  pthread_mutex_lock(&sim->runway_mutex);
+
+  ai->fuel_left = ai->fuel_reserve;
+  ai->fuel_checked_at = ai->arrival_timestamp;
+
+  sim->waiting_cargo++;
+  take_ticket(ai);
+  sim->waiting_wake[ai->aircraft_type][ai->wake]++;
+  sim->waiting_south++;
+  live_publish(sim, LIVE_CHANGE, NULL);
+
+  while (1)
+  {
+    /* The controller admitted it with a group after a pause */
+    if (ai->granted)
+    {
+      ai->granted = 0;
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 1;
+    }
+
+    now = sim_now(sim);
+
+    /* Check for fuel emergency escalation */
+    fuel = check_fuel(ai, now);
+    fuel_emergency = ai->fuel_declared;
+
+    block = turn_block(ai, desired_direction, now, fuel_emergency);
+    note_block(ai, now, block);
+
+    if (block == BLOCK_NONE)
+    {
+      /* Aircraft can enter runway now */
+      admit_arrival(ai, now, fuel_emergency);
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 1;
+    }
+
+    /* Hold, or divert if the stack is full or the fuel has run out; give
+     * up if the run has been abandoned or aborted.
+     */
+    reason = giving_up(sim) ? DIVERT_ABANDONED :
+             sim->holding.num_levels > 0 ? hold(ai, fuel) : 0;
+    if (reason != 0)
+    {
+      leave_waiting(ai, fuel_emergency);
+      return_ticket(ai);
+      divert(ai, reason);
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 0;
+    }
+
+    if (my_turn(ai, fuel_emergency))
+    {
+      wait_on(ai, wake_wait(ai, now));
+    }
+    else
+    {
+      wait_turn(ai, now);
+    }
+  }
+}
+
+/* Code executed by an emergency aircraft to enter the runway.
+ * Emergency aircraft have high priority and flexible direction.
+ */
+int emergency_enter(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
+  int fuel_emergency = 0;
+  double now;
+  int block;
+  int desired_direction;
+
+  pthread_mutex_lock(&sim->runway_mutex);
+
+  sim->waiting_emergency++;
+  take_ticket(ai);
+  live_publish(sim, LIVE_CHANGE, NULL);
+
+  while (1)
+  {
+    /* The controller admitted it with a group after a pause */
+    if (ai->granted)
+    {
+      ai->granted = 0;
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 1;
+    }
+
+    now = sim_now(sim);
+
+    /* Fuel emergency escalation (highest priority overall) */
+    check_fuel(ai, now);
+    fuel_emergency = ai->fuel_declared;
+
+    /* Emergency aircraft must be admitted within EMERGENCY_TIMEOUT
+     * seconds whenever possible. They already have priority over
+     * commercial/cargo in can_enter_common().
+     */
+
+    /* Emergency aircraft can use either direction; always use the
+     * current direction to avoid forcing a direction switch.
+     */
+    desired_direction = sim->current_direction;
+
+    block = turn_block(ai, desired_direction, now, fuel_emergency);
+    note_block(ai, now, block);
+
+    if (block == BLOCK_NONE)
+    {
+      /* Aircraft can enter runway now */
+      admit_arrival(ai, now, fuel_emergency);
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 1;
+    }
+
+    if (giving_up(sim))
+    {
+      leave_waiting(ai, fuel_emergency);
+      return_ticket(ai);
+      divert(ai, DIVERT_ABANDONED);
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 0;
+    }
+
+    if (my_turn(ai, fuel_emergency))
+    {
+      wait_on(ai, wake_wait(ai, now));
+    }
+    else
+    {
+      wait_turn(ai, now);
+    }
+  }
+}
+
+/* Code executed by an aircraft to simulate the time spent on the runway
+ * You do not need to add anything here.
+ */
+static void use_runway(runway_sim *sim, int t)
+{
+  sim_pause(sim, t);
+}
+
+/* Returns non-zero if a waiting arrival could take the runway now.  Called
+ * with runway_mutex locked; departures only use gaps in which it cannot.
+ */
+static int arrival_ready(runway_sim *sim)
+{
+  aircraft_info probe;
+
+  if (sim->waiting_emergency > 0 || sim->fuel_emergency_waiting > 0)
+  {
+    return 1;
+  }
+
+  probe.sim = sim;
+  probe.aircraft_type = COMMERCIAL;
+  if (sim->waiting_commercial > 0 && can_enter_common(&probe, NORTH, 0))
+  {
+    return 1;
+  }
+  probe.aircraft_type = CARGO;
+  if (sim->waiting_cargo > 0 && can_enter_common(&probe, SOUTH, 0))
+  {
+    return 1;
+  }
+  return 0;
+}
+
+/* Separation and priority rules for a departure; called with
+ * runway_mutex locked.  Returns BLOCK_NONE if the departure may roll now,
+ * otherwise the RUNWAY_BLOCK_* reason it has to wait.
+ */
+static int depart_block(runway_sim *sim, double now)
+{
+  /* Departures need the whole runway and a controller on duty */
+  if (sim->aircraft_on_runway > 0 || sim->runway_capacity == 0)
+  {
+    return RUNWAY_BLOCK_RUNWAY;
+  }
+  if (sim->use_layout &&
+      airport_pick(&sim->layout, sim->current_direction,
+                   sim->runway_capacity) < 0)
+  {
+    return RUNWAY_BLOCK_RUNWAY;
+  }
+  if (sim->shift_pending ||
+      sim->aircraft_since_break >= sim->config.controller_limit)
+  {
+    return RUNWAY_BLOCK_CONTROLLER;
+  }
+  if (sim->direction_pending)
+  {
+    return RUNWAY_BLOCK_DIRECTION;
+  }
+
+  /* Separation behind the last arrival */
+  if (now < sim->arrival_cleared_at + DEPARTURE_AFTER_ARRIVAL)
+  {
+    return RUNWAY_BLOCK_SEPARATION;
+  }
+
+  /* Arrivals go first unless a departure has waited too long; emergencies
+   * always go first.
+   */
+  if (sim->waiting_emergency > 0 || sim->fuel_emergency_waiting > 0)
+  {
+    return RUNWAY_BLOCK_PRIORITY;
+  }
+  if (sim->departures_due == 0 && arrival_ready(sim))
+  {
+    return RUNWAY_BLOCK_PRIORITY;
+  }
+
+  return BLOCK_NONE;
+}
+
+/* Code executed by a departure at the runway hold point.  Departures
+ * are fitted into gaps in the arrival flow.
+ */
+int departure_enter(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
+  int due = 0;
+  double now;
+  double gap;
+  int block;
+  struct timespec ts;
+
+  pthread_mutex_lock(&sim->runway_mutex);
+
+  sim->waiting_departures++;
+  live_publish(sim, LIVE_CHANGE, NULL);
+
+  while (1)
+  {
+    now = sim_now(sim);
+
+    if (!due && now - ai->arrival_timestamp >= DEPARTURE_MAX_WAIT)
+    {
+      due = 1;
+      sim->departures_due++;
+      say(sim, "Departure %d has waited %d seconds, holding new arrivals\n",
+          ai->aircraft_id, DEPARTURE_MAX_WAIT);
+    }
+
+    block = depart_block(sim, now);
+    note_block(ai, now, block);
+
+    if (block == BLOCK_NONE)
+    {
+      sim->waiting_departures--;
+      if (due)
+      {
+        sim->departures_due--;
+      }
+
+      ai->admitted_at = now;
+      ai->direction = sim->current_direction;
+      ai->fuel_emergency = 0;
+      sim->aircraft_on_runway++;
+      sim->departures_on_runway++;
+      sim->aircraft_since_break++;
+
+      take_end(ai);
+      note_admission(sim, now);
+      live_publish(sim, RUNWAY_EVENT_ADMITTED, ai);
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 1;
+    }
+
+    if (giving_up(sim))
+    {
+      sim->waiting_departures--;
+      if (due)
+      {
+        sim->departures_due--;
+      }
+      divert(ai, DIVERT_ABANDONED);
+      pthread_mutex_unlock(&sim->runway_mutex);
+      return 0;
+    }
+
+    /* Wake up when the separation behind the last arrival is over */
+    gap = sim->arrival_cleared_at + DEPARTURE_AFTER_ARRIVAL - now;
+    sim_deadline(sim, &ts, gap > 0 && gap < 1 ? gap : 1);
+    pthread_cond_timedwait(&sim->cond_aircraft, &sim->runway_mutex, &ts);
+  }
+}
+
+/* Code executed by a commercial aircraft when leaving the runway.
+ * Updates shared counters and wakes waiting aircraft.
+ */
+static void commercial_leave(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
+
+  pthread_mutex_lock(&sim->runway_mutex);
+
+  ai->cleared_at = sim_now(sim);
+
+  sim->aircraft_on_runway--;
+  sim->commercial_on_runway--;
+
+  assert(sim->aircraft_on_runway >= 0);
+  assert(sim->commercial_on_runway >= 0);
+
+  sim->arrival_cleared_at = ai->cleared_at;
+  release_end(ai);
+  note_clearance(sim, ai->cleared_at);
+
+  /* Wake any waiting aircraft to re-check conditions */
+  wake_turns(sim);
+
+  pthread_mutex_unlock(&sim->runway_mutex);
+}
+
+/* Code executed by a cargo aircraft when leaving the runway.
+ * Updates shared counters and wakes waiting aircraft.
+ */
+static void cargo_leave(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
+
+  pthread_mutex_lock(&sim->runway_mutex);
+
+  ai->cleared_at = sim_now(sim);
+
+  sim->aircraft_on_runway--;
+  sim->cargo_on_runway--;
+
+  assert(sim->aircraft_on_runway >= 0);
+  assert(sim->cargo_on_runway >= 0);
+
+  sim->arrival_cleared_at = ai->cleared_at;
+  release_end(ai);
+  note_clearance(sim, ai->cleared_at);
+
+  wake_turns(sim);
+
+  pthread_mutex_unlock(&sim->runway_mutex);
+}
+
+/* Code executed by an emergency aircraft when leaving the runway.
+ * Updates shared counters and wakes waiting aircraft.
+ */
+static void emergency_leave(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
+
+  pthread_mutex_lock(&sim->runway_mutex);
+
+  ai->cleared_at = sim_now(sim);
+
+  sim->aircraft_on_runway--;
+  sim->emergency_on_runway--;
+
+  assert(sim->aircraft_on_runway >= 0);
+  assert(sim->emergency_on_runway >= 0);
+
+  sim->arrival_cleared_at = ai->cleared_at;
+  release_end(ai);
+  note_clearance(sim, ai->cleared_at);
+
+  wake_turns(sim);
+
+  pthread_mutex_unlock(&sim->runway_mutex);
+}
+
+/* Code executed by a departure once it is airborne.  The runway stays
+ * blocked for ARRIVAL_AFTER_DEPARTURE seconds behind it.
+ */
+static void departure_leave(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
+
+  sim_pause(sim, ARRIVAL_AFTER_DEPARTURE);
+
+  pthread_mutex_lock(&sim->runway_mutex);
+
+  ai->cleared_at = sim_now(sim);
+
+  sim->aircraft_on_runway--;
+  sim->departures_on_runway--;
+
+  assert(sim->aircraft_on_runway >= 0);
+  assert(sim->departures_on_runway >= 0);
+
+  release_end(ai);
+  note_clearance(sim, ai->cleared_at);
+
+  wake_turns(sim);
+
+  pthread_mutex_unlock(&sim->runway_mutex);
+}
+
+/* Queues an aircraft for a stage, waiting while the queue is full.
+ * Returns the time spent waiting.
+ */
+static double stage_push(pipeline_stage *st, aircraft_info *ai)
+{
+  runway_sim *sim = st->sim;
+  double start = 0;
+  double waited = 0;
+  unsigned long length;
+  unsigned long longest;
+
+  if (!bounded_queue_push(&st->input, ai))
+  {
+    start = sim_now(sim);
+    while (!bounded_queue_push(&st->input, ai))
+    {
+      sim_sleep(sim, PIPELINE_POLL_TIME);
+    }
+    waited = sim_now(sim) - start;
+  }
+
+  length = bounded_queue_length(&st->input);
+  longest = __atomic_load_n(&st->longest_queue, __ATOMIC_RELAXED);
+  while (length > longest &&
+         !__atomic_compare_exchange_n(&st->longest_queue, &longest, length,
+                                      1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+  {
+  }
+
+  return waited;
+}
+
+/* Code for one taxiway slot or gate. */
+static void * stage_worker(void *arg)
+{
+  stage_server *server = (stage_server *)arg;
+  pipeline_stage *st = server->stage;
+  runway_sim *sim = st->sim;
+  aircraft_info *ai;
+  void *item;
+
+  while (1)
+  {
+    if (!bounded_queue_pop(&st->input, &item))
+    {
+      if (__atomic_load_n(&st->closing, __ATOMIC_ACQUIRE))
+      {
+        break;
+      }
+      sim_sleep(sim, PIPELINE_POLL_TIME);
+      continue;
+    }
+
+    ai = (aircraft_info *)item;
+    if (st->next == NULL)
+    {
+      ai->parked_at = sim_now(sim);
+    }
+    sim_pause(sim, st->service_time);
+    server->busy += st->service_time;
+
+    if (st->next != NULL)
+    {
+      server->blocked += stage_push(st->next, ai);
+    }
+  }
+
+  return NULL;
+}
+
+/* Lets the stage finish the aircraft it has, waits for its servers and
+ * collects their totals.
+ */
+static void stage_stop(pipeline_stage *st)
+{
+  int i;
+
+  __atomic_store_n(&st->closing, 1, __ATOMIC_RELEASE);
+  for (i = 0; i < st->num_servers; i++)
+  {
+    pthread_join(st->servers[i].tid, NULL);
+    st->busy += st->servers[i].busy;
+    st->blocked += st->servers[i].blocked;
+  }
+}
+
+static int stage_start(pipeline_stage *st)
+{
+  runway_sim *sim = st->sim;
+  int i;
+
+  if (bounded_queue_init(&st->input, PIPELINE_QUEUE_SIZE,
+                         &sim->run_cache) != 0 ||
+      (st->servers = arena_alloc(&sim->run_cache, sizeof(stage_server) *
+                                                  st->num_servers)) == NULL)
+  {
+    say(sim, "runway: cannot set up the %s stage\n", st->name);
+    return -1;
+  }
+  for (i = 0; i < st->num_servers; i++)
+  {
+    st->servers[i].stage = st;
+    if (pthread_create(&st->servers[i].tid, &sim->aircraft_attr,
+                       stage_worker, &st->servers[i]))
+    {
+      say(sim, "runway: pthread_create failed for the %s stage\n", st->name);
+      st->num_servers = i;
+      stage_stop(st);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* Called by an arrival after its runway operations.  It stays on the
+ * runway until the taxiway can take it.
+ */
+static void enter_pipeline(aircraft_info *ai)
+{
+  runway_sim *sim = ai->sim;
+
+  if (sim->taxi_stage.num_servers > 0)
+  {
+    ai->exit_blocked = stage_push(&sim->taxi_stage, ai);
+  }
+}
+
+/* Main code for commercial aircraft threads.
+ * You do not need to change anything here, but you can add
+ * debug statements to help you during development/debugging.
+ */
+void * commercial_aircraft(void *ai_ptr)
+{
+  aircraft_info *ai = (aircraft_info *)ai_ptr;
+  runway_sim *sim = ai->sim;
+
+  /* Record arrival time for fuel tracking */
+  ai->arrival_timestamp = sim_now(sim);
+
+  /* Request runway access; an aircraft that diverts never lands */
+  if (!commercial_enter(ai))
+  {
+    return NULL;
+  }
+
+  announce(sim, RUNWAY_EVENT_ADMITTED, ai);
+  say(sim, "Commercial aircraft %d (fuel: %ds) is now on the runway "
+      "(direction: %s)\n",
+      ai->aircraft_id, ai->fuel_reserve,
+      sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+
+  assert(sim->aircraft_on_runway <= sim->runway_slots &&
+         sim->aircraft_on_runway >= 0);
+  assert(sim->commercial_on_runway >= 0 &&
+         sim->commercial_on_runway <= sim->runway_slots);
+  assert(sim->cargo_on_runway >= 0 &&
+         sim->cargo_on_runway <= sim->runway_slots);
+  assert(sim->emergency_on_runway >= 0 &&
+         sim->emergency_on_runway <= sim->runway_slots);
+  assert(sim->cargo_on_runway == 0); /* Commercial and cargo cannot mix */
+
+  /* Use runway --- do not make changes to the 3 lines below */
+  say(sim, "Commercial aircraft %d begins runway operations for %d seconds\n",
+      ai->aircraft_id, ai->runway_time);
+  use_runway(sim, ai->runway_time);
+  say(sim, "Commercial aircraft %d completes runway operations and "
+      "prepares to depart\n",
+      ai->aircraft_id);
+
+  /* Hand over to the taxiway; waits on the runway while it is full */
+  enter_pipeline(ai);
+
+  /* Leave runway */
+  commercial_leave(ai);
+
+  announce(sim, RUNWAY_EVENT_CLEARED, ai);
+  say(sim, "Commercial aircraft %d has cleared the runway\n",
+      ai->aircraft_id);
+
+  if (!(sim->aircraft_on_runway <= sim->runway_slots &&
+        sim->aircraft_on_runway >= 0))
+  {
+    say(sim, "ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n",
+        sim->aircraft_on_runway, sim->runway_slots);
+    say(sim, "Runway state: commercial=%d, cargo=%d, emergency=%d, "
+        "direction=%s\n",
+        sim->commercial_on_runway, sim->cargo_on_runway,
+        sim->emergency_on_runway,
+        sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+  }
+  assert(sim->aircraft_on_runway <= sim->runway_slots &&
+         sim->aircraft_on_runway >= 0);
+  assert(sim->commercial_on_runway >= 0 &&
+         sim->commercial_on_runway <= sim->runway_slots);
+  assert(sim->cargo_on_runway >= 0 &&
+         sim->cargo_on_runway <= sim->runway_slots);
+  assert(sim->emergency_on_runway >= 0 &&
+         sim->emergency_on_runway <= sim->runway_slots);
+
+  return NULL;
+}
+
+/* Main code for cargo aircraft threads.
+ * You do not need to change anything here, but you can add
+ * debug statements to help you during development/debugging.
+ */
+void * cargo_aircraft(void *ai_ptr)
+{
+  aircraft_info *ai = (aircraft_info *)ai_ptr;
+  runway_sim *sim = ai->sim;
+
+  /* Record arrival time for fuel tracking */
+  ai->arrival_timestamp = sim_now(sim);
+
+  /* Request runway access; an aircraft that diverts never lands */
+  if (!cargo_enter(ai))
+  {
+    return NULL;
+  }
+
+  announce(sim, RUNWAY_EVENT_ADMITTED, ai);
+  say(sim, "Cargo aircraft %d (fuel: %ds) is now on the runway "
+      "(direction: %s)\n",
+      ai->aircraft_id, ai->fuel_reserve,
+      sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+
+  if (!(sim->aircraft_on_runway <= sim->runway_slots &&
+        sim->aircraft_on_runway >= 0))
+  {
+    say(sim, "ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n",
+        sim->aircraft_on_runway, sim->runway_slots);
+    say(sim, "Runway state: commercial=%d, cargo=%d, emergency=%d, "
+        "direction=%s\n",
+        sim->commercial_on_runway, sim->cargo_on_runway,
+        sim->emergency_on_runway,
+        sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+  }
+  assert(sim->aircraft_on_runway <= sim->runway_slots &&
+         sim->aircraft_on_runway >= 0);
+  assert(sim->commercial_on_runway >= 0 &&
+         sim->commercial_on_runway <= sim->runway_slots);
+  assert(sim->cargo_on_runway >= 0 &&
+         sim->cargo_on_runway <= sim->runway_slots);
+  assert(sim->emergency_on_runway >= 0 &&
+         sim->emergency_on_runway <= sim->runway_slots);
+  assert(sim->commercial_on_runway == 0);
+
+  say(sim, "Cargo aircraft %d begins runway operations for %d seconds\n",
+      ai->aircraft_id, ai->runway_time);
+  use_runway(sim, ai->runway_time);
+  say(sim, "Cargo aircraft %d completes runway operations and "
+      "prepares to depart\n",
+      ai->aircraft_id);
+
+  /* Hand over to the taxiway; waits on the runway while it is full */
+  enter_pipeline(ai);
+
+  /* Leave runway */
+  cargo_leave(ai);
+
+  announce(sim, RUNWAY_EVENT_CLEARED, ai);
+  say(sim, "Cargo aircraft %d has cleared the runway\n",
+      ai->aircraft_id);
+
+  if (!(sim->aircraft_on_runway <= sim->runway_slots &&
+        sim->aircraft_on_runway >= 0))
+  {
+    say(sim, "ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n",
+        sim->aircraft_on_runway, sim->runway_slots);
+    say(sim, "Runway state: commercial=%d, cargo=%d, emergency=%d, "
+        "direction=%s\n",
+        sim->commercial_on_runway, sim->cargo_on_runway,
+        sim->emergency_on_runway,
+        sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+  }
+  assert(sim->aircraft_on_runway <= sim->runway_slots &&
+         sim->aircraft_on_runway >= 0);
+  assert(sim->commercial_on_runway >= 0 &&
+         sim->commercial_on_runway <= sim->runway_slots);
+  assert(sim->cargo_on_runway >= 0 &&
+         sim->cargo_on_runway <= sim->runway_slots);
+  assert(sim->emergency_on_runway >= 0 &&
+         sim->emergency_on_runway <= sim->runway_slots);
+
+  return NULL;
+}
+
+/* Main code for emergency aircraft threads.
+ * You do not need to change anything here, but you can add
+ * debug statements to help you during development/debugging.
+ */
+void * emergency_aircraft(void *ai_ptr)
+{
+  aircraft_info *ai = (aircraft_info *)ai_ptr;
+  runway_sim *sim = ai->sim;
+
+  /* Record arrival time for fuel and emergency timeout tracking */
+  ai->arrival_timestamp = sim_now(sim);
+
+  /* Request runway access */
+  if (!emergency_enter(ai))
+  {
+    return NULL;
+  }
+
+  announce(sim, RUNWAY_EVENT_ADMITTED, ai);
+  say(sim, "EMERGENCY aircraft %d (fuel: %ds) is now on the runway "
+      "(direction: %s)\n",
+      ai->aircraft_id, ai->fuel_reserve,
+      sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+
+  if (!(sim->aircraft_on_runway <= sim->runway_slots &&
+        sim->aircraft_on_runway >= 0))
+  {
+    say(sim, "ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n",
+        sim->aircraft_on_runway, sim->runway_slots);
+    say(sim, "Runway state: commercial=%d, cargo=%d, emergency=%d, "
+        "direction=%s\n",
+        sim->commercial_on_runway, sim->cargo_on_runway,
+        sim->emergency_on_runway,
+        sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+  }
+  assert(sim->aircraft_on_runway <= sim->runway_slots &&
+         sim->aircraft_on_runway >= 0);
+  assert(sim->commercial_on_runway >= 0 &&
+         sim->commercial_on_runway <= sim->runway_slots);
+  assert(sim->cargo_on_runway >= 0 &&
+         sim->cargo_on_runway <= sim->runway_slots);
+  assert(sim->emergency_on_runway >= 0 &&
+         sim->emergency_on_runway <= sim->runway_slots);
+
+  say(sim, "EMERGENCY aircraft %d begins runway operations for %d seconds\n",
+      ai->aircraft_id, ai->runway_time);
+  use_runway(sim, ai->runway_time);
+  say(sim, "EMERGENCY aircraft %d completes runway operations and "
+      "prepares to depart\n",
+      ai->aircraft_id);
+
+  /* Hand over to the taxiway; waits on the runway while it is full */
+  enter_pipeline(ai);
+
+  /* Leave runway */
+  emergency_leave(ai);
+
+  announce(sim, RUNWAY_EVENT_CLEARED, ai);
+  say(sim, "EMERGENCY aircraft %d has cleared the runway\n",
+      ai->aircraft_id);
+
+  if (!(sim->aircraft_on_runway <= sim->runway_slots &&
+        sim->aircraft_on_runway >= 0))
+  {
+    say(sim, "ASSERT FAILURE: aircraft_on_runway=%d (should be 0-%d)\n",
+        sim->aircraft_on_runway, sim->runway_slots);
+    say(sim, "Runway state: commercial=%d, cargo=%d, emergency=%d, "
+        "direction=%s\n",
+        sim->commercial_on_runway, sim->cargo_on_runway,
+        sim->emergency_on_runway,
+        sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+  }
+  assert(sim->aircraft_on_runway <= sim->runway_slots &&
+         sim->aircraft_on_runway >= 0);
+  assert(sim->commercial_on_runway >= 0 &&
+         sim->commercial_on_runway <= sim->runway_slots);
+  assert(sim->cargo_on_runway >= 0 &&
+         sim->cargo_on_runway <= sim->runway_slots);
+  assert(sim->emergency_on_runway >= 0 &&
+         sim->emergency_on_runway <= sim->runway_slots);
+
+  return NULL;
+}
+
+/* Main code for departure threads. */
+void * departure_aircraft(void *ai_ptr)
+{
+  aircraft_info *ai = (aircraft_info *)ai_ptr;
+  runway_sim *sim = ai->sim;
+
+  /* Record the time the departure reached the hold point */
+  ai->arrival_timestamp = sim_now(sim);
+
+  if (!departure_enter(ai))
+  {
+    return NULL;
+  }
+
+  assert(sim->aircraft_on_runway == 1 && sim->departures_on_runway == 1);
+
+  announce(sim, RUNWAY_EVENT_ADMITTED, ai);
+  say(sim, "%s departure %d begins its takeoff roll for %d seconds "
+      "(direction: %s)\n",
+      type_names[ai->aircraft_type], ai->aircraft_id, ai->runway_time,
+      sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+  use_runway(sim, ai->runway_time);
+  say(sim, "%s departure %d is airborne\n",
+      type_names[ai->aircraft_type], ai->aircraft_id);
+
+  departure_leave(ai);
+
+  announce(sim, RUNWAY_EVENT_CLEARED, ai);
+  say(sim, "%s departure %d has cleared the runway\n",
+      type_names[ai->aircraft_type], ai->aircraft_id);
+
+  return NULL;
+}
+
+typedef void *(*aircraft_routine)(void *);
+
+/* Returns the thread function that flies the given aircraft. */
+static aircraft_routine routine_for(const aircraft_info *ai)
+{
+  if (ai->departure)
+  {
+    return departure_aircraft;
+  }
+  if (ai->aircraft_type == COMMERCIAL)
+  {
+    return commercial_aircraft;
+  }
+  if (ai->aircraft_type == CARGO)
+  {
+    return cargo_aircraft;
+  }
+  return emergency_aircraft;
+}
+
+/* Thread function for every aircraft.  In a build with COUNT_ALLOCATIONS
+ * it checks that admission, runway use and leaving never touch the heap.
+ */
+static void * fly_aircraft(void *ai_ptr)
+{
+#ifdef COUNT_ALLOCATIONS
+  aircraft_info *ai = (aircraft_info *)ai_ptr;
+  unsigned long before = thread_heap_calls();
+#endif
+
+  routine_for((aircraft_info *)ai_ptr)(ai_ptr);
+
+#ifdef COUNT_ALLOCATIONS
+  if (thread_heap_calls() != before)
+  {
+    say(ai->sim, "ASSERT FAILURE: aircraft %d made %lu heap calls\n",
+        ai->aircraft_id, thread_heap_calls() - before);
+  }
+  assert(thread_heap_calls() == before);
+#endif
+  return NULL;
+}
+
+/* Prints how the runway recovered from each closure: the time from
+ * reopening to the first admission and until the backlog that built up
+ * while it was closed had been worked off.
+ */
+static void print_closures(runway_sim *sim, FILE *fp)
+{
+  closure_record *c;
+  int i;
+
+  if (sim->num_closures == 0)
+  {
+    return;
+  }
+
+  fprintf(fp, "  Runway closures: %d\n", sim->num_closures);
+  for (c = sim->closures, i = 0; i < sim->num_closures; c++, i++)
+  {
+    fprintf(fp, "    closed at %.1f s", c->closed_at);
+    if (c->reopened_at < 0)
+    {
+      fprintf(fp, ", never reopened\n");
+      continue;
+    }
+    fprintf(fp, " for %.1f s, backlog %d -> %d", c->reopened_at - c->closed_at,
+            c->backlog_before, c->backlog_at_reopen);
+    if (c->recovered_at >= 0)
+    {
+      fprintf(fp, ", first admission after %.1f s",
+              c->recovered_at - c->reopened_at);
+    }
+    if (c->cleared_at >= 0)
+    {
+      fprintf(fp, ", backlog cleared after %.1f s\n",
+              c->cleared_at - c->reopened_at);
+    }
+    else
+    {
+      fprintf(fp, ", backlog not cleared\n");
+    }
+  }
+}
+
+/* Prints how aircraft flowed from the runway to the gates and which part
+ * of the chain was busiest.
+ */
+static void print_pipeline(runway_sim *sim, FILE *fp)
+{
+  aircraft_info *ai = sim->ai;
+  pipeline_stage *stages[2] = { &sim->taxi_stage, &sim->gate_stage };
+  pipeline_stage *st;
+  const char *bottleneck = "Runway";
+  double worst;
+  double share;
+  double blocked = 0;
+  double total = 0;
+  double longest = 0;
+  int exits_blocked = 0;
+  int parked = 0;
+  int i;
+
+  if (sim->taxi_stage.num_servers == 0 || sim->pipeline_span <= 0)
+  {
+    return;
+  }
+
+  worst = sim->busy_time / sim->pipeline_span;
+  for (i = 0; i < 2; i++)
+  {
+    st = stages[i];
+    share = st->busy / (st->num_servers * sim->pipeline_span);
+    fprintf(fp, "  %s: %d %s x %.1f s, busy %.0f%%, blocked %.1f s, "
+            "longest queue %lu\n", st->name, st->num_servers, st->unit,
+            st->service_time, 100 * share, st->blocked, st->longest_queue);
+    if (share > worst)
+    {
+      worst = share;
+      bottleneck = st->name;
+    }
+  }
+
+  for (i = 0; i < sim->num_aircraft; i++)
+  {
+    if (ai[i].exit_blocked > 0)
+    {
+      exits_blocked++;
+      blocked += ai[i].exit_blocked;
+    }
+    if (ai[i].parked_at >= 0)
+    {
+      parked++;
+      total += ai[i].parked_at - ai[i].arrival_timestamp;
+      if (ai[i].parked_at - ai[i].arrival_timestamp > longest)
+      {
+        longest = ai[i].parked_at - ai[i].arrival_timestamp;
+      }
+    }
+  }
+
+  fprintf(fp, "  Runway exits blocked: %d aircraft, %.1f s in total\n",
+          exits_blocked, blocked);
+  if (parked > 0)
+  {
+    fprintf(fp, "  Arrival to gate: average %.1f s, max %.1f s, gates done at "
+            "%.1f s\n", total / parked, longest, sim->pipeline_span);
+  }
+  fprintf(fp, "  Bottleneck: %s (%.0f%% busy)\n", bottleneck, 100 * worst);
+}
+
+/* Prints the controller and holding counters of the summary. */
+static void print_counters(runway_sim *sim, FILE *fp)
+{
+  fprintf(fp, "  Fuel emergencies: %d\n", sim->fuel_emergencies);
+  fprintf(fp, "  Direction switches: %d\n", sim->direction_switches);
+  fprintf(fp, "  Controller breaks: %d\n", sim->controller_breaks);
+  fprintf(fp, "  Controller shifts: %d\n", sim->controller_shifts);
+  if (sim->holding.num_levels > 0)
+  {
+    fprintf(fp, "  Holding levels: %d (peak occupancy %d)\n",
+            sim->holding.num_levels,
+            sim->holding.peak_occupancy);
+    fprintf(fp, "  Diversions: %d (stack full %d, out of fuel %d)\n",
+            sim->holding.diversions_full + sim->holding.diversions_fuel,
+            sim->holding.diversions_full, sim->holding.diversions_fuel);
+    fprintf(fp, "  Fuel burned in holding: %.1f s\n", sim->holding.fuel_burned);
+  }
+  if (sim->stopping)
+  {
+    fprintf(fp, "  Stopped early (%s): %d aircraft gave up, shutdown took "
+            "%.3f s\n", stop_policy(sim) == RUNWAY_STOP_DRAIN ? "drain"
+                                                             : "abort",
+            sim->gave_up, sim->shutdown_latency);
+  }
+}
+
+static int by_wait(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Returns the nearest-rank percentile p of n sorted values. */
+static double percentile(const double *sorted, int n, int p)
+{
+  int rank = (p * n + 99) / 100;
+
+  return n > 0 ? sorted[rank > 0 ? rank - 1 : 0] : 0;
+}
+
+/* Finds the arrival that the most later arrivals of its own class landed
+ * ahead of.  Aircraft that diverted are left out, and so are overtakers
+ * with a fuel emergency, which go ahead by rule.
+ */
+static void overtaking(runway_sim *sim, runway_metrics *m)
+{
+  aircraft_info *ai = sim->ai;
+  int overtaken;
+  int i;
+  int j;
+
+  m->max_overtaken_aircraft = -1;
+  for (i = 0; i < sim->num_aircraft; i++)
+  {
+    if (ai[i].departure || ai[i].admission < 0)
+    {
+      continue;
+    }
+    overtaken = 0;
+    for (j = 0; j < sim->num_aircraft; j++)
+    {
+      if (!ai[j].departure && ai[j].admission >= 0 &&
+          !ai[j].fuel_emergency &&
+          ai[j].aircraft_type == ai[i].aircraft_type &&
+          ai[j].ticket > ai[i].ticket && ai[j].admission < ai[i].admission)
+      {
+        overtaken++;
+      }
+    }
+    if (overtaken > m->max_overtaken)
+    {
+      m->max_overtaken = overtaken;
+      m->max_overtaken_aircraft = i;
+    }
+  }
+}
+
+/* Works out the metrics of a run from the aircraft records, or for a
+ * soak run from the totals of the recycled slots.
+ */
+static void compute_metrics(runway_sim *sim, runway_metrics *m)
+{
+  aircraft_info *ai = sim->ai;
+  double *waits;
+  double wait;
+  double total_wait = 0;
+  double total_delay = 0;
+  int i;
+
+  memset(m, 0, sizeof(*m));
+  m->fuel_emergencies = sim->fuel_emergencies;
+  m->direction_switches = sim->direction_switches;
+  m->controller_breaks = sim->controller_breaks;
+  m->controller_shifts = sim->controller_shifts;
+  m->reopenings = sim->reopenings;
+  m->ramps = sim->ramps;
+  m->average_ramp = sim->ramps > 0 ? sim->ramp_total / sim->ramps : 0;
+  m->max_ramp = sim->ramp_max;
+  m->diverted = sim->holding.diversions_full + sim->holding.diversions_fuel;
+  m->gave_up = sim->gave_up;
+  m->stopped = sim->stopping;
+  m->shutdown_latency = sim->shutdown_latency;
+
+  if (sim->config.soak_hours > 0)
+  {
+    m->aircraft = sim->soak.handled;
+    m->landed = sim->soak.landed;
+    m->makespan = sim->soak_span;
+    m->average_wait = m->landed > 0 ? sim->soak.total_wait / m->landed : 0;
+    m->max_wait = sim->soak.max_wait;
+    m->max_wait_aircraft = -1;
+    m->max_overtaken_aircraft = -1;
+    m->runway_occupied = m->makespan > 0 ? sim->busy_time / m->makespan : 0;
+    return;
+  }
+
+  m->aircraft = sim->num_aircraft;
+  waits = malloc(sizeof(double) * (sim->num_aircraft + 1));
+  for (i = 0; i < sim->num_aircraft; i++)
+  {
+    if (ai[i].diverted)
+    {
+      continue;
+    }
+    if (ai[i].cleared_at > m->makespan)
+    {
+      m->makespan = ai[i].cleared_at;
+    }
+
+    wait = ai[i].admitted_at - ai[i].arrival_timestamp;
+    if (ai[i].departure)
+    {
+      m->departed++;
+      total_delay += wait;
+      if (wait > m->max_departure_delay)
+      {
+        m->max_departure_delay = wait;
+      }
+      continue;
+    }
+
+    if (waits != NULL)
+    {
+      waits[m->landed] = wait;
+    }
+    m->landed++;
+    total_wait += wait;
+    if (wait > m->max_wait)
+    {
+      m->max_wait = wait;
+      m->max_wait_aircraft = i;
+    }
+  }
+
+  if (waits != NULL)
+  {
+    qsort(waits, m->landed, sizeof(double), by_wait);
+    m->wait_p50 = percentile(waits, m->landed, 50);
+    m->wait_p90 = percentile(waits, m->landed, 90);
+    m->wait_p99 = percentile(waits, m->landed, 99);
+    free(waits);
+  }
+
+  overtaking(sim, m);
+  m->average_wait = m->landed > 0 ? total_wait / m->landed : 0;
+  m->average_departure_delay = m->departed > 0 ?
+                               total_delay / m->departed : 0;
+  m->runway_occupied = m->makespan > 0 ? sim->busy_time / m->makespan : 0;
+}
+
+/* Prints the run statistics collected during the simulation.  The
+ * "Max wait" line is parsed by tools such as runway-reduce, so keep its
+ * format stable.
+ */
+static void print_summary(runway_sim *sim, FILE *fp)
+{
+  runway_metrics m;
+  int i;
+
+  compute_metrics(sim, &m);
+  fprintf(fp, "Simulation summary:\n");
+  if (m.aircraft < sim->scheduled)
+  {
+    fprintf(fp, "  Aircraft handled: %ld of %d\n", m.aircraft,
+            sim->scheduled);
+  }
+  else
+  {
+    fprintf(fp, "  Aircraft handled: %ld\n", m.aircraft);
+  }
+  fprintf(fp, "  Makespan: %.1f s\n", m.makespan);
+  fprintf(fp, "  Average wait: %.1f s\n", m.average_wait);
+  fprintf(fp, "  Max wait: %.1f s (aircraft %d)\n", m.max_wait,
+          m.max_wait_aircraft);
+  if (m.max_overtaken > 0)
+  {
+    fprintf(fp, "  Most overtaken within its class: %d aircraft "
+            "(aircraft %d)\n", m.max_overtaken, m.max_overtaken_aircraft);
+  }
+  print_counters(sim, fp);
+  if (m.ramps > 0)
+  {
+    fprintf(fp, "  Reopening ramp: %.1f us average, %.1f us max (%d of %d "
+            "reopenings)\n", m.average_ramp * 1e6, m.max_ramp * 1e6,
+            m.ramps, m.reopenings);
+  }
+  if (m.departed > 0)
+  {
+    fprintf(fp, "  Departures: %ld (average delay %.1f s, max %.1f s)\n",
+            m.departed, m.average_departure_delay, m.max_departure_delay);
+  }
+  if (m.makespan > 0)
+  {
+    fprintf(fp, "  Throughput: %.1f arrivals/h, %.1f departures/h "
+            "(runway occupied %.0f%%)\n",
+            m.landed * 3600 / m.makespan, m.departed * 3600 / m.makespan,
+            100 * m.runway_occupied);
+  }
+  if (sim->wake_time > 0)
+  {
+    fprintf(fp, "  Wake separation: %.1f s in total, %d aircraft let others "
+            "go first\n", sim->wake_time, sim->wake_deferrals);
+  }
+  if (sim->use_layout)
+  {
+    for (i = 0; i < sim->layout.num_ends; i++)
+    {
+      fprintf(fp, "  Runway %s (%s): %d aircraft\n", sim->layout.names[i],
+              sim->layout.direction[i] == NORTH ? "north" : "south",
+              sim->layout.uses[i]);
+    }
+  }
+  print_pipeline(sim, fp);
+  print_closures(sim, fp);
+}
+
+/* Prints one line per aircraft with its admission and clearance times.
+ * The layout is parsed by runway-difftest, so keep it stable.
+ */
+static void print_results(runway_sim *sim, FILE *fp)
+{
+  aircraft_info *ai = sim->ai;
+  int i;
+
+  fprintf(fp, "Aircraft results:\n");
+  fprintf(fp, "# id type arrival fuel admitted cleared direction "
+          "fuel_emergency\n");
+  for (i = 0; i < sim->num_aircraft; i++)
+  {
+    fprintf(fp, "%d %d %.3f %d %.3f %.3f %d %d\n",
+            ai[i].aircraft_id, ai[i].aircraft_type, ai[i].arrival_timestamp,
+            ai[i].fuel_reserve, ai[i].admitted_at, ai[i].cleared_at,
+            ai[i].direction, ai[i].fuel_emergency);
+  }
+}
+
+/* Soak mode (-S hours).  Arrivals are generated for as long as the run
+ * lasts instead of being read from a trace, and each one is flown by a
+ * slot from a fixed pool: an aircraft record plus a thread that waits for
+ * its next aircraft and returns the slot to the pool once the aircraft has
+ * cleared or diverted.  Statistics are folded in as slots are recycled, so
+ * memory use does not grow with the length of the run.
+ */
+/* Returns the resident set size in kB, or -1 if it cannot be read. */
+static long resident_kb(void)
+{
+  FILE *fp;
+  long pages;
+  long resident;
+
+  if ((fp = fopen("/proc/self/statm", "r")) == NULL)
+  {
+    return -1;
+  }
+  if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+  {
+    resident = -1;
+  }
+  fclose(fp);
+  return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/* Code for one pool slot: flies each aircraft it is given. */
+static void * soak_worker(void *arg)
+{
+  soak_slot *slot = (soak_slot *)arg;
+  aircraft_info *ai = &slot->ai;
+  runway_sim *sim = ai->sim;
+  double wait;
+
+  while (1)
+  {
+    while (sem_wait(&slot->start) == -1 && errno == EINTR)
+    {
+    }
+    if (sim->soak_stopping)
+    {
+      break;
+    }
+
+    fly_aircraft((void *)ai);
+
+    pthread_mutex_lock(&sim->soak_mutex);
+    sim->soak.handled++;
+    if (!ai->diverted && !ai->departure)
+    {
+      wait = ai->admitted_at - ai->arrival_timestamp;
+      sim->soak.landed++;
+      sim->soak.total_wait += wait;
+      if (wait > sim->soak.max_wait)
+      {
+        sim->soak.max_wait = wait;
+      }
+    }
+    slot->next_free = sim->soak_free;
+    sim->soak_free = (int)(slot - sim->soak_pool);
+    sim->soak_in_flight--;
+    pthread_cond_broadcast(&sim->soak_cond);
+    pthread_mutex_unlock(&sim->soak_mutex);
+  }
+
+  return NULL;
+}
+
+/* Takes a free slot, waiting for one if the whole pool is flying. */
+static soak_slot *soak_acquire(runway_sim *sim)
+{
+  soak_slot *slot;
+
+  pthread_mutex_lock(&sim->soak_mutex);
+  if (sim->soak_free < 0)
+  {
+    sim->soak.pool_stalls++;
+  }
+  while (sim->soak_free < 0)
+  {
+    pthread_cond_wait(&sim->soak_cond, &sim->soak_mutex);
+  }
+  slot = &sim->soak_pool[sim->soak_free];
+  sim->soak_free = slot->next_free;
+  sim->soak_in_flight++;
+  if (sim->soak_in_flight > sim->soak.peak_in_flight)
+  {
+    sim->soak.peak_in_flight = sim->soak_in_flight;
+  }
+  pthread_mutex_unlock(&sim->soak_mutex);
+  return slot;
+}
+
+static void soak_report(runway_sim *sim, int hour)
+{
+  long rss = resident_kb();
+
+  pthread_mutex_lock(&sim->soak_mutex);
+  if (hour == 1)
+  {
+    sim->soak.first_rss = rss;
+  }
+  if (rss > sim->soak.peak_rss)
+  {
+    sim->soak.peak_rss = rss;
+  }
+  say(sim, "Soak hour %d: %ld aircraft handled, %d in flight, RSS %ld kB\n",
+      hour, sim->soak.handled, sim->soak_in_flight, rss);
+  pthread_mutex_unlock(&sim->soak_mutex);
+}
+
+/* Lets the pool workers exit and waits for the first num_slots of them. */
+static void soak_stop(runway_sim *sim, int num_slots)
+{
+  int i;
+
+  pthread_mutex_lock(&sim->soak_mutex);
+  sim->soak_stopping = 1;
+  pthread_mutex_unlock(&sim->soak_mutex);
+  for (i = 0; i < num_slots; i++)
+  {
+    sem_post(&sim->soak_pool[i].start);
+    pthread_join(sim->soak_pool[i].tid, NULL);
+    sem_destroy(&sim->soak_pool[i].start);
+    pthread_cond_destroy(&sim->soak_pool[i].ai.turn);
+  }
+}
+
+/* Generates arrivals until the soak run is over, then waits for the
+ * aircraft still in flight and stops the pool.  Returns -1 if the pool
+ * cannot be started.
+ */
+static int soak_run(runway_sim *sim, unsigned int seed)
+{
+  unsigned int state = seed;
+  scenario_aircraft sa;
+  soak_slot *slot;
+  double end = sim->config.soak_hours * 3600;
+  int next = 0;
+  int previous = 0;
+  int hour = 1;
+  int id = 0;
+  int result;
+  int i;
+  int r;
+
+  for (i = 0; i < SOAK_POOL_SIZE; i++)
+  {
+    sim->soak_pool[i].ai.sim = sim;
+    sim->soak_pool[i].next_free = i + 1 < SOAK_POOL_SIZE ? i + 1 : -1;
+    sem_init(&sim->soak_pool[i].start, 0, 0);
+    pthread_cond_init(&sim->soak_pool[i].ai.turn, NULL);
+    result = pthread_create(&sim->soak_pool[i].tid, &sim->aircraft_attr,
+                            soak_worker, &sim->soak_pool[i]);
+    if (result)
+    {
+      say(sim, "runway: pthread_create failed for pool slot %d: %s\n",
+          i, strerror(result));
+      sem_destroy(&sim->soak_pool[i].start);
+      pthread_cond_destroy(&sim->soak_pool[i].ai.turn);
+      soak_stop(sim, i);
+      return -1;
+    }
+  }
+  sim->soak_free = 0;
+
+  sa.wake = WAKE_MEDIUM;
+  sa.departure = 0;
+  while (next < end)
+  {
+    if (wait_for_stop(sim, next))
+    {
+      break;
+    }
+    for (; hour <= sim->config.soak_hours && hour * 3600 <= sim_now(sim);
+         hour++)
+    {
+      soak_report(sim, hour);
+    }
+
+    r = rand_r(&state) % 100;
+    sa.aircraft_type = r < 55 ? COMMERCIAL : r < 95 ? CARGO : EMERGENCY;
+    sa.arrival = next;
+    sa.runway_time = 1 + rand_r(&state) % 8;
+    sa.fuel_reserve = FUEL_MIN + rand_r(&state) % (FUEL_MAX - FUEL_MIN + 1);
+
+    slot = soak_acquire(sim);
+    setup_aircraft(sim, &slot->ai, &sa, next - previous);
+    slot->ai.aircraft_id = id++;
+    sem_post(&slot->start);
+
+    previous = next;
+    next += rand_r(&state) % (2 * SOAK_MEAN_GAP + 1);
+  }
+
+  if (!wait_for_stop(sim, end))
+  {
+    for (; hour <= sim->config.soak_hours; hour++)
+    {
+      soak_report(sim, hour);
+    }
+  }
+  sim->soak_span = sim_now(sim) < end ? sim_now(sim) : end;
+
+  /* Let the aircraft still in flight clear, then stop the pool */
+  pthread_mutex_lock(&sim->soak_mutex);
+  while (sim->soak_in_flight > 0)
+  {
+    pthread_cond_wait(&sim->soak_cond, &sim->soak_mutex);
+  }
+  pthread_mutex_unlock(&sim->soak_mutex);
+  soak_stop(sim, SOAK_POOL_SIZE);
+  return 0;
+}
+
+static void print_soak_summary(runway_sim *sim, FILE *fp)
+{
+  long rss = resident_kb();
+
+  fprintf(fp, "Soak summary:\n");
+  fprintf(fp, "  Simulated hours: %.1f\n", sim->soak_span / 3600);
+  fprintf(fp, "  Aircraft handled: %ld (%.1f/h)\n", sim->soak.handled,
+          sim->soak_span > 0 ? sim->soak.handled * 3600 / sim->soak_span
+                             : 0);
+  fprintf(fp, "  Average wait: %.1f s\n",
+          sim->soak.landed > 0 ?
+          sim->soak.total_wait / sim->soak.landed : 0);
+  fprintf(fp, "  Max wait: %.1f s\n", sim->soak.max_wait);
+  print_counters(sim, fp);
+  fprintf(fp, "  Aircraft pool: %d slots, peak %d in flight, %ld arrivals "
+          "waited for a slot\n", SOAK_POOL_SIZE, sim->soak.peak_in_flight,
+          sim->soak.pool_stalls);
+  if (sim->soak.first_rss > 0)
+  {
+    fprintf(fp, "  RSS: %ld kB after the first hour, %ld kB at the end "
+            "(peak %ld kB)\n", sim->soak.first_rss, rss,
+            rss > sim->soak.peak_rss ? rss : sim->soak.peak_rss);
+  }
+  else
+  {
+    fprintf(fp, "  RSS: %ld kB at the end\n", rss);
+  }
+}
+
+/* Sets up the aircraft pool and the controller for a soak run and flies
+ * generated arrivals until it is over.
+ */
+static int run_soak(runway_sim *sim)
+{
+  pthread_t controller_tid;
+  int result;
+
+  sim->soak_pool = arena_alloc(&sim->run_cache,
+                               sizeof(soak_slot) * SOAK_POOL_SIZE);
+  if (sim->soak_pool == NULL)
+  {
+    say(sim, "runway: out of memory for the aircraft pool\n");
+    return -1;
+  }
+
+  say(sim, "Starting %.1f-hour runway soak with %d pooled aircraft ...\n",
+      sim->config.soak_hours, SOAK_POOL_SIZE);
+
+  clock_gettime(CLOCK_MONOTONIC, &sim->clock_epoch);
+  live_run(sim, 0);
+
+  result = pthread_create(&controller_tid, &sim->controller_attr,
+                          controller_thread, sim);
+  if (result)
+  {
+    say(sim, "runway:  pthread_create failed for controller: %s\n",
+        strerror(result));
+    return -1;
+  }
+
+  result = soak_run(sim, sim->config.seed);
+
+  stop_controller(sim, controller_tid);
+  return result;
+}
+
+/* Walks the compiled scenario, starting a thread for each arriving
+ * aircraft, and waits for all of them and the pipeline stages.
+ */
+static int run_scenario(runway_sim *sim)
+{
+  pthread_t controller_tid;
+  scenario_event *ev;
+  int spawned = 0;
+  int failed = 0;
+  int result;
+  int i;
+
+  say(sim, "Starting runway simulation with %d aircraft ...\n",
+      sim->num_aircraft);
+  sim->scheduled = sim->num_aircraft;
+
+  clock_gettime(CLOCK_MONOTONIC, &sim->clock_epoch);
+  live_run(sim, 0);
+
+  if (sim->taxi_stage.num_servers > 0)
+  {
+    sim->taxi_stage.next = &sim->gate_stage;
+    if (stage_start(&sim->gate_stage) != 0)
+    {
+      return -1;
+    }
+    if (stage_start(&sim->taxi_stage) != 0)
+    {
+      stage_stop(&sim->gate_stage);
+      return -1;
+    }
+  }
+
+  result = pthread_create(&controller_tid, &sim->controller_attr,
+                          controller_thread, sim);
+  if (result)
+  {
+    say(sim, "runway:  pthread_create failed for controller: %s\n",
+        strerror(result));
+    if (sim->taxi_stage.num_servers > 0)
+    {
+      stage_stop(&sim->taxi_stage);
+      stage_stop(&sim->gate_stage);
+    }
+    return -1;
+  }
+
+  /* Walk the compiled scenario: aircraft arrivals and runway events */
+  for (ev = sim->sc.events; ev < sim->sc.events + sim->sc.num_events; ev++)
+  {
+    if (wait_for_stop(sim, ev->time))
+    {
+      break;
+    }
+
+    if (ev->kind != EVENT_ARRIVAL)
+    {
+      pthread_mutex_lock(&sim->runway_mutex);
+      apply_event(sim, ev);
+      pthread_mutex_unlock(&sim->runway_mutex);
+      continue;
+    }
+
+    /* Arrivals come in index order, so the aircraft started so far are
+     * always 0 .. spawned - 1.
+     */
+    i = ev->aux;
+    sim->ai[i].aircraft_id = i;
+
+    result = pthread_create(&sim->aircraft_tid[i], &sim->aircraft_attr,
+                            fly_aircraft, (void *)&sim->ai[i]);
+    if (result)
+    {
+      say(sim, "runway: pthread_create failed for aircraft %d: %s\n",
+          i, strerror(result));
+      failed = 1;
+      break;
+    }
+    spawned++;
+  }
+
+  /* wait for all aircraft threads to finish */
+  for (i = 0; i < spawned; i++)
+  {
+    pthread_join(sim->aircraft_tid[i], NULL);
+  }
+
+  /* tell the controller to finish. */
+  stop_controller(sim, controller_tid);
+
+  /* Let the aircraft still taxiing reach their gates */
+  if (sim->taxi_stage.num_servers > 0)
+  {
+    stage_stop(&sim->taxi_stage);
+    stage_stop(&sim->gate_stage);
+    sim->pipeline_span = sim_now(sim);
+  }
+
+  /* A stopped run covers the aircraft that arrived before the stop */
+  sim->num_aircraft = spawned;
+  return failed ? -1 : 0;
+}
+
+/* Reactor mode (config.reactor).  One thread runs the whole scenario: it
+ * brings in the arrivals, admits and clears the aircraft and does the
+ * controller's work, with the same rule code as the aircraft threads and
+ * controller_thread(), and sleeps in epoll_wait() in between.  The next
+ * thing due (a scenario event, an aircraft leaving the runway, the end of
+ * a break or switch, or a deadline of a waiting aircraft) is armed on a
+ * single timerfd; aircraft on the runway are kept in a small heap by the
+ * time they leave it.  runway_stop() wakes the thread through an eventfd.
+ * No other thread touches the runway, so no lock is taken on the way.
+ */
+#define REACTOR_ROLLING 0        /* Aircraft finishes its runway time */
+#define REACTOR_AIRBORNE 1       /* Departure airborne, runway still blocked */
+
+#define REACTOR_DUE 1            /* Departure holding up new arrivals */
+
+#define REACTOR_NEVER 1e300
+
+typedef struct
+{
+  double time;
+  int kind;                      /* REACTOR_ROLLING or _AIRBORNE */
+  int aircraft;
+} reactor_timer;
+
+typedef struct
+{
+  runway_sim *sim;
+  int epoll_fd;
+  int timer_fd;
+  int wake_fd;
+  reactor_timer *timers;         /* heap of aircraft on the runway */
+  int num_timers;
+  int *waiting;                  /* waiting aircraft in arrival order */
+  int num_waiting;
+  unsigned char *flags;          /* REACTOR_DUE by aircraft */
+  int busy;                      /* LIVE_* the controller is busy with */
+  double busy_until;
+} reactor;
+
+static void earliest(double *next, double when)
+{
+  if (when < *next)
+  {
+    *next = when;
+  }
+}
+
+static void timer_push(reactor *r, double time, int kind, int aircraft)
+{
+  reactor_timer t;
+  int i = r->num_timers++;
+
+  t.time = time;
+  t.kind = kind;
+  t.aircraft = aircraft;
+  while (i > 0 && r->timers[(i - 1) / 2].time > time)
+  {
+    r->timers[i] = r->timers[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  r->timers[i] = t;
+}
+
+static reactor_timer timer_pop(reactor *r)
+{
+  reactor_timer top = r->timers[0];
+  reactor_timer last = r->timers[--r->num_timers];
+  int i = 0;
+  int child;
+
+  while ((child = 2 * i + 1) < r->num_timers)
+  {
+    if (child + 1 < r->num_timers &&
+        r->timers[child + 1].time < r->timers[child].time)
+    {
+      child++;
+    }
+    if (last.time <= r->timers[child].time)
+    {
+      break;
+    }
+    r->timers[i] = r->timers[child];
+    i = child;
+  }
+  r->timers[i] = last;
+  return top;
+}
+
+static int reactor_check_arrival(reactor *r, aircraft_info *ai, double now,
+                                 double *next);
+static int reactor_check_departure(reactor *r, aircraft_info *ai,
+                                   double now, double *next);
+
+/* An aircraft arrives, or a departure reaches the hold point, at its
+ * scheduled time arrived.  Like a new aircraft thread it looks at the
+ * rules straight away, before the next arrival does, and only waits if it
+ * cannot go.  An arrival that came due during a pause only looks once the
+ * pause is over, but its wait and fuel count from when it arrived.
+ */
+static void reactor_arrive(reactor *r, int i, double arrived, double now)
+{
+  double next;
+
+  runway_sim *sim = r->sim;
+  aircraft_info *ai = &sim->ai[i];
+
+  ai->aircraft_id = i;
+  ai->arrival_timestamp = arrived;
+  if (ai->departure)
+  {
+    sim->waiting_departures++;
+  }
+  else
+  {
+    ai->fuel_left = ai->fuel_reserve;
+    ai->fuel_checked_at = arrived;
+    if (ai->aircraft_type == COMMERCIAL)
+    {
+      sim->waiting_commercial++;
+      sim->waiting_north++;
+    }
+    else if (ai->aircraft_type == CARGO)
+    {
+      sim->waiting_cargo++;
+      sim->waiting_south++;
+    }
+    else
+    {
+      sim->waiting_emergency++;
+    }
+    if (ai->aircraft_type != EMERGENCY)
+    {
+      sim->waiting_wake[ai->aircraft_type][ai->wake]++;
+    }
+    take_ticket(ai);
+  }
+  live_publish(sim, LIVE_CHANGE, NULL);
+  if (ai->departure ? reactor_check_departure(r, ai, now, &next) :
+                      reactor_check_arrival(r, ai, now, &next))
+  {
+    return;
+  }
+  r->waiting[r->num_waiting++] = i;
+}
+
+/* Puts an arrival on the runway and starts its runway time. */
+static void reactor_admit(reactor *r, aircraft_info *ai, double now)
+{
+  runway_sim *sim = r->sim;
+
+  admit_arrival(ai, now, ai->fuel_declared);
+  assert(sim->aircraft_on_runway <= sim->runway_slots);
+  assert(sim->commercial_on_runway == 0 || sim->cargo_on_runway == 0);
+
+  announce(sim, RUNWAY_EVENT_ADMITTED, ai);
+  say(sim, "%s aircraft %d (fuel: %ds) is now on the runway "
+      "(direction: %s)\n", arrival_names[ai->aircraft_type],
+      ai->aircraft_id, ai->fuel_reserve,
+      sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+  say(sim, "%s aircraft %d begins runway operations for %d seconds\n",
+      arrival_names[ai->aircraft_type], ai->aircraft_id, ai->runway_time);
+  timer_push(r, now + ai->runway_time, REACTOR_ROLLING, ai->aircraft_id);
+}
+
+/* One pass of the loop in the *_enter() functions for a waiting arrival.
+ * Returns non-zero if it landed or diverted; otherwise lowers next to the
+ * time it has to be looked at again.
+ */
+static int reactor_check_arrival(reactor *r, aircraft_info *ai, double now,
+                                 double *next)
+{
+  runway_sim *sim = r->sim;
+  int desired_direction;
+  double fuel;
+  double left;
+  int reason;
+  int block;
+
+  fuel = check_fuel(ai, now);
+  desired_direction = ai->aircraft_type == COMMERCIAL ? NORTH :
+                      ai->aircraft_type == CARGO ? SOUTH :
+                      sim->current_direction;
+  block = turn_block(ai, desired_direction, now, ai->fuel_declared);
+  note_block(ai, now, block);
+  if (block == BLOCK_NONE)
+  {
+    reactor_admit(r, ai, now);
+    return 1;
+  }
+
+  reason = giving_up(sim) ? DIVERT_ABANDONED :
+           ai->aircraft_type != EMERGENCY && sim->holding.num_levels > 0 ?
+           hold(ai, fuel) : 0;
+  if (reason != 0)
+  {
+    leave_waiting(ai, ai->fuel_declared);
+    return_ticket(ai);
+    divert(ai, reason);
+    return 1;
+  }
+
+  left = fuel_wait(ai, now, ai->fuel_declared);
+  if (left > 0)
+  {
+    earliest(next, now + left);
+  }
+  earliest(next, now + wake_wait(ai, now));
+  return 0;
+}
+
+/* One pass of the loop in departure_enter(). */
+static int reactor_check_departure(reactor *r, aircraft_info *ai,
+                                   double now, double *next)
+{
+  runway_sim *sim = r->sim;
+  unsigned char *flags = &r->flags[ai->aircraft_id];
+  double gap;
+  int block;
+
+  if (!(*flags & REACTOR_DUE) &&
+      now - ai->arrival_timestamp >= DEPARTURE_MAX_WAIT)
+  {
+    *flags |= REACTOR_DUE;
+    sim->departures_due++;
+    say(sim, "Departure %d has waited %d seconds, holding new arrivals\n",
+        ai->aircraft_id, DEPARTURE_MAX_WAIT);
+  }
+
+  block = depart_block(sim, now);
+  note_block(ai, now, block);
+  if (block != BLOCK_NONE && !giving_up(sim))
+  {
+    if (!(*flags & REACTOR_DUE))
+    {
+      earliest(next, ai->arrival_timestamp + DEPARTURE_MAX_WAIT);
+    }
+    gap = sim->arrival_cleared_at + DEPARTURE_AFTER_ARRIVAL - now;
+    earliest(next, now + (gap > 0 && gap < 1 ? gap : 1));
+    return 0;
+  }
+
+  sim->waiting_departures--;
+  if (*flags & REACTOR_DUE)
+  {
+    sim->departures_due--;
+  }
+  if (block != BLOCK_NONE)
+  {
+    divert(ai, DIVERT_ABANDONED);
+    return 1;
+  }
+
+  ai->admitted_at = now;
+  ai->direction = sim->current_direction;
+  ai->fuel_emergency = 0;
+  sim->aircraft_on_runway++;
+  sim->departures_on_runway++;
+  sim->aircraft_since_break++;
+  take_end(ai);
+  note_admission(sim, now);
+  live_publish(sim, RUNWAY_EVENT_ADMITTED, ai);
+
+  announce(sim, RUNWAY_EVENT_ADMITTED, ai);
+  say(sim, "%s departure %d begins its takeoff roll for %d seconds "
+      "(direction: %s)\n",
+      type_names[ai->aircraft_type], ai->aircraft_id, ai->runway_time,
+      sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+  timer_push(r, now + ai->runway_time, REACTOR_ROLLING, ai->aircraft_id);
+  return 1;
+}
+
+/* Looks at every waiting aircraft in arrival order, as often as that
+ * lets one more go, and returns the time one of them next needs a look.
+ */
+static double reactor_settle(reactor *r, double now)
+{
+  runway_sim *sim = r->sim;
+  aircraft_info *ai;
+  double next = REACTOR_NEVER;
+  int gone;
+  int kept;
+  int i;
+
+  do
+  {
+    gone = 0;
+    kept = 0;
+    next = REACTOR_NEVER;
+    for (i = 0; i < r->num_waiting; i++)
+    {
+      ai = &sim->ai[r->waiting[i]];
+      if (ai->departure ? reactor_check_departure(r, ai, now, &next) :
+                          reactor_check_arrival(r, ai, now, &next))
+      {
+        gone++;
+      }
+      else
+      {
+        r->waiting[kept++] = r->waiting[i];
+      }
+    }
+    r->num_waiting = kept;
+  } while (gone > 0 && kept > 0);
+  return next;
+}
+
+/* An aircraft is done with its runway time, or a departure's runway
+ * block behind it has passed, as in the aircraft threads.
+ */
+static void reactor_clear(reactor *r, reactor_timer t, double now)
+{
+  runway_sim *sim = r->sim;
+  aircraft_info *ai = &sim->ai[t.aircraft];
+
+  if (ai->departure && t.kind == REACTOR_ROLLING)
+  {
+    say(sim, "%s departure %d is airborne\n",
+        type_names[ai->aircraft_type], ai->aircraft_id);
+    timer_push(r, now + ARRIVAL_AFTER_DEPARTURE, REACTOR_AIRBORNE,
+               t.aircraft);
+    return;
+  }
+  if (!ai->departure)
+  {
+    say(sim, "%s aircraft %d completes runway operations and "
+        "prepares to depart\n",
+        arrival_names[ai->aircraft_type], ai->aircraft_id);
+  }
+
+  ai->cleared_at = now;
+  sim->aircraft_on_runway--;
+  if (ai->departure)
+  {
+    sim->departures_on_runway--;
+  }
+  else
+  {
+    if (ai->aircraft_type == COMMERCIAL)
+    {
+      sim->commercial_on_runway--;
+    }
+    else if (ai->aircraft_type == CARGO)
+    {
+      sim->cargo_on_runway--;
+    }
+    else
+    {
+      sim->emergency_on_runway--;
+    }
+    sim->arrival_cleared_at = now;
+  }
+  assert(sim->aircraft_on_runway >= 0);
+  release_end(ai);
+  note_clearance(sim, now);
+
+  announce(sim, RUNWAY_EVENT_CLEARED, ai);
+  if (ai->departure)
+  {
+    say(sim, "%s departure %d has cleared the runway\n",
+        type_names[ai->aircraft_type], ai->aircraft_id);
+  }
+  else
+  {
+    say(sim, "%s aircraft %d has cleared the runway\n",
+        arrival_names[ai->aircraft_type], ai->aircraft_id);
+  }
+}
+
+static void reactor_busy(reactor *r, int what, double seconds)
+{
+  r->busy = what;
+  r->busy_until = sim_now(r->sim) + seconds;
+  live_controller(r->sim, what, seconds);
+}
+
+static void reactor_switch(reactor *r)
+{
+  runway_sim *sim = r->sim;
+
+  say(sim, "Switching runway direction from %s to %s\n",
+      sim->current_direction == NORTH ? "NORTH" : "SOUTH",
+      sim->current_direction == NORTH ? "SOUTH" : "NORTH");
+  reactor_busy(r, LIVE_SWITCH, sim->config.switch_time);
+}
+
+/* One round of controller_thread().  A break, switch or handover runs
+ * until busy_until instead of pausing; nothing else happens meanwhile,
+ * as nothing can while the controller holds runway_mutex.  Returns
+ * non-zero when one has just ended.
+ */
+static int reactor_controller(reactor *r, double now)
+{
+  runway_sim *sim = r->sim;
+  int opposite_waiting;
+  int same_waiting;
+
+  if (r->busy != LIVE_WORKING)
+  {
+    if (now < r->busy_until && stop_policy(sim) != RUNWAY_STOP_ABORT)
+    {
+      return 0;
+    }
+    if (r->busy == LIVE_SWITCH)
+    {
+      sim->current_direction = (sim->current_direction == NORTH) ?
+                               SOUTH : NORTH;
+      sim->consecutive_direction = 0;
+      sim->direction_switches++;
+      say(sim, "Runway direction switched to %s\n",
+          sim->current_direction == NORTH ? "NORTH" : "SOUTH");
+      sim->direction_pending = 0;
+    }
+    else
+    {
+      sim->aircraft_since_break = 0;
+      if (r->busy == LIVE_BREAK)
+      {
+        sim->controller_breaks++;
+      }
+      else
+      {
+        sim->shift_pending = 0;
+        sim->controller_shifts++;
+      }
+    }
+    r->busy = LIVE_WORKING;
+    live_controller(sim, LIVE_WORKING, 0);
+    return 1;
   }
 
-  /* wait for all aircraft threads to finish */
-  for (i = 0; i < num_aircraft; i++)
+  if (sim->aircraft_on_runway > 0)
   {
-    pthread_join(aircraft_tid[i], &status);
+    check_stall(sim);
+    return 0;
   }
 
-  /* tell the controller to finish. */
-  pthread_cancel(controller_tid);
-  pthread_join(controller_tid, &status);
+  if (sim->shift_pending)
+  {
+    say(sim, "Controller shift change: a new air traffic controller "
+        "takes over\n");
+    reactor_busy(r, LIVE_SHIFT, sim->shift_handover);
+  }
+  else if (sim->direction_pending)
+  {
+    if (sim->forced_direction != sim->current_direction)
+    {
+      reactor_switch(r);
+    }
+    else
+    {
+      sim->direction_pending = 0;
+    }
+  }
+  else if (sim->aircraft_since_break >= sim->config.controller_limit)
+  {
+    say(sim, "The air traffic controller is taking a break now.\n");
+    reactor_busy(r, LIVE_BREAK, sim->config.break_time);
+  }
+  else
+  {
+    opposite_waiting = sim->current_direction == NORTH ?
+                       sim->waiting_south : sim->waiting_north;
+    same_waiting = sim->current_direction == NORTH ?
+                   sim->waiting_north : sim->waiting_south;
+    if ((opposite_waiting >= sim->config.switch_threshold &&
+         sim->consecutive_direction >= sim->config.direction_limit) ||
+        (opposite_waiting > 0 && same_waiting == 0))
+    {
+      reactor_switch(r);
+    }
+  }
+  check_stall(sim);
+  return 0;
+}
+
+/* Sets up the timerfd, the eventfd for runway_stop() and the epoll set,
+ * and the reactor's memory from the run's arena.  Returns 0 or -1.
+ */
+static int reactor_open(runway_sim *sim, reactor *r)
+{
+  struct epoll_event event;
+
+  memset(r, 0, sizeof(*r));
+  r->sim = sim;
+  r->busy = LIVE_WORKING;
+  r->epoll_fd = -1;
+  r->timer_fd = -1;
+  r->wake_fd = -1;
+  r->timers = arena_alloc(&sim->run_cache,
+                          sizeof(reactor_timer) * sim->num_aircraft);
+  r->waiting = arena_alloc(&sim->run_cache, sizeof(int) * sim->num_aircraft);
+  r->flags = arena_alloc(&sim->run_cache, sim->num_aircraft);
+  if (r->timers == NULL || r->waiting == NULL || r->flags == NULL)
+  {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  r->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  r->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (r->epoll_fd < 0 || r->timer_fd < 0 || r->wake_fd < 0)
+  {
+    return -1;
+  }
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.fd = r->timer_fd;
+  if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->timer_fd, &event) != 0)
+  {
+    return -1;
+  }
+  event.data.fd = r->wake_fd;
+  if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->wake_fd, &event) != 0)
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&sim->stop_mutex);
+  sim->reactor_fd = r->wake_fd;
+  pthread_mutex_unlock(&sim->stop_mutex);
+  return 0;
+}
+
+static void reactor_close(reactor *r)
+{
+  runway_sim *sim = r->sim;
+
+  pthread_mutex_lock(&sim->stop_mutex);
+  sim->reactor_fd = -1;
+  pthread_mutex_unlock(&sim->stop_mutex);
+  if (r->epoll_fd >= 0)
+  {
+    close(r->epoll_fd);
+  }
+  if (r->timer_fd >= 0)
+  {
+    close(r->timer_fd);
+  }
+  if (r->wake_fd >= 0)
+  {
+    close(r->wake_fd);
+  }
+}
+
+/* Sleeps until the given simulated time or a stop request. */
+static void reactor_sleep(reactor *r, double when)
+{
+  runway_sim *sim = r->sim;
+  struct epoll_event events[2];
+  struct itimerspec its;
+  double wall;
+  uint64_t count;
+  int n;
+  int i;
+
+  memset(&its, 0, sizeof(its));
+  if (when < REACTOR_NEVER)
+  {
+    wall = when > 0 ? when / sim->config.speed : 0;
+    its.it_value.tv_sec = sim->clock_epoch.tv_sec + (time_t)wall;
+    its.it_value.tv_nsec = sim->clock_epoch.tv_nsec +
+                           (long)((wall - (double)(time_t)wall) * 1e9);
+    if (its.it_value.tv_nsec >= 1000000000L)
+    {
+      its.it_value.tv_sec += 1;
+      its.it_value.tv_nsec -= 1000000000L;
+    }
+  }
+  timerfd_settime(r->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+
+  n = epoll_wait(r->epoll_fd, events, 2, -1);
+  for (i = 0; i < n; i++)
+  {
+    while (read(events[i].data.fd, &count, sizeof(count)) > 0)
+    {
+    }
+  }
+}
+
+/* runway_run() in reactor mode: the whole scenario in this thread. */
+static int run_reactor(runway_sim *sim)
+{
+  scenario_event *ev = sim->sc.events;
+  scenario_event *end = sim->sc.events + sim->sc.num_events;
+  reactor_timer t;
+  reactor r;
+  double now;
+  double next;
+  double left;
+  int spawned = 0;
+  int resumed;
+  int result;
+
+  say(sim, "Starting runway simulation with %d aircraft in one thread "
+      "...\n", sim->num_aircraft);
+  sim->scheduled = sim->num_aircraft;
+
+  result = reactor_open(sim, &r);
+  if (result != 0)
+  {
+    say(sim, "runway: cannot set up the reactor: %s\n", strerror(errno));
+    reactor_close(&r);
+    return -1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &sim->clock_epoch);
+  live_run(sim, 0);
+  say(sim, "The air traffic controller arrived and is beginning operations\n");
+
+  while (1)
+  {
+    check_drain(sim);
+    now = sim_now(sim);
+
+    /* A stop ends the arrivals; an abort also cuts runway time short */
+    if (stop_policy(sim) >= 0)
+    {
+      ev = end;
+    }
+    while (r.num_timers > 0 &&
+           (r.timers[0].time <= now ||
+            stop_policy(sim) == RUNWAY_STOP_ABORT))
+    {
+      t = timer_pop(&r);
+      reactor_clear(&r, t, now);
+    }
+
+    resumed = reactor_controller(&r, now);
+    next = REACTOR_NEVER;
+    if (r.busy == LIVE_WORKING)
+    {
+      /* The aircraft woken at the end of a pause get their look before
+       * the events that came due during it, as they do in threads
+       */
+      if (resumed)
+      {
+        note_reopen(sim);
+        reactor_settle(&r, now);
+      }
+      for (; ev < end && ev->time <= now; ev++)
+      {
+        if (ev->kind == EVENT_ARRIVAL)
+        {
+          reactor_arrive(&r, ev->aux, ev->time, now);
+          spawned++;
+        }
+        else
+        {
+          apply_event(sim, ev);
+          now = sim_now(sim);
+        }
+      }
+      next = reactor_settle(&r, now);
+      if (ev < end)
+      {
+        earliest(&next, ev->time);
+      }
+    }
+    else
+    {
+      earliest(&next, r.busy_until);
+    }
+
+    if (ev == end && r.num_waiting == 0 && r.num_timers == 0)
+    {
+      break;
+    }
+    if (r.num_timers > 0)
+    {
+      earliest(&next, r.timers[0].time);
+    }
+    /* An abort cuts every pause short, the ones it starts too */
+    if (stop_policy(sim) == RUNWAY_STOP_ABORT)
+    {
+      next = now;
+    }
+    else if (stop_policy(sim) == RUNWAY_STOP_DRAIN && sim->config.drain_limit > 0)
+    {
+      left = sim->config.drain_limit - wall_since(&sim->stop_at);
+      earliest(&next, now + (left > 0 ? left : 0) * sim->config.speed);
+    }
+
+    /* The controller looks again once the runway may have changed */
+    if (r.busy == LIVE_WORKING && sim->aircraft_on_runway == 0 &&
+        r.num_waiting > 0)
+    {
+      earliest(&next, now + CONTROLLER_POLL_TIME);
+    }
+    reactor_sleep(&r, next);
+  }
+
+  reactor_close(&r);
+  sim->num_aircraft = spawned;
+  return 0;
+}
+
+void runway_config_defaults(runway_config *config)
+{
+  memset(config, 0, sizeof(*config));
+  config->speed = 1;
+  config->wake_reorder = 1;
+  config->fifo_tickets = 1;
+  config->group_admission = 1;
+  config->direction_limit = DIRECTION_LIMIT;
+  config->fairness_limit = FAIRNESS_LIMIT;
+  config->controller_limit = CONTROLLER_LIMIT;
+  config->switch_threshold = 1;
+  config->switch_time = DIRECTION_SWITCH_TIME;
+  config->break_time = BREAK_TIME;
+  config->numa_node = -1;
+}
+
+int runway_numa_nodes(void)
+{
+  return numa_node_count();
+}
+
+/* Reads one of the config's CPU lists into set, narrowed to the CPUs of
+ * the node, if any, and to those the calling thread may use.  Returns 1 if
+ * the threads are to be pinned to set, 0 if they may run anywhere, or -1
+ * if the list is malformed or leaves no CPU.
+ */
+static int placement_cpus(const char *list, int node, cpu_set_t *set)
+{
+  cpu_set_t allowed;
+  cpu_set_t node_cpus;
+
+  if (list == NULL && node < 0)
+  {
+    return 0;
+  }
+  if (pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed) != 0)
+  {
+    return -1;
+  }
+  if (list == NULL)
+  {
+    *set = allowed;
+  }
+  else if (cpu_list_parse(list, set) != 0)
+  {
+    return -1;
+  }
+  if (node >= 0)
+  {
+    if (numa_node_cpus(node, &node_cpus) != 0)
+    {
+      return -1;
+    }
+    CPU_AND(set, set, &node_cpus);
+  }
+  CPU_AND(set, set, &allowed);
+  return CPU_COUNT(set) > 0 ? 1 : -1;
+}
+
+/* The handle of a run bound to a node lives on that node as well. */
+static void free_sim(runway_sim *sim)
+{
+  if (sim->config.numa_node >= 0)
+  {
+    node_free(sim, sizeof(runway_sim));
+  }
+  else
+  {
+    free(sim);
+  }
+}
+
+runway_sim *runway_create(const runway_config *config)
+{
+  runway_sim *sim;
+  cpu_set_t controller_cpus;
+  cpu_set_t aircraft_cpus;
+  int pin_controller;
+  int pin_aircraft;
+
+  if (config->speed <= 0 || config->holding_levels < 0 ||
+      config->holding_levels > HOLDING_MAX_LEVELS || config->soak_hours < 0 ||
+      config->taxi_slots < 0 || config->gates < 0 ||
+      (config->taxi_slots > 0) != (config->gates > 0) ||
+      config->taxi_time < 0 || config->gate_time < 0 ||
+      config->direction_limit < 1 || config->fairness_limit < 1 ||
+      config->controller_limit < 1 || config->switch_threshold < 1 ||
+      config->switch_time < 0 || config->break_time < 0 ||
+      config->stall_limit < 0 || config->drain_limit < 0 ||
+      config->numa_node < -1 ||
+      (config->reactor && (config->soak_hours > 0 || config->taxi_slots > 0)))
+  {
+    return NULL;
+  }
+  pin_controller = placement_cpus(config->controller_cpus,
+                                  config->numa_node, &controller_cpus);
+  pin_aircraft = placement_cpus(config->aircraft_cpus, config->numa_node,
+                                &aircraft_cpus);
+  if (pin_controller < 0 || pin_aircraft < 0)
+  {
+    return NULL;
+  }
+
+  if (config->numa_node >= 0)
+  {
+    sim = node_alloc(sizeof(runway_sim), config->numa_node);
+  }
+  else
+  {
+    sim = calloc(1, sizeof(runway_sim));
+  }
+  if (sim == NULL)
+  {
+    return NULL;
+  }
+  sim->config = *config;
+  sim->runway_slots = MAX_RUNWAY_CAPACITY;
+  if (config->layout != NULL)
+  {
+    if (airport_load(&sim->layout, config->layout) != 0)
+    {
+      free_sim(sim);
+      return NULL;
+    }
+    sim->use_layout = 1;
+    sim->runway_slots = airport_slots(&sim->layout);
+  }
+  if (config->live_name != NULL &&
+      (sim->live = live_create(config->live_name)) == NULL)
+  {
+    free_sim(sim);
+    return NULL;
+  }
+
+  /* Initialize synchronization variables */
+  pthread_mutex_init(&sim->runway_mutex, NULL);
+  pthread_cond_init(&sim->cond_aircraft, NULL);
+  pthread_mutex_init(&sim->soak_mutex, NULL);
+  pthread_cond_init(&sim->soak_cond, NULL);
+  pthread_mutex_init(&sim->stop_mutex, NULL);
+  pthread_cond_init(&sim->stop_cond, NULL);
+  sim->soak_free = -1;
+  sim->reactor_fd = -1;
+
+  arena_init(&sim->run_arena);
+  arena_bind(&sim->run_arena, config->numa_node);
+  arena_cache_init(&sim->run_cache, &sim->run_arena);
+
+  pthread_attr_init(&sim->controller_attr);
+  pthread_attr_init(&sim->aircraft_attr);
+  if (pin_controller)
+  {
+    pthread_attr_setaffinity_np(&sim->controller_attr, sizeof(cpu_set_t),
+                                &controller_cpus);
+    sim->controller_cpus = controller_cpus;
+    sim->pin_controller = 1;
+  }
+  if (pin_aircraft)
+  {
+    pthread_attr_setaffinity_np(&sim->aircraft_attr, sizeof(cpu_set_t),
+                                &aircraft_cpus);
+  }
+
+  sim->taxi_stage.sim = sim;
+  sim->taxi_stage.name = "Taxi";
+  sim->taxi_stage.unit = "slots";
+  sim->taxi_stage.num_servers = config->taxi_slots;
+  sim->taxi_stage.service_time = config->taxi_time;
+  sim->gate_stage.sim = sim;
+  sim->gate_stage.name = "Gates";
+  sim->gate_stage.unit = "gates";
+  sim->gate_stage.num_servers = config->gates;
+  sim->gate_stage.service_time = config->gate_time;
+
+  reset_runway(sim);
+  clock_gettime(CLOCK_MONOTONIC, &sim->clock_epoch);
+  return sim;
+}
+
+/* Takes a scenario read by one of the loaders below. */
+static int load(runway_sim *sim, int result)
+{
+  int error = errno;
+
+  if (result != 0 || initialize(sim) != 0)
+  {
+    scenario_free(&sim->sc);
+    errno = result != 0 ? error : EINVAL;
+    return -1;
+  }
+  sim->loaded = 1;
+  return 0;
+}
+
+int runway_load_file(runway_sim *sim, const char *filename)
+{
+  if (sim->loaded || sim->config.soak_hours > 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+  return load(sim, scenario_load(&sim->sc, filename, MAX_AIRCRAFT));
+}
+
+int runway_load_buffer(runway_sim *sim, const char *text, size_t length)
+{
+  if (sim->loaded || sim->config.soak_hours > 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+  return load(sim, scenario_load_buffer(&sim->sc, text, length,
+                                        MAX_AIRCRAFT));
+}
+
+int runway_run(runway_sim *sim)
+{
+  runway_metrics metrics;
+  int result;
+
+  if (sim->finished || (!sim->loaded && sim->config.soak_hours <= 0))
+  {
+    return -1;
+  }
+
+  /* The calling thread starts the aircraft and walks the scenario, so it
+   * runs with the controller for the length of the run.
+   */
+  if (sim->pin_controller)
+  {
+    pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                           &sim->dispatcher_cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                           &sim->controller_cpus);
+  }
+  result = sim->config.soak_hours > 0 ? run_soak(sim) :
+           sim->config.reactor ? run_reactor(sim) : run_scenario(sim);
+  if (sim->pin_controller)
+  {
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                           &sim->dispatcher_cpus);
+  }
+  sim->finished = 1;
+  live_run(sim, 1);
+  if (sim->stopping)
+  {
+    sim->shutdown_latency = wall_since(&sim->stop_at);
+  }
+  if (result != 0 || sim->abandoned)
+  {
+    return -1;
+  }
+
+  say(sim, "Runway simulation done.\n");
+  if (sim->config.on_metrics != NULL)
+  {
+    compute_metrics(sim, &metrics);
+    sim->config.on_metrics(&metrics, sim->config.user);
+  }
+  return 0;
+}
+
+int runway_stop(runway_sim *sim, int policy)
+{
+  if (policy != RUNWAY_STOP_DRAIN && policy != RUNWAY_STOP_ABORT)
+  {
+    return -1;
+  }
 
-  printf("Runway simulation done.\n");
+  pthread_mutex_lock(&sim->stop_mutex);
+  if (sim->stopping == 0)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &sim->stop_at);
+  }
+  if (policy + 1 > sim->stopping)
+  {
+    __atomic_store_n(&sim->stopping, policy + 1, __ATOMIC_RELEASE);
+  }
+  pthread_cond_broadcast(&sim->stop_cond);
+  if (sim->reactor_fd >= 0)
+  {
+    eventfd_write(sim->reactor_fd, 1);
+  }
+  pthread_mutex_unlock(&sim->stop_mutex);
 
+  /* Waiting aircraft look at the policy when they wake up */
+  pthread_mutex_lock(&sim->runway_mutex);
+  wake_everyone(sim);
+  pthread_mutex_unlock(&sim->runway_mutex);
   return 0;
 }
+
+void runway_get_metrics(runway_sim *sim, runway_metrics *metrics)
+{
+  compute_metrics(sim, metrics);
+}
+
+long runway_get_outcomes(runway_sim *sim, runway_outcome *outcomes,
+                         long max)
+{
+  aircraft_info *ai = sim->ai;
+  runway_outcome *o;
+  int i;
+
+  if (!sim->finished || sim->config.soak_hours > 0)
+  {
+    return 0;
+  }
+
+  for (i = 0; i < sim->num_aircraft && i < max; i++)
+  {
+    o = &outcomes[i];
+    o->aircraft_id = ai[i].aircraft_id;
+    o->aircraft_type = ai[i].aircraft_type;
+    o->departure = ai[i].departure;
+    o->arrival = ai[i].arrival_timestamp;
+    o->fuel_reserve = ai[i].fuel_reserve;
+    o->admitted_at = ai[i].admitted_at;
+    o->direction = ai[i].direction;
+    o->cleared_at = ai[i].cleared_at;
+    o->wait = ai[i].diverted ? -1 :
+              ai[i].admitted_at - ai[i].arrival_timestamp;
+    o->fuel_emergency = ai[i].fuel_emergency;
+    o->diverted = ai[i].diverted != 0;
+    memcpy(o->blocked, ai[i].blocked, sizeof(o->blocked));
+  }
+  return sim->num_aircraft;
+}
+
+void runway_print_summary(runway_sim *sim, FILE *fp)
+{
+  if (sim->config.soak_hours > 0)
+  {
+    print_soak_summary(sim, fp);
+  }
+  else
+  {
+    print_summary(sim, fp);
+  }
+}
+
+void runway_print_results(runway_sim *sim, FILE *fp)
+{
+  if (sim->config.soak_hours <= 0)
+  {
+    print_results(sim, fp);
+  }
+}
+
+void runway_destroy(runway_sim *sim)
+{
+  int i;
+
+  if (sim == NULL)
+  {
+    return;
+  }
+  for (i = 0; sim->loaded && i < sim->sc.num_aircraft; i++)
+  {
+    pthread_cond_destroy(&sim->ai[i].turn);
+  }
+  scenario_free(&sim->sc);
+  arena_release(&sim->run_arena);
+  if (sim->live != NULL)
+  {
+    live_destroy(sim->live, sim->config.live_name);
+  }
+  pthread_mutex_destroy(&sim->runway_mutex);
+  pthread_cond_destroy(&sim->cond_aircraft);
+  pthread_mutex_destroy(&sim->soak_mutex);
+  pthread_cond_destroy(&sim->soak_cond);
+  pthread_mutex_destroy(&sim->stop_mutex);
+  pthread_cond_destroy(&sim->stop_cond);
+  pthread_attr_destroy(&sim->controller_attr);
+  pthread_attr_destroy(&sim->aircraft_attr);
+  free_sim(sim);
+}
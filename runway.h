@@ -0,0 +1,67 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Parameters and identifiers shared by the threaded simulator (runway.c)
+ * and the single-threaded reference model (model.c).
+ */
+
+#ifndef RUNWAY_H
+#define RUNWAY_H
+
+/*** Constants that define parameters of the simulation ***/
+
+#ifndef MAX_RUNWAY_CAPACITY
+#define MAX_RUNWAY_CAPACITY 2    /* Number of aircraft that can use runway simultaneously */
+#endif
+#define CONTROLLER_LIMIT 8       /* Number of aircraft the controller can manage before break */
+#define MAX_AIRCRAFT 1000        /* Maximum number of aircraft in the simulation */
+#define FUEL_MIN 20              /* Minimum fuel reserve in seconds */
+#define FUEL_MAX 60              /* Maximum fuel reserve in seconds */
+#define EMERGENCY_TIMEOUT 30     /* Max wait time for emergency aircraft in seconds */
+#define DIRECTION_SWITCH_TIME 5  /* Time required to switch runway direction */
+#define DIRECTION_LIMIT 3        /* Max consecutive aircraft in same direction */
+#define BREAK_TIME 5             /* Length of a controller break in seconds */
+#define EMERGENCY_FUEL 10        /* Holding fuel left after a fuel emergency before diverting */
+#define DEPARTURE_AFTER_ARRIVAL 1  /* Seconds from an arrival clearing to a departure rolling */
+#define ARRIVAL_AFTER_DEPARTURE 2  /* Seconds the runway stays blocked after a departure */
+#define DEPARTURE_MAX_WAIT 60    /* Departure wait after which arrivals are held for it */
+#define WAKE_MAX_DEFER 20        /* Longest an aircraft lets lighter-separated ones go first */
+#define FAIRNESS_LIMIT 4         /* Consecutive regular aircraft of one type before the other type is preferred */
+
+#define CONTROLLER_POLL_TIME 0.1 /* Controller polling interval in seconds */
+#define PIPELINE_POLL_TIME 0.1   /* Polling interval of the taxi and gate stages */
+#define PIPELINE_QUEUE_SIZE 4    /* Aircraft queued in front of a stage, power of two */
+#define SOAK_POOL_SIZE 64        /* Aircraft records and threads in soak mode */
+#define SOAK_MEAN_GAP 10          /* Mean seconds between generated arrivals */
+#define SOAK_LOG_SIZE 65536      /* Bytes of stdout buffering in soak mode */
+#define STOP_DRAIN_LIMIT 30      /* Wall-clock seconds the program lets a signalled drain take */
+
+#define COMMERCIAL 0
+#define CARGO 1
+#define EMERGENCY 2
+
+#define WAKE_LIGHT 0             /* Wake-turbulence categories, lightest first */
+#define WAKE_MEDIUM 1
+#define WAKE_HEAVY 2
+#define WAKE_SUPER 3
+#define WAKE_CATEGORIES 4
+
+#define NORTH 0
+#define SOUTH 1
+#define EAST  2
+#define WEST  4
+
+#endif
@@ -0,0 +1,587 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* The runway program: a command-line front end to librunway.  It reads
+ * the options into a runway_config, prints the simulation log as it
+ * comes and the summary at the end.
+ */
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "librunway.h"
+#include "runway.h"
+#include "holding.h"
+#include "batch.h"
+
+/* Soak runs write their log through one fixed buffer */
+static char soak_log[SOAK_LOG_SIZE];
+
+static const struct option long_options[] =
+{
+  { "batch", required_argument, NULL, 'B' },
+  { "jobs", required_argument, NULL, 'j' },
+  { "format", required_argument, NULL, 'F' },
+  { "controller-cpus", required_argument, NULL, 'c' },
+  { "aircraft-cpus", required_argument, NULL, 'a' },
+  { "numa-node", required_argument, NULL, 'N' },
+  { "numa-spread", no_argument, NULL, 'n' },
+  { "log-writer", required_argument, NULL, 'w' },
+  { "live", required_argument, NULL, 'l' },
+  { "reactor", no_argument, NULL, 'e' },
+  { "drain-limit", required_argument, NULL, 'D' },
+  { NULL, 0, NULL, 0 }
+};
+
+/* Signals are taken by one thread with sigwait() rather than a handler,
+ * since runway_stop() is not async-signal-safe.  The first SIGINT or
+ * SIGTERM drains the run, the next one aborts it, as does the drain
+ * itself once it has taken config.drain_limit seconds; SIGUSR1 tells the
+ * thread that the run is over.
+ */
+typedef struct
+{
+  pthread_t tid;
+  sigset_t signals;
+  runway_sim *sim;          /* the run to stop, or NULL for the batch */
+  double drain_limit;       /* seconds before a drain becomes an abort */
+} signal_watch;
+
+static void * watch_signals(void *arg)
+{
+  signal_watch *watch = (signal_watch *)arg;
+  int policy = RUNWAY_STOP_DRAIN;
+  int sig;
+
+  while (sigwait(&watch->signals, &sig) == 0 && sig != SIGUSR1)
+  {
+    if (policy == RUNWAY_STOP_ABORT)
+    {
+      fprintf(stderr, "runway: aborting\n");
+    }
+    else if (watch->drain_limit > 0)
+    {
+      fprintf(stderr, "runway: stopping, landing the aircraft already here "
+              "for up to %g s (interrupt again to abort)\n",
+              watch->drain_limit);
+    }
+    else
+    {
+      fprintf(stderr, "runway: stopping, landing the aircraft already here "
+              "(interrupt again to abort)\n");
+    }
+    if (watch->sim != NULL)
+    {
+      runway_stop(watch->sim, policy);
+    }
+    else
+    {
+      batch_stop(policy);
+    }
+    policy = RUNWAY_STOP_ABORT;
+  }
+  return NULL;
+}
+
+/* Blocks the signals in every thread started from here on and starts the
+ * thread that waits for them.  Returns 0, or -1 if it cannot be started.
+ */
+static int start_watch(signal_watch *watch, runway_sim *sim,
+                       double drain_limit)
+{
+  sigemptyset(&watch->signals);
+  sigaddset(&watch->signals, SIGINT);
+  sigaddset(&watch->signals, SIGTERM);
+  sigaddset(&watch->signals, SIGUSR1);
+  watch->sim = sim;
+  watch->drain_limit = drain_limit;
+  if (pthread_sigmask(SIG_BLOCK, &watch->signals, NULL) != 0 ||
+      pthread_create(&watch->tid, NULL, watch_signals, watch) != 0)
+  {
+    pthread_sigmask(SIG_UNBLOCK, &watch->signals, NULL);
+    return -1;
+  }
+  return 0;
+}
+
+static void stop_watch(signal_watch *watch)
+{
+  pthread_kill(watch->tid, SIGUSR1);
+  pthread_join(watch->tid, NULL);
+  pthread_sigmask(SIG_UNBLOCK, &watch->signals, NULL);
+}
+
+static void print_event(const runway_event *event, void *user)
+{
+  (void)user;
+  if (event->kind == RUNWAY_EVENT_MESSAGE)
+  {
+    printf("%s\n", event->message);
+  }
+}
+
+static void usage(void)
+{
+  printf("Usage: runway [-s seed] [-x speed] [-H levels] [-A] [-W] [-T] [-G] "
+         "[-P slots:time:gates:time] [-R layout]\n"
+         "              [-r] [-o prefix] [-L file] [--live NAME] "
+         "[--reactor]\n"
+         "              <scenario file>\n"
+         "       runway -S hours [-s seed] [-x speed] [-H levels] [-W] [-T] "
+         "[-G] [-R layout]\n"
+         "              [--live NAME]\n"
+         "       runway --batch DIR [-j jobs] [-F csv|json] [-s seed] "
+         "[-x speed] [-H levels]\n"
+         "              [-A] [-W] [-T] [-G] [-P slots:time:gates:time] "
+         "[-R layout]\n");
+  printf("  -s seed   seed for the fuel reserve generator "
+         "(default: current time)\n");
+  printf("  -x speed  simulated seconds per wall-clock second "
+         "(default: 1)\n");
+  printf("  -H levels holding stack with this many levels; aircraft divert "
+         "when it is\n"
+         "            full or their fuel runs out (default: no stack)\n");
+  printf("  -A        arrivals only: leave the departures in the scenario "
+         "out\n");
+  printf("  -W        keep arrivals in order instead of reordering them "
+         "to cut\n"
+         "            wake-turbulence separation\n");
+  printf("  -T        let every waiting aircraft look at the rules instead "
+         "of only the\n"
+         "            one that arrived first in its class\n");
+  printf("  -G        let waiting aircraft race to fill the runway after a "
+         "switch, break\n"
+         "            or shift change instead of the controller admitting "
+         "them as a group\n");
+  printf("  -P slots:time:gates:time\n"
+         "            send arrivals on through a taxiway with this many slots "
+         "and\n"
+         "            taxi time and a gate area with this many gates and "
+         "gate time\n");
+  printf("  -R layout airport layout with several runways and their "
+         "conflicts\n");
+  printf("  -r        print per-aircraft results at the end\n");
+  printf("  -o prefix write the per-aircraft outcomes to prefix.csv and, "
+         "in columnar\n"
+         "            form, to prefix.cols\n");
+  printf("  -L file   write the simulation log to file through the "
+         "asynchronous writer\n"
+         "            instead of printing it\n");
+  printf("  --log-writer uring|thread\n"
+         "            how -L writes: io_uring, or a thread with writev "
+         "(default: io_uring\n"
+         "            where the kernel has it)\n");
+  printf("  --live NAME\n"
+         "            publish the runway state in the shared-memory object "
+         "NAME, e.g.\n"
+         "            /runway, for runway-top to show while the run goes "
+         "on\n");
+  printf("  --reactor run the whole simulation in one thread with epoll "
+         "and timerfd\n"
+         "            instead of a thread per aircraft\n");
+  printf("  --drain-limit SECONDS\n"
+         "            abort a run that a signal is draining after this many "
+         "wall-clock\n"
+         "            seconds, 0 for no limit (default: %d)\n",
+         STOP_DRAIN_LIMIT);
+  printf("  -S hours  soak run: generate arrivals for this many simulated "
+         "hours,\n"
+         "            flying them from a fixed pool of aircraft slots\n");
+  printf("  --batch DIR\n"
+         "            run every *.txt trace in DIR as its own simulation "
+         "and print\n"
+         "            one summary row per trace (default speed: %d)\n",
+         BATCH_SPEED);
+  printf("  -j jobs   traces run at the same time in batch mode "
+         "(default: online CPUs)\n");
+  printf("  -F format batch output, csv or json (default: csv)\n");
+  printf("  --controller-cpus LIST\n"
+         "            run the controller and the thread starting the "
+         "aircraft on these\n"
+         "            CPUs, e.g. 0 or 0-1,4\n");
+  printf("  --aircraft-cpus LIST\n"
+         "            run the aircraft, pool and stage threads on these "
+         "CPUs\n");
+  printf("  --numa-node N\n"
+         "            keep the run's threads and memory on NUMA node N "
+         "(0-%d here)\n", runway_numa_nodes() - 1);
+  printf("  --numa-spread\n"
+         "            in batch mode, bind the traces in turn to each NUMA "
+         "node\n");
+}
+
+/* Writes prefix.csv and prefix.cols.  Returns 0, or -1 on failure. */
+static int export_outcomes(runway_sim *sim, const char *prefix)
+{
+  char *filename;
+  int result = 0;
+
+  if ((filename = malloc(strlen(prefix) + sizeof(".cols"))) == NULL)
+  {
+    return -1;
+  }
+  sprintf(filename, "%s.csv", prefix);
+  if (runway_export_csv(sim, filename) != 0)
+  {
+    printf("runway: cannot write %s\n", filename);
+    result = -1;
+  }
+  sprintf(filename, "%s.cols", prefix);
+  if (runway_export_columns(sim, filename) != 0)
+  {
+    printf("runway: cannot write %s\n", filename);
+    result = -1;
+  }
+  free(filename);
+  return result;
+}
+
+/* Main function sets up simulation and prints report
+ * at the end.
+ * GUID: 355F4066-DA3E-4F74-9656-EF8097FBC985
+ */
+int main(int nargs, char **args)
+{
+  runway_config config;
+  runway_sim *sim;
+  const char *batch_dir = NULL;
+  const char *export_prefix = NULL;
+  const char *log_file = NULL;
+  int log_backend = RUNWAY_WRITER_AUTO;
+  runway_writer *log = NULL;
+  runway_writer_stats log_stats;
+  int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int format = BATCH_CSV;
+  int spread = 0;
+  int speed_set = 0;
+  int show_results = 0;
+  signal_watch watch;
+  int watching;
+  int result;
+  int opt;
+
+  runway_config_defaults(&config);
+  config.seed = (unsigned int)time(NULL);
+  config.on_event = print_event;
+  config.drain_limit = STOP_DRAIN_LIMIT;
+
+  while ((opt = getopt_long(nargs, args, "s:x:H:AWTGP:R:rS:j:F:o:L:",
+                            long_options, NULL)) != -1)
+  {
+    switch (opt)
+    {
+      case 's':
+        config.seed = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'x':
+        config.speed = atof(optarg);
+        if (config.speed <= 0)
+        {
+          printf("runway: speed must be positive\n");
+          return EINVAL;
+        }
+        speed_set = 1;
+        break;
+      case 'H':
+        config.holding_levels = atoi(optarg);
+        if (config.holding_levels < 0 ||
+            config.holding_levels > HOLDING_MAX_LEVELS)
+        {
+          printf("runway: holding levels must be 0-%d\n",
+                 HOLDING_MAX_LEVELS);
+          return EINVAL;
+        }
+        break;
+      case 'A':
+        config.arrivals_only = 1;
+        break;
+      case 'W':
+        config.wake_reorder = 0;
+        break;
+      case 'T':
+        config.fifo_tickets = 0;
+        break;
+      case 'G':
+        config.group_admission = 0;
+        break;
+      case 'R':
+        config.layout = optarg;
+        break;
+      case 'P':
+        if (sscanf(optarg, "%d:%lf:%d:%lf", &config.taxi_slots,
+                   &config.taxi_time, &config.gates,
+                   &config.gate_time) != 4 ||
+            config.taxi_slots <= 0 || config.gates <= 0 ||
+            config.taxi_time < 0 || config.gate_time < 0)
+        {
+          printf("runway: -P needs slots:time:gates:time, e.g. "
+                 "4:10:6:60\n");
+          return EINVAL;
+        }
+        break;
+      case 'r':
+        show_results = 1;
+        break;
+      case 'o':
+        export_prefix = optarg;
+        break;
+      case 'S':
+        config.soak_hours = atof(optarg);
+        if (config.soak_hours <= 0)
+        {
+          printf("runway: soak hours must be positive\n");
+          return EINVAL;
+        }
+        break;
+      case 'B':
+        batch_dir = optarg;
+        break;
+      case 'j':
+        jobs = atoi(optarg);
+        if (jobs < 1)
+        {
+          printf("runway: jobs must be positive\n");
+          return EINVAL;
+        }
+        break;
+      case 'F':
+        if (strcmp(optarg, "csv") == 0)
+        {
+          format = BATCH_CSV;
+        }
+        else if (strcmp(optarg, "json") == 0)
+        {
+          format = BATCH_JSON;
+        }
+        else
+        {
+          printf("runway: -F takes csv or json\n");
+          return EINVAL;
+        }
+        break;
+      case 'c':
+        config.controller_cpus = optarg;
+        break;
+      case 'a':
+        config.aircraft_cpus = optarg;
+        break;
+      case 'N':
+        config.numa_node = atoi(optarg);
+        if (config.numa_node < 0 || config.numa_node >= runway_numa_nodes())
+        {
+          printf("runway: NUMA node must be 0-%d\n",
+                 runway_numa_nodes() - 1);
+          return EINVAL;
+        }
+        break;
+      case 'n':
+        spread = 1;
+        break;
+      case 'L':
+        log_file = optarg;
+        break;
+      case 'l':
+        config.live_name = optarg;
+        break;
+      case 'e':
+        config.reactor = 1;
+        break;
+      case 'D':
+        config.drain_limit = atof(optarg);
+        if (config.drain_limit < 0)
+        {
+          printf("runway: drain limit must not be negative\n");
+          return EINVAL;
+        }
+        break;
+      case 'w':
+        if (strcmp(optarg, "uring") == 0)
+        {
+          log_backend = RUNWAY_WRITER_URING;
+        }
+        else if (strcmp(optarg, "thread") == 0)
+        {
+          log_backend = RUNWAY_WRITER_THREAD;
+        }
+        else
+        {
+          printf("runway: --log-writer takes uring or thread\n");
+          return EINVAL;
+        }
+        break;
+      default:
+        usage();
+        return EINVAL;
+    }
+  }
+
+  if (batch_dir != NULL)
+  {
+    if (optind != nargs || show_results || config.soak_hours > 0 ||
+        export_prefix != NULL || log_file != NULL ||
+        config.live_name != NULL)
+    {
+      printf("runway: --batch takes no scenario file and cannot be "
+             "combined with -S, -r, -o, -L or --live\n");
+      return EINVAL;
+    }
+    if (spread && config.numa_node >= 0)
+    {
+      printf("runway: --numa-spread picks the node of each trace and "
+             "cannot be combined\n"
+             "        with --numa-node\n");
+      return EINVAL;
+    }
+    if (!speed_set)
+    {
+      config.speed = BATCH_SPEED;
+    }
+    config.on_event = NULL;
+
+    /* Read the layout and check the placement once up front instead of
+     * failing every trace
+     */
+    if ((sim = runway_create(&config)) == NULL)
+    {
+      printf("runway: invalid configuration, layout or CPU list\n");
+      return 1;
+    }
+    runway_destroy(sim);
+    watching = start_watch(&watch, NULL, config.drain_limit) == 0;
+    result = batch_run(&config, batch_dir, jobs < 1 ? 1 : jobs, format,
+                       spread, stdout);
+    if (watching)
+    {
+      stop_watch(&watch);
+    }
+    fflush(stdout);
+    return result == 0 ? 0 : 1;
+  }
+
+  if (config.soak_hours > 0)
+  {
+    if (optind != nargs || show_results || config.arrivals_only ||
+        config.taxi_slots > 0 || export_prefix != NULL)
+    {
+      printf("runway: -S takes no scenario file and cannot be combined "
+             "with -A, -P, -r or -o\n");
+      return EINVAL;
+    }
+    if (log_file == NULL)
+    {
+      setvbuf(stdout, soak_log, _IOFBF, sizeof(soak_log));
+    }
+  }
+  else if (optind != nargs - 1)
+  {
+    usage();
+    return EINVAL;
+  }
+  if (config.reactor && (config.soak_hours > 0 || config.taxi_slots > 0))
+  {
+    printf("runway: --reactor cannot be combined with -S or -P\n");
+    return EINVAL;
+  }
+  if (spread)
+  {
+    printf("runway: --numa-spread is for batch mode\n");
+    return EINVAL;
+  }
+
+  if (log_file != NULL)
+  {
+    if ((log = runway_writer_open(log_file, log_backend)) == NULL)
+    {
+      printf("runway: cannot write the log to %s%s\n", log_file,
+             log_backend == RUNWAY_WRITER_URING ?
+             " through io_uring" : "");
+      return 1;
+    }
+    config.on_event = runway_writer_event;
+    config.user = log;
+  }
+
+  if ((sim = runway_create(&config)) == NULL)
+  {
+    printf("runway: invalid configuration, layout or CPU list%s\n",
+           config.live_name != NULL ? ", or cannot create the live view" :
+           "");
+    result = -1;
+  }
+  else if (config.soak_hours <= 0 &&
+           runway_load_file(sim, args[optind]) != 0)
+  {
+    if (errno != EINVAL)
+    {
+      printf("Cannot open input file %s for reading.\n", args[optind]);
+    }
+    runway_destroy(sim);
+    sim = NULL;
+    result = -1;
+  }
+  if (sim == NULL)
+  {
+    if (log != NULL)
+    {
+      runway_writer_close(log, NULL);
+    }
+    return 1;
+  }
+
+  watching = start_watch(&watch, sim, config.drain_limit) == 0;
+  result = runway_run(sim);
+  if (watching)
+  {
+    stop_watch(&watch);
+  }
+  if (log != NULL)
+  {
+    if (runway_writer_close(log, &log_stats) != 0)
+    {
+      printf("runway: writing the log to %s failed\n", log_file);
+      result = -1;
+    }
+    if (log_stats.dropped > 0)
+    {
+      fprintf(stderr, "runway: %lld log lines dropped with the disk "
+              "behind\n", log_stats.dropped);
+    }
+  }
+  if (result == 0)
+  {
+    runway_print_summary(sim, stdout);
+    if (show_results)
+    {
+      runway_print_results(sim, stdout);
+    }
+    if (export_prefix != NULL && export_outcomes(sim, export_prefix) != 0)
+    {
+      result = -1;
+    }
+  }
+  fflush(stdout);
+  runway_destroy(sim);
+  return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,433 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "runway.h"
+#include "scenario.h"
+
+#define MAX_TOKENS 8             /* Tokens looked at on one scenario line */
+
+static const char wake_letters[WAKE_CATEGORIES + 1] = "LMHJ";
+
+/* Sort helpers carry the original position so that equal keys keep their
+ * file order.
+ */
+typedef struct
+{
+  scenario_aircraft aircraft;
+  int seq;
+} ordered_aircraft;
+
+typedef struct
+{
+  scenario_event event;
+  int seq;
+} ordered_event;
+
+static int by_arrival(const void *a, const void *b)
+{
+  const ordered_aircraft *x = a;
+  const ordered_aircraft *y = b;
+
+  if (x->aircraft.arrival != y->aircraft.arrival)
+  {
+    return x->aircraft.arrival < y->aircraft.arrival ? -1 : 1;
+  }
+  return x->seq - y->seq;
+}
+
+static int by_time(const void *a, const void *b)
+{
+  const ordered_event *x = a;
+  const ordered_event *y = b;
+
+  if (x->event.time != y->event.time)
+  {
+    return x->event.time < y->event.time ? -1 : 1;
+  }
+  return x->seq - y->seq;
+}
+
+void scenario_compile(scenario *s)
+{
+  ordered_aircraft *aircraft;
+  ordered_event *others;
+  scenario_event *events;
+  int num_others = 0;
+  int i;
+  int a;
+  int o;
+  int n;
+
+  aircraft = malloc(sizeof(ordered_aircraft) * (s->num_aircraft + 1));
+  for (i = 0; i < s->num_aircraft; i++)
+  {
+    aircraft[i].aircraft = s->aircraft[i];
+    aircraft[i].seq = i;
+  }
+  qsort(aircraft, s->num_aircraft, sizeof(ordered_aircraft), by_arrival);
+  for (i = 0; i < s->num_aircraft; i++)
+  {
+    s->aircraft[i] = aircraft[i].aircraft;
+  }
+  free(aircraft);
+
+  others = malloc(sizeof(ordered_event) * (s->num_events + 1));
+  for (i = 0; i < s->num_events; i++)
+  {
+    if (s->events[i].kind != EVENT_ARRIVAL)
+    {
+      others[num_others].event = s->events[i];
+      others[num_others].seq = num_others;
+      num_others++;
+    }
+  }
+  qsort(others, num_others, sizeof(ordered_event), by_time);
+
+  /* Merge; runway events come before arrivals at the same time so that an
+   * aircraft arriving with a closure sees the runway closed.
+   */
+  events = malloc(sizeof(scenario_event) *
+                  (num_others + s->num_aircraft + 1));
+  n = 0;
+  a = 0;
+  o = 0;
+  while (a < s->num_aircraft || o < num_others)
+  {
+    if (o < num_others &&
+        (a >= s->num_aircraft ||
+         others[o].event.time <= s->aircraft[a].arrival))
+    {
+      events[n++] = others[o++].event;
+    }
+    else
+    {
+      events[n].time = s->aircraft[a].arrival;
+      events[n].kind = EVENT_ARRIVAL;
+      events[n].arg = (short)s->aircraft[a].aircraft_type;
+      events[n].aux = a;
+      n++;
+      a++;
+    }
+  }
+
+  free(others);
+  free(s->events);
+  s->events = events;
+  s->num_events = n;
+}
+
+/* Parses the optional "fuel=<s>", "wake=<c>" and "dep" tokens after an
+ * aircraft's runway time.  Anything else is ignored.
+ */
+static void parse_options(scenario_aircraft *a, char **tokens)
+{
+  const char *letter;
+
+  a->fuel_reserve = FUEL_RANDOM;
+  a->wake = WAKE_MEDIUM;
+  a->departure = 0;
+  for (; *tokens != NULL; tokens++)
+  {
+    if (strncmp(*tokens, "fuel=", 5) == 0)
+    {
+      a->fuel_reserve = atoi(*tokens + 5);
+    }
+    else if (strncmp(*tokens, "wake=", 5) == 0 && (*tokens)[5] != '\0' &&
+             (letter = strchr(wake_letters, (*tokens)[5])) != NULL)
+    {
+      a->wake = (int)(letter - wake_letters);
+    }
+    else if (strcmp(*tokens, "dep") == 0)
+    {
+      a->departure = 1;
+    }
+  }
+}
+
+static int is_number(const char *token)
+{
+  char *end;
+
+  if (token == NULL)
+  {
+    return 0;
+  }
+  strtol(token, &end, 10);
+  return end != token && *end == '\0';
+}
+
+static int is_aircraft_type(const char *token)
+{
+  return is_number(token) && atoi(token) >= COMMERCIAL &&
+         atoi(token) <= EMERGENCY;
+}
+
+/* Reads and compiles a scenario from fp.  filename names it in the
+ * messages about skipped lines.
+ */
+static void read_scenario(scenario *s, FILE *fp, const char *filename,
+                          int max_aircraft)
+{
+  char line[256];
+  char *tokens[MAX_TOKENS];
+  char *comment;
+  char *save;
+  int num_tokens;
+  int line_number = 0;
+  int max_events = 64;
+  int previous_arrival = 0;
+  int time;
+  scenario_aircraft *a;
+  scenario_event *e;
+
+  s->aircraft = malloc(sizeof(scenario_aircraft) * (max_aircraft + 1));
+  s->num_aircraft = 0;
+  s->events = malloc(sizeof(scenario_event) * max_events);
+  s->num_events = 0;
+
+  while (fgets(line, sizeof(line), fp) && s->num_aircraft < max_aircraft)
+  {
+    line_number++;
+    if ((comment = strchr(line, '#')) != NULL)
+    {
+      *comment = '\0';
+    }
+
+    num_tokens = 0;
+    for (tokens[0] = strtok_r(line, " \t\r\n", &save);
+         tokens[num_tokens] != NULL && num_tokens < MAX_TOKENS - 1;
+         tokens[num_tokens] = strtok_r(NULL, " \t\r\n", &save))
+    {
+      num_tokens++;
+    }
+    tokens[num_tokens] = NULL;
+    if (num_tokens == 0)
+    {
+      continue;
+    }
+
+    if (tokens[0][0] != '@')
+    {
+      /* Original format: type, delay since previous aircraft, runway time */
+      if (num_tokens >= 3 && is_number(tokens[0]) && is_number(tokens[1]) &&
+          is_number(tokens[2]))
+      {
+        if (!is_aircraft_type(tokens[0]))
+        {
+          fprintf(stderr, "%s:%d: aircraft type must be %d-%d, line "
+                  "skipped\n", filename, line_number, COMMERCIAL, EMERGENCY);
+          continue;
+        }
+        a = &s->aircraft[s->num_aircraft++];
+        a->aircraft_type = atoi(tokens[0]);
+        a->arrival = previous_arrival + atoi(tokens[1]);
+        a->runway_time = atoi(tokens[2]);
+        parse_options(a, &tokens[3]);
+        previous_arrival = a->arrival;
+        continue;
+      }
+      fprintf(stderr, "%s:%d: unrecognized line skipped\n",
+              filename, line_number);
+      continue;
+    }
+
+    if (!is_number(tokens[0] + 1) || num_tokens < 2)
+    {
+      fprintf(stderr, "%s:%d: bad event time, line skipped\n",
+              filename, line_number);
+      continue;
+    }
+    time = atoi(tokens[0] + 1);
+
+    if (is_number(tokens[1]))
+    {
+      if (num_tokens < 3 || !is_number(tokens[2]))
+      {
+        fprintf(stderr, "%s:%d: aircraft needs a runway time, line "
+                "skipped\n", filename, line_number);
+        continue;
+      }
+      if (!is_aircraft_type(tokens[1]))
+      {
+        fprintf(stderr, "%s:%d: aircraft type must be %d-%d, line "
+                "skipped\n", filename, line_number, COMMERCIAL, EMERGENCY);
+        continue;
+      }
+      a = &s->aircraft[s->num_aircraft++];
+      a->aircraft_type = atoi(tokens[1]);
+      a->arrival = time;
+      a->runway_time = atoi(tokens[2]);
+      parse_options(a, &tokens[3]);
+      previous_arrival = a->arrival;
+      continue;
+    }
+
+    if (s->num_events == max_events)
+    {
+      max_events *= 2;
+      s->events = realloc(s->events, sizeof(scenario_event) * max_events);
+    }
+    e = &s->events[s->num_events];
+    e->time = time;
+    e->arg = 0;
+    e->aux = 0;
+    if (strcmp(tokens[1], "capacity") == 0 && is_number(tokens[2]))
+    {
+      e->kind = EVENT_CAPACITY;
+      e->arg = (short)atoi(tokens[2]);
+    }
+    else if (strcmp(tokens[1], "close") == 0)
+    {
+      e->kind = EVENT_CAPACITY;
+      e->arg = 0;
+    }
+    else if (strcmp(tokens[1], "open") == 0)
+    {
+      e->kind = EVENT_CAPACITY;
+      e->arg = MAX_RUNWAY_CAPACITY;
+    }
+    else if (strcmp(tokens[1], "shift") == 0)
+    {
+      e->kind = EVENT_SHIFT;
+      e->aux = is_number(tokens[2]) ? atoi(tokens[2]) : 0;
+    }
+    else if (strcmp(tokens[1], "direction") == 0 && tokens[2] != NULL &&
+             (strcmp(tokens[2], "north") == 0 ||
+              strcmp(tokens[2], "south") == 0))
+    {
+      e->kind = EVENT_DIRECTION;
+      e->arg = strcmp(tokens[2], "north") == 0 ? NORTH : SOUTH;
+    }
+    else
+    {
+      fprintf(stderr, "%s:%d: unknown event '%s', line skipped\n",
+              filename, line_number, tokens[1]);
+      continue;
+    }
+
+    if (e->kind == EVENT_CAPACITY &&
+        (e->arg < 0 || e->arg > MAX_RUNWAY_CAPACITY))
+    {
+      fprintf(stderr, "%s:%d: capacity must be 0-%d, line skipped\n",
+              filename, line_number, MAX_RUNWAY_CAPACITY);
+      continue;
+    }
+    s->num_events++;
+  }
+
+  scenario_compile(s);
+}
+
+int scenario_load(scenario *s, const char *filename, int max_aircraft)
+{
+  FILE *fp;
+
+  if ((fp = fopen(filename, "r")) == NULL)
+  {
+    return -1;
+  }
+  read_scenario(s, fp, filename, max_aircraft);
+  fclose(fp);
+  return 0;
+}
+
+int scenario_load_buffer(scenario *s, const char *text, size_t length,
+                         int max_aircraft)
+{
+  FILE *fp;
+
+  if (length == 0 || (fp = fmemopen((void *)text, length, "r")) == NULL)
+  {
+    return -1;
+  }
+  read_scenario(s, fp, "<buffer>", max_aircraft);
+  fclose(fp);
+  return 0;
+}
+
+void scenario_write(FILE *fp, const scenario *s)
+{
+  const scenario_event *e;
+  const scenario_aircraft *a;
+  int previous_arrival = 0;
+  int i;
+
+  for (i = 0; i < s->num_events; i++)
+  {
+    e = &s->events[i];
+    switch (e->kind)
+    {
+      case EVENT_ARRIVAL:
+        a = &s->aircraft[e->aux];
+        fprintf(fp, "%d %d %d", a->aircraft_type,
+                a->arrival - previous_arrival, a->runway_time);
+        if (a->fuel_reserve != FUEL_RANDOM)
+        {
+          fprintf(fp, " fuel=%d", a->fuel_reserve);
+        }
+        if (a->wake != WAKE_MEDIUM)
+        {
+          fprintf(fp, " wake=%c", wake_letters[a->wake]);
+        }
+        if (a->departure)
+        {
+          fprintf(fp, " dep");
+        }
+        fprintf(fp, "\n");
+        previous_arrival = a->arrival;
+        break;
+      case EVENT_CAPACITY:
+        fprintf(fp, "@%d capacity %d\n", e->time, e->arg);
+        break;
+      case EVENT_SHIFT:
+        fprintf(fp, "@%d shift %d\n", e->time, e->aux);
+        break;
+      case EVENT_DIRECTION:
+        fprintf(fp, "@%d direction %s\n", e->time,
+                e->arg == NORTH ? "north" : "south");
+        break;
+    }
+  }
+}
+
+void scenario_copy(scenario *dst, const scenario *src)
+{
+  dst->num_aircraft = src->num_aircraft;
+  dst->aircraft = malloc(sizeof(scenario_aircraft) *
+                         (src->num_aircraft + 1));
+  memcpy(dst->aircraft, src->aircraft,
+         sizeof(scenario_aircraft) * src->num_aircraft);
+  dst->num_events = src->num_events;
+  dst->events = malloc(sizeof(scenario_event) * (src->num_events + 1));
+  memcpy(dst->events, src->events,
+         sizeof(scenario_event) * src->num_events);
+}
+
+void scenario_free(scenario *s)
+{
+  free(s->aircraft);
+  free(s->events);
+  s->aircraft = NULL;
+  s->events = NULL;
+  s->num_aircraft = 0;
+  s->num_events = 0;
+}
@@ -0,0 +1,109 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Scenario files: aircraft traces plus scheduled runway events.
+ *
+ * A scenario file is a superset of the original trace format.  Lines are
+ * one of:
+ *
+ *   <type> <delay> <runway_time> [fuel=<s>] [wake=L|M|H|J] [dep]
+ *                                             aircraft, delay relative to
+ *                                             the previous aircraft
+ *   @<t> <type> <runway_time> [fuel=<s>] [wake=L|M|H|J] [dep]
+ *                                             aircraft arriving at time t
+ *   @<t> capacity <n>                         runway capacity becomes n
+ *   @<t> close                                same as capacity 0
+ *   @<t> open                                 full capacity again
+ *   @<t> shift [<handover>]                   controller shift change
+ *   @<t> direction north|south                runway direction change
+ *
+ * Times are whole seconds from the start of the run.  Without fuel= the
+ * fuel reserve is drawn at random when the run starts.  wake= sets the
+ * wake-turbulence category (light, medium, heavy or super), medium if
+ * absent.  "dep" makes the aircraft a departure that reaches the runway
+ * hold point at that time.  Everything after
+ * a '#' is a comment.
+ *
+ * Loading compiles the file into a flat array of events sorted by time
+ * that the simulators walk in order without looking at the text again.
+ */
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <stdio.h>
+
+#define EVENT_ARRIVAL 0          /* aircraft arg arrives or is ready to depart;
+                                    aux = aircraft index */
+#define EVENT_CAPACITY 1         /* runway capacity becomes arg */
+#define EVENT_SHIFT 2            /* controller shift change; aux = handover time */
+#define EVENT_DIRECTION 3        /* runway direction must become arg */
+
+#define FUEL_RANDOM -1           /* fuel reserve is drawn when the run starts */
+
+typedef struct
+{
+  int aircraft_type;        /* COMMERCIAL, CARGO, or EMERGENCY */
+  int arrival;              /* absolute arrival time in seconds */
+  int runway_time;          /* time the aircraft needs on the runway */
+  int fuel_reserve;         /* fuel reserve in seconds, or FUEL_RANDOM */
+  int wake;                 /* WAKE_* category */
+  int departure;            /* non-zero for a departure */
+} scenario_aircraft;
+
+typedef struct
+{
+  int time;                 /* absolute time in seconds */
+  short kind;               /* EVENT_* */
+  short arg;                /* aircraft type, capacity or direction */
+  int aux;                  /* aircraft index or handover time */
+} scenario_event;
+
+typedef struct
+{
+  scenario_aircraft *aircraft;   /* sorted by arrival */
+  int num_aircraft;
+  scenario_event *events;        /* sorted by time, arrivals last */
+  int num_events;
+} scenario;
+
+/* Reads and compiles a scenario file, keeping at most max_aircraft
+ * aircraft.  Returns 0 on success or -1 with errno set if the file cannot
+ * be opened.  Unrecognized lines are reported on stderr and skipped.
+ */
+int scenario_load(scenario *s, const char *filename, int max_aircraft);
+
+/* Same as scenario_load() for length bytes of scenario text.  Returns -1
+ * if the text is empty.
+ */
+int scenario_load_buffer(scenario *s, const char *text, size_t length,
+                         int max_aircraft);
+
+/* Builds the event array from s->aircraft plus the non-arrival events
+ * already in s->events, sorting both.  Used by code that constructs
+ * scenarios in memory.
+ */
+void scenario_compile(scenario *s);
+
+/* Writes the scenario in the file format above.  Aircraft are written as
+ * relative lines, so files without events stay in the original format.
+ */
+void scenario_write(FILE *fp, const scenario *s);
+
+void scenario_copy(scenario *dst, const scenario *src);
+void scenario_free(scenario *s);
+
+#endif
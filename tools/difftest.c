@@ -0,0 +1,793 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* runway-difftest: differential testing of the threaded simulator against
+ * the reference model.
+ *
+ * Generates random traces, runs each one on the simulator through
+ * librunway (seeded, fast clock, many runs at a time) and through
+ * model_run() with the same fuel reserves, and compares admission order,
+ * per-aircraft admission and clearance times, directions and fuel
+ * emergencies, and the aggregate metrics.  Where the two disagree, the
+ * model is run again with the ties the rules leave open at one instant
+ * broken other ways (model_run_ties()); a trace only fails if no order
+ * the rules allow agrees with the simulator.  The first divergence of the
+ * model's own run is reported for every failing trace.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include "librunway.h"
+#include "runway.h"
+#include "scenario.h"
+#include "model.h"
+
+#define POLL_INTERVAL 10000000L  /* Watchdog polling interval in nanoseconds */
+#define DIFF_STALL 120           /* Simulated seconds aircraft may wait at an
+                                    empty runway before a run is abandoned;
+                                    well past any fuel emergency */
+#define TIE_RUNS 2000            /* Model runs spent on other tie orders */
+#define JOBS_PER_CPU 64          /* Default simulations at a time per CPU */
+
+#define AGREED 0                 /* the runs agree */
+#define DIVERGED 1               /* the runway did not follow the rules */
+#define DEADLOCKED 2             /* it stalled where the rules deadlock */
+
+static double speed = 100;
+static int num_traces = 100;
+static int trace_length = 20;
+static unsigned int base_seed = 1;
+static double tolerance = 1.5;  /* allowed timestamp difference, seconds */
+static double timeout = 30;     /* wall-clock seconds per runway run */
+static int jobs = 1;
+static const char *keep_path = NULL;
+static int verbose = 0;
+static int with_events = 0;     /* add closures and shift changes */
+
+/* One generated trace and everything known about its two runs */
+typedef struct
+{
+  unsigned int seed;
+  scenario sc;
+
+  runway_sim *sim;          /* while it runs */
+  struct timespec started;
+  int timed_out;
+  int finished;             /* runway_run() returned 0 */
+  runway_outcome *outcomes;
+  runway_metrics metrics;
+  int *order;               /* the runway's admissions in order */
+  int admitted;
+
+  /* The model run being compared */
+  model_result *ref;
+  int *ref_order;
+  model_metrics ref_metrics;
+  int runs_left;            /* model runs left for other tie orders */
+} test_case;
+
+/* The traces and the workers running them */
+typedef struct
+{
+  test_case *cases;
+  int next;                 /* next trace to start */
+  int done;
+  int divergent;
+  int deadlocked;
+  int reordered;            /* agreed only with ties broken another way */
+  pthread_mutex_t mutex;    /* guards the above, the running simulations
+                               and the output */
+} run_queue;
+
+static double elapsed_since(struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Random scenario with a mix of all aircraft types, bursty arrivals and
+ * explicit fuel reserves, optionally with runway capacity dips, closures,
+ * controller shift changes and ordered direction changes.
+ */
+static void generate(test_case *tc)
+{
+  unsigned int state = tc->seed;
+  scenario *sc = &tc->sc;
+  scenario_event *e;
+  int now = 0;
+  int i;
+  int r;
+  int start;
+
+  sc->num_aircraft = trace_length;
+  sc->aircraft = calloc(trace_length + 1, sizeof(scenario_aircraft));
+  sc->events = calloc(8, sizeof(scenario_event));
+  sc->num_events = 0;
+  for (i = 0; i < trace_length; i++)
+  {
+    r = rand_r(&state) % 100;
+    sc->aircraft[i].aircraft_type = r < 45 ? COMMERCIAL
+                                  : r < 85 ? CARGO : EMERGENCY;
+    now += i == 0 ? 0 : rand_r(&state) % 7;
+    sc->aircraft[i].arrival = now;
+    sc->aircraft[i].runway_time = 1 + rand_r(&state) % 8;
+    sc->aircraft[i].wake = WAKE_MEDIUM;
+    sc->aircraft[i].fuel_reserve = FUEL_MIN +
+                                   rand_r(&state) % (FUEL_MAX - FUEL_MIN + 1);
+  }
+
+  if (with_events)
+  {
+    /* A capacity dip or closure, and maybe a shift change */
+    start = rand_r(&state) % (now + 1);
+    e = &sc->events[sc->num_events++];
+    e->time = start;
+    e->kind = EVENT_CAPACITY;
+    e->arg = (short)(rand_r(&state) % MAX_RUNWAY_CAPACITY);
+    e = &sc->events[sc->num_events++];
+    e->time = start + 3 + rand_r(&state) % 13;
+    e->kind = EVENT_CAPACITY;
+    e->arg = MAX_RUNWAY_CAPACITY;
+    if (rand_r(&state) % 2)
+    {
+      e = &sc->events[sc->num_events++];
+      e->time = rand_r(&state) % (now + 1);
+      e->kind = EVENT_SHIFT;
+      e->aux = rand_r(&state) % 4;
+    }
+    if (rand_r(&state) % 2)
+    {
+      e = &sc->events[sc->num_events++];
+      e->time = rand_r(&state) % (now + 1);
+      e->kind = EVENT_DIRECTION;
+      e->arg = rand_r(&state) % 2 ? NORTH : SOUTH;
+    }
+  }
+
+  scenario_compile(sc);
+}
+
+/* Runs the trace on the simulator and keeps its outcomes.  The simulation
+ * is published in the test case while it runs so that the watchdog can
+ * stop it.  Returns 0, or -1 if it could not be run.
+ */
+static int simulate(run_queue *q, test_case *tc)
+{
+  runway_config config;
+  runway_sim *sim;
+  char *text;
+  size_t length;
+  FILE *fp;
+  long count = tc->sc.num_aircraft;
+  int result = -1;
+
+  if ((fp = open_memstream(&text, &length)) == NULL)
+  {
+    return -1;
+  }
+  scenario_write(fp, &tc->sc);
+  fclose(fp);
+
+  runway_config_defaults(&config);
+  config.seed = tc->seed;
+  config.speed = speed;
+  config.stall_limit = DIFF_STALL;
+  if ((sim = runway_create(&config)) == NULL)
+  {
+    free(text);
+    return -1;
+  }
+  if (runway_load_buffer(sim, text, length) == 0)
+  {
+    pthread_mutex_lock(&q->mutex);
+    tc->sim = sim;
+    clock_gettime(CLOCK_MONOTONIC, &tc->started);
+    pthread_mutex_unlock(&q->mutex);
+
+    tc->finished = runway_run(sim) == 0;
+
+    pthread_mutex_lock(&q->mutex);
+    tc->sim = NULL;
+    pthread_mutex_unlock(&q->mutex);
+    tc->outcomes = calloc(count, sizeof(runway_outcome));
+    if (runway_get_outcomes(sim, tc->outcomes, count) == count)
+    {
+      runway_get_metrics(sim, &tc->metrics);
+      result = 0;
+    }
+  }
+  runway_destroy(sim);
+  free(text);
+  return result;
+}
+
+/* Lists the aircraft the runway admitted in the order it admitted them.
+ * Once a run is abandoned, the aircraft that look at the rules and give
+ * up make room for others, which may then get in: admissions that come
+ * about DIFF_STALL seconds after the runway was last in use are part of
+ * giving up, and count as never admitted.
+ */
+static void admission_order(test_case *tc)
+{
+  runway_outcome *out = tc->outcomes;
+  int count = tc->sc.num_aircraft;
+  double in_use = 0;
+  int id;
+  int j;
+  int k;
+
+  tc->order = malloc(sizeof(int) * (count + 1));
+  tc->admitted = 0;
+  for (k = 0; k < count; k++)
+  {
+    if (out[k].admitted_at < 0)
+    {
+      continue;
+    }
+    for (j = tc->admitted; j > 0 &&
+         out[tc->order[j - 1]].admitted_at > out[k].admitted_at; j--)
+    {
+      tc->order[j] = tc->order[j - 1];
+    }
+    tc->order[j] = k;
+    tc->admitted++;
+  }
+
+  for (k = 0; k < tc->admitted && tc->metrics.gave_up > 0; k++)
+  {
+    id = tc->order[k];
+    if (out[id].admitted_at - in_use >= DIFF_STALL - tolerance)
+    {
+      for (j = k; j < tc->admitted; j++)
+      {
+        out[tc->order[j]].admitted_at = -1;
+        out[tc->order[j]].cleared_at = -1;
+      }
+      tc->admitted = k;
+    }
+    else if (out[id].cleared_at > in_use)
+    {
+      in_use = out[id].cleared_at;
+    }
+  }
+}
+
+/* Keeps the earliest difference found so far, with its description. */
+static void note(double *first, double at, char *report, size_t size,
+                 const char *format, ...)
+{
+  va_list args;
+
+  if (at >= *first)
+  {
+    return;
+  }
+  *first = at;
+  if (report != NULL)
+  {
+    va_start(args, format);
+    vsnprintf(report, size, format, args);
+    va_end(args);
+  }
+}
+
+/* Compares the runway's run with the model run in tc->ref.  Returns the
+ * model time of the earliest difference, described in report if that is
+ * not NULL, or -1 if the runs agree.  Aircraft the model admits at the
+ * same instant may be admitted in any order.  A run abandoned where the
+ * rules deadlock has no makespan or fuel emergency count to compare.
+ */
+static double difference(const test_case *tc, char *report, size_t size)
+{
+  const runway_outcome *sim = tc->outcomes;
+  const model_result *ref = tc->ref;
+  const model_metrics *mm = &tc->ref_metrics;
+  const runway_metrics *rm = &tc->metrics;
+  double first = HUGE_VAL;
+  double end = mm->makespan > rm->makespan ? mm->makespan : rm->makespan;
+  int count = tc->sc.num_aircraft;
+  int a;
+  int b;
+  int i;
+  int k;
+
+  for (i = 0; i < count; i++)
+  {
+    if ((sim[i].admitted_at < 0) != (ref[i].admitted_at < 0))
+    {
+      note(&first, sim[i].admitted_at < 0 ? ref[i].admitted_at
+                                          : sim[i].admitted_at,
+           report, size, "aircraft %d: runway admitted it at %.2f, "
+           "model at %.2f (-1: never)", i, sim[i].admitted_at,
+           ref[i].admitted_at);
+    }
+    else if (sim[i].admitted_at < 0)
+    {
+      continue;
+    }
+    else if (fabs(sim[i].admitted_at - ref[i].admitted_at) > tolerance)
+    {
+      note(&first, fmin(sim[i].admitted_at, ref[i].admitted_at), report,
+           size, "aircraft %d: runway admitted it at %.2f, model at %.2f",
+           i, sim[i].admitted_at, ref[i].admitted_at);
+    }
+    else if (fabs(sim[i].cleared_at - ref[i].cleared_at) > tolerance)
+    {
+      note(&first, ref[i].admitted_at, report, size, "aircraft %d: "
+           "runway cleared it at %.2f, model at %.2f", i,
+           sim[i].cleared_at, ref[i].cleared_at);
+    }
+    else if (sim[i].direction != ref[i].direction)
+    {
+      note(&first, ref[i].admitted_at, report, size, "aircraft %d: "
+           "runway admitted it in direction %d, model in %d", i,
+           sim[i].direction, ref[i].direction);
+    }
+    else if ((sim[i].fuel_emergency != 0) != (ref[i].fuel_emergency != 0))
+    {
+      note(&first, ref[i].admitted_at, report, size, "aircraft %d: "
+           "runway fuel emergency %d, model %d", i,
+           sim[i].fuel_emergency != 0, ref[i].fuel_emergency != 0);
+    }
+  }
+
+  for (k = 1; k < tc->admitted; k++)
+  {
+    a = tc->order[k - 1];
+    b = tc->order[k];
+    if (ref[a].admitted_at > ref[b].admitted_at && ref[b].admitted_at >= 0)
+    {
+      note(&first, ref[b].admitted_at, report, size, "runway admitted "
+           "aircraft %d before %d, model at %.2f after %.2f", a, b,
+           ref[a].admitted_at, ref[b].admitted_at);
+    }
+  }
+
+  if (rm->direction_switches != mm->direction_switches ||
+      rm->controller_breaks != mm->controller_breaks ||
+      rm->controller_shifts != mm->controller_shifts)
+  {
+    note(&first, end, report, size, "runway switches %d breaks %d shifts "
+         "%d, model %d %d %d", rm->direction_switches,
+         rm->controller_breaks, rm->controller_shifts,
+         mm->direction_switches, mm->controller_breaks,
+         mm->controller_shifts);
+  }
+  if (rm->gave_up == 0 && rm->fuel_emergencies != mm->fuel_emergencies)
+  {
+    note(&first, end, report, size, "runway fuel emergencies %d, model %d",
+         rm->fuel_emergencies, mm->fuel_emergencies);
+  }
+  if (rm->gave_up == 0 && fabs(rm->makespan - mm->makespan) > tolerance)
+  {
+    note(&first, end, report, size, "runway makespan %.2f, model %.2f",
+         rm->makespan, mm->makespan);
+  }
+
+  return first < HUGE_VAL ? first : -1;
+}
+
+/* Runs the model with the first fixed ties broken as ties says and
+ * compares it with the runway.  Returns the model time of the first
+ * difference, as difference() does.
+ */
+static double try_ties(test_case *tc, model_ties *ties, int fixed,
+                       char *report, size_t size)
+{
+  int i;
+
+  ties->num_fixed = fixed;
+  memset(tc->ref, 0, sizeof(model_result) * tc->sc.num_aircraft);
+  for (i = 0; i < tc->sc.num_aircraft; i++)
+  {
+    tc->ref[i].admitted_at = -1;
+  }
+  model_run_ties(&tc->sc, ties, tc->ref, tc->ref_order, &tc->ref_metrics);
+  tc->runs_left--;
+  return difference(tc, report, size);
+}
+
+/* One tie broken another way, and the first difference that makes */
+typedef struct
+{
+  int tie;
+  int way;
+  double at;
+} tie_flip;
+
+static int by_later_difference(const void *a, const void *b)
+{
+  const tie_flip *fa = (const tie_flip *)a;
+  const tie_flip *fb = (const tie_flip *)b;
+
+  if (fa->at != fb->at)
+  {
+    return fa->at > fb->at ? -1 : 1;
+  }
+  return fa->tie - fb->tie;
+}
+
+/* Looks for a way to break the ties from fixed on that agrees with the
+ * runway, given a run with ties that first differs at.  Every other way
+ * to break each tie up to that difference is tried, and the search goes
+ * on from those that agree the longest first, as long as model runs are
+ * left.  Returns 1 once a run agrees.
+ */
+static int explore(test_case *tc, const model_ties *ties, int fixed,
+                   double at)
+{
+  model_ties *other = malloc(sizeof(model_ties));
+  tie_flip *flips = NULL;
+  int num_flips = 0;
+  int found = 0;
+  int way;
+  int j;
+
+  for (j = fixed; j < ties->num_ties && !found; j++)
+  {
+    for (way = 1; way < ties->ways[j] && ties->at[j] <= at && !found &&
+         tc->runs_left > 0; way++)
+    {
+      *other = *ties;
+      other->choice[j] = way;
+      flips = realloc(flips, sizeof(tie_flip) * (num_flips + 1));
+      flips[num_flips].tie = j;
+      flips[num_flips].way = way;
+      flips[num_flips].at = try_ties(tc, other, j + 1, NULL, 0);
+      found = flips[num_flips++].at < 0;
+    }
+  }
+
+  if (!found)
+  {
+    qsort(flips, num_flips, sizeof(tie_flip), by_later_difference);
+  }
+  for (j = 0; j < num_flips && !found && tc->runs_left > 0; j++)
+  {
+    *other = *ties;
+    other->choice[flips[j].tie] = flips[j].way;
+    at = try_ties(tc, other, flips[j].tie + 1, NULL, 0);
+    found = at < 0 || explore(tc, other, flips[j].tie + 1, at);
+  }
+  free(flips);
+  free(other);
+  return found;
+}
+
+/* Prints both admission tables side by side, the model's own run. */
+static void print_tables(test_case *tc)
+{
+  int count = tc->sc.num_aircraft;
+  model_metrics metrics;
+  int a;
+  int b;
+  int k;
+
+  for (k = 0; k < count; k++)
+  {
+    tc->ref[k].admitted_at = -1;
+    tc->ref_order[k] = -1;
+  }
+  model_run(&tc->sc, tc->ref, tc->ref_order, &metrics);
+  printf("  rank  runway: id  admitted   cleared  |  model: id  admitted"
+         "   cleared\n");
+  for (k = 0; k < count; k++)
+  {
+    a = k < tc->admitted ? tc->order[k] : -1;
+    b = tc->ref_order[k];
+    printf("  %4d  ", k);
+    if (a >= 0)
+    {
+      printf("%10d %9.2f %9.2f  |", a, tc->outcomes[a].admitted_at,
+             tc->outcomes[a].cleared_at);
+    }
+    else
+    {
+      printf("%30s  |", "");
+    }
+    if (b >= 0)
+    {
+      printf(" %10d %9.2f %9.2f", b, tc->ref[b].admitted_at,
+             tc->ref[b].cleared_at);
+    }
+    printf("\n");
+  }
+}
+
+/* Compares the two runs and writes the first divergence into report.
+ * Returns AGREED, DIVERGED, or DEADLOCKED if the runway was abandoned
+ * where the rules deadlock.  reordered is set if only another tie order
+ * of the model agreed.
+ */
+static int compare(test_case *tc, int *reordered, char *report,
+                   size_t size)
+{
+  int count = tc->sc.num_aircraft;
+  model_ties *ties = malloc(sizeof(model_ties));
+  double at;
+  int result = DIVERGED;
+
+  *reordered = 0;
+  tc->ref = malloc(sizeof(model_result) * (count + 1));
+  tc->ref_order = malloc(sizeof(int) * (count + 1));
+  if (tc->timed_out)
+  {
+    snprintf(report, size, "runway did not finish in %.0f s", timeout);
+  }
+  else if (!tc->finished && tc->metrics.gave_up == 0)
+  {
+    snprintf(report, size, "runway run failed");
+  }
+  else
+  {
+    admission_order(tc);
+    tc->runs_left = TIE_RUNS;
+    ties->num_ties = 0;
+    at = try_ties(tc, ties, 0, report, size);
+    if (at < 0 || explore(tc, ties, 0, at))
+    {
+      *reordered = tc->runs_left < TIE_RUNS - 1;
+      result = tc->metrics.gave_up > 0 ? DEADLOCKED : AGREED;
+      if (result == DEADLOCKED)
+      {
+        snprintf(report, size, "runway gave up after %d s without "
+                 "an admission, the model deadlocks too", DIFF_STALL);
+      }
+    }
+  }
+  free(ties);
+  return result;
+}
+
+static void keep_trace(test_case *tc, const char *report)
+{
+  FILE *fp;
+
+  if ((fp = fopen(keep_path, "w")) == NULL)
+  {
+    perror("runway-difftest");
+    return;
+  }
+  fprintf(fp, "# Diverging trace found by runway-difftest (seed %u)\n",
+          tc->seed);
+  fprintf(fp, "# %s\n", report);
+  fprintf(fp, "# Reproduce with: runway -s %u -x %g -r <this file>\n\n",
+          tc->seed, speed);
+  scenario_write(fp, &tc->sc);
+  fclose(fp);
+  keep_path = NULL;
+}
+
+static void free_case(test_case *tc)
+{
+  scenario_free(&tc->sc);
+  free(tc->outcomes);
+  free(tc->order);
+  free(tc->ref);
+  free(tc->ref_order);
+  tc->outcomes = NULL;
+  tc->order = NULL;
+  tc->ref = NULL;
+  tc->ref_order = NULL;
+}
+
+/* Code for one worker: runs and checks traces until none are left. */
+static void * difftest_worker(void *arg)
+{
+  run_queue *q = (run_queue *)arg;
+  test_case *tc;
+  char report[256];
+  int reordered;
+  int result;
+  int i;
+
+  while (1)
+  {
+    pthread_mutex_lock(&q->mutex);
+    i = q->next < num_traces ? q->next++ : -1;
+    pthread_mutex_unlock(&q->mutex);
+    if (i < 0)
+    {
+      break;
+    }
+
+    tc = &q->cases[i];
+    tc->seed = base_seed + (unsigned int)i;
+    generate(tc);
+    if (simulate(q, tc) != 0)
+    {
+      snprintf(report, sizeof(report), "runway could not run the trace");
+      result = DIVERGED;
+      reordered = 0;
+    }
+    else
+    {
+      result = compare(tc, &reordered, report, sizeof(report));
+    }
+
+    pthread_mutex_lock(&q->mutex);
+    q->divergent += result == DIVERGED;
+    q->deadlocked += result == DEADLOCKED;
+    q->reordered += reordered;
+    if (result != AGREED)
+    {
+      printf("trace %d (seed %u): %s\n", i, tc->seed, report);
+      if (result == DIVERGED && verbose && tc->order != NULL)
+      {
+        print_tables(tc);
+      }
+      if (result == DIVERGED && keep_path)
+      {
+        keep_trace(tc, report);
+      }
+      fflush(stdout);
+    }
+    q->done++;
+    pthread_mutex_unlock(&q->mutex);
+    free_case(tc);
+  }
+  return NULL;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: runway-difftest [options]\n"
+    "  -n traces    number of random traces (default: 100)\n"
+    "  -a aircraft  aircraft per trace (default: 20)\n"
+    "  -E           add capacity, shift and direction changes to the traces\n"
+    "  -S seed      seed of the first trace (default: 1)\n"
+    "  -e seconds   timestamp tolerance (default: 1.5)\n"
+    "  -x speed     simulator clock speed (default: 100)\n"
+    "  -t seconds   wall-clock limit per run (default: 30)\n"
+    "  -j runs      simulations at a time (default: %d per online CPU)\n"
+    "  -k file      save the first diverging trace to file\n"
+    "  -v           print both admission tables for diverging traces\n",
+    JOBS_PER_CPU);
+}
+
+int main(int nargs, char **args)
+{
+  run_queue q;
+  pthread_t *workers;
+  struct timespec started;
+  struct timespec pause = { 0, POLL_INTERVAL };
+  int started_workers;
+  int opt;
+  int i;
+  double seconds;
+
+  jobs = JOBS_PER_CPU * (int)sysconf(_SC_NPROCESSORS_ONLN);
+  while ((opt = getopt(nargs, args, "n:a:ES:e:x:t:j:k:v")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n':
+        num_traces = atoi(optarg);
+        break;
+      case 'a':
+        trace_length = atoi(optarg);
+        break;
+      case 'E':
+        with_events = 1;
+        break;
+      case 'S':
+        base_seed = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'e':
+        tolerance = atof(optarg);
+        break;
+      case 'x':
+        speed = atof(optarg);
+        break;
+      case 't':
+        timeout = atof(optarg);
+        break;
+      case 'j':
+        jobs = atoi(optarg);
+        break;
+      case 'k':
+        keep_path = optarg;
+        break;
+      case 'v':
+        verbose = 1;
+        break;
+      default:
+        usage();
+        return EINVAL;
+    }
+  }
+  if (optind != nargs || num_traces < 1 || trace_length < 1 ||
+      trace_length > MAX_AIRCRAFT || speed <= 0)
+  {
+    usage();
+    return EINVAL;
+  }
+  if (jobs < 1)
+  {
+    jobs = 1;
+  }
+  if (jobs > num_traces)
+  {
+    jobs = num_traces;
+  }
+
+  memset(&q, 0, sizeof(q));
+  q.cases = calloc(num_traces, sizeof(test_case));
+  pthread_mutex_init(&q.mutex, NULL);
+  workers = malloc(sizeof(pthread_t) * jobs);
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  for (started_workers = 0; started_workers < jobs; started_workers++)
+  {
+    if (pthread_create(&workers[started_workers], NULL, difftest_worker,
+                       &q))
+    {
+      break;
+    }
+  }
+  if (started_workers == 0)
+  {
+    fprintf(stderr, "runway-difftest: cannot start a worker\n");
+    return 1;
+  }
+
+  /* Watchdog: runs that take too long are aborted and reported */
+  pthread_mutex_lock(&q.mutex);
+  while (q.done < num_traces)
+  {
+    for (i = 0; i < num_traces; i++)
+    {
+      if (q.cases[i].sim != NULL && !q.cases[i].timed_out &&
+          elapsed_since(&q.cases[i].started) > timeout)
+      {
+        q.cases[i].timed_out = 1;
+        runway_stop(q.cases[i].sim, RUNWAY_STOP_ABORT);
+      }
+    }
+    pthread_mutex_unlock(&q.mutex);
+    nanosleep(&pause, NULL);
+    pthread_mutex_lock(&q.mutex);
+  }
+  pthread_mutex_unlock(&q.mutex);
+  for (i = 0; i < started_workers; i++)
+  {
+    pthread_join(workers[i], NULL);
+  }
+
+  seconds = elapsed_since(&started);
+  printf("%d traces, %d divergent, %d deadlocked by the rules, %d agreed "
+         "with ties broken another way, %.1f s (%.0f traces per minute)\n",
+         num_traces, q.divergent, q.deadlocked, q.reordered, seconds,
+         num_traces * 60.0 / seconds);
+
+  pthread_mutex_destroy(&q.mutex);
+  free(workers);
+  free(q.cases);
+  return q.divergent ? 1 : 0;
+}
@@ -0,0 +1,449 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* runway-estimate: instant wait and utilization estimates for planning.
+ *
+ * Prints the analytical estimate of estimate.c for arrival rates and a
+ * runway time range given on the command line, or for the traffic of a
+ * trace.  With -V it validates the estimate instead: a grid of arrival
+ * rates and commercial/cargo mixes is generated as Poisson traffic, each
+ * point is run on the reference model (or, with -x, on the threaded
+ * simulator) for several seeds, and the estimated and simulated mean
+ * waits and runway occupancy are printed side by side with the points
+ * where the estimate is within tolerance marked.  The grid is run twice:
+ * with fuel reserves drawn as the simulator draws them, and with fuel to
+ * spare, since the estimate leaves fuel emergencies out.
+ */
+
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+
+#include "librunway.h"
+#include "runway.h"
+#include "scenario.h"
+#include "model.h"
+#include "estimate.h"
+
+#define GRID_RATES 10            /* arrival rates in the grid */
+#define GRID_RATE_STEP 60        /* arrivals per hour between them */
+#define GRID_MIXES 3
+#define GRID_FUELS 2
+#define EMERGENCY_SHARE 0.05     /* share of emergencies in the grid */
+#define TRUST_RELATIVE 0.25      /* estimate within 25% ... */
+#define TRUST_ABSOLUTE 2.0       /* ... or 2 s of the simulated wait */
+#define AMPLE_FUEL 86400         /* fuel reserve that never runs out */
+
+static const double grid_mixes[GRID_MIXES] = { 0.5, 0.75, 1.0 };
+static const char *fuel_names[GRID_FUELS] = { "drawn", "ample" };
+
+static int runway_min = 8;
+static int runway_max = 15;
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: runway-estimate [-c rate] [-g rate] [-e rate] [-t min:max]\n"
+    "       runway-estimate <trace file>\n"
+    "       runway-estimate -V [-n aircraft] [-r seeds] [-x speed] "
+    "[-t min:max]\n"
+    "  -c rate      commercial arrivals per hour (default: 120)\n"
+    "  -g rate      cargo arrivals per hour (default: 120)\n"
+    "  -e rate      emergency arrivals per hour (default: 0)\n"
+    "  -t min:max   runway times, uniform whole seconds (default: 8:15)\n"
+    "  -V           check the estimate against simulation over a grid\n"
+    "  -n aircraft  aircraft per simulated trace (default: 1000)\n"
+    "  -r seeds     traces per grid point (default: 3)\n"
+    "  -x speed     simulate on librunway at this clock speed instead of "
+    "the\n"
+    "               reference model\n");
+}
+
+/* Fills in the runway time moments of the uniform range. */
+static void uniform_runway(estimate_input *in)
+{
+  int t;
+
+  in->runway_mean = 0;
+  in->runway_square = 0;
+  for (t = runway_min; t <= runway_max; t++)
+  {
+    in->runway_mean += t;
+    in->runway_square += (double)t * t;
+  }
+  in->runway_mean /= runway_max - runway_min + 1;
+  in->runway_square /= runway_max - runway_min + 1;
+}
+
+static void print_estimate(const estimate_input *in)
+{
+  estimate_result r;
+
+  printf("Arrivals per hour: %.1f commercial, %.1f cargo, %.1f emergency\n",
+         in->rate[COMMERCIAL] * 3600, in->rate[CARGO] * 3600,
+         in->rate[EMERGENCY] * 3600);
+  printf("Runway time: mean %.2f s, standard deviation %.2f s\n",
+         in->runway_mean,
+         sqrt(in->runway_square - in->runway_mean * in->runway_mean));
+  if (estimate_run(in, &r) != 0)
+  {
+    printf("Saturated: slot utilization %.0f%%, %.0f%% with switches and "
+           "breaks\n", r.utilization * 100, r.load * 100);
+    return;
+  }
+  printf("Slot utilization: %.1f%% (%.1f%% with switches and breaks)\n",
+         r.utilization * 100, r.load * 100);
+  printf("Runway occupied: %.1f%%\n", r.occupied * 100);
+  printf("Mean wait: %.2f s (commercial %.2f s, cargo %.2f s, emergency "
+         "%.2f s)\n", r.average_wait, r.wait[COMMERCIAL], r.wait[CARGO],
+         r.wait[EMERGENCY]);
+  printf("Direction switches: %.1f per hour\n", r.switches_per_hour);
+  printf("Controller breaks: %.1f per hour\n", r.breaks_per_hour);
+}
+
+/* Poisson arrivals at rate per hour, with the given share of commercial
+ * among the regular aircraft, and fuel reserves drawn or to spare.
+ */
+static void generate(scenario *sc, int count, double rate, double mix,
+                     int ample, unsigned int seed)
+{
+  unsigned int state = seed;
+  double now = 0;
+  double u;
+  scenario_aircraft *a;
+  int i;
+
+  sc->aircraft = calloc(count + 1, sizeof(scenario_aircraft));
+  sc->events = calloc(1, sizeof(scenario_event));
+  sc->num_aircraft = count;
+  sc->num_events = 0;
+  for (i = 0; i < count; i++)
+  {
+    u = (rand_r(&state) + 1.0) / ((double)RAND_MAX + 2.0);
+    now += -log(u) * 3600 / rate;
+    a = &sc->aircraft[i];
+    a->arrival = (int)now;
+    u = rand_r(&state) / ((double)RAND_MAX + 1.0);
+    a->aircraft_type = u < EMERGENCY_SHARE ? EMERGENCY
+                     : u < EMERGENCY_SHARE + (1 - EMERGENCY_SHARE) * mix ?
+                       COMMERCIAL : CARGO;
+    a->runway_time = runway_min +
+                     rand_r(&state) % (runway_max - runway_min + 1);
+    a->fuel_reserve = FUEL_MIN +
+                      rand_r(&state) % (FUEL_MAX - FUEL_MIN + 1);
+    if (ample)
+    {
+      a->fuel_reserve = AMPLE_FUEL;
+    }
+    a->wake = WAKE_MEDIUM;
+  }
+  scenario_compile(sc);
+}
+
+/* Share of the makespan with an aircraft on the runway. */
+static double occupied(const model_result *results, const int *order,
+                       int count, double makespan)
+{
+  const model_result *r;
+  double busy = 0;
+  double start = 0;
+  double end = -1;
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    r = &results[order[i]];
+    if (r->admitted_at > end)
+    {
+      busy += end - start;
+      start = r->admitted_at;
+    }
+    if (r->cleared_at > end)
+    {
+      end = r->cleared_at;
+    }
+  }
+  busy += end - start;
+  return makespan > 0 ? busy / makespan : 0;
+}
+
+/* Runs a trace on the model, or with speed > 0 on librunway, and gives
+ * its mean wait and occupancy.  Returns 0, or -1 if the run failed.
+ */
+static int simulate(const scenario *sc, double speed, double *wait,
+                    double *busy)
+{
+  runway_config config;
+  runway_metrics metrics;
+  runway_sim *sim;
+  model_metrics mm;
+  model_result *results;
+  int *order;
+  char *text;
+  size_t length;
+  FILE *fp;
+  int result;
+
+  if (speed <= 0)
+  {
+    results = calloc(sc->num_aircraft + 1, sizeof(model_result));
+    order = calloc(sc->num_aircraft + 1, sizeof(int));
+    memset(&mm, 0, sizeof(mm));
+    result = model_run(sc, results, order, &mm);
+    *wait = mm.total_wait / sc->num_aircraft;
+    *busy = occupied(results, order, sc->num_aircraft, mm.makespan);
+    free(results);
+    free(order);
+    return result;
+  }
+
+  if ((fp = open_memstream(&text, &length)) == NULL)
+  {
+    return -1;
+  }
+  scenario_write(fp, sc);
+  fclose(fp);
+  runway_config_defaults(&config);
+  config.speed = speed;
+  result = -1;
+  if ((sim = runway_create(&config)) != NULL)
+  {
+    if (runway_load_buffer(sim, text, length) == 0 && runway_run(sim) == 0)
+    {
+      runway_get_metrics(sim, &metrics);
+      *wait = metrics.average_wait;
+      *busy = metrics.runway_occupied;
+      result = 0;
+    }
+    runway_destroy(sim);
+  }
+  free(text);
+  return result;
+}
+
+static int validate(int count, int seeds, double speed)
+{
+  estimate_input in;
+  estimate_result est;
+  scenario sc;
+  double rate;
+  double wait;
+  double busy;
+  double sim_wait;
+  double sim_busy;
+  double error;
+  int trusted_to[GRID_FUELS][GRID_MIXES];
+  int points = 0;
+  int good = 0;
+  int runs;
+  int trust;
+  int saturated;
+  int row;
+  int fuel;
+  int mix;
+  int k;
+  int s;
+
+  printf("Estimate against %s, %d aircraft x %d seeds per point, "
+         "runway times %d-%d s\n\n", speed > 0 ? "librunway" : "the model",
+         count, seeds, runway_min, runway_max);
+  printf(" fuel  rate/h   mix   load  occupied est/sim   wait est/sim s  "
+         "error  trust\n");
+  for (row = 0; row < GRID_FUELS * GRID_MIXES; row++)
+  {
+    fuel = row / GRID_MIXES;
+    mix = row % GRID_MIXES;
+    trusted_to[fuel][mix] = 0;
+    for (k = 1; k <= GRID_RATES; k++)
+    {
+      rate = k * GRID_RATE_STEP;
+      estimate_defaults(&in);
+      uniform_runway(&in);
+      in.rate[EMERGENCY] = rate * EMERGENCY_SHARE / 3600;
+      in.rate[COMMERCIAL] = rate * (1 - EMERGENCY_SHARE) *
+                            grid_mixes[mix] / 3600;
+      in.rate[CARGO] = rate * (1 - EMERGENCY_SHARE) *
+                       (1 - grid_mixes[mix]) / 3600;
+      saturated = estimate_run(&in, &est) != 0;
+
+      sim_wait = 0;
+      sim_busy = 0;
+      runs = 0;
+      for (s = 0; s < seeds; s++)
+      {
+        generate(&sc, count, rate, grid_mixes[mix], fuel,
+                 (unsigned int)(s + 1));
+        if (simulate(&sc, speed, &wait, &busy) == 0)
+        {
+          sim_wait += wait;
+          sim_busy += busy;
+          runs++;
+        }
+        scenario_free(&sc);
+      }
+      if (runs == 0)
+      {
+        printf("%5s  %6.0f  %4.2f  simulation failed\n", fuel_names[fuel],
+               rate, grid_mixes[mix]);
+        continue;
+      }
+      sim_wait /= runs;
+      sim_busy /= runs;
+
+      points++;
+      if (saturated)
+      {
+        printf("%5s  %6.0f  %4.2f  %4.0f%%  %7s %4.0f%%  %7s %7.1f  %5s  "
+               "no\n", fuel_names[fuel], rate, grid_mixes[mix],
+               est.load * 100, "sat", sim_busy * 100, "sat", sim_wait, "-");
+        continue;
+      }
+      error = sim_wait > 0 ? (est.average_wait - sim_wait) / sim_wait : 0;
+      trust = fabs(est.average_wait - sim_wait) <= TRUST_ABSOLUTE ||
+              fabs(error) <= TRUST_RELATIVE;
+      if (trust)
+      {
+        good++;
+        if (trusted_to[fuel][mix] == k - 1)
+        {
+          trusted_to[fuel][mix] = k;
+        }
+      }
+      printf("%5s  %6.0f  %4.2f  %4.0f%%  %6.0f%% %4.0f%%  %7.1f %7.1f  "
+             "%+4.0f%%  %s\n", fuel_names[fuel], rate, grid_mixes[mix],
+             est.load * 100,
+             est.occupied * 100, sim_busy * 100, est.average_wait, sim_wait,
+             error * 100, trust ? "yes" : "no");
+    }
+  }
+
+  printf("\n%d of %d points within %.0f%% or %.0f s of the simulated "
+         "wait\n", good, points, TRUST_RELATIVE * 100, TRUST_ABSOLUTE);
+  for (fuel = 0; fuel < GRID_FUELS; fuel++)
+  {
+    for (mix = 0; mix < GRID_MIXES; mix++)
+    {
+      printf("Fuel %s, commercial share %.2f: trustworthy up to %d "
+             "arrivals per hour\n", fuel_names[fuel], grid_mixes[mix],
+             trusted_to[fuel][mix] * GRID_RATE_STEP);
+    }
+  }
+  return 0;
+}
+
+int main(int nargs, char **args)
+{
+  estimate_input in;
+  scenario sc;
+  double speed = 0;
+  int check = 0;
+  int count = 1000;
+  int seeds = 3;
+  int opt;
+
+  estimate_defaults(&in);
+  in.rate[COMMERCIAL] = 120.0 / 3600;
+  in.rate[CARGO] = 120.0 / 3600;
+  while ((opt = getopt(nargs, args, "c:g:e:t:Vn:r:x:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'c':
+        in.rate[COMMERCIAL] = atof(optarg) / 3600;
+        break;
+      case 'g':
+        in.rate[CARGO] = atof(optarg) / 3600;
+        break;
+      case 'e':
+        in.rate[EMERGENCY] = atof(optarg) / 3600;
+        break;
+      case 't':
+        if (sscanf(optarg, "%d:%d", &runway_min, &runway_max) != 2 ||
+            runway_min < 1 || runway_max < runway_min)
+        {
+          usage();
+          return EINVAL;
+        }
+        break;
+      case 'V':
+        check = 1;
+        break;
+      case 'n':
+        count = atoi(optarg);
+        break;
+      case 'r':
+        seeds = atoi(optarg);
+        break;
+      case 'x':
+        speed = atof(optarg);
+        break;
+      default:
+        usage();
+        return EINVAL;
+    }
+  }
+  if (count < 2 || seeds < 1 || speed < 0 ||
+      in.rate[COMMERCIAL] < 0 || in.rate[CARGO] < 0 ||
+      in.rate[EMERGENCY] < 0)
+  {
+    usage();
+    return EINVAL;
+  }
+
+  if (check)
+  {
+    if (optind != nargs)
+    {
+      usage();
+      return EINVAL;
+    }
+    return validate(count, seeds, speed);
+  }
+
+  if (optind == nargs - 1)
+  {
+    if (scenario_load(&sc, args[optind], MAX_AIRCRAFT) != 0)
+    {
+      fprintf(stderr, "runway-estimate: cannot open %s: %s\n", args[optind],
+              strerror(errno));
+      return 1;
+    }
+    if (estimate_from_scenario(&in, &sc) != 0)
+    {
+      fprintf(stderr, "runway-estimate: %s has too few aircraft\n",
+              args[optind]);
+      scenario_free(&sc);
+      return 1;
+    }
+    scenario_free(&sc);
+  }
+  else if (optind == nargs)
+  {
+    uniform_runway(&in);
+  }
+  else
+  {
+    usage();
+    return EINVAL;
+  }
+  print_estimate(&in);
+  return 0;
+}
@@ -0,0 +1,254 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* runway-logbench: sustained log records per second written to a file.
+ *
+ * Producer threads write log lines like those of the aircraft threads as
+ * fast as they can, through one of:
+ *
+ *   stdio   fprintf() to one shared FILE, the way the runway program
+ *           prints its log; a producer that fills the stdio buffer makes
+ *           the write(2) itself while the others wait for the lock
+ *   thread  runway_writer with the writev(2) thread
+ *   uring   runway_writer through io_uring
+ *
+ * For each it reports the records per second and megabytes per second
+ * from the first record until the file is closed, the records dropped,
+ * the writes made and the longest time a producer spent in one call.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include "librunway.h"
+
+#define SINK_STDIO 0
+#define SINK_THREAD 1
+#define SINK_URING 2
+#define NUM_SINKS 3
+
+#define STDIO_BUFFER_SIZE 65536  /* stdio buffer of the stdio sink */
+
+static const char *sink_names[NUM_SINKS] = { "stdio", "thread", "uring" };
+
+typedef struct
+{
+  pthread_t tid;
+  int id;
+  int sink;
+  long records;
+  long long bytes;
+  double max_call;          /* longest call, in seconds */
+} producer;
+
+static FILE *stdio_file;
+static runway_writer *writer;
+
+static double now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: runway-logbench [options]\n"
+    "  -p threads   producer threads (default: 4)\n"
+    "  -n records   records per producer (default: 500000)\n"
+    "  -o file      file to write, removed at the end "
+    "(default: runway-logbench.log)\n"
+    "  -b sinks     comma-separated sinks to run: stdio,thread,uring "
+    "(default: all)\n");
+}
+
+/* Code for a producer: formats and writes its records. */
+static void * produce(void *arg)
+{
+  producer *p = (producer *)arg;
+  char line[256];
+  double start;
+  double took;
+  int length;
+  long i;
+
+  for (i = 0; i < p->records; i++)
+  {
+    length = snprintf(line, sizeof(line),
+                      "Commercial aircraft %ld (fuel: %lds) is now on the "
+                      "runway (direction: %s)\n",
+                      i * 64 + p->id, 30 + i % 90,
+                      i % 2 == 0 ? "NORTH" : "SOUTH");
+    start = now();
+    if (p->sink == SINK_STDIO)
+    {
+      fwrite(line, 1, (size_t)length, stdio_file);
+    }
+    else
+    {
+      runway_writer_write(writer, line, (size_t)length);
+    }
+    took = now() - start;
+    p->bytes += length;
+    if (took > p->max_call)
+    {
+      p->max_call = took;
+    }
+  }
+  return NULL;
+}
+
+/* Runs one sink.  Returns 0, or -1 if it could not be set up. */
+static int run_sink(int sink, const char *filename, producer *producers,
+                    int threads, long records)
+{
+  runway_writer_stats stats;
+  double start;
+  double elapsed;
+  double max_call = 0;
+  long long bytes = 0;
+  int i;
+
+  memset(&stats, 0, sizeof(stats));
+  if (sink == SINK_STDIO)
+  {
+    if ((stdio_file = fopen(filename, "w")) == NULL)
+    {
+      return -1;
+    }
+    setvbuf(stdio_file, NULL, _IOFBF, STDIO_BUFFER_SIZE);
+  }
+  else if ((writer = runway_writer_open(filename, sink == SINK_URING ?
+                                                  RUNWAY_WRITER_URING :
+                                                  RUNWAY_WRITER_THREAD)) ==
+           NULL)
+  {
+    return -1;
+  }
+
+  start = now();
+  for (i = 0; i < threads; i++)
+  {
+    producers[i].id = i;
+    producers[i].sink = sink;
+    producers[i].records = records;
+    producers[i].bytes = 0;
+    producers[i].max_call = 0;
+    pthread_create(&producers[i].tid, NULL, produce, &producers[i]);
+  }
+  for (i = 0; i < threads; i++)
+  {
+    pthread_join(producers[i].tid, NULL);
+    bytes += producers[i].bytes;
+    if (producers[i].max_call > max_call)
+    {
+      max_call = producers[i].max_call;
+    }
+  }
+  if (sink == SINK_STDIO)
+  {
+    fclose(stdio_file);
+    stats.records = (long long)threads * records;
+    stats.bytes = bytes;
+    stats.writes = -1;
+  }
+  else
+  {
+    runway_writer_close(writer, &stats);
+  }
+  elapsed = now() - start;
+
+  printf("%-6s  %12.0f  %8.1f  %10lld", sink_names[sink],
+         stats.records / elapsed, stats.bytes / elapsed / 1e6,
+         stats.dropped);
+  if (stats.writes < 0)
+  {
+    printf("  %8s", "n/a");
+  }
+  else
+  {
+    printf("  %8lld", stats.writes);
+  }
+  printf("  %12.1f\n", max_call * 1e6);
+  return 0;
+}
+
+int main(int nargs, char **args)
+{
+  const char *filename = "runway-logbench.log";
+  const char *sinks = "stdio,thread,uring";
+  producer *producers;
+  int threads = 4;
+  long records = 500000;
+  int opt;
+  int s;
+
+  while ((opt = getopt(nargs, args, "p:n:o:b:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'p':
+        threads = atoi(optarg);
+        break;
+      case 'n':
+        records = atol(optarg);
+        break;
+      case 'o':
+        filename = optarg;
+        break;
+      case 'b':
+        sinks = optarg;
+        break;
+      default:
+        usage();
+        return EINVAL;
+    }
+  }
+  if (optind != nargs || threads < 1 || records < 1)
+  {
+    usage();
+    return EINVAL;
+  }
+
+  producers = calloc(threads, sizeof(producer));
+  printf("%d producers, %ld records each, to %s\n\n", threads, records,
+         filename);
+  printf("sink         records/s      MB/s     dropped    writes  "
+         "max call us\n");
+  for (s = 0; s < NUM_SINKS; s++)
+  {
+    if (strstr(sinks, sink_names[s]) == NULL)
+    {
+      continue;
+    }
+    if (run_sink(s, filename, producers, threads, records) != 0)
+    {
+      printf("%-6s  not available\n", sink_names[s]);
+    }
+  }
+  unlink(filename);
+  free(producers);
+  return 0;
+}
@@ -0,0 +1,442 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* runway-pinbench: throughput and cross-node traffic of concurrent runs
+ * with and without placement.
+ *
+ * Runs several librunway simulations of one trace at the same time, the
+ * way a batch or a multi-airport run does, in three placements:
+ *
+ *   free    no placement; the scheduler moves threads as it likes
+ *   pinned  each run gets its own slice of the CPUs, the controller and
+ *           the thread starting the aircraft on the first CPU and the
+ *           aircraft on the rest
+ *   numa    the runs are bound in turn to the NUMA nodes, threads and
+ *           memory both
+ *
+ * The placements take turns for a number of rounds.  For each one it
+ * reports aircraft per wall-clock second, CPU time per aircraft, CPU
+ * migrations, context switches and loads served from another node's
+ * memory, the last three from perf_event_open(2) counters inherited by
+ * every thread of the runs.  Where the counters are not available (perf
+ * disabled, or a machine without per-node cache events) they are shown
+ * as n/a and context switches come from getrusage(2).
+ */
+
+#define _GNU_SOURCE
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include "librunway.h"
+
+#define MODE_FREE 0
+#define MODE_PINNED 1
+#define MODE_NUMA 2
+#define NUM_MODES 3
+
+#define COUNTER_MIGRATIONS 0
+#define COUNTER_SWITCHES 1
+#define COUNTER_REMOTE 2
+#define NUM_COUNTERS 3
+
+#define LIST_SIZE 32             /* Bytes of a CPU list like "12-15" */
+
+static const char *mode_names[NUM_MODES] = { "free", "pinned", "numa" };
+
+/* One simulation of a round */
+typedef struct
+{
+  pthread_t tid;
+  runway_config config;
+  char controller_cpus[LIST_SIZE];
+  char aircraft_cpus[LIST_SIZE];
+  int ok;
+  runway_metrics metrics;
+} instance;
+
+/* Totals of one placement over all its rounds */
+typedef struct
+{
+  double wall;              /* wall-clock seconds */
+  double cpu;               /* CPU seconds of the process */
+  long aircraft;
+  double wait;              /* sum of the runs' average waits */
+  int runs;
+  int failed;
+  long long count[NUM_COUNTERS];
+  int counted[NUM_COUNTERS];
+} mode_totals;
+
+static const char *trace_text;
+static size_t trace_length;
+static int cpus[CPU_SETSIZE];    /* CPUs this process may use */
+static int num_cpus;
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: runway-pinbench [options] <trace file>\n"
+    "  -k runs      simulations run at the same time "
+    "(default: 2 per node, at least 4)\n"
+    "  -r rounds    rounds of each placement (default: 3)\n"
+    "  -x speed     simulation clock speed (default: 2000)\n"
+    "  -s seed      fuel seed (default: 1)\n");
+}
+
+/* Reads the whole trace so every simulation can load it from memory. */
+static int read_trace(const char *filename)
+{
+  FILE *fp;
+  char *text;
+  long length;
+
+  if ((fp = fopen(filename, "rb")) == NULL)
+  {
+    perror("runway-pinbench");
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  length = ftell(fp);
+  rewind(fp);
+  if (length <= 0 || (text = malloc(length)) == NULL ||
+      fread(text, 1, length, fp) != (size_t)length)
+  {
+    fprintf(stderr, "runway-pinbench: cannot read %s\n", filename);
+    fclose(fp);
+    return -1;
+  }
+  fclose(fp);
+  trace_text = text;
+  trace_length = (size_t)length;
+  return 0;
+}
+
+static double now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static double cpu_seconds(const struct rusage *u)
+{
+  return (double)(u->ru_utime.tv_sec + u->ru_stime.tv_sec) +
+         (double)(u->ru_utime.tv_usec + u->ru_stime.tv_usec) / 1e6;
+}
+
+/* Opens a counter of this process and every thread it starts from now
+ * on.  Returns the descriptor, or -1 if the kernel will not count it.
+ * Migrations and switches happen in the kernel, so software events count
+ * kernel time as well, which perf_event_paranoid may forbid.
+ */
+static int open_counter(unsigned int type, unsigned long long config)
+{
+  struct perf_event_attr attr;
+  int fd;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.inherit = 1;
+  attr.disabled = 1;
+  attr.exclude_kernel = type != PERF_TYPE_SOFTWARE;
+  attr.exclude_hv = 1;
+  fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0UL);
+  if (fd >= 0)
+  {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  return fd;
+}
+
+static void open_counters(int *fd)
+{
+  fd[COUNTER_MIGRATIONS] = open_counter(PERF_TYPE_SOFTWARE,
+                                        PERF_COUNT_SW_CPU_MIGRATIONS);
+  fd[COUNTER_SWITCHES] = open_counter(PERF_TYPE_SOFTWARE,
+                                      PERF_COUNT_SW_CONTEXT_SWITCHES);
+  fd[COUNTER_REMOTE] = open_counter(PERF_TYPE_HW_CACHE,
+                                    PERF_COUNT_HW_CACHE_NODE |
+                                    PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                    PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static void close_counters(int *fd, mode_totals *t)
+{
+  long long value;
+  int c;
+
+  for (c = 0; c < NUM_COUNTERS; c++)
+  {
+    if (fd[c] < 0)
+    {
+      continue;
+    }
+    ioctl(fd[c], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd[c], &value, sizeof(value)) == sizeof(value))
+    {
+      t->count[c] += value;
+      t->counted[c]++;
+    }
+    close(fd[c]);
+  }
+}
+
+/* Writes CPUs first .. first + count - 1 of the usable ones as a list,
+ * wrapping around.
+ */
+static void cpu_slice(char *list, int first, int count)
+{
+  int length = 0;
+  int i;
+
+  list[0] = '\0';
+  for (i = 0; i < count && length < LIST_SIZE - 8; i++)
+  {
+    length += snprintf(list + length, LIST_SIZE - length, "%s%d",
+                       i > 0 ? "," : "", cpus[(first + i) % num_cpus]);
+  }
+}
+
+/* Sets up run i of k for a placement. */
+static void place(instance *in, int mode, int i, int k, int nodes)
+{
+  int slice = num_cpus / k > 0 ? num_cpus / k : 1;
+  int first = i * slice;
+
+  if (mode == MODE_PINNED)
+  {
+    cpu_slice(in->controller_cpus, first, 1);
+    if (slice > 1)
+    {
+      cpu_slice(in->aircraft_cpus, first + 1, slice - 1);
+    }
+    else
+    {
+      cpu_slice(in->aircraft_cpus, first, 1);
+    }
+    in->config.controller_cpus = in->controller_cpus;
+    in->config.aircraft_cpus = in->aircraft_cpus;
+  }
+  else if (mode == MODE_NUMA)
+  {
+    in->config.numa_node = i % nodes;
+  }
+}
+
+static void * run_instance(void *arg)
+{
+  instance *in = (instance *)arg;
+  runway_sim *sim;
+
+  in->ok = 0;
+  if ((sim = runway_create(&in->config)) == NULL)
+  {
+    return NULL;
+  }
+  if (runway_load_buffer(sim, trace_text, trace_length) == 0 &&
+      runway_run(sim) == 0)
+  {
+    runway_get_metrics(sim, &in->metrics);
+    in->ok = 1;
+  }
+  runway_destroy(sim);
+  return NULL;
+}
+
+/* Runs k simulations at once in one placement and adds them up. */
+static void round_of(instance *runs, int k, int mode, int nodes,
+                     const runway_config *base, mode_totals *t)
+{
+  struct rusage before;
+  struct rusage after;
+  int fd[NUM_COUNTERS];
+  double start;
+  int started;
+  int i;
+
+  for (i = 0; i < k; i++)
+  {
+    runs[i].config = *base;
+    place(&runs[i], mode, i, k, nodes);
+  }
+
+  getrusage(RUSAGE_SELF, &before);
+  open_counters(fd);
+  start = now();
+  for (started = 0; started < k; started++)
+  {
+    if (pthread_create(&runs[started].tid, NULL, run_instance,
+                       &runs[started]))
+    {
+      break;
+    }
+  }
+  for (i = 0; i < started; i++)
+  {
+    pthread_join(runs[i].tid, NULL);
+  }
+  t->wall += now() - start;
+  close_counters(fd, t);
+  getrusage(RUSAGE_SELF, &after);
+  t->cpu += cpu_seconds(&after) - cpu_seconds(&before);
+  if (fd[COUNTER_SWITCHES] < 0)
+  {
+    t->count[COUNTER_SWITCHES] += (after.ru_nvcsw - before.ru_nvcsw) +
+                                  (after.ru_nivcsw - before.ru_nivcsw);
+    t->counted[COUNTER_SWITCHES]++;
+  }
+
+  for (i = 0; i < k; i++)
+  {
+    if (i >= started || !runs[i].ok)
+    {
+      t->failed++;
+      continue;
+    }
+    t->aircraft += runs[i].metrics.landed + runs[i].metrics.departed +
+                   runs[i].metrics.diverted;
+    t->wait += runs[i].metrics.average_wait;
+    t->runs++;
+  }
+}
+
+static void print_count(const mode_totals *t, int c, int width)
+{
+  if (t->counted[c] == 0)
+  {
+    printf(" %*s", width, "n/a");
+  }
+  else
+  {
+    printf(" %*lld", width, t->count[c] / t->counted[c]);
+  }
+}
+
+int main(int nargs, char **args)
+{
+  runway_config base;
+  mode_totals totals[NUM_MODES];
+  mode_totals *t;
+  instance *runs;
+  cpu_set_t allowed;
+  int nodes = runway_numa_nodes();
+  int k = 0;
+  int rounds = 3;
+  int opt;
+  int m;
+  int r;
+  int i;
+
+  runway_config_defaults(&base);
+  base.speed = 2000;
+  base.seed = 1;
+  while ((opt = getopt(nargs, args, "k:r:x:s:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'k':
+        k = atoi(optarg);
+        break;
+      case 'r':
+        rounds = atoi(optarg);
+        break;
+      case 'x':
+        base.speed = atof(optarg);
+        break;
+      case 's':
+        base.seed = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      default:
+        usage();
+        return EINVAL;
+    }
+  }
+  if (optind != nargs - 1 || k < 0 || rounds < 1 || base.speed <= 0)
+  {
+    usage();
+    return EINVAL;
+  }
+  if (k == 0)
+  {
+    k = nodes * 2 > 4 ? nodes * 2 : 4;
+  }
+  if (read_trace(args[optind]) != 0)
+  {
+    return 1;
+  }
+
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+  for (i = 0; i < CPU_SETSIZE; i++)
+  {
+    if (CPU_ISSET(i, &allowed))
+    {
+      cpus[num_cpus++] = i;
+    }
+  }
+
+  runs = calloc(k, sizeof(instance));
+  memset(totals, 0, sizeof(totals));
+  for (r = 0; r < rounds; r++)
+  {
+    for (m = 0; m < NUM_MODES; m++)
+    {
+      round_of(runs, k, m, nodes, &base, &totals[m]);
+    }
+  }
+
+  printf("%s: %d runs at a time, %d rounds, speed %.0f, %d CPUs, "
+         "%d NUMA node%s\n\n", args[optind], k, rounds, base.speed,
+         num_cpus, nodes, nodes == 1 ? "" : "s");
+  printf("placement  aircraft/s  CPU ms/aircraft  avg wait  migrations  "
+         "switches  remote loads\n");
+  for (m = 0; m < NUM_MODES; m++)
+  {
+    t = &totals[m];
+    printf("%-9s  %10.1f  %15.3f  %8.2f", mode_names[m],
+           t->wall > 0 ? t->aircraft / t->wall : 0,
+           t->aircraft > 0 ? t->cpu * 1000 / t->aircraft : 0,
+           t->runs > 0 ? t->wait / t->runs : 0);
+    print_count(t, COUNTER_MIGRATIONS, 11);
+    print_count(t, COUNTER_SWITCHES, 9);
+    print_count(t, COUNTER_REMOTE, 13);
+    if (t->failed > 0)
+    {
+      printf("  (%d failed)", t->failed);
+    }
+    printf("\n");
+  }
+  printf("\nCounts are per round.  Remote loads are loads that missed "
+         "the caches and\nwere served from another node's memory.\n");
+
+  free(runs);
+  free((void *)trace_text);
+  return 0;
+}
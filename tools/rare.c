@@ -0,0 +1,506 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* runway-rare: probability that an aircraft runs out of holding fuel.
+ *
+ * A fuel emergency leaves an aircraft EMERGENCY_FUEL seconds of holding
+ * before it must divert.  How often that happens under a given traffic is
+ * too rare to count by running the model over and over, so it is found by
+ * fixed-effort multilevel splitting on the reference model.
+ *
+ * The runway goes idle between busy periods, and an idle runway carries
+ * over nothing but its direction and counters, so the rare event is
+ * estimated per busy period: the starts of busy periods are collected
+ * from one long run.  The importance of a waiting aircraft is how long it
+ * has waited past its fuel reserve plus a few seconds for every aircraft
+ * ahead of it, since a long queue is what makes a long overrun likely.
+ * Each stage runs a fixed number of attempts, each one from a clone of a
+ * random start or of a random attempt that reached the level before,
+ * until the next level is reached or the runway goes idle again; the last
+ * stage runs to the overrun itself.  The probability for a busy period is
+ * the product of the fractions that got through, and the probability over
+ * the traffic horizon follows from the busy periods per hour.  The levels
+ * are chosen by a pilot so that about a tenth of the attempts get through
+ * each stage, and the interval comes from independent repetitions.  Plain Monte Carlo over the horizon on the
+ * same number of model events is run alongside for comparison.
+ */
+
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+
+#include "runway.h"
+#include "scenario.h"
+#include "model.h"
+
+#define MAX_LEVELS 64            /* stages a pilot may set up */
+#define Z95 1.96                 /* normal quantile of a 95% interval */
+#define ENDLESS 1e18             /* horizon of the busy period runs */
+#define UNREACHABLE 1e300        /* level no aircraft gets to */
+#define PASS_FRACTION 0.1        /* attempts meant to get through a stage */
+
+/* The simulator's reserves of FUEL_MIN to FUEL_MAX run out at any load,
+ * so the default traffic holds for longer.
+ */
+static model_traffic traffic = {
+  90,                            /* rate */
+  0.5,                           /* commercial_share */
+  0.05,                          /* emergency_share */
+  0.05,                          /* burst_chance */
+  4,                             /* burst_size */
+  2,                             /* burst_gap */
+  8, 15,                         /* runway_min, runway_max */
+  120, 180,                      /* fuel_min, fuel_max */
+  3600                           /* horizon */
+};
+
+static double ahead = -1;        /* importance per aircraft ahead */
+static unsigned int seed_state = 1;
+static long work;                /* model events, all runs */
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: runway-rare [options]\n"
+    "  -r rate       arrivals per hour (default: 90)\n"
+    "  -m share      commercial share of regular aircraft (default: 0.5)\n"
+    "  -e share      emergency share (default: 0.05)\n"
+    "  -b p:n:gap    chance an arrival starts a burst of n aircraft gap "
+    "seconds\n"
+    "                apart (default: 0.05:4:2)\n"
+    "  -t min:max    runway times (default: 8:15)\n"
+    "  -f min:max    fuel reserves (default: 120:180)\n"
+    "  -T seconds    length of the traffic (default: 3600)\n"
+    "  -M seconds    overrun past the reserve that counts (default: %d)\n"
+    "  -w seconds    importance per aircraft waiting ahead (default: mean "
+    "runway\n"
+    "                time over runway capacity)\n"
+    "  -n runs       attempts per stage (default: 1000)\n"
+    "  -R reps       independent repetitions (default: 20)\n"
+    "  -s seed       random seed (default: 1)\n",
+    EMERGENCY_FUEL);
+}
+
+static unsigned int next_seed(void)
+{
+  return (unsigned int)rand_r(&seed_state) * 2654435761u;
+}
+
+static model_chain *clone(const model_chain *c)
+{
+  model_chain *copy = model_chain_clone(c, next_seed());
+
+  if (copy == NULL)
+  {
+    fprintf(stderr, "runway-rare: out of memory\n");
+    exit(ENOMEM);
+  }
+  return copy;
+}
+
+static void free_runs(model_chain **runs, int count)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    model_chain_free(runs[i]);
+  }
+}
+
+/* Collects the idle states that start n busy periods of one long run into
+ * starts.  Returns the busy periods per second.
+ */
+static double collect(model_chain **starts, int n)
+{
+  model_traffic endless = traffic;
+  model_chain *c;
+  model_chain *next;
+  double rate;
+  int i;
+
+  endless.horizon = ENDLESS;
+  c = model_chain_start(&endless, next_seed());
+  if (c == NULL)
+  {
+    fprintf(stderr, "runway-rare: out of memory\n");
+    exit(ENOMEM);
+  }
+  for (i = 0; i < n; i++)
+  {
+    starts[i] = clone(c);
+    model_chain_run(c, UNREACHABLE, 0, MODEL_CHAIN_IDLE);
+    work += model_chain_work(c);
+
+    /* Drops the landed aircraft */
+    next = clone(c);
+    model_chain_free(c);
+    c = next;
+  }
+  rate = n / model_chain_now(c);
+  model_chain_free(c);
+  return rate;
+}
+
+/* Runs n attempts at level of the importance with weight, each from a
+ * clone of a random one of from[0 .. count - 1], until they reach it or
+ * the runway goes idle.  Keeps the ones that got there in to and returns
+ * how many did.  peaks and overruns, if not NULL, get how far each got in
+ * importance and in overrun.
+ */
+static int stage(model_chain **from, int count, double level, double weight,
+                 int n, model_chain **to, double *peaks, double *overruns)
+{
+  model_chain *c;
+  int hits = 0;
+  int reached;
+  int i;
+
+  for (i = 0; i < n; i++)
+  {
+    c = clone(from[rand_r(&seed_state) % count]);
+    reached = model_chain_run(c, level, weight, MODEL_CHAIN_IDLE);
+    work += model_chain_work(c);
+    if (peaks != NULL)
+    {
+      peaks[i] = model_chain_peak(c);
+      overruns[i] = model_chain_overrun(c);
+    }
+    if (reached)
+    {
+      to[hits++] = c;
+    }
+    else
+    {
+      model_chain_free(c);
+    }
+  }
+  return hits;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Pilot: from the states that reached the last level (busy period starts
+ * at first), runs n attempts to the end of their busy periods.  If enough
+ * of them overran by the margin, the last stage can run to it; otherwise
+ * the next level is set where about PASS_FRACTION of them got in
+ * importance, in whole seconds since the model's times are, and the
+ * states at that level are collected.  Returns the number of levels
+ * before the margin.
+ */
+static int choose_levels(int n, double margin, double *levels)
+{
+  model_chain **from = malloc(sizeof(model_chain *) * n);
+  model_chain **to = malloc(sizeof(model_chain *) * n);
+  model_chain **swap;
+  double *peaks = malloc(sizeof(double) * n);
+  double *overruns = malloc(sizeof(double) * n);
+  double level;
+  int count = n;
+  int num_levels = 0;
+  int over;
+  int i;
+
+  collect(from, n);
+  while (num_levels < MAX_LEVELS - 1 && count > 0)
+  {
+    stage(from, count, UNREACHABLE, ahead, n, to, peaks, overruns);
+    over = 0;
+    for (i = 0; i < n; i++)
+    {
+      over += overruns[i] >= margin;
+    }
+    if (over >= n * PASS_FRACTION)
+    {
+      break;
+    }
+    qsort(peaks, n, sizeof(double), compare_doubles);
+    level = floor(peaks[n - 1 - (int)(n * PASS_FRACTION)]);
+    if (num_levels > 0 && level <= levels[num_levels - 1])
+    {
+      level = levels[num_levels - 1] + 1;
+    }
+    if (peaks[n - 1] < level)
+    {
+      break;
+    }
+    i = stage(from, count, level, ahead, n, to, NULL, NULL);
+    free_runs(from, count);
+    levels[num_levels++] = level;
+    swap = from;
+    from = to;
+    to = swap;
+    count = i;
+  }
+  free_runs(from, count);
+  free(from);
+  free(to);
+  free(peaks);
+  free(overruns);
+  return num_levels;
+}
+
+/* One splitting estimate over the given levels and the margin: the
+ * probability that a busy period overruns by the margin.  *periods gets
+ * the busy periods per second.
+ */
+static double split(const double *levels, int num_levels, double margin,
+                    int n, double *fractions, double *periods)
+{
+  model_chain **from = malloc(sizeof(model_chain *) * n);
+  model_chain **to = malloc(sizeof(model_chain *) * n);
+  model_chain **swap;
+  double p = 1;
+  int count = n;
+  int hits;
+  int k;
+
+  *periods = collect(from, n);
+  for (k = 0; k <= num_levels; k++)
+  {
+    fractions[k] = 0;
+  }
+  for (k = 0; k <= num_levels && count > 0; k++)
+  {
+    hits = k < num_levels ?
+           stage(from, count, levels[k], ahead, n, to, NULL, NULL) :
+           stage(from, count, margin, 0, n, to, NULL, NULL);
+    free_runs(from, count);
+    fractions[k] = (double)hits / n;
+    p *= fractions[k];
+    swap = from;
+    from = to;
+    to = swap;
+    count = hits;
+  }
+  free_runs(from, count);
+  free(from);
+  free(to);
+  return count > 0 ? p : 0;
+}
+
+int main(int nargs, char **args)
+{
+  double levels[MAX_LEVELS];
+  double fractions[MAX_LEVELS];
+  double mean_fractions[MAX_LEVELS];
+  double margin = EMERGENCY_FUEL;
+  double *estimates;
+  double per_period = 0;
+  double periods;
+  double mean_periods = 0;
+  double p = 0;
+  double spread = 0;
+  double relative;
+  double mc_p;
+  double mc_per_run;
+  double mc_needed;
+  long split_work;
+  long mc_runs;
+  long mc_hits;
+  int num_levels;
+  int n = 1000;
+  int reps = 20;
+  int opt;
+  int i;
+  int k;
+
+  while ((opt = getopt(nargs, args, "r:m:e:b:t:f:T:M:w:n:R:s:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'r':
+        traffic.rate = atof(optarg);
+        break;
+      case 'm':
+        traffic.commercial_share = atof(optarg);
+        break;
+      case 'e':
+        traffic.emergency_share = atof(optarg);
+        break;
+      case 'b':
+        if (sscanf(optarg, "%lf:%d:%d", &traffic.burst_chance,
+                   &traffic.burst_size, &traffic.burst_gap) != 3)
+        {
+          usage();
+          return EINVAL;
+        }
+        break;
+      case 't':
+        if (sscanf(optarg, "%d:%d", &traffic.runway_min,
+                   &traffic.runway_max) != 2)
+        {
+          usage();
+          return EINVAL;
+        }
+        break;
+      case 'f':
+        if (sscanf(optarg, "%d:%d", &traffic.fuel_min,
+                   &traffic.fuel_max) != 2)
+        {
+          usage();
+          return EINVAL;
+        }
+        break;
+      case 'T':
+        traffic.horizon = atof(optarg);
+        break;
+      case 'M':
+        margin = atof(optarg);
+        break;
+      case 'w':
+        ahead = atof(optarg);
+        break;
+      case 'n':
+        n = atoi(optarg);
+        break;
+      case 'R':
+        reps = atoi(optarg);
+        break;
+      case 's':
+        seed_state = (unsigned int)atoi(optarg);
+        break;
+      default:
+        usage();
+        return EINVAL;
+    }
+  }
+  if (optind != nargs || traffic.rate <= 0 || traffic.horizon <= 0 ||
+      traffic.commercial_share < 0 || traffic.commercial_share > 1 ||
+      traffic.emergency_share < 0 || traffic.emergency_share > 1 ||
+      traffic.burst_chance < 0 || traffic.burst_size < 1 ||
+      traffic.burst_gap < 0 || traffic.runway_min < 1 ||
+      traffic.runway_max < traffic.runway_min || traffic.fuel_min < 0 ||
+      traffic.fuel_max < traffic.fuel_min || n < 10 || reps < 2)
+  {
+    usage();
+    return EINVAL;
+  }
+
+  if (ahead < 0)
+  {
+    ahead = (traffic.runway_min + traffic.runway_max) / 2.0 /
+            MAX_RUNWAY_CAPACITY;
+  }
+
+  printf("Traffic: %.0f arrivals per hour for %.0f s, bursts of %d with "
+         "chance %.2f\n", traffic.rate, traffic.horizon, traffic.burst_size,
+         traffic.burst_chance);
+  printf("Event: an aircraft waits %.0f s past its fuel reserve\n\n",
+         margin);
+
+  num_levels = choose_levels(n, margin, levels);
+  printf("Levels: importance");
+  for (k = 0; k < num_levels; k++)
+  {
+    printf(" %.0f", levels[k]);
+  }
+  printf(" (%.2g s per aircraft ahead), then overrun %.0f (pilot: %ld "
+         "events)\n", ahead, margin, work);
+  for (k = 0; k <= num_levels; k++)
+  {
+    mean_fractions[k] = 0;
+  }
+
+  /* Busy periods are independent but for the direction and counters they
+   * leave behind, so the events in the horizon are close to Poisson.
+   */
+  estimates = malloc(sizeof(double) * reps);
+  work = 0;
+  for (i = 0; i < reps; i++)
+  {
+    double q = split(levels, num_levels, margin, n, fractions, &periods);
+
+    estimates[i] = 1 - exp(-q * periods * traffic.horizon);
+    p += estimates[i] / reps;
+    per_period += q / reps;
+    mean_periods += periods / reps;
+    for (k = 0; k <= num_levels; k++)
+    {
+      mean_fractions[k] += fractions[k] / reps;
+    }
+  }
+  for (i = 0; i < reps; i++)
+  {
+    spread += (estimates[i] - p) * (estimates[i] - p) / (reps - 1);
+  }
+  spread = sqrt(spread / reps);
+  split_work = work;
+  printf("Stage fractions:");
+  for (k = 0; k <= num_levels; k++)
+  {
+    printf(" %.3f", mean_fractions[k]);
+  }
+  printf("\nBusy periods: %.1f per hour, %.3g of them reach the margin\n\n",
+         mean_periods * 3600, per_period);
+  relative = p > 0 ? spread / p : 0;
+  printf("splitting  P = %.3g +- %.2g (95%%), relative error %.1f%%, "
+         "%d x %d stages x %d runs, %ld events\n", p, Z95 * spread,
+         relative * 100, reps, num_levels + 1, n, split_work);
+
+  /* Plain Monte Carlo over the horizon on the same work */
+  work = 0;
+  mc_runs = 0;
+  mc_hits = 0;
+  while (work < split_work)
+  {
+    model_chain *c = model_chain_start(&traffic, next_seed());
+
+    if (c == NULL)
+    {
+      fprintf(stderr, "runway-rare: out of memory\n");
+      return ENOMEM;
+    }
+    mc_hits += model_chain_run(c, margin, 0, MODEL_CHAIN_END);
+    work += model_chain_work(c);
+    model_chain_free(c);
+    mc_runs++;
+  }
+  mc_p = (double)mc_hits / mc_runs;
+  mc_per_run = (double)work / mc_runs;
+  if (mc_hits == 0)
+  {
+    printf("plain MC   P < %.2g (95%%, no hits in %ld runs), %ld events\n",
+           3.0 / mc_runs, mc_runs, work);
+  }
+  else
+  {
+    printf("plain MC   P = %.3g +- %.2g (95%%), %ld hits in %ld runs, %ld "
+           "events\n", mc_p, Z95 * sqrt(mc_p * (1 - mc_p) / mc_runs),
+           mc_hits, mc_runs, work);
+  }
+  if (p > 0 && relative > 0)
+  {
+    /* Runs after which the binomial relative error is as small */
+    mc_needed = (1 - p) / (p * relative * relative);
+    printf("plain MC would need %.3g runs (%.3g events) for the same "
+           "relative error: %.1fx the work\n", mc_needed,
+           mc_needed * mc_per_run, mc_needed * mc_per_run / split_work);
+  }
+  free(estimates);
+  return 0;
+}
@@ -0,0 +1,582 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* runway-reduce: delta-debugging trace minimizer.
+ *
+ * Given a trace that makes the simulator misbehave (crash on an assert,
+ * hang because of starvation or deadlock, or show a pathological wait),
+ * repeatedly runs ./runway with a fixed seed and a fast clock on smaller
+ * and smaller variants of the trace and keeps the ones for which the
+ * property still holds.  Lines (aircraft and runway events) are removed
+ * first (ddmin), then the remaining numbers are shrunk.  Candidate
+ * variants are run in parallel.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include "runway.h"
+#include "scenario.h"
+
+#define POLL_INTERVAL 2000000L  /* Child polling interval in nanoseconds */
+
+/* Property of interest the reduced trace must keep */
+enum
+{
+  PROP_CRASH,               /* runway dies on a signal (assert, SIGSEGV)
+                               or exits with an unexpected status */
+  PROP_HANG,                /* runway does not finish within the timeout */
+  PROP_WAIT,                /* max wait reported in the summary >= limit */
+  PROP_GREP                 /* output contains a given text */
+};
+
+static const char *runway_path = "./runway";
+static int property = PROP_CRASH;
+static double wait_limit = 0;
+static const char *grep_text = NULL;
+static const char *seed_arg = "1";
+static const char *speed_arg = "100";
+static double timeout = 10;     /* wall-clock seconds per candidate run */
+static int jobs = 1;
+static int runs = 0;            /* candidate runs performed so far */
+
+/* A candidate run in flight */
+typedef struct
+{
+  pid_t pid;
+  char trace_path[64];
+  char output_path[64];
+  struct timespec started;
+  int timed_out;
+  int status;
+} job;
+
+static double elapsed_since(struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Builds dst from the events of src whose keep flag is set.  Aircraft
+ * whose arrival is dropped disappear from the scenario.
+ */
+static void select_events(scenario *dst, const scenario *src,
+                          const char *keep)
+{
+  int i;
+
+  dst->aircraft = malloc(sizeof(scenario_aircraft) *
+                         (src->num_aircraft + 1));
+  dst->events = malloc(sizeof(scenario_event) * (src->num_events + 1));
+  dst->num_aircraft = 0;
+  dst->num_events = 0;
+  for (i = 0; i < src->num_events; i++)
+  {
+    if (!keep[i])
+    {
+      continue;
+    }
+    if (src->events[i].kind == EVENT_ARRIVAL)
+    {
+      dst->aircraft[dst->num_aircraft++] =
+        src->aircraft[src->events[i].aux];
+    }
+    else
+    {
+      dst->events[dst->num_events++] = src->events[i];
+    }
+  }
+  scenario_compile(dst);
+}
+
+/* Writes the candidate to a temporary file and starts runway on it. */
+static int start_job(job *j, scenario *t)
+{
+  FILE *fp;
+  int trace_fd;
+  int output_fd;
+
+  strcpy(j->trace_path, "/tmp/runway-reduce-XXXXXX");
+  strcpy(j->output_path, "/tmp/runway-reduce-out-XXXXXX");
+  if ((trace_fd = mkstemp(j->trace_path)) == -1 ||
+      (output_fd = mkstemp(j->output_path)) == -1)
+  {
+    perror("runway-reduce: mkstemp");
+    exit(1);
+  }
+
+  fp = fdopen(trace_fd, "w");
+  scenario_write(fp, t);
+  fclose(fp);
+
+  j->timed_out = 0;
+  clock_gettime(CLOCK_MONOTONIC, &j->started);
+  j->pid = fork();
+  if (j->pid == -1)
+  {
+    perror("runway-reduce: fork");
+    exit(1);
+  }
+  if (j->pid == 0)
+  {
+    dup2(output_fd, STDOUT_FILENO);
+    dup2(output_fd, STDERR_FILENO);
+    execl(runway_path, runway_path, "-s", seed_arg, "-x", speed_arg,
+          j->trace_path, (char *)NULL);
+    _exit(127);
+  }
+
+  close(output_fd);
+  runs++;
+  return 0;
+}
+
+/* Returns non-zero if runway's exit status is one it never returns by
+ * itself: 0 on success, 1 when a run fails and EINVAL for bad options
+ * are all normal, and 127 is a failed exec.
+ */
+static int abnormal_exit(int status)
+{
+  int code;
+
+  if (WIFSIGNALED(status))
+  {
+    return 1;
+  }
+  code = WEXITSTATUS(status);
+  return code != 0 && code != 1 && code != EINVAL && code != 127;
+}
+
+/* Returns non-zero if the finished job shows the property of interest. */
+static int job_interesting(job *j)
+{
+  FILE *fp;
+  char line[512];
+  double max_wait;
+  int found = 0;
+
+  if (property == PROP_HANG)
+  {
+    return j->timed_out;
+  }
+  if (j->timed_out)
+  {
+    return 0;
+  }
+  if (property == PROP_CRASH)
+  {
+    return abnormal_exit(j->status);
+  }
+
+  if ((fp = fopen(j->output_path, "r")) == NULL)
+  {
+    return 0;
+  }
+  while (!found && fgets(line, sizeof(line), fp))
+  {
+    if (property == PROP_GREP)
+    {
+      found = strstr(line, grep_text) != NULL;
+    }
+    else if (sscanf(line, "  Max wait: %lf", &max_wait) == 1)
+    {
+      found = max_wait >= wait_limit;
+    }
+  }
+  fclose(fp);
+  return found;
+}
+
+/* Runs all candidates, at most `jobs` at a time, and returns the index of
+ * the first interesting one (in candidate order, so the result does not
+ * depend on which run finishes first), or -1 if none is.
+ */
+static int first_interesting(scenario *candidates, int count)
+{
+  job *running = calloc(jobs, sizeof(job));
+  int *slot_candidate = malloc(sizeof(int) * jobs);
+  int next = 0;
+  int active = 0;
+  int best = -1;
+  int s;
+  int status;
+  struct timespec pause = { 0, POLL_INTERVAL };
+
+  for (s = 0; s < jobs; s++)
+  {
+    slot_candidate[s] = -1;
+  }
+
+  while (next < count || active > 0)
+  {
+    /* Candidates after an interesting one can no longer win */
+    for (s = 0; s < jobs && next < count && (best < 0 || next < best); s++)
+    {
+      if (slot_candidate[s] == -1)
+      {
+        start_job(&running[s], &candidates[next]);
+        slot_candidate[s] = next++;
+        active++;
+      }
+    }
+    if (best >= 0 && next >= best)
+    {
+      next = count;
+    }
+
+    nanosleep(&pause, NULL);
+
+    for (s = 0; s < jobs; s++)
+    {
+      job *j = &running[s];
+
+      if (slot_candidate[s] == -1)
+      {
+        continue;
+      }
+      if (!j->timed_out && elapsed_since(&j->started) > timeout)
+      {
+        kill(j->pid, SIGKILL);
+        j->timed_out = 1;
+      }
+      if (waitpid(j->pid, &status, WNOHANG) != j->pid)
+      {
+        continue;
+      }
+
+      j->status = status;
+      if (job_interesting(j))
+      {
+        if (best < 0 || slot_candidate[s] < best)
+        {
+          best = slot_candidate[s];
+        }
+      }
+      unlink(j->trace_path);
+      unlink(j->output_path);
+      slot_candidate[s] = -1;
+      active--;
+    }
+  }
+
+  free(running);
+  free(slot_candidate);
+  return best;
+}
+
+/* ddmin over scenario lines (aircraft and runway events): try removing
+ * each of n chunks, refining the granularity when no removal keeps the
+ * property.  Removals that leave no aircraft are not tried, since runway
+ * has nothing to simulate then.
+ */
+static void reduce_lines(scenario *t)
+{
+  scenario *candidates;
+  char *keep;
+  int n = 2;
+  int i;
+  int k;
+  int found;
+  int made;
+
+  while (t->num_events >= 2)
+  {
+    if (n > t->num_events)
+    {
+      n = t->num_events;
+    }
+    made = 0;
+    candidates = malloc(sizeof(scenario) * n);
+    keep = malloc(t->num_events);
+    for (i = 0; i < n; i++)
+    {
+      int start = (int)((long)t->num_events * i / n);
+      int end = (int)((long)t->num_events * (i + 1) / n);
+
+      for (k = 0; k < t->num_events; k++)
+      {
+        keep[k] = k < start || k >= end;
+      }
+      select_events(&candidates[made], t, keep);
+      if (candidates[made].num_aircraft > 0)
+      {
+        made++;
+      }
+      else
+      {
+        scenario_free(&candidates[made]);
+      }
+    }
+    free(keep);
+
+    found = made > 0 ? first_interesting(candidates, made) : -1;
+    if (found >= 0)
+    {
+      scenario_free(t);
+      *t = candidates[found];
+      fprintf(stderr, "runway-reduce: %d lines (%d runs)\n",
+              t->num_events, runs);
+      n = n > 2 ? n - 1 : 2;
+    }
+    for (i = 0; i < made; i++)
+    {
+      if (i != found)
+      {
+        scenario_free(&candidates[i]);
+      }
+    }
+    free(candidates);
+
+    if (found < 0)
+    {
+      if (t->num_events / n <= 1)
+      {
+        break;
+      }
+      n = n * 2;
+    }
+  }
+}
+
+/* Moves event i and everything after it earlier by shift seconds. */
+static void pull_in(scenario *t, int i, int shift)
+{
+  for (; i < t->num_events; i++)
+  {
+    t->events[i].time -= shift;
+    if (t->events[i].kind == EVENT_ARRIVAL)
+    {
+      t->aircraft[t->events[i].aux].arrival -= shift;
+    }
+  }
+}
+
+/* Shrinks the numbers of the remaining lines: halves runway times,
+ * handover times and the gaps between lines, and turns aircraft into
+ * commercial ones.
+ */
+static void reduce_values(scenario *t)
+{
+  scenario *candidates = malloc(sizeof(scenario) * (t->num_events * 3 + 1));
+  scenario_event *e;
+  int count;
+  int found;
+  int i;
+  int gap;
+
+  do
+  {
+    count = 0;
+    for (i = 0; i < t->num_events; i++)
+    {
+      e = &t->events[i];
+      if (e->kind == EVENT_ARRIVAL && t->aircraft[e->aux].runway_time > 1)
+      {
+        scenario_copy(&candidates[count], t);
+        candidates[count].aircraft[e->aux].runway_time /= 2;
+        count++;
+      }
+      if (e->kind == EVENT_SHIFT && e->aux > 0)
+      {
+        scenario_copy(&candidates[count], t);
+        candidates[count].events[i].aux /= 2;
+        count++;
+      }
+
+      gap = e->time - (i > 0 ? t->events[i - 1].time : 0);
+      if (gap > 0)
+      {
+        scenario_copy(&candidates[count], t);
+        pull_in(&candidates[count], i, gap - gap / 2);
+        count++;
+      }
+
+      if (e->kind == EVENT_ARRIVAL &&
+          t->aircraft[e->aux].aircraft_type != COMMERCIAL)
+      {
+        scenario_copy(&candidates[count], t);
+        candidates[count].aircraft[e->aux].aircraft_type = COMMERCIAL;
+        candidates[count].events[i].arg = COMMERCIAL;
+        count++;
+      }
+    }
+
+    found = count > 0 ? first_interesting(candidates, count) : -1;
+    if (found >= 0)
+    {
+      scenario_free(t);
+      *t = candidates[found];
+      fprintf(stderr, "runway-reduce: shrunk line values (%d runs)\n",
+              runs);
+    }
+    for (i = 0; i < count; i++)
+    {
+      if (i != found)
+      {
+        scenario_free(&candidates[i]);
+      }
+    }
+  } while (found >= 0);
+
+  free(candidates);
+}
+
+static int parse_property(const char *arg)
+{
+  if (strcmp(arg, "crash") == 0)
+  {
+    property = PROP_CRASH;
+  }
+  else if (strcmp(arg, "hang") == 0)
+  {
+    property = PROP_HANG;
+  }
+  else if (strncmp(arg, "wait:", 5) == 0)
+  {
+    property = PROP_WAIT;
+    wait_limit = atof(arg + 5);
+  }
+  else if (strncmp(arg, "grep:", 5) == 0)
+  {
+    property = PROP_GREP;
+    grep_text = arg + 5;
+  }
+  else
+  {
+    return -1;
+  }
+  return 0;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: runway-reduce [options] <trace file>\n"
+    "  -p property  crash | hang | wait:SECONDS | grep:TEXT "
+    "(default: crash)\n"
+    "  -r path      simulator binary (default: ./runway)\n"
+    "  -s seed      fuel reserve seed passed to runway (default: 1)\n"
+    "  -x speed     clock speed passed to runway (default: 100)\n"
+    "  -t seconds   wall-clock limit per run (default: 10)\n"
+    "  -j jobs      candidate runs in parallel (default: online CPUs)\n"
+    "  -o file      write the minimized trace here (default: stdout)\n");
+}
+
+int main(int nargs, char **args)
+{
+  scenario t;
+  scenario original;
+  FILE *out = stdout;
+  const char *property_arg = "crash";
+  const char *output = NULL;
+  int opt;
+
+  jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  while ((opt = getopt(nargs, args, "p:r:s:x:t:j:o:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'p':
+        property_arg = optarg;
+        break;
+      case 'r':
+        runway_path = optarg;
+        break;
+      case 's':
+        seed_arg = optarg;
+        break;
+      case 'x':
+        speed_arg = optarg;
+        break;
+      case 't':
+        timeout = atof(optarg);
+        break;
+      case 'j':
+        jobs = atoi(optarg);
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      default:
+        usage();
+        return EINVAL;
+    }
+  }
+
+  if (optind != nargs - 1 || parse_property(property_arg) != 0)
+  {
+    usage();
+    return EINVAL;
+  }
+  if (jobs < 1)
+  {
+    jobs = 1;
+  }
+
+  if (scenario_load(&original, args[optind], MAX_AIRCRAFT) != 0)
+  {
+    fprintf(stderr, "runway-reduce: cannot open %s: %s\n", args[optind],
+            strerror(errno));
+    return 1;
+  }
+  if (original.num_aircraft == 0)
+  {
+    fprintf(stderr, "runway-reduce: %s has no aircraft\n", args[optind]);
+    return 1;
+  }
+  if (first_interesting(&original, 1) != 0)
+  {
+    fprintf(stderr, "runway-reduce: property '%s' does not hold on %s\n",
+            property_arg, args[optind]);
+    return 1;
+  }
+
+  scenario_copy(&t, &original);
+  reduce_lines(&t);
+  reduce_values(&t);
+
+  if (output && (out = fopen(output, "w")) == NULL)
+  {
+    perror("runway-reduce");
+    return 1;
+  }
+  fprintf(out, "# Minimized by runway-reduce from %s\n", args[optind]);
+  fprintf(out, "# Property: %s (seed %s, speed %s), %d -> %d aircraft, "
+          "%d runs\n", property_arg, seed_arg, speed_arg,
+          original.num_aircraft, t.num_aircraft, runs);
+  fprintf(out, "\n");
+  scenario_write(out, &t);
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+
+  scenario_free(&t);
+  scenario_free(&original);
+  return 0;
+}
@@ -0,0 +1,282 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* runway-replay: exact parallel replay of long traces on the reference
+ * model.
+ *
+ * Runs a trace through model_run() and through model_run_parallel(),
+ * which splits it at idle points of the runway and replays the pieces on
+ * a thread pool, checks that both give the same admissions, per-aircraft
+ * results and counters, and reports the time each took.  With -g a
+ * day-like trace of the given length is generated instead of reading one.
+ */
+
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include "runway.h"
+#include "scenario.h"
+#include "model.h"
+
+#define SEGMENTS_PER_JOB 8       /* default pieces per worker thread */
+
+static double elapsed_since(struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Traffic for the given number of hours in banks: busy half hours with a
+ * few seconds between arrivals and quiet ones with minutes between them,
+ * a controller shift change every eight hours.
+ */
+static void generate(scenario *sc, double hours, unsigned int seed)
+{
+  unsigned int state = seed;
+  scenario_event *e;
+  int length = (int)(hours * 3600);
+  int max_aircraft = length / 2 + 1;
+  int max_events = length / (8 * 3600) + 1;
+  int now = 0;
+  int r;
+
+  sc->aircraft = calloc(max_aircraft + 1, sizeof(scenario_aircraft));
+  sc->events = calloc(max_events + 1, sizeof(scenario_event));
+  sc->num_aircraft = 0;
+  sc->num_events = 0;
+  while (sc->num_aircraft < max_aircraft)
+  {
+    now += (now / 1800) % 2 == 0 ? rand_r(&state) % 13
+                                 : 30 + rand_r(&state) % 240;
+    if (now >= length)
+    {
+      break;
+    }
+    r = rand_r(&state) % 100;
+    sc->aircraft[sc->num_aircraft].aircraft_type = r < 45 ? COMMERCIAL
+                                                 : r < 95 ? CARGO : EMERGENCY;
+    sc->aircraft[sc->num_aircraft].arrival = now;
+    sc->aircraft[sc->num_aircraft].runway_time = 1 + rand_r(&state) % 8;
+    sc->aircraft[sc->num_aircraft].wake = WAKE_MEDIUM;
+    sc->aircraft[sc->num_aircraft].fuel_reserve = FUEL_RANDOM;
+    sc->num_aircraft++;
+  }
+  for (r = 8 * 3600; r < length && sc->num_events < max_events; r += 8 * 3600)
+  {
+    e = &sc->events[sc->num_events++];
+    e->time = r;
+    e->kind = EVENT_SHIFT;
+    e->aux = 60;
+  }
+  scenario_compile(sc);
+}
+
+/* Returns the first aircraft whose results differ, or -1. */
+static int compare(const scenario *sc, const model_result *a,
+                   const int *order_a, const model_result *b,
+                   const int *order_b)
+{
+  int i;
+
+  for (i = 0; i < sc->num_aircraft; i++)
+  {
+    if (order_a[i] != order_b[i])
+    {
+      return order_a[i];
+    }
+    if (a[i].admitted_at != b[i].admitted_at ||
+        a[i].cleared_at != b[i].cleared_at ||
+        a[i].direction != b[i].direction ||
+        a[i].fuel_emergency != b[i].fuel_emergency)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int same_metrics(const model_metrics *a, const model_metrics *b)
+{
+  return a->makespan == b->makespan && a->total_wait == b->total_wait &&
+         a->max_wait == b->max_wait &&
+         a->fuel_emergencies == b->fuel_emergencies &&
+         a->direction_switches == b->direction_switches &&
+         a->controller_breaks == b->controller_breaks &&
+         a->controller_shifts == b->controller_shifts;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: runway-replay [options] <trace file>\n"
+    "       runway-replay [options] -g hours\n"
+    "  -g hours     generate a trace this many hours long\n"
+    "  -j jobs      worker threads (default: online CPUs)\n"
+    "  -n pieces    pieces to split the trace into "
+    "(default: 8 per job)\n"
+    "  -s seed      seed for random fuel reserves and -g (default: 1)\n");
+}
+
+int main(int nargs, char **args)
+{
+  scenario sc;
+  model_result *sequential;
+  model_result *parallel;
+  model_metrics seq_metrics;
+  model_metrics par_metrics;
+  model_split_stats stats;
+  struct timespec start;
+  unsigned int seed = 1;
+  unsigned int state;
+  double hours = 0;
+  double seq_time;
+  double par_time;
+  int *seq_order;
+  int *par_order;
+  int jobs;
+  int pieces = 0;
+  int seq_status;
+  int par_status;
+  int differ;
+  int opt;
+  int i;
+
+  jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  while ((opt = getopt(nargs, args, "g:j:n:s:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'g':
+        hours = atof(optarg);
+        break;
+      case 'j':
+        jobs = atoi(optarg);
+        break;
+      case 'n':
+        pieces = atoi(optarg);
+        break;
+      case 's':
+        seed = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      default:
+        usage();
+        return EINVAL;
+    }
+  }
+  if (jobs < 1)
+  {
+    jobs = 1;
+  }
+  if (pieces <= 0)
+  {
+    pieces = jobs * SEGMENTS_PER_JOB;
+  }
+
+  if (hours > 0 && optind == nargs)
+  {
+    generate(&sc, hours, seed);
+  }
+  else if (hours <= 0 && optind == nargs - 1)
+  {
+    if (scenario_load(&sc, args[optind], MAX_AIRCRAFT * 1000) != 0)
+    {
+      fprintf(stderr, "runway-replay: cannot open %s: %s\n", args[optind],
+              strerror(errno));
+      return 1;
+    }
+  }
+  else
+  {
+    usage();
+    return EINVAL;
+  }
+
+  /* The model needs every fuel reserve; draw the missing ones */
+  state = seed;
+  for (i = 0; i < sc.num_aircraft; i++)
+  {
+    if (sc.aircraft[i].fuel_reserve == FUEL_RANDOM)
+    {
+      sc.aircraft[i].fuel_reserve = FUEL_MIN +
+                                    rand_r(&state) % (FUEL_MAX - FUEL_MIN + 1);
+    }
+  }
+
+  sequential = calloc(sc.num_aircraft + 1, sizeof(model_result));
+  parallel = calloc(sc.num_aircraft + 1, sizeof(model_result));
+  seq_order = calloc(sc.num_aircraft + 1, sizeof(int));
+  par_order = calloc(sc.num_aircraft + 1, sizeof(int));
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  seq_status = model_run(&sc, sequential, seq_order, &seq_metrics);
+  seq_time = elapsed_since(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  par_status = model_run_parallel(&sc, parallel, par_order, &par_metrics,
+                                  jobs, pieces, &stats);
+  par_time = elapsed_since(&start);
+
+  printf("Trace: %d aircraft, %d events, %.1f hours\n", sc.num_aircraft,
+         sc.num_events, seq_metrics.makespan / 3600);
+  printf("Sequential: %8.3f s\n", seq_time);
+  printf("Parallel:   %8.3f s on %d jobs, speedup %.2f\n", par_time, jobs,
+         par_time > 0 ? seq_time / par_time : 0);
+  printf("Pieces: %d, %d cuts dropped (runway busy), %d replays in %d "
+         "rounds\n", stats.segments, stats.merged, stats.replays,
+         stats.rounds);
+  printf("Work: %.2f times the events of the sequential run, speedup at "
+         "most %.1f on %d CPUs\n", (double)stats.events / sc.num_events,
+         (double)sc.num_events * jobs / stats.events, jobs);
+
+  differ = seq_status != par_status ? -2
+         : compare(&sc, sequential, seq_order, parallel, par_order);
+  if (differ == -2)
+  {
+    printf("DIFFERENT: sequential run returned %d, parallel %d\n",
+           seq_status, par_status);
+  }
+  else if (differ >= 0)
+  {
+    printf("DIFFERENT: aircraft %d admitted at %.0f sequentially, %.0f in "
+           "parallel\n", differ, sequential[differ].admitted_at,
+           parallel[differ].admitted_at);
+  }
+  else if (!same_metrics(&seq_metrics, &par_metrics))
+  {
+    differ = -2;
+    printf("DIFFERENT: counters\n");
+  }
+  else
+  {
+    printf("Identical to the sequential run.\n");
+  }
+
+  free(sequential);
+  free(parallel);
+  free(seq_order);
+  free(par_order);
+  scenario_free(&sc);
+  return differ == -1 ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* runway-top: live view of a running simulation.
+ *
+ * Attaches to the shared-memory state a simulation started with
+ * --live NAME publishes (live.h) and redraws it several times a second:
+ * who is waiting, who is on the runway, the flow direction and how many
+ * aircraft have gone that way in a row, the controller's break count and
+ * any break, switch or handover under way, throughput over a recent
+ * window and over the run, and percentiles of the waits of the last
+ * LIVE_WAITS arrivals that landed.  It only ever reads the segment, so
+ * it cannot slow the simulation down, and it waits for the simulation if
+ * it has not started yet.
+ */
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#include "runway.h"
+#include "live.h"
+
+#define HISTORY 4096             /* throughput samples kept */
+
+static const char *controller_names[] =
+{
+  "working", "on a break", "switching direction", "handing over"
+};
+
+/* Throughput samples: simulated time and totals at each refresh */
+typedef struct
+{
+  double time;
+  long landed;
+  long departed;
+} sample;
+
+static sample history[HISTORY];
+static long samples;
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: runway-top [options] [name]\n"
+    "  name         shared-memory object given to runway --live "
+    "(default: /runway)\n"
+    "  -i ms        refresh interval (default: 250)\n"
+    "  -w seconds   simulated seconds of the recent throughput window "
+    "(default: 300)\n"
+    "  -1           print the state once, without clearing the screen\n");
+}
+
+static int compare_floats(const void *a, const void *b)
+{
+  float x = *(const float *)a;
+  float y = *(const float *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Returns the nearest-rank percentile p of n sorted values. */
+static double percentile(const float *sorted, int n, int p)
+{
+  int rank = (p * n + 99) / 100;
+
+  return n > 0 ? sorted[rank > 0 ? rank - 1 : 0] : 0;
+}
+
+/* Simulated time now, from the run's epoch and speed. */
+static double sim_time(const live_state *s)
+{
+  struct timespec now;
+
+  if (s->finished || s->speed <= 0)
+  {
+    return s->updated_at;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((double)(now.tv_sec - s->epoch_sec) +
+          (double)(now.tv_nsec - s->epoch_nsec) / 1e9) * s->speed;
+}
+
+/* Records a sample and returns the oldest one inside the window. */
+static const sample *remember(double time, const live_state *s,
+                              double window)
+{
+  const sample *oldest;
+  long i;
+
+  history[samples % HISTORY].time = time;
+  history[samples % HISTORY].landed = s->landed;
+  history[samples % HISTORY].departed = s->departed;
+  samples++;
+
+  oldest = &history[(samples - 1) % HISTORY];
+  for (i = samples - 1; i >= 0 && i > samples - HISTORY; i--)
+  {
+    if (history[i % HISTORY].time < time - window)
+    {
+      break;
+    }
+    oldest = &history[i % HISTORY];
+  }
+  return oldest;
+}
+
+static void show(const char *name, const live_state *s, double window,
+                 int clear)
+{
+  static float waits[LIVE_WAITS];
+  const sample *oldest;
+  double now = sim_time(s);
+  double span;
+  int n;
+
+  oldest = remember(now, s, window);
+  if (clear)
+  {
+    printf("\033[H\033[2J");
+  }
+  printf("runway-top  %s  pid %d  simulated %02d:%02d:%02d (x%g)%s\n\n",
+         name, s->pid, (int)now / 3600, (int)now / 60 % 60, (int)now % 60,
+         s->speed, s->finished ? "  finished" : "");
+
+  printf("Runway      direction %s, %d in a row, capacity %d\n",
+         s->direction == NORTH ? "NORTH" : "SOUTH",
+         s->consecutive_direction, s->capacity);
+  printf("  on it     commercial %d  cargo %d  emergency %d  "
+         "departures %d\n",
+         s->on_runway[COMMERCIAL], s->on_runway[CARGO],
+         s->on_runway[EMERGENCY], s->departures_on_runway);
+  printf("Controller  %s", controller_names[s->controller]);
+  if (s->controller != LIVE_WORKING)
+  {
+    printf(", %.0f s to go", s->controller_until > now ?
+                             s->controller_until - now : 0);
+  }
+  printf(", %d aircraft since the last break\n", s->aircraft_since_break);
+  printf("Waiting     commercial %d  cargo %d  emergency %d  "
+         "departures %d\n",
+         s->waiting[COMMERCIAL], s->waiting[CARGO], s->waiting[EMERGENCY],
+         s->waiting_departures);
+  printf("  for       north %d  south %d  fuel emergencies %d\n",
+         s->waiting_north, s->waiting_south, s->fuel_emergency_waiting);
+  printf("Totals      landed %ld  departed %ld  diverted %ld  "
+         "switches %d  breaks %d\n",
+         s->landed, s->departed, s->diverted, s->direction_switches,
+         s->controller_breaks);
+
+  span = now - oldest->time;
+  printf("Throughput  ");
+  if (span > 0)
+  {
+    printf("%.1f arrivals/h, %.1f departures/h over the last %.0f s",
+           (s->landed - oldest->landed) * 3600 / span,
+           (s->departed - oldest->departed) * 3600 / span, span);
+  }
+  if (now > 0)
+  {
+    printf("%s%.1f arrivals/h over the run", span > 0 ? "; " : "",
+           s->landed * 3600 / now);
+  }
+  printf("\n");
+
+  n = s->waits_seen < LIVE_WAITS ? (int)s->waits_seen : LIVE_WAITS;
+  memcpy(waits, s->waits, sizeof(float) * n);
+  qsort(waits, n, sizeof(float), compare_floats);
+  printf("Waits       ");
+  if (n > 0)
+  {
+    printf("p50 %.1f s  p90 %.1f s  p99 %.1f s  max %.1f s "
+           "(last %d landed)\n", percentile(waits, n, 50),
+           percentile(waits, n, 90), percentile(waits, n, 99),
+           waits[n - 1], n);
+  }
+  else
+  {
+    printf("none landed yet\n");
+  }
+  fflush(stdout);
+}
+
+int main(int nargs, char **args)
+{
+  const char *name = "/runway";
+  const live_state *live = NULL;
+  live_state copy;
+  struct timespec delay;
+  double window = 300;
+  int interval = 250;
+  int once = 0;
+  int waiting = 0;
+  int opt;
+
+  while ((opt = getopt(nargs, args, "i:w:1")) != -1)
+  {
+    switch (opt)
+    {
+      case 'i':
+        interval = atoi(optarg);
+        break;
+      case 'w':
+        window = atof(optarg);
+        break;
+      case '1':
+        once = 1;
+        break;
+      default:
+        usage();
+        return EINVAL;
+    }
+  }
+  if (optind < nargs - 1 || interval < 1 || window <= 0)
+  {
+    usage();
+    return EINVAL;
+  }
+  if (optind == nargs - 1)
+  {
+    name = args[optind];
+  }
+
+  delay.tv_sec = interval / 1000;
+  delay.tv_nsec = (long)(interval % 1000) * 1000000;
+  while (1)
+  {
+    if (live == NULL && (live = live_attach(name)) == NULL)
+    {
+      if (once)
+      {
+        fprintf(stderr, "runway-top: no live view %s\n", name);
+        return 1;
+      }
+      if (!waiting)
+      {
+        printf("runway-top: waiting for a run with --live %s ...\n", name);
+        fflush(stdout);
+        waiting = 1;
+      }
+    }
+    else if (live_read(live, &copy) == 0)
+    {
+      show(name, &copy, window, !once);
+      if (once || copy.finished)
+      {
+        break;
+      }
+
+      /* A run that was killed leaves its segment behind */
+      if (kill(copy.pid, 0) != 0 && errno == ESRCH)
+      {
+        printf("\nrunway-top: the simulation has gone away\n");
+        live_detach(live);
+        return 1;
+      }
+    }
+    nanosleep(&delay, NULL);
+  }
+  live_detach(live);
+  return 0;
+}
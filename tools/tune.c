@@ -0,0 +1,565 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* runway-tune: successive-halving tuner for the rule parameters.
+ *
+ * Treats the direction limit, the fairness limit, the direction switch
+ * threshold and, where policy allows (-C), the controller limit as a
+ * search space.  Random configurations, plus the defaults of runway.h,
+ * are run on one trace as in-process librunway simulations on a pool of
+ * worker threads.  After each rung the best third survive and are run
+ * with three times as many fuel seeds, until one is left.  The winner's
+ * neighbourhood is then swept one parameter at a time, which gives each
+ * parameter a sensitivity score: how far the objective moves over its
+ * range with the others held at their best values.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "librunway.h"
+#include "runway.h"
+
+#define TUNE_ETA 3               /* 1 in TUNE_ETA candidates survive a rung */
+#define TUNE_FAILED 1e9          /* score of a run that did not finish */
+#define TUNE_STALL 600           /* simulated seconds of stall that fail a run */
+
+enum
+{
+  KNOB_DIRECTION,
+  KNOB_FAIRNESS,
+  KNOB_CONTROLLER,
+  KNOB_SWITCH,
+  NUM_KNOBS
+};
+
+typedef struct
+{
+  const char *name;
+  int low;
+  int high;
+  int tuned;                /* zero keeps the default */
+} knob;
+
+static knob knobs[NUM_KNOBS] =
+{
+  { "direction_limit", 1, 8, 1 },
+  { "fairness_limit", 1, 8, 1 },
+  { "controller_limit", 4, 16, 0 },
+  { "switch_threshold", 1, 4, 1 }
+};
+
+static const int defaults[NUM_KNOBS] =
+{
+  DIRECTION_LIMIT, FAIRNESS_LIMIT, CONTROLLER_LIMIT, 1
+};
+
+/* Objectives (-m): which metric of a run is minimized */
+enum
+{
+  OBJ_WAIT,                 /* average wait */
+  OBJ_P90,                  /* 90th percentile wait */
+  OBJ_MAX,                  /* longest wait */
+  OBJ_MAKESPAN
+};
+
+typedef struct
+{
+  int value[NUM_KNOBS];
+  double total;             /* sum of the scores of its runs */
+  int runs;
+  int rung;                 /* last rung it was run in */
+} candidate;
+
+/* One simulation to run: a configuration and a fuel seed */
+typedef struct
+{
+  const int *value;
+  unsigned int seed;
+  double score;
+} tune_job;
+
+typedef struct
+{
+  tune_job *jobs;
+  int num_jobs;
+  int next;
+  pthread_mutex_t mutex;
+} job_queue;
+
+static const char *trace_text;
+static size_t trace_length;
+static double speed = 100;
+static unsigned int base_seed = 1;
+static int objective = OBJ_WAIT;
+static int jobs = 1;
+static int total_runs = 0;
+
+static double score_of(const runway_metrics *m)
+{
+  switch (objective)
+  {
+    case OBJ_P90:
+      return m->wait_p90;
+    case OBJ_MAX:
+      return m->max_wait;
+    case OBJ_MAKESPAN:
+      return m->makespan;
+    default:
+      return m->average_wait;
+  }
+}
+
+/* Runs the trace once with the given parameters and fuel seed. */
+static double run_once(const int *value, unsigned int seed)
+{
+  runway_config config;
+  runway_metrics m;
+  runway_sim *sim;
+  double score = TUNE_FAILED;
+
+  runway_config_defaults(&config);
+  config.seed = seed;
+  config.speed = speed;
+  config.direction_limit = value[KNOB_DIRECTION];
+  config.fairness_limit = value[KNOB_FAIRNESS];
+  config.controller_limit = value[KNOB_CONTROLLER];
+  config.switch_threshold = value[KNOB_SWITCH];
+  config.stall_limit = TUNE_STALL;
+
+  if ((sim = runway_create(&config)) == NULL)
+  {
+    return score;
+  }
+  if (runway_load_buffer(sim, trace_text, trace_length) == 0 &&
+      runway_run(sim) == 0)
+  {
+    runway_get_metrics(sim, &m);
+    score = score_of(&m);
+  }
+  runway_destroy(sim);
+  return score;
+}
+
+static void * tune_worker(void *arg)
+{
+  job_queue *q = (job_queue *)arg;
+  int i;
+
+  while (1)
+  {
+    pthread_mutex_lock(&q->mutex);
+    i = q->next < q->num_jobs ? q->next++ : -1;
+    pthread_mutex_unlock(&q->mutex);
+    if (i < 0)
+    {
+      break;
+    }
+    q->jobs[i].score = run_once(q->jobs[i].value, q->jobs[i].seed);
+  }
+
+  return NULL;
+}
+
+/* Runs all jobs, at most `jobs` at a time. */
+static void run_jobs(tune_job *list, int count)
+{
+  job_queue q;
+  pthread_t *workers;
+  int started;
+  int n = jobs < count ? jobs : count;
+  int i;
+
+  q.jobs = list;
+  q.num_jobs = count;
+  q.next = 0;
+  pthread_mutex_init(&q.mutex, NULL);
+  workers = malloc(sizeof(pthread_t) * (n + 1));
+  for (started = 0; started < n; started++)
+  {
+    if (pthread_create(&workers[started], NULL, tune_worker, &q))
+    {
+      break;
+    }
+  }
+  if (started == 0)
+  {
+    tune_worker(&q);
+  }
+  for (i = 0; i < started; i++)
+  {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+  pthread_mutex_destroy(&q.mutex);
+  total_runs += count;
+}
+
+static double mean(const candidate *c)
+{
+  return c->runs > 0 ? c->total / c->runs : TUNE_FAILED;
+}
+
+/* Candidates that got furthest first, then by mean score. */
+static int by_rank(const void *a, const void *b)
+{
+  const candidate *x = a;
+  const candidate *y = b;
+
+  if (x->rung != y->rung)
+  {
+    return y->rung - x->rung;
+  }
+  return mean(x) < mean(y) ? -1 : mean(x) > mean(y);
+}
+
+/* Brings each of the first count candidates up to `seeds` runs. */
+static void evaluate(candidate *list, int count, int seeds, int rung)
+{
+  tune_job *work = malloc(sizeof(tune_job) * (count * seeds + 1));
+  int num_jobs = 0;
+  int i;
+  int s;
+
+  for (i = 0; i < count; i++)
+  {
+    for (s = list[i].runs; s < seeds; s++)
+    {
+      work[num_jobs].value = list[i].value;
+      work[num_jobs].seed = base_seed + s;
+      num_jobs++;
+    }
+  }
+  run_jobs(work, num_jobs);
+
+  num_jobs = 0;
+  for (i = 0; i < count; i++)
+  {
+    for (s = list[i].runs; s < seeds; s++)
+    {
+      list[i].total += work[num_jobs++].score;
+    }
+    list[i].runs = seeds;
+    list[i].rung = rung;
+  }
+  free(work);
+}
+
+static int same_values(const int *a, const int *b)
+{
+  return memcmp(a, b, sizeof(int) * NUM_KNOBS) == 0;
+}
+
+/* Fills list with the defaults followed by distinct random
+ * configurations.  Returns how many there are; small search spaces may
+ * have fewer than asked for.
+ */
+static int sample(candidate *list, int count)
+{
+  unsigned int state = base_seed;
+  int n = 0;
+  int tries;
+  int i;
+  int k;
+
+  memset(list, 0, sizeof(candidate) * count);
+  memcpy(list[n++].value, defaults, sizeof(defaults));
+  for (tries = 0; n < count && tries < count * 100; tries++)
+  {
+    for (k = 0; k < NUM_KNOBS; k++)
+    {
+      list[n].value[k] = knobs[k].tuned ?
+                         knobs[k].low + (int)(rand_r(&state) %
+                                    (knobs[k].high - knobs[k].low + 1)) :
+                         defaults[k];
+    }
+    for (i = 0; i < n && !same_values(list[i].value, list[n].value); i++)
+    {
+    }
+    if (i == n)
+    {
+      n++;
+    }
+  }
+  return n;
+}
+
+/* Sweeps each tuned parameter over its range around best, with the
+ * other parameters at their best values, and prints how much the mean
+ * score moves.
+ */
+static void sensitivity(const candidate *best, int seeds)
+{
+  candidate sweep[NUM_KNOBS][32];
+  double range[NUM_KNOBS];
+  int best_value[NUM_KNOBS];
+  int stalled[NUM_KNOBS];
+  double total_range = 0;
+  double low;
+  double high;
+  int count;
+  int k;
+  int i;
+
+  for (k = 0; k < NUM_KNOBS; k++)
+  {
+    range[k] = 0;
+    stalled[k] = 0;
+    if (!knobs[k].tuned)
+    {
+      continue;
+    }
+    count = knobs[k].high - knobs[k].low + 1;
+    memset(sweep[k], 0, sizeof(candidate) * count);
+    for (i = 0; i < count; i++)
+    {
+      memcpy(sweep[k][i].value, best->value, sizeof(best->value));
+      sweep[k][i].value[k] = knobs[k].low + i;
+    }
+    evaluate(sweep[k], count, seeds, 0);
+
+    /* Values whose runs stall are counted but kept out of the range */
+    low = TUNE_FAILED;
+    high = 0;
+    best_value[k] = best->value[k];
+    for (i = 0; i < count; i++)
+    {
+      if (mean(&sweep[k][i]) >= TUNE_FAILED)
+      {
+        stalled[k]++;
+        continue;
+      }
+      if (mean(&sweep[k][i]) < low)
+      {
+        low = mean(&sweep[k][i]);
+        best_value[k] = knobs[k].low + i;
+      }
+      if (mean(&sweep[k][i]) > high)
+      {
+        high = mean(&sweep[k][i]);
+      }
+    }
+    range[k] = low < high ? high - low : 0;
+    total_range += range[k];
+  }
+
+  printf("\nSensitivity (objective range over each parameter with the "
+         "others at their best, %d seeds):\n", seeds);
+  for (k = 0; k < NUM_KNOBS; k++)
+  {
+    if (!knobs[k].tuned)
+    {
+      printf("  %-18s fixed at %d\n", knobs[k].name, defaults[k]);
+      continue;
+    }
+    printf("  %-18s %9.2f  score %.2f  best %d of %d-%d", knobs[k].name,
+           range[k], total_range > 0 ? range[k] / total_range : 0,
+           best_value[k], knobs[k].low, knobs[k].high);
+    if (stalled[k] > 0)
+    {
+      printf("  (%d stall)", stalled[k]);
+    }
+    printf("\n");
+  }
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: runway-tune [options] <trace file>\n"
+    "  -n count     random configurations in the first rung (default: 27)\n"
+    "  -m metric    wait | p90 | max | makespan to minimize "
+    "(default: wait)\n"
+    "  -C           tune controller_limit too, where policy allows it\n"
+    "  -r seeds     seeds per point of the sensitivity sweep "
+    "(default: 3)\n"
+    "  -s seed      first fuel seed and sampler seed (default: 1)\n"
+    "  -x speed     simulation clock speed (default: 100)\n"
+    "  -j jobs      simulations run at the same time "
+    "(default: online CPUs)\n");
+}
+
+/* Reads the whole trace so every simulation can load it from memory. */
+static int read_trace(const char *filename)
+{
+  FILE *fp;
+  char *text;
+  long length;
+
+  if ((fp = fopen(filename, "rb")) == NULL)
+  {
+    perror("runway-tune");
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  length = ftell(fp);
+  rewind(fp);
+  if (length <= 0 || (text = malloc(length)) == NULL ||
+      fread(text, 1, length, fp) != (size_t)length)
+  {
+    fprintf(stderr, "runway-tune: cannot read %s\n", filename);
+    fclose(fp);
+    return -1;
+  }
+  fclose(fp);
+  trace_text = text;
+  trace_length = (size_t)length;
+  return 0;
+}
+
+int main(int nargs, char **args)
+{
+  static const char *metric_names[] =
+  {
+    "average wait", "90th percentile wait", "max wait", "makespan"
+  };
+  candidate *list;
+  int count = 27;
+  int sweep_seeds = 3;
+  int alive;
+  int seeds = 1;
+  int rung = 0;
+  int opt;
+  int i;
+  int k;
+
+  jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  while ((opt = getopt(nargs, args, "n:m:Cr:s:x:j:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n':
+        count = atoi(optarg);
+        break;
+      case 'm':
+        if (strcmp(optarg, "wait") == 0)
+        {
+          objective = OBJ_WAIT;
+        }
+        else if (strcmp(optarg, "p90") == 0)
+        {
+          objective = OBJ_P90;
+        }
+        else if (strcmp(optarg, "max") == 0)
+        {
+          objective = OBJ_MAX;
+        }
+        else if (strcmp(optarg, "makespan") == 0)
+        {
+          objective = OBJ_MAKESPAN;
+        }
+        else
+        {
+          usage();
+          return EINVAL;
+        }
+        break;
+      case 'C':
+        knobs[KNOB_CONTROLLER].tuned = 1;
+        break;
+      case 'r':
+        sweep_seeds = atoi(optarg);
+        break;
+      case 's':
+        base_seed = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'x':
+        speed = atof(optarg);
+        break;
+      case 'j':
+        jobs = atoi(optarg);
+        break;
+      default:
+        usage();
+        return EINVAL;
+    }
+  }
+
+  if (optind != nargs - 1 || count < 1 || sweep_seeds < 1 || speed <= 0)
+  {
+    usage();
+    return EINVAL;
+  }
+  if (jobs < 1)
+  {
+    jobs = 1;
+  }
+  if (read_trace(args[optind]) != 0)
+  {
+    return 1;
+  }
+
+  list = malloc(sizeof(candidate) * (count + 1));
+  count = sample(list, count + 1);
+
+  /* Successive halving: each rung keeps the best 1 in TUNE_ETA and runs
+   * them with TUNE_ETA times as many seeds.
+   */
+  for (alive = count; ; alive = (alive + TUNE_ETA - 1) / TUNE_ETA)
+  {
+    evaluate(list, alive, seeds, rung);
+    qsort(list, alive, sizeof(candidate), by_rank);
+    fprintf(stderr, "runway-tune: rung %d, %d configurations, %d seeds, "
+            "best %.2f\n", rung, alive, seeds, mean(&list[0]));
+    if (alive == 1)
+    {
+      break;
+    }
+    seeds *= TUNE_ETA;
+    rung++;
+  }
+  qsort(list, count, sizeof(candidate), by_rank);
+
+  printf("Tuning %s: %d configurations, objective %s, speed %.0f\n",
+         args[optind], count, metric_names[objective], speed);
+  printf("\nRank");
+  for (k = 0; k < NUM_KNOBS; k++)
+  {
+    printf(" %s", knobs[k].name);
+  }
+  printf("  score  seeds\n");
+  for (i = 0; i < count; i++)
+  {
+    printf("%4d", i + 1);
+    for (k = 0; k < NUM_KNOBS; k++)
+    {
+      printf(" %*d", (int)strlen(knobs[k].name), list[i].value[k]);
+    }
+    if (mean(&list[i]) >= TUNE_FAILED)
+    {
+      printf("  stall");
+    }
+    else
+    {
+      printf(" %6.2f", mean(&list[i]));
+    }
+    printf(" %6d%s\n", list[i].runs,
+           same_values(list[i].value, defaults) ? "  (defaults)" : "");
+  }
+
+  sensitivity(&list[0], sweep_seeds);
+  printf("\n%d simulations run\n", total_runs);
+
+  free(list);
+  free((char *)trace_text);
+  return 0;
+}
@@ -0,0 +1,576 @@
+/* Copyright (c) 2025 Trevor Bakker
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABLIITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/license/>.
+ */
+
+/* Asynchronous log writer (runway_writer_* in librunway.h).
+ *
+ * Producers copy each record into the buffer being filled under a mutex
+ * that is held only for the copy; they never make a system call.  A full
+ * buffer is queued for a flusher thread and the producer moves on to a
+ * free one, or drops the record if every buffer is waiting for the disk.
+ * The flusher writes the queued buffers through io_uring, with up to
+ * WRITER_RING_DEPTH writes in flight at their file offsets, or with one
+ * writev(2) per batch where io_uring is unavailable.  A partly filled
+ * buffer is flushed after WRITER_FLUSH_INTERVAL so that a slow run still
+ * reaches the file.
+ *
+ * The ring is set up with the raw system calls and <linux/io_uring.h>,
+ * so no liburing is needed.
+ */
+
+#define _GNU_SOURCE
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "librunway.h"
+
+#define WRITER_BUFFER_SIZE (1 << 20)     /* bytes of one output buffer */
+#define WRITER_BUFFERS 16                /* buffers of one writer */
+#define WRITER_ALIGN 4096                /* buffers start on a page */
+#define WRITER_RING_DEPTH 8              /* io_uring writes in flight */
+#define WRITER_FLUSH_INTERVAL 0.2        /* seconds before a partly filled
+                                            buffer is written anyway */
+#define WRITER_RECORD_SIZE 512           /* longest formatted record */
+
+/* The mapped io_uring submission and completion rings */
+typedef struct
+{
+  int fd;
+  void *sq_map;
+  size_t sq_map_size;
+  void *cq_map;
+  size_t cq_map_size;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+} uring;
+
+struct runway_writer
+{
+  int fd;
+  int backend;              /* RUNWAY_WRITER_URING or _THREAD */
+  uring ring;
+  off_t offset;             /* file offset of the next buffer written */
+
+  pthread_mutex_t lock;
+  pthread_cond_t ready;     /* a buffer is full, or the writer closes */
+  char *memory;             /* all buffers, WRITER_ALIGN aligned */
+  size_t fill[WRITER_BUFFERS];
+  int current;              /* buffer being filled, or -1 if none free */
+  int free_list[WRITER_BUFFERS];
+  int num_free;
+  int full[WRITER_BUFFERS]; /* buffers waiting to be written, oldest first */
+  int num_full;
+  int closing;
+  pthread_t tid;
+
+  runway_writer_stats stats;
+};
+
+#define BUFFER(w, i) ((w)->memory + (size_t)(i) * WRITER_BUFFER_SIZE)
+
+static int uring_setup(uring *r, unsigned entries)
+{
+  struct io_uring_params p;
+
+  memset(&p, 0, sizeof(p));
+  r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+  if (r->fd < 0)
+  {
+    return -1;
+  }
+
+  r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  r->cq_map_size = p.cq_off.cqes +
+                   p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (r->cq_map_size > r->sq_map_size)
+    {
+      r->sq_map_size = r->cq_map_size;
+    }
+    r->cq_map_size = 0;
+  }
+  r->sq_map = mmap(NULL, r->sq_map_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  if (r->sq_map == MAP_FAILED)
+  {
+    close(r->fd);
+    return -1;
+  }
+  r->cq_map = r->sq_map;
+  if (r->cq_map_size > 0)
+  {
+    r->cq_map = mmap(NULL, r->cq_map_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    if (r->cq_map == MAP_FAILED)
+    {
+      munmap(r->sq_map, r->sq_map_size);
+      close(r->fd);
+      return -1;
+    }
+  }
+  r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  if (r->sqes == MAP_FAILED)
+  {
+    if (r->cq_map_size > 0)
+    {
+      munmap(r->cq_map, r->cq_map_size);
+    }
+    munmap(r->sq_map, r->sq_map_size);
+    close(r->fd);
+    return -1;
+  }
+
+  r->sq_tail = (unsigned *)((char *)r->sq_map + p.sq_off.tail);
+  r->sq_mask = (unsigned *)((char *)r->sq_map + p.sq_off.ring_mask);
+  r->sq_array = (unsigned *)((char *)r->sq_map + p.sq_off.array);
+  r->cq_head = (unsigned *)((char *)r->cq_map + p.cq_off.head);
+  r->cq_tail = (unsigned *)((char *)r->cq_map + p.cq_off.tail);
+  r->cq_mask = (unsigned *)((char *)r->cq_map + p.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe *)((char *)r->cq_map + p.cq_off.cqes);
+  return 0;
+}
+
+static void uring_close(uring *r)
+{
+  munmap(r->sqes, r->sqes_size);
+  if (r->cq_map_size > 0)
+  {
+    munmap(r->cq_map, r->cq_map_size);
+  }
+  munmap(r->sq_map, r->sq_map_size);
+  close(r->fd);
+}
+
+/* Queues a write of length bytes at offset; tag comes back with its
+ * completion.  Only the flusher touches the ring, so the tail needs no
+ * lock, only ordering against the kernel.
+ */
+static void uring_write(uring *r, int fd, const char *data, size_t length,
+                        off_t offset, unsigned long long tag)
+{
+  unsigned tail = *r->sq_tail;
+  unsigned index = tail & *r->sq_mask;
+  struct io_uring_sqe *sqe = &r->sqes[index];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = fd;
+  sqe->addr = (unsigned long long)(size_t)data;
+  sqe->len = (unsigned)length;
+  sqe->off = (unsigned long long)offset;
+  sqe->user_data = tag;
+  r->sq_array[index] = index;
+  __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Submits the queued writes and waits for wanted completions. */
+static int uring_enter(uring *r, unsigned submit, unsigned wanted)
+{
+  long result;
+
+  do
+  {
+    result = syscall(__NR_io_uring_enter, r->fd, submit, wanted,
+                     IORING_ENTER_GETEVENTS, NULL, 0);
+  }
+  while (result < 0 && errno == EINTR);
+  return result < 0 ? -1 : 0;
+}
+
+/* Takes the next completion, if there is one.  Returns 0 or -1. */
+static int uring_reap(uring *r, unsigned long long *tag, int *res)
+{
+  unsigned head = *r->cq_head;
+  struct io_uring_cqe *cqe;
+
+  if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+  {
+    return -1;
+  }
+  cqe = &r->cqes[head & *r->cq_mask];
+  *tag = cqe->user_data;
+  *res = cqe->res;
+  __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/* Writes buffers batch[0 .. count - 1], in order, through the ring. */
+static int write_uring(runway_writer *w, const int *batch, int count)
+{
+  size_t done[WRITER_BUFFERS];
+  off_t offset[WRITER_BUFFERS];
+  unsigned long long tag;
+  int next = 0;
+  int in_flight = 0;
+  int queued = 0;
+  int failed = 0;
+  int res;
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    done[i] = 0;
+    offset[i] = w->offset;
+    w->offset += (off_t)w->fill[batch[i]];
+  }
+
+  while (next < count || in_flight > 0)
+  {
+    for (; next < count && in_flight < WRITER_RING_DEPTH; next++)
+    {
+      uring_write(&w->ring, w->fd, BUFFER(w, batch[next]),
+                  w->fill[batch[next]], offset[next],
+                  (unsigned long long)next);
+      in_flight++;
+      queued++;
+    }
+    if (uring_enter(&w->ring, (unsigned)queued, 1) != 0)
+    {
+      return -1;
+    }
+    w->stats.writes += queued;
+    queued = 0;
+    while (uring_reap(&w->ring, &tag, &res) == 0)
+    {
+      in_flight--;
+      i = (int)tag;
+      if (res < 0)
+      {
+        failed = 1;
+        continue;
+      }
+      /* A short write goes back in for the rest of the buffer */
+      done[i] += (size_t)res;
+      if (res > 0 && done[i] < w->fill[batch[i]])
+      {
+        uring_write(&w->ring, w->fd, BUFFER(w, batch[i]) + done[i],
+                    w->fill[batch[i]] - done[i], offset[i] + done[i],
+                    tag);
+        in_flight++;
+        queued++;
+      }
+      else if (res == 0)
+      {
+        failed = 1;
+      }
+    }
+  }
+  return failed ? -1 : 0;
+}
+
+/* Writes buffers batch[0 .. count - 1] with as few writev() calls as
+ * the kernel allows.
+ */
+static int write_thread(runway_writer *w, const int *batch, int count)
+{
+  struct iovec iov[WRITER_BUFFERS];
+  struct iovec *first = iov;
+  ssize_t written;
+  int left = count;
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    iov[i].iov_base = BUFFER(w, batch[i]);
+    iov[i].iov_len = w->fill[batch[i]];
+    w->offset += (off_t)w->fill[batch[i]];
+  }
+  while (left > 0)
+  {
+    written = writev(w->fd, first, left);
+    w->stats.writes++;
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    while (left > 0 && (size_t)written >= first->iov_len)
+    {
+      written -= (ssize_t)first->iov_len;
+      first++;
+      left--;
+    }
+    if (left > 0)
+    {
+      first->iov_base = (char *)first->iov_base + written;
+      first->iov_len -= (size_t)written;
+    }
+  }
+  return 0;
+}
+
+/* Queues the buffer being filled, if it holds anything.  Called with the
+ * lock held.
+ */
+static void seal_current(runway_writer *w)
+{
+  if (w->current < 0 || w->fill[w->current] == 0)
+  {
+    return;
+  }
+  w->full[w->num_full++] = w->current;
+  w->current = w->num_free > 0 ? w->free_list[--w->num_free] : -1;
+  pthread_cond_signal(&w->ready);
+}
+
+static void flush_deadline(struct timespec *ts)
+{
+  clock_gettime(CLOCK_REALTIME, ts);
+  ts->tv_nsec += (long)(WRITER_FLUSH_INTERVAL * 1e9);
+  if (ts->tv_nsec >= 1000000000L)
+  {
+    ts->tv_sec += 1;
+    ts->tv_nsec -= 1000000000L;
+  }
+}
+
+/* Code for the flusher: writes full buffers until the writer closes and
+ * everything has been written.
+ */
+static void * flusher(void *arg)
+{
+  runway_writer *w = (runway_writer *)arg;
+  struct timespec ts;
+  int batch[WRITER_BUFFERS];
+  int count;
+  int result;
+  int i;
+
+  pthread_mutex_lock(&w->lock);
+  while (1)
+  {
+    if (w->num_full == 0 && !w->closing)
+    {
+      flush_deadline(&ts);
+      if (pthread_cond_timedwait(&w->ready, &w->lock, &ts) == ETIMEDOUT)
+      {
+        seal_current(w);
+      }
+    }
+    if (w->closing)
+    {
+      seal_current(w);
+    }
+    if (w->num_full == 0)
+    {
+      if (w->closing)
+      {
+        break;
+      }
+      continue;
+    }
+
+    count = w->num_full;
+    memcpy(batch, w->full, sizeof(int) * count);
+    w->num_full = 0;
+    pthread_mutex_unlock(&w->lock);
+
+    if (w->backend == RUNWAY_WRITER_URING)
+    {
+      result = write_uring(w, batch, count);
+    }
+    else
+    {
+      result = write_thread(w, batch, count);
+    }
+
+    pthread_mutex_lock(&w->lock);
+    if (result != 0)
+    {
+      w->stats.errors++;
+    }
+    for (i = 0; i < count; i++)
+    {
+      w->fill[batch[i]] = 0;
+      w->free_list[w->num_free++] = batch[i];
+    }
+    if (w->current < 0)
+    {
+      w->current = w->free_list[--w->num_free];
+    }
+  }
+  pthread_mutex_unlock(&w->lock);
+  return NULL;
+}
+
+runway_writer *runway_writer_open(const char *filename, int backend)
+{
+  runway_writer *w;
+  void *memory;
+  int i;
+
+  if (backend != RUNWAY_WRITER_AUTO && backend != RUNWAY_WRITER_URING &&
+      backend != RUNWAY_WRITER_THREAD)
+  {
+    return NULL;
+  }
+  if ((w = calloc(1, sizeof(runway_writer))) == NULL)
+  {
+    return NULL;
+  }
+  if (posix_memalign(&memory, WRITER_ALIGN,
+                     (size_t)WRITER_BUFFERS * WRITER_BUFFER_SIZE) != 0)
+  {
+    free(w);
+    return NULL;
+  }
+  w->memory = memory;
+  w->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (w->fd < 0)
+  {
+    free(w->memory);
+    free(w);
+    return NULL;
+  }
+
+  w->backend = RUNWAY_WRITER_THREAD;
+  if (backend != RUNWAY_WRITER_THREAD)
+  {
+    if (uring_setup(&w->ring, WRITER_RING_DEPTH) == 0)
+    {
+      w->backend = RUNWAY_WRITER_URING;
+    }
+    else if (backend == RUNWAY_WRITER_URING)
+    {
+      close(w->fd);
+      free(w->memory);
+      free(w);
+      return NULL;
+    }
+  }
+  w->stats.backend = w->backend;
+
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->ready, NULL);
+  for (i = WRITER_BUFFERS - 1; i > 0; i--)
+  {
+    w->free_list[w->num_free++] = i;
+  }
+  w->current = 0;
+
+  if (pthread_create(&w->tid, NULL, flusher, w) != 0)
+  {
+    if (w->backend == RUNWAY_WRITER_URING)
+    {
+      uring_close(&w->ring);
+    }
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->ready);
+    close(w->fd);
+    free(w->memory);
+    free(w);
+    return NULL;
+  }
+  return w;
+}
+
+void runway_writer_write(runway_writer *w, const char *record, size_t length)
+{
+  if (length > WRITER_BUFFER_SIZE)
+  {
+    length = WRITER_BUFFER_SIZE;
+  }
+
+  pthread_mutex_lock(&w->lock);
+  if (w->current >= 0 &&
+      w->fill[w->current] + length > WRITER_BUFFER_SIZE)
+  {
+    seal_current(w);
+  }
+  if (w->current < 0)
+  {
+    /* Every buffer is waiting for the disk: drop rather than wait */
+    w->stats.dropped++;
+    pthread_mutex_unlock(&w->lock);
+    return;
+  }
+  memcpy(BUFFER(w, w->current) + w->fill[w->current], record, length);
+  w->fill[w->current] += length;
+  w->stats.records++;
+  w->stats.bytes += (long long)length;
+  pthread_mutex_unlock(&w->lock);
+}
+
+void runway_writer_event(const runway_event *event, void *user)
+{
+  char record[WRITER_RECORD_SIZE];
+  int length;
+
+  if (event->kind != RUNWAY_EVENT_MESSAGE)
+  {
+    return;
+  }
+  length = snprintf(record, sizeof(record), "%s\n", event->message);
+  if (length >= (int)sizeof(record))
+  {
+    length = (int)sizeof(record) - 1;
+    record[length - 1] = '\n';
+  }
+  runway_writer_write((runway_writer *)user, record, (size_t)length);
+}
+
+int runway_writer_close(runway_writer *w, runway_writer_stats *stats)
+{
+  int result;
+
+  pthread_mutex_lock(&w->lock);
+  w->closing = 1;
+  pthread_cond_signal(&w->ready);
+  pthread_mutex_unlock(&w->lock);
+  pthread_join(w->tid, NULL);
+
+  if (w->backend == RUNWAY_WRITER_URING)
+  {
+    uring_close(&w->ring);
+  }
+  if (close(w->fd) != 0)
+  {
+    w->stats.errors++;
+  }
+  result = w->stats.errors == 0 ? 0 : -1;
+  if (stats != NULL)
+  {
+    *stats = w->stats;
+  }
+  pthread_mutex_destroy(&w->lock);
+  pthread_cond_destroy(&w->ready);
+  free(w->memory);
+  free(w);
+  return result;
+}